@@ -1,82 +1,183 @@
 `timescale 1ns / 1ps
 
+// Receptor SPI (modo 0) do Pico: audio estereo e acesso ao banco de registradores (control_regs).
+// Toda janela de CS comeca com uma palavra de comando de 16 bits, MSB primeiro:
+//   [15:8] comando, [7:0] endereco
+//   CMD_AUDIO (0x00): seguem quadros de 2*BITS bits, canal esquerdo primeiro, depois o direito
+//   CMD_WRITE (0x80): seguem palavras de 16 bits gravadas a partir do endereco (autoincremento)
+//   CMD_READ  (0x40): o FPGA devolve no MISO uma palavra de 16 bits por palavra recebida,
+//                     a partir do endereco (autoincremento); o MOSI e ignorado
+// Outro comando descarta o resto da janela. O contador de bits zera quando o CS e ativado, entao
+// o Pico pode mandar um quadro por janela de CS ou uma rajada de quadros seguidos na mesma janela.
+// SCLK, MOSI e CS sao sincronizados com o clock de 25 MHz: SCLK maximo = clk/4 (6,25 MHz).
+// O MISO muda na descida do SCLK ja sincronizada (ate 3 ciclos depois da borda real), entao
+// leituras precisam de SCLK mais lento: com 1 MHz sobram ~380 ns ate a subida seguinte.
 module comunication #(
-    parameter int unsigned clock_max = 25_000_000
+    parameter int unsigned clock_max = 25_000_000,
+    parameter int unsigned BITS = 16,        // bits por canal (multiplo de 8 se LSB_BYTE_FIRST = 1)
+    parameter bit LSB_BYTE_FIRST = 1'b0,     // 1: cada canal chega em bytes little endian
+    parameter bit ACTIVE_LOW = 1'b1          // CS ativo em nivel baixo, como o Pico aciona
 )(
     input logic clk_25mhz,
     input logic sclk_in, //clock vindo do pico
-    input logic mosi_in, //input data from pico 
-    input logic active,
+    input logic mosi_in, //input data from pico
+    input logic active,  //chip select vindo do pico
     input logic reset,
 
-    output logic data_ready,
-    output logic [15:0] audio_out  //testar se pacotes de 16 bits fazem uma transnmissão lisa
+    output logic frame_ready,                 //pulso de 1 ciclo a cada quadro completo
+    output logic [BITS-1:0] audio_left,
+    output logic [BITS-1:0] audio_right,
+
+    //barramento do banco de registradores
+    output logic reg_we,                      //pulso de 1 ciclo com reg_addr/reg_wdata validos
+    output logic reg_re,                      //pulso de 1 ciclo em que reg_rdata e capturado (reg_addr = endereco lido)
+    output logic [7:0] reg_addr,
+    output logic [15:0] reg_wdata,
+    input  logic [15:0] reg_rdata,            //combinacional a partir de reg_addr
+    output logic miso_out
 );
 
-typedef enum logic {
-        IDLE,    
-        RECEIVING  
-    } state_t;
+localparam int unsigned FRAME_BITS = 2 * BITS;
+localparam int unsigned WORD_BITS = 16;
+localparam logic [7:0] CMD_AUDIO = 8'h00;
+localparam logic [7:0] CMD_WRITE = 8'h80;
+localparam logic [7:0] CMD_READ  = 8'h40;
+
+initial begin
+    if (FRAME_BITS < WORD_BITS) $error("comunication: BITS deve ser >= 8");
+end
+
+typedef enum logic [2:0] {
+    COM_HEADER,   //recebendo a palavra de comando
+    COM_AUDIO,
+    COM_WRITE,
+    COM_READ,
+    COM_IGNORE    //comando desconhecido: espera o CS subir
+} com_state_t;
+
+com_state_t state;
 
-state_t state;       
-logic [15:0] shift_reg; 
-logic [3:0]  bit_counter;
+logic [FRAME_BITS-1:0] shift_reg;
+logic [$clog2(FRAME_BITS)-1:0] bit_counter;
+logic [FRAME_BITS-1:0] next_frame;
+logic [15:0] next_word;
+logic [15:0] miso_shift;
+logic miso_load;                              //carrega reg_rdata no proximo ciclo (reg_addr ja atualizado)
 
-logic sclk_d1, sclk_d2; 
+//a leitura acontece no proprio ciclo de miso_load, antes de reg_addr avancar: control_regs ve o
+//endereco que esta sendo capturado junto com reg_re
+assign reg_re = miso_load;
 
-//tornando o clock do pico um clock conhecido pelo fpga
-always_ff @(posedge clk_25mhz) begin 
-        sclk_d1 <= sclk_in;
-        sclk_d2 <= sclk_d1;
-end 
+//tornando os sinais do pico conhecidos pelo fpga (dois flops de sincronismo + um de historico no SCLK)
+logic [2:0] sclk_sync;
+logic [1:0] mosi_sync;
+logic [1:0] cs_sync;
 
-logic sclk_posedge;  //por algum motivo não funcionou quando criei e atribui junto
-assign sclk_posedge = (sclk_d1 == 1'b1) && (sclk_d2 == 1'b0);
+always_ff @(posedge clk_25mhz) begin
+        sclk_sync <= {sclk_sync[1:0], sclk_in};
+        mosi_sync <= {mosi_sync[0], mosi_in};         //mesmo atraso do SCLK: o bit e lido junto com a borda
+        cs_sync   <= {cs_sync[0], active ^ ACTIVE_LOW}; //1 = selecionado, qualquer que seja a polaridade
+end
+
+logic sclk_posedge, sclk_negedge;
+logic selected;
+logic word_done, frame_done;
+assign sclk_posedge = (sclk_sync[1] == 1'b1) && (sclk_sync[2] == 1'b0);
+assign sclk_negedge = (sclk_sync[1] == 1'b0) && (sclk_sync[2] == 1'b1);
+assign selected = cs_sync[1];
+assign next_frame = {shift_reg[FRAME_BITS-2:0], mosi_sync[1]};
+assign next_word = next_frame[WORD_BITS-1:0];
+assign word_done = (bit_counter == WORD_BITS - 1);
+assign frame_done = (bit_counter == FRAME_BITS - 1);
+assign miso_out = miso_shift[15];
+
+//reordena os bytes de um canal que chegou LSB primeiro
+function automatic logic [BITS-1:0] ordenar_canal(input logic [BITS-1:0] palavra);
+    logic [BITS-1:0] resultado;
+    resultado = palavra;
+    if (LSB_BYTE_FIRST) begin
+        for (int b = 0; b < BITS / 8; b++) begin
+            resultado[b*8 +: 8] = palavra[BITS - 8 - b*8 +: 8];
+        end
+    end
+    ordenar_canal = resultado;
+endfunction
 
 always_ff @(posedge clk_25mhz or posedge reset)
     begin
         if(reset == 1'b1) begin  //implementação do botão de desligar ou desativar comunicação
-            state <= IDLE;
-            shift_reg <= 16'b0000000000000000;
-            bit_counter <= 4'b0000;
-            data_ready <= 1'b0;
-            audio_out <= 16'b0000000000000000;
-        
-
-        end else begin //a cada pulso de clock do pico, executar
-            if (data_ready == 1'b1) begin
-                data_ready <= 1'b0;
+            state <= COM_HEADER;
+            shift_reg <= '0;
+            bit_counter <= '0;
+            frame_ready <= 1'b0;
+            audio_left <= '0;
+            audio_right <= '0;
+            reg_we <= 1'b0;
+            reg_addr <= '0;
+            reg_wdata <= '0;
+            miso_shift <= '0;
+            miso_load <= 1'b0;
+
+        end else begin
+            frame_ready <= 1'b0;
+            reg_we <= 1'b0;
+            miso_load <= 1'b0;
+
+            //o endereco avanca depois de cada palavra gravada ou lida
+            if (reg_we) reg_addr <= reg_addr + 1'b1;
+
+            //palavra de leitura: captura o registrador apontado e avanca o endereco
+            if (miso_load) begin
+                miso_shift <= reg_rdata;
+                reg_addr <= reg_addr + 1'b1;
             end
 
-            case(state)
-                IDLE: begin //modo ociosos, sem novos dados chegando
-                    if(active == 1'b1) begin
-                        state <= RECEIVING;
-                        shift_reg <= 16'b0000000000000000;
-                        bit_counter <= 4'b0000;
+            if (!selected) begin
+                state <= COM_HEADER;
+                bit_counter <= '0; //CS inativo: descarta quadro parcial e realinha na proxima janela
+                miso_shift <= '0;
+            end else if (sclk_posedge) begin
+                shift_reg <= next_frame;
+                bit_counter <= bit_counter + 1'b1;
+
+                case (state)
+                    COM_HEADER: if (word_done) begin
+                        bit_counter <= '0;
+                        reg_addr <= next_word[7:0];
+                        case (next_word[15:8])
+                            CMD_AUDIO: state <= COM_AUDIO;
+                            CMD_WRITE: state <= COM_WRITE;
+                            CMD_READ: begin
+                                state <= COM_READ;
+                                miso_load <= 1'b1;
+                            end
+                            default: state <= COM_IGNORE;
+                        endcase
+                    end
+
+                    COM_AUDIO: if (frame_done) begin
+                        audio_left <= ordenar_canal(next_frame[FRAME_BITS-1:BITS]);
+                        audio_right <= ordenar_canal(next_frame[BITS-1:0]);
+                        frame_ready <= 1'b1;
+                        bit_counter <= '0;
                     end
-                end  
-
-                RECEIVING: begin //estado em que a comunicação está acontecendo, recebendo dados do pico
-                    if(active == 1'b0) begin
-                        state <= IDLE;
-                        
-                    end else if (sclk_posedge) begin
-                        shift_reg <= {shift_reg[14:0], mosi_in};
-
-                        if(bit_counter == 4'd15) begin
-                            audio_out <= {shift_reg[14:0], mosi_in};
-                            state <= RECEIVING;
-                            data_ready <= 1'b1;
-                            bit_counter <= 4'b0000;
-
-                        end else begin
-                            bit_counter <= bit_counter + 1'b1;
-                        end
+
+                    COM_WRITE: if (word_done) begin
+                        reg_wdata <= next_word;
+                        reg_we <= 1'b1;
+                        bit_counter <= '0;
+                    end
+
+                    COM_READ: if (word_done) begin
+                        miso_load <= 1'b1;
+                        bit_counter <= '0;
                     end
-                end 
 
-            endcase
-        end 
-    end 
+                    default: bit_counter <= '0;
+                endcase
+            end else if (sclk_negedge && state == COM_READ && bit_counter != '0) begin
+                miso_shift <= {miso_shift[14:0], 1'b0}; //proximo bit para a subida seguinte do SCLK
+            end
+        end
+    end
 endmodule
@@ -0,0 +1,194 @@
+`timescale 1ns / 1ps
+
+// Banco de registradores de 16 bits escrito e lido pelo Pico pelo mesmo SPI do audio
+// (comandos CMD_WRITE / CMD_READ de comunication.sv). Troca parametros, bypass e ordem da
+// cadeia de efeitos sem ressintetizar e sem parar o audio.
+//
+//   0x00  ID         (leitura)  ID_VALUE
+//   0x01  STATUS     (leitura)  [0] overflow, [1] underflow, [2] FIFO cheia, [3] FIFO vazia,
+//                               [4] pedido de quadros ao Pico
+//   0x02  FIFO_LEVEL (leitura)  quadros na FIFO
+//   0x03  FRAMES_LO  (leitura)  quadros recebidos, bits 15:0 (a leitura congela FRAMES_HI)
+//   0x04  FRAMES_HI  (leitura)  quadros recebidos, bits 31:16 do valor congelado
+//   0x05  UNDERFLOWS (leitura)  leituras com a FIFO vazia (satura em 0xFFFF)
+//   0x06  OVERFLOWS  (leitura)  quadros descartados com a FIFO cheia (satura em 0xFFFF)
+//   0x08  CONTROL    (escrita)  [0] 1 = limpa as flags da FIFO, [1] 1 = zera os contadores
+//   0x09  BYPASS                um bit por estagio, 1 = bypass
+//   0x0A  ORDER_HI              posicoes 4..7 da ordem (4 bits cada), aplicada junto com ORDER
+//   0x0B  ORDER                 posicoes 0..3 da ordem; a escrita aplica ORDER_HI:ORDER na cadeia
+//   0x0C  RATE_HI               bits 31:16 da taxa de amostragem em Hz, aplicada junto com RATE
+//   0x0D  RATE                  bits 15:0; a escrita aplica RATE_HI:RATE no sample_clock (ou no BCLK do I2S)
+//   0x10+ PARAM[estagio]        stage_param de cada estagio
+//   0x20  COEF_ADDR             {estagio[3:0], indice[7:0]} do proximo coeficiente de biquad
+//   0x21  COEF_HI               bits 17:16 do coeficiente (sinal)
+//   0x22  COEF_LO               bits 15:0; a escrita grava {COEF_HI, COEF_LO} e avanca COEF_ADDR
+//
+// Enderecos sem registrador leem 0 e ignoram escrita. Uma rajada CMD_WRITE a partir de 0x0A grava
+// a ordem inteira; cada coeficiente de 18 bits e uma rajada HI, LO a partir de 0x21 (o endereco
+// do coeficiente avanca sozinho, entao COEF_ADDR so e escrito no primeiro).
+module control_regs #(
+    parameter int unsigned NUM_STAGES = 5,
+    parameter logic [15:0] ID_VALUE = 16'hEF01,
+    parameter logic [NUM_STAGES-1:0] BYPASS_RESET = '1,
+    parameter logic [16*NUM_STAGES-1:0] PARAM_RESET = '0,
+    parameter logic [31:0] RATE_RESET = 32'd44_100
+)(
+    input logic clk_25mhz,
+    input logic reset,
+
+    //barramento vindo de comunication
+    input  logic reg_we,
+    input  logic reg_re,
+    input  logic [7:0] reg_addr,
+    input  logic [15:0] reg_wdata,
+    output logic [15:0] reg_rdata,
+
+    //estado e eventos do caminho de audio
+    input logic frame_received,                  //pulso por quadro recebido do Pico
+    input logic [15:0] fifo_level,
+    input logic fifo_full,
+    input logic fifo_empty,
+    input logic fifo_overflow,                   //flags fixas da sample_fifo
+    input logic fifo_underflow,
+    input logic overflow_event,                  //pulso: quadro descartado
+    input logic underflow_event,                 //pulso: leitura com a FIFO vazia
+    input logic fifo_request,                    //linha de pedido de quadros ao Pico
+    output logic clear_fifo_flags,               //pulso para a sample_fifo
+    output logic [31:0] sample_rate,             //taxa do sample_clock em Hz
+
+    //controle da cadeia de efeitos
+    output logic [NUM_STAGES-1:0] bypass,
+    output logic [4*NUM_STAGES-1:0] order,
+    output logic [16*NUM_STAGES-1:0] stage_param,
+    output logic coef_we,
+    output logic [11:0] coef_addr,
+    output logic signed [17:0] coef_data
+);
+
+localparam logic [7:0] REG_ID         = 8'h00;
+localparam logic [7:0] REG_STATUS     = 8'h01;
+localparam logic [7:0] REG_FIFO_LEVEL = 8'h02;
+localparam logic [7:0] REG_FRAMES_LO  = 8'h03;
+localparam logic [7:0] REG_FRAMES_HI  = 8'h04;
+localparam logic [7:0] REG_UNDERFLOWS = 8'h05;
+localparam logic [7:0] REG_OVERFLOWS  = 8'h06;
+localparam logic [7:0] REG_CONTROL    = 8'h08;
+localparam logic [7:0] REG_BYPASS     = 8'h09;
+localparam logic [7:0] REG_ORDER_HI   = 8'h0A;
+localparam logic [7:0] REG_ORDER      = 8'h0B;
+localparam logic [7:0] REG_RATE_HI    = 8'h0C;
+localparam logic [7:0] REG_RATE       = 8'h0D;
+localparam logic [7:0] REG_PARAM      = 8'h10;
+localparam logic [7:0] REG_COEF_ADDR  = 8'h20;
+localparam logic [7:0] REG_COEF_HI    = 8'h21;
+localparam logic [7:0] REG_COEF_LO    = 8'h22;
+
+initial begin
+    if (NUM_STAGES > 8) $error("control_regs: no maximo 8 estagios (ORDER_HI:ORDER e PARAM em 0x10..0x17)");
+end
+
+//ordem fixa 0, 1, 2... na posicao de cada estagio
+function automatic logic [31:0] identity_order();
+    logic [31:0] result;
+    for (int p = 0; p < 8; p++) result[4*p +: 4] = 4'(p);
+    return result;
+endfunction
+
+logic [31:0] order_q;                            //ordem aplicada
+logic [15:0] order_hi_q;                         //ORDER_HI esperando a escrita de ORDER
+logic [15:0] rate_hi_q;                          //RATE_HI esperando a escrita de RATE
+logic [31:0] frames;
+logic [15:0] frames_hi_snap;
+logic [15:0] underflows, overflows;
+logic [1:0] coef_hi_q;
+
+assign order = order_q[4*NUM_STAGES-1:0];
+
+always_ff @(posedge clk_25mhz or posedge reset) begin
+    if (reset) begin
+        bypass <= BYPASS_RESET;
+        stage_param <= PARAM_RESET;
+        order_q <= identity_order();
+        order_hi_q <= 16'(identity_order() >> 16);
+        sample_rate <= RATE_RESET;
+        rate_hi_q <= RATE_RESET[31:16];
+        coef_addr <= '0;
+        coef_hi_q <= '0;
+        coef_we <= 1'b0;
+        coef_data <= '0;
+        clear_fifo_flags <= 1'b0;
+        frames <= '0;
+        frames_hi_snap <= '0;
+        underflows <= '0;
+        overflows <= '0;
+    end else begin
+        coef_we <= 1'b0;
+        clear_fifo_flags <= 1'b0;
+
+        //coeficiente gravado no ciclo anterior: avanca para o proximo
+        if (coef_we) coef_addr <= coef_addr + 1'b1;
+
+        if (frame_received) frames <= frames + 1'b1;
+        if (underflow_event && underflows != 16'hFFFF) underflows <= underflows + 1'b1;
+        if (overflow_event && overflows != 16'hFFFF) overflows <= overflows + 1'b1;
+
+        //FRAMES_LO e FRAMES_HI lidos em sequencia formam um valor so, mesmo com quadros chegando:
+        //HI e congelado no mesmo ciclo em que comunication captura LO (reg_re com reg_addr = FRAMES_LO)
+        if (reg_re && reg_addr == REG_FRAMES_LO) frames_hi_snap <= frames[31:16];
+
+        if (reg_we) begin
+            if (reg_addr >= REG_PARAM && reg_addr < REG_PARAM + NUM_STAGES) begin
+                stage_param[16*(reg_addr - REG_PARAM) +: 16] <= reg_wdata;
+            end
+            case (reg_addr)
+                REG_CONTROL: begin
+                    clear_fifo_flags <= reg_wdata[0];
+                    if (reg_wdata[1]) begin
+                        frames <= '0;
+                        frames_hi_snap <= '0;
+                        underflows <= '0;
+                        overflows <= '0;
+                    end
+                end
+                REG_BYPASS: bypass <= reg_wdata[NUM_STAGES-1:0];
+                REG_ORDER_HI: order_hi_q <= reg_wdata;
+                REG_ORDER: order_q <= {order_hi_q, reg_wdata};
+                REG_RATE_HI: rate_hi_q <= reg_wdata;
+                REG_RATE: sample_rate <= {rate_hi_q, reg_wdata};
+                REG_COEF_ADDR: coef_addr <= reg_wdata[11:0];
+                REG_COEF_HI: coef_hi_q <= reg_wdata[1:0];
+                REG_COEF_LO: begin
+                    coef_data <= {coef_hi_q, reg_wdata};
+                    coef_we <= 1'b1;
+                end
+                default: ;
+            endcase
+        end
+    end
+end
+
+always_comb begin
+    reg_rdata = '0;
+    if (reg_addr >= REG_PARAM && reg_addr < REG_PARAM + NUM_STAGES) begin
+        reg_rdata = stage_param[16*(reg_addr - REG_PARAM) +: 16];
+    end
+    case (reg_addr)
+        REG_ID: reg_rdata = ID_VALUE;
+        REG_STATUS: reg_rdata = {11'd0, fifo_request, fifo_empty, fifo_full, fifo_underflow, fifo_overflow};
+        REG_FIFO_LEVEL: reg_rdata = fifo_level;
+        REG_FRAMES_LO: reg_rdata = frames[15:0];
+        REG_FRAMES_HI: reg_rdata = frames_hi_snap;
+        REG_UNDERFLOWS: reg_rdata = underflows;
+        REG_OVERFLOWS: reg_rdata = overflows;
+        REG_BYPASS: reg_rdata = 16'(bypass);
+        REG_ORDER_HI: reg_rdata = order_q[31:16];
+        REG_ORDER: reg_rdata = order_q[15:0];
+        REG_RATE_HI: reg_rdata = sample_rate[31:16];
+        REG_RATE: reg_rdata = sample_rate[15:0];
+        REG_COEF_ADDR: reg_rdata = {4'd0, coef_addr};
+        REG_COEF_HI: reg_rdata = {{14{coef_hi_q[1]}}, coef_hi_q};
+        default: ;
+    endcase
+end
+
+endmodule
@@ -1,5 +1,7 @@
-module dac_driver #( 
-    parameter int unsigned clock_max = 25_000_000
+module dac_driver #(
+    parameter int unsigned clock_max = 25_000_000,
+    parameter int unsigned SCLK_DIV = 2,           //periodo do SCLK em ciclos de clk_25mhz (par, >= 2): 2 -> 12,5MHz
+    parameter logic [3:0] DAC_CONFIG = 4'b1000     //bits de comando enviados antes dos 12 bits de dado
 )(
     //recepção de dados de audio(modificado ou original)
     input logic clk_25mhz,
@@ -8,100 +10,103 @@ module dac_driver #(
     input logic reset, //apenas para dar start e integrar com outros módulo auxilares
 
     //pinos do protocolo de comunicação com modulo dac fisico
-    output logic sclk_out, 
+    output logic sclk_out,
     output logic mosi_out, //mandando bit a bit para slave spi
     output logic active_out,
     input logic miso_out //util p/ debbug, verificar se dac está convertendo certo
 );
 
 //modos da FSM p/ master SPI
-typedef enum logic {
-    DAC_IDLE, 
-    DAC_TRANSFER
+typedef enum logic [1:0] {
+    DAC_IDLE,
+    DAC_TRANSFER,
+    DAC_FINISH   //meio periodo com o CS ainda baixo depois da ultima descida do SCLK
     //DAC_RECEIVING  //opcional, util para debug
 }state_t;
 
 state_t state;
 
-//geração do clock para comunicação com slave SPI, tecnica vista em sala
-localparam int sclk_div_count = 5; //para clock de 2mhz, um pulso a cada 
-logic [$clog2(sclk_div_count) -1:0] count_clock = '0; //var de tamanho de 2Mhz, para contar pulsos
-logic internal_clock = 1'b0;
+initial begin
+    if (SCLK_DIV < 2 || (SCLK_DIV % 2) != 0) $error("dac_driver: SCLK_DIV deve ser par e >= 2 (recebido %0d)", SCLK_DIV);
+end
 
-logic [15:0] shift_reg; 
-logic [3:0]  bit_counter;
-logic busy;
+//gerador de clock enable: um pulso a cada meio periodo do SCLK, sem clock derivado
+localparam int unsigned HALF_PERIOD = SCLK_DIV / 2;
+logic [$clog2(HALF_PERIOD + 1)-1:0] phase_count;
+logic sclk_enable;
+
+assign sclk_enable = (phase_count == HALF_PERIOD - 1);
 
 always_ff @(posedge clk_25mhz or posedge reset) begin
     if(reset) begin
-        count_clock <= '0;
-        internal_clock <= 1'b0;
-
-    end else if(state == DAC_TRANSFER) begin
-        if(count_clock == sclk_div_count) begin  //contador de clock interno atingido
-            count_clock <= '0;
-            internal_clock <= ~internal_clock;
-
-        end else begin  //continuar incrementação
-            count_clock <= count_clock + 1;
-        end
-    end else begin  //se manter em modo DAC_IDLE
-        count_clock <= '0;
-        internal_clock <= 1'b0;
-    end 
+        phase_count <= '0;
+    end else if(state == DAC_IDLE || sclk_enable) begin
+        phase_count <= '0;
+    end else begin  //continuar incrementação
+        phase_count <= phase_count + 1'b1;
+    end
 end
 
-assign sclk_out = internal_clock;
+logic [15:0] shift_reg;
+logic [3:0]  bit_counter;
+logic [15:0] dac_word;
+
+assign dac_word = {DAC_CONFIG, mosi_in[15:4]};  //cabeçalho + truncamento de dados para saída
 
-//FSM para controle principal do master e slave SPI
+//FSM para controle principal do master SPI (modo 0)
+//o bit muda junto com a descida do SCLK e o DAC le na subida: meio periodo de setup e meio de hold
 always_ff @(posedge clk_25mhz or posedge reset) begin
-    if(reset) begin 
+    if(reset) begin
         state <= DAC_IDLE;
         active_out <= 1'b1;
         mosi_out <= 1'b0;
-        busy<= 1'b0;
+        sclk_out <= 1'b0;
+        shift_reg <= '0;
         bit_counter <= 4'b0000;
-    end
 
-    busy <= 1'b0;
-    case (state)
-        DAC_IDLE: begin
-            active_out <= 1'b1;
-            mosi_out <= 1'b0;
-            busy <= 1'b0;
-
-            if(data_ready) begin 
-                state <= DAC_TRANSFER;
-                
-                shift_reg <= {1'b1, 3'b000, mosi_in[15:4]};  //configurando mensagem p/ SPI slave com cabeçalo e truncamento de dados para saída
-                bit_counter <= 4'b0000;
-                active_out <= 1'b0;
-                busy <= 1'b1;
-            end 
-        end
-
-        DAC_TRANSFER: begin 
-            busy <= 1'b1;
-            active_out <= 1'b0;
-
-            if(count_clock == sclk_div_count) begin 
-                if(internal_clock == 1'b0) begin 
-                    if(bit_counter < 16) begin 
-                        mosi_out <= shift_reg[15];
-                        shift_reg <= shift_reg << 1; //desliza bits, do maior para menor
-                        bit_counter <= bit_counter + 1;
-                        state <= DAC_TRANSFER;
-                    
-                    end else begin //após mandar uma amostra, volta para DAC_IDLE e espera próximo sinal data_ready
-                        state <= DAC_IDLE;
-                        active_out <= 1'b1;
-                        busy <= 1'b0;
+    end else begin
+        case (state)
+            DAC_IDLE: begin
+                active_out <= 1'b1;
+                sclk_out <= 1'b0;
+
+                if(data_ready) begin
+                    state <= DAC_TRANSFER;
+                    active_out <= 1'b0;
+                    mosi_out <= dac_word[15];          //primeiro bit ja fica estavel antes da primeira subida
+                    shift_reg <= {dac_word[14:0], 1'b0};
+                    bit_counter <= 4'b0000;
+                end
+            end
+
+            DAC_TRANSFER: begin
+                if(sclk_enable) begin
+                    if(sclk_out == 1'b0) begin
+                        sclk_out <= 1'b1;                  //subida: DAC captura mosi_out
+                    end else begin
+                        sclk_out <= 1'b0;                  //descida: proximo bit
+                        if(bit_counter == 4'd15) begin
+                            state <= DAC_FINISH;
+                        end else begin
+                            mosi_out <= shift_reg[15];
+                            shift_reg <= shift_reg << 1; //desliza bits, do maior para menor
+                            bit_counter <= bit_counter + 1'b1;
+                        end
                     end
                 end
             end
 
-        end
-    endcase        
+            DAC_FINISH: begin //após mandar uma amostra, volta para DAC_IDLE e espera próximo sinal data_ready
+                if(sclk_enable) begin
+                    state <= DAC_IDLE;
+                    active_out <= 1'b1;
+                    mosi_out <= 1'b0;
+                end
+            end
+
+            default: state <= DAC_IDLE;
+        endcase
+    end
 end
 
 
@@ -0,0 +1,114 @@
+`timescale 1ns / 1ps
+
+// Linha de atraso circular em block RAM com tap de leitura variavel em tempo de execucao.
+// delay tem FRAC_BITS bits fracionarios: 1.0 e a ultima amostra escrita, e o tap fracionario
+// e a interpolacao linear entre int(delay) e int(delay) + 1. Cada leitura usa a porta de leitura
+// da EBR em dois ciclos seguidos e read_done sai 3 ciclos depois de read_start; a escrita tem
+// porta propria e pode acontecer em qualquer ciclo.
+//
+// Uso de EBR no ECP5 (blocos de 18 kbit, 16384 bits de dado por bloco com palavra de 32 bits):
+//   DEPTH = 1024, LANES = 2 -> 2 EBR  (ate 1022 amostras, 21 ms a 48 kHz)
+//   DEPTH = 8192, LANES = 2 -> 16 EBR (ate 8190 amostras, 170 ms a 48 kHz)
+// O LFE5U-25F tem 56 EBR.
+module delay_line #(
+    parameter int unsigned DEPTH = 1024,   // potencia de 2; atraso maximo = DEPTH - 2 amostras
+    parameter int unsigned LANES = 2,      // canais de 16 bits por palavra
+    parameter int unsigned FRAC_BITS = 8
+)(
+    input logic clk_25mhz,
+    input logic reset,
+
+    input logic write_en,                  //grava a amostra e avanca o ponteiro de escrita
+    input logic [16*LANES-1:0] write_data,
+
+    input logic read_start,
+    input logic [$clog2(DEPTH)+FRAC_BITS-1:0] delay,
+    output logic read_done,                //pulso com tap_data valido
+    output logic [16*LANES-1:0] tap_data
+);
+
+localparam int unsigned ADDR_BITS = $clog2(DEPTH);
+localparam logic [ADDR_BITS-1:0] MAX_DELAY = DEPTH - 2;
+
+initial begin
+    if ((1 << ADDR_BITS) != DEPTH) $error("delay_line: DEPTH deve ser potencia de 2 (recebido %0d)", DEPTH);
+end
+
+//a memoria comeca em silencio (valor inicial da EBR na configuracao), sem reset
+logic [16*LANES-1:0] mem [0:DEPTH-1];
+initial begin
+    for (int i = 0; i < DEPTH; i++) mem[i] = '0;
+end
+
+logic [ADDR_BITS-1:0] wr_ptr;              //proxima posicao a gravar
+logic [16*LANES-1:0] rd_data;
+
+//atraso inteiro limitado a [1, MAX_DELAY]; nos limites a fracao e descartada
+logic [ADDR_BITS-1:0] delay_int;
+logic [FRAC_BITS-1:0] delay_frac;
+logic [ADDR_BITS-1:0] near_addr;
+
+always_comb begin
+    delay_int = delay[ADDR_BITS+FRAC_BITS-1:FRAC_BITS];
+    delay_frac = delay[FRAC_BITS-1:0];
+    if (delay_int == '0) begin
+        delay_int = 1;
+        delay_frac = '0;
+    end else if (delay_int >= MAX_DELAY) begin
+        delay_int = MAX_DELAY;
+        delay_frac = '0;
+    end
+end
+
+assign near_addr = wr_ptr - delay_int;
+
+//sequencia de leitura: ciclo 0 le o tap perto, ciclo 1 le o tap longe, ciclo 2 interpola
+logic reading_near, reading_far;
+logic [ADDR_BITS-1:0] far_addr;
+logic [FRAC_BITS-1:0] frac_q;
+logic [16*LANES-1:0] near_q;
+
+always_ff @(posedge clk_25mhz) begin
+    if (write_en) mem[wr_ptr] <= write_data;
+    if (read_start) rd_data <= mem[near_addr];
+    else if (reading_near) rd_data <= mem[far_addr];
+end
+
+always_ff @(posedge clk_25mhz or posedge reset) begin
+    if (reset) begin
+        wr_ptr <= '0;
+        reading_near <= 1'b0;
+        reading_far <= 1'b0;
+        read_done <= 1'b0;
+    end else begin
+        if (write_en) wr_ptr <= wr_ptr + 1'b1;
+        reading_near <= read_start;
+        reading_far <= reading_near;
+        read_done <= reading_far;
+    end
+end
+
+always_ff @(posedge clk_25mhz) begin
+    if (read_start) begin
+        far_addr <= near_addr - 1'b1;
+        frac_q <= delay_frac;
+    end
+    if (reading_near) near_q <= rd_data;
+    if (reading_far) begin
+        for (int lane = 0; lane < LANES; lane++) begin
+            tap_data[16*lane +: 16] <= interpolate(near_q[16*lane +: 16], rd_data[16*lane +: 16], frac_q);
+        end
+    end
+end
+
+//near + (far - near) * frac; o resultado fica entre as duas amostras e cabe em 16 bits
+function automatic logic signed [15:0] interpolate(input logic signed [15:0] near, input logic signed [15:0] far,
+                                                   input logic [FRAC_BITS-1:0] frac);
+    logic signed [16:0] diff;
+    logic signed [17+FRAC_BITS:0] step;
+    diff = far - near;
+    step = diff * $signed({1'b0, frac});
+    return near + 16'(step >>> FRAC_BITS);
+endfunction
+
+endmodule
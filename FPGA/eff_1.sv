@@ -1,30 +1,52 @@
+`timescale 1ns / 1ps
+
+// Hard clipping nos dois canais, um estagio de pipeline.
 module eff_1 #(
     parameter int unsigned clock_max = 25_000_000
-)( 
+)(
     input  logic clk_25mhz,
-    input  logic data_ready,               // sinal para começar o processamento de áudio
-    input  logic signed [15:0] audio_in,   // entrada PCM
-    output logic signed [15:0] audio_out,  // saída com efeito
-    output logic process_status            // status do processamento
+    input  logic reset,
+    input  logic bypass,
+    input  logic signed [15:0] clip_level,  // limite de clipping (ajustavel), positivo
+
+    input  logic in_valid,                  // quadro PCM de entrada
+    output logic in_ready,
+    input  logic signed [15:0] in_left,
+    input  logic signed [15:0] in_right,
+
+    output logic out_valid,                 // quadro com efeito
+    input  logic out_ready,
+    output logic signed [15:0] out_left,
+    output logic signed [15:0] out_right
 );
 
-    // Limite de clipping (ajustável)
-    parameter signed [15:0] CLIP_LEVEL = 10000;
+    localparam int unsigned LATENCY = effect_pkg::CLIP_LATENCY;
+
+    logic advance;
+    logic signed [15:0] wet_left, wet_right;
+
+    function automatic logic signed [15:0] clip(input logic signed [15:0] sample, input logic signed [15:0] level);
+        if (sample > level)
+            return level;
+        else if (sample < -level)
+            return -level;
+        else
+            return sample;
+    endfunction
+
+    effect_pipe #(.LATENCY(LATENCY), .WIDTH(32)) u_pipe (
+        .clk_25mhz(clk_25mhz), .reset(reset), .bypass(bypass),
+        .in_valid(in_valid), .in_ready(in_ready), .in_data({in_left, in_right}),
+        .advance(advance), .accept(),
+        .wet_data({wet_left, wet_right}),
+        .out_valid(out_valid), .out_ready(out_ready), .out_data({out_left, out_right})
+    );
 
+    // Aplicando hard clipping
     always_ff @(posedge clk_25mhz) begin
-        if (data_ready) begin
-            process_status <= 1'b1;
-
-            // Aplicando hard clipping
-            if (audio_in > CLIP_LEVEL)
-                audio_out <= CLIP_LEVEL;
-            else if (audio_in < -CLIP_LEVEL)
-                audio_out <= -CLIP_LEVEL;
-            else
-                audio_out <= audio_in;
-        end else begin
-            process_status <= 1'b0;
-            audio_out <= 16'sd0; // ou manter o último valor, se preferir
+        if (advance) begin
+            wet_left <= clip(in_left, clip_level);
+            wet_right <= clip(in_right, clip_level);
         end
     end
 
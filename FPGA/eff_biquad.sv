@@ -0,0 +1,182 @@
+`timescale 1ns / 1ps
+
+// Motor de biquads IIR multiplexado no tempo: SECTIONS secoes de segunda ordem em cascata
+// nos dois canais, todas com um unico multiplicador 18x18 registrado (MULT18X18D do ECP5).
+// Cada secao e Direct Form I com acumulador de 40 bits:
+//   y[n] = b0*x[n] + b1*x[n-1] + b2*x[n-2] - a1*y[n-1] - a2*y[n-2]
+// Coeficientes em Q3.15 de 18 bits (-4 a 4) num banco de registradores escrito por coef_we:
+// endereco = secao * 5 + {0: b0, 1: b1, 2: b2, 3: a1, 4: a2}. No reset toda secao e identidade
+// (b0 = 1.0). Estados em 16 bits com saturacao; arredondamento na saida de cada secao.
+// Seis ciclos por secao por canal; latencia fixa: effect_pkg::BIQUAD_LATENCY.
+module eff_biquad #(
+    parameter int unsigned clock_max = 25_000_000,
+    parameter int unsigned SECTIONS = 4
+)(
+    input  logic clk_25mhz,
+    input  logic reset,
+    input  logic bypass,
+
+    input  logic coef_we,
+    input  logic [7:0] coef_addr,
+    input  logic signed [17:0] coef_data,
+
+    input  logic in_valid,
+    output logic in_ready,
+    input  logic signed [15:0] in_left,
+    input  logic signed [15:0] in_right,
+
+    output logic out_valid,
+    input  logic out_ready,
+    output logic signed [15:0] out_left,
+    output logic signed [15:0] out_right
+);
+
+    localparam int unsigned COEFS = 5 * SECTIONS;
+    localparam int unsigned COEF_FRAC = 15;
+    localparam logic signed [17:0] COEF_ONE = 18'sd1 <<< COEF_FRAC;
+    localparam int unsigned SEC_BITS = (SECTIONS > 1) ? $clog2(SECTIONS) : 1;
+
+    initial begin
+        if (COEFS > 256) $error("eff_biquad: no maximo 51 secoes (endereco de 8 bits)");
+    end
+
+    // --- Banco de coeficientes ---
+    logic signed [17:0] coef [0:COEFS-1];
+
+    always_ff @(posedge clk_25mhz or posedge reset) begin
+        if (reset) begin
+            for (int i = 0; i < COEFS; i++) coef[i] <= (i % 5 == 0) ? COEF_ONE : 18'sd0;
+        end else if (coef_we && coef_addr < COEFS) begin
+            coef[coef_addr] <= coef_data;
+        end
+    end
+
+    // --- Estados: indice {canal, secao} ---
+    logic signed [15:0] x1 [0:2*SECTIONS-1];
+    logic signed [15:0] x2 [0:2*SECTIONS-1];
+    logic signed [15:0] y1 [0:2*SECTIONS-1];
+    logic signed [15:0] y2 [0:2*SECTIONS-1];
+
+    // --- Sequenciador ---
+    logic start, done;
+    logic signed [15:0] wet_left, wet_right;
+
+    effect_step #(.WIDTH(32)) u_step (
+        .clk_25mhz(clk_25mhz), .reset(reset), .bypass(bypass),
+        .in_valid(in_valid), .in_ready(in_ready), .in_data({in_left, in_right}),
+        .start(start), .done(done), .wet_data({wet_left, wet_right}),
+        .out_valid(out_valid), .out_ready(out_ready), .out_data({out_left, out_right})
+    );
+
+    logic running;
+    logic channel;                            //0 = esquerdo, 1 = direito
+    logic [SEC_BITS-1:0] section;
+    logic [2:0] step;                         //0..4 emite um produto, 5 fecha a secao
+    logic signed [15:0] section_in;           //entrada da secao atual
+    logic signed [15:0] right_q;
+
+    logic [SEC_BITS:0] state_index;
+    logic signed [15:0] operand;
+    logic signed [17:0] coef_operand;
+
+    assign state_index = {channel, section};
+
+    always_comb begin
+        case (step)
+            3'd0: operand = section_in;
+            3'd1: operand = x1[state_index];
+            3'd2: operand = x2[state_index];
+            3'd3: operand = y1[state_index];
+            default: operand = y2[state_index];
+        endcase
+        coef_operand = coef[section * 5 + ((step > 3'd4) ? 3'd4 : step)];
+    end
+
+    // --- Multiplicador unico (entradas combinacionais, produto registrado) e acumulador ---
+    logic signed [35:0] product;
+    logic subtract;                           //termos de a1 e a2 entram com sinal trocado
+    logic signed [39:0] acc;
+    logic signed [39:0] acc_final;
+    logic signed [15:0] section_out;
+
+    always_ff @(posedge clk_25mhz) begin
+        product <= $signed({{2{operand[15]}}, operand}) * coef_operand;
+        subtract <= (step >= 3'd3);
+    end
+
+    assign acc_final = acc + (subtract ? -40'(product) : 40'(product));
+
+    //arredonda Q.15 -> inteiro e satura em 16 bits
+    always_comb begin : arredonda
+        logic signed [39:0] rounded;
+        rounded = (acc_final + (40'sd1 <<< (COEF_FRAC - 1))) >>> COEF_FRAC;
+        if (rounded > 40'sd32767)
+            section_out = 16'sd32767;
+        else if (rounded < -40'sd32768)
+            section_out = -16'sd32768;
+        else
+            section_out = rounded[15:0];
+    end
+
+    always_ff @(posedge clk_25mhz or posedge reset) begin
+        if (reset) begin
+            running <= 1'b0;
+            done <= 1'b0;
+            channel <= 1'b0;
+            section <= '0;
+            step <= '0;
+            acc <= '0;
+            section_in <= '0;
+            right_q <= '0;
+            wet_left <= '0;
+            wet_right <= '0;
+            for (int i = 0; i < 2*SECTIONS; i++) begin
+                x1[i] <= '0;
+                x2[i] <= '0;
+                y1[i] <= '0;
+                y2[i] <= '0;
+            end
+        end else begin
+            done <= 1'b0;
+
+            if (start) begin
+                running <= 1'b1;
+                channel <= 1'b0;
+                section <= '0;
+                step <= '0;
+                section_in <= in_left;
+                right_q <= in_right;
+            end else if (running) begin
+                //o produto emitido no passo anterior entra no acumulador
+                if (step == 3'd1) acc <= subtract ? -40'(product) : 40'(product);
+                else if (step != 3'd0) acc <= acc_final;
+
+                if (step != 3'd5) begin
+                    step <= step + 1'b1;
+                end else begin
+                    //fecha a secao: desloca os estados e passa a saida adiante
+                    x2[state_index] <= x1[state_index];
+                    x1[state_index] <= section_in;
+                    y2[state_index] <= y1[state_index];
+                    y1[state_index] <= section_out;
+                    step <= '0;
+
+                    if (section != SECTIONS - 1) begin
+                        section <= section + 1'b1;
+                        section_in <= section_out;
+                    end else if (channel == 1'b0) begin
+                        wet_left <= section_out;
+                        channel <= 1'b1;
+                        section <= '0;
+                        section_in <= right_q;
+                    end else begin
+                        wet_right <= section_out;
+                        running <= 1'b0;
+                        done <= 1'b1;
+                    end
+                end
+            end
+        end
+    end
+
+endmodule
@@ -0,0 +1,86 @@
+`timescale 1ns / 1ps
+
+// Chorus nos dois canais: tap fracionario de uma delay_line modulado por um LFO triangular,
+// misturado meio a meio com o sinal seco.
+//   atraso = BASE_DELAY + depth * tri(fase), em amostras com 8 bits fracionarios
+// Parametro do estagio: [15:8] rate (passo do LFO), [7:0] depth (desvio maximo em amostras).
+// A fase do LFO tem 26 bits e anda rate * 256 por amostra: a 48 kHz, rate = 1 da ~0,18 Hz.
+// Latencia fixa: effect_pkg::CHORUS_LATENCY.
+module eff_chorus #(
+    parameter int unsigned clock_max = 25_000_000,
+    parameter int unsigned DEPTH = 1024,          // 2 EBR
+    parameter int unsigned BASE_DELAY = 480       // 10 ms a 48 kHz; BASE_DELAY + 255 <= DEPTH - 2
+)(
+    input  logic clk_25mhz,
+    input  logic reset,
+    input  logic bypass,
+    input  logic [15:0] rate_depth,
+
+    input  logic in_valid,
+    output logic in_ready,
+    input  logic signed [15:0] in_left,
+    input  logic signed [15:0] in_right,
+
+    output logic out_valid,
+    input  logic out_ready,
+    output logic signed [15:0] out_left,
+    output logic signed [15:0] out_right
+);
+
+    localparam int unsigned ADDR_BITS = $clog2(DEPTH);
+    localparam int unsigned FRAC_BITS = 8;
+    localparam int unsigned PHASE_BITS = 26;
+
+    initial begin
+        if (BASE_DELAY + 255 > DEPTH - 2) $error("eff_chorus: BASE_DELAY + 255 precisa caber em DEPTH - 2");
+    end
+
+    logic start, read_done;
+    logic signed [15:0] in_left_q, in_right_q;
+    logic signed [15:0] tap_left, tap_right;
+    logic signed [16:0] sum_left, sum_right;
+
+    logic [PHASE_BITS-1:0] lfo_phase;
+    logic [15:0] lfo_tri;                         //0..1 em Q0.16
+    logic [23:0] lfo_offset;                      //depth * tri em Q8.16
+    logic [ADDR_BITS+FRAC_BITS-1:0] delay;
+
+    effect_step #(.WIDTH(32)) u_step (
+        .clk_25mhz(clk_25mhz), .reset(reset), .bypass(bypass),
+        .in_valid(in_valid), .in_ready(in_ready), .in_data({in_left, in_right}),
+        .start(start), .done(read_done), .wet_data({sum_left[16:1], sum_right[16:1]}),
+        .out_valid(out_valid), .out_ready(out_ready), .out_data({out_left, out_right})
+    );
+
+    //triangulo: sobe na primeira metade da fase e desce na segunda
+    assign lfo_tri = lfo_phase[PHASE_BITS-1] ? ~lfo_phase[PHASE_BITS-2 -: 16] : lfo_phase[PHASE_BITS-2 -: 16];
+    assign lfo_offset = rate_depth[7:0] * lfo_tri;
+    assign delay = (ADDR_BITS + FRAC_BITS)'((BASE_DELAY << FRAC_BITS) + lfo_offset[23:8]);
+
+    always_ff @(posedge clk_25mhz or posedge reset) begin
+        if (reset) begin
+            lfo_phase <= '0;
+        end else if (start) begin
+            lfo_phase <= lfo_phase + {rate_depth[15:8], 8'b0};
+        end
+    end
+
+    always_ff @(posedge clk_25mhz) begin
+        if (start) begin
+            in_left_q <= in_left;
+            in_right_q <= in_right;
+        end
+    end
+
+    assign sum_left = in_left_q + tap_left;
+    assign sum_right = in_right_q + tap_right;
+
+    //a linha guarda o sinal seco; a escrita vem depois da leitura do tap
+    delay_line #(.DEPTH(DEPTH), .LANES(2), .FRAC_BITS(FRAC_BITS)) u_delay_line (
+        .clk_25mhz(clk_25mhz), .reset(reset),
+        .write_en(read_done), .write_data({in_left_q, in_right_q}),
+        .read_start(start), .delay(delay),
+        .read_done(read_done), .tap_data({tap_left, tap_right})
+    );
+
+endmodule
@@ -0,0 +1,86 @@
+`timescale 1ns / 1ps
+
+// Eco com realimentacao nos dois canais sobre uma delay_line:
+//   w[n] = x[n] + FEEDBACK * w[n - D]   (gravado na linha)
+//   y[n] = x[n] + MIX * w[n - D]
+// D vem do parametro do estagio em amostras inteiras (1 a DEPTH - 2).
+// FEEDBACK e MIX em Q1.15, somas com saturacao. Latencia fixa: effect_pkg::ECHO_LATENCY.
+module eff_echo #(
+    parameter int unsigned clock_max = 25_000_000,
+    parameter int unsigned DEPTH = 8192,                 // 16 EBR, ate 170 ms a 48 kHz
+    parameter logic signed [15:0] FEEDBACK = 16'sh4000,  // 0.5
+    parameter logic signed [15:0] MIX = 16'sh4000        // 0.5
+)(
+    input  logic clk_25mhz,
+    input  logic reset,
+    input  logic bypass,
+    input  logic [15:0] delay_samples,
+
+    input  logic in_valid,
+    output logic in_ready,
+    input  logic signed [15:0] in_left,
+    input  logic signed [15:0] in_right,
+
+    output logic out_valid,
+    input  logic out_ready,
+    output logic signed [15:0] out_left,
+    output logic signed [15:0] out_right
+);
+
+    localparam int unsigned ADDR_BITS = $clog2(DEPTH);
+    localparam int unsigned FRAC_BITS = 8;
+
+    logic start, read_done;
+    logic signed [15:0] in_left_q, in_right_q;
+    logic signed [15:0] tap_left, tap_right;
+    logic signed [15:0] wet_left, wet_right;
+    logic signed [15:0] line_left, line_right;
+    logic [ADDR_BITS+FRAC_BITS-1:0] delay;
+
+    //x + coef * tap, com o produto em Q1.15 e saturacao em 16 bits
+    function automatic logic signed [15:0] mix_saturate(input logic signed [15:0] x, input logic signed [15:0] tap,
+                                                        input logic signed [15:0] coef);
+        logic signed [31:0] product;
+        logic signed [17:0] sum;
+        product = tap * coef;
+        sum = x + (product >>> 15);
+        if (sum > 18'sd32767)
+            return 16'sd32767;
+        else if (sum < -18'sd32768)
+            return -16'sd32768;
+        else
+            return sum[15:0];
+    endfunction
+
+    effect_step #(.WIDTH(32)) u_step (
+        .clk_25mhz(clk_25mhz), .reset(reset), .bypass(bypass),
+        .in_valid(in_valid), .in_ready(in_ready), .in_data({in_left, in_right}),
+        .start(start), .done(read_done), .wet_data({wet_left, wet_right}),
+        .out_valid(out_valid), .out_ready(out_ready), .out_data({out_left, out_right})
+    );
+
+    //atraso inteiro (fracao zero), limitado ao tamanho da linha
+    assign delay = (delay_samples > DEPTH - 2) ? {ADDR_BITS'(DEPTH - 2), {FRAC_BITS{1'b0}}}
+                                               : {delay_samples[ADDR_BITS-1:0], {FRAC_BITS{1'b0}}};
+
+    always_ff @(posedge clk_25mhz) begin
+        if (start) begin
+            in_left_q <= in_left;
+            in_right_q <= in_right;
+        end
+    end
+
+    assign line_left = mix_saturate(in_left_q, tap_left, FEEDBACK);
+    assign line_right = mix_saturate(in_right_q, tap_right, FEEDBACK);
+    assign wet_left = mix_saturate(in_left_q, tap_left, MIX);
+    assign wet_right = mix_saturate(in_right_q, tap_right, MIX);
+
+    //le o tap no start e grava w[n] junto com o resultado, depois da leitura
+    delay_line #(.DEPTH(DEPTH), .LANES(2), .FRAC_BITS(FRAC_BITS)) u_delay_line (
+        .clk_25mhz(clk_25mhz), .reset(reset),
+        .write_en(read_done), .write_data({line_left, line_right}),
+        .read_start(start), .delay(delay),
+        .read_done(read_done), .tap_data({tap_left, tap_right})
+    );
+
+endmodule
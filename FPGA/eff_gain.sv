@@ -0,0 +1,59 @@
+`timescale 1ns / 1ps
+
+// Ganho (drive) nos dois canais: multiplicacao em Q4.12 com arredondamento e saturacao.
+// Dois estagios: o produto registrado cabe em um bloco DSP do ECP5, a saturacao vem depois.
+module eff_gain #(
+    parameter int unsigned clock_max = 25_000_000
+)(
+    input  logic clk_25mhz,
+    input  logic reset,
+    input  logic bypass,
+    input  logic signed [15:0] gain,        // Q4.12: 16'h1000 = 1.0, ate ~8x
+
+    input  logic in_valid,
+    output logic in_ready,
+    input  logic signed [15:0] in_left,
+    input  logic signed [15:0] in_right,
+
+    output logic out_valid,
+    input  logic out_ready,
+    output logic signed [15:0] out_left,
+    output logic signed [15:0] out_right
+);
+
+    localparam int unsigned LATENCY = effect_pkg::GAIN_LATENCY;
+    localparam int unsigned FRAC_BITS = 12;
+
+    logic advance;
+    logic signed [31:0] product_left, product_right;
+    logic signed [15:0] wet_left, wet_right;
+
+    function automatic logic signed [15:0] round_saturate(input logic signed [31:0] product);
+        logic signed [31:0] scaled;
+        scaled = (product + (32'sd1 <<< (FRAC_BITS - 1))) >>> FRAC_BITS;
+        if (scaled > 32'sd32767)
+            return 16'sd32767;
+        else if (scaled < -32'sd32768)
+            return -16'sd32768;
+        else
+            return scaled[15:0];
+    endfunction
+
+    effect_pipe #(.LATENCY(LATENCY), .WIDTH(32)) u_pipe (
+        .clk_25mhz(clk_25mhz), .reset(reset), .bypass(bypass),
+        .in_valid(in_valid), .in_ready(in_ready), .in_data({in_left, in_right}),
+        .advance(advance), .accept(),
+        .wet_data({wet_left, wet_right}),
+        .out_valid(out_valid), .out_ready(out_ready), .out_data({out_left, out_right})
+    );
+
+    always_ff @(posedge clk_25mhz) begin
+        if (advance) begin
+            product_left <= in_left * gain;
+            product_right <= in_right * gain;
+            wet_left <= round_saturate(product_left);
+            wet_right <= round_saturate(product_right);
+        end
+    end
+
+endmodule
@@ -0,0 +1,217 @@
+`timescale 1ns / 1ps
+
+// Cadeia de NUM_STAGES efeitos em sequencia, ligados por valid/ready.
+// STAGE_EFFECTS escolhe o efeito de cada estagio (ids em effect_pkg, estagio 0 nos bits
+// baixos); stage_param leva uma palavra de 16 bits por estagio e bypass um bit por estagio.
+// Cada efeito tem latencia fixa, com ou sem bypass, entao a cadeia inteira tem LATENCY
+// ciclos da entrada ate out_valid. Estagios de pipeline (eff_1, eff_gain) aceitam um quadro
+// por ciclo; estagios de varios ciclos (eco, chorus) um quadro a cada LATENCY ciclos.
+// A 96 kHz sobram ~260 ciclos de 25MHz por amostra.
+// coef_we/coef_addr/coef_data escrevem os coeficientes dos estagios eff_biquad:
+// coef_addr = {estagio[3:0], indice do coeficiente[7:0]}.
+// Com RUNTIME_ORDER = 1 a ordem dos estagios vem da entrada order (4 bits por posicao, posicao 0
+// nos bits baixos: o estagio que roda nessa posicao). Ordem que nao e permutacao vira a ordem
+// fixa 0, 1, 2... Nesse modo a cadeia processa um quadro por vez (um quadro a cada LATENCY
+// ciclos, folgado para audio), entao os estagios nunca seguram uns aos outros, o ready nao
+// passa pelos multiplexadores e a ordem nova so e aplicada com a cadeia vazia.
+module effect_chain #(
+    parameter int unsigned clock_max = 25_000_000,
+    parameter int unsigned NUM_STAGES = 2,
+    parameter logic [8*NUM_STAGES-1:0] STAGE_EFFECTS = {effect_pkg::EFFECT_CLIP, effect_pkg::EFFECT_GAIN},
+    parameter int unsigned ECHO_DEPTH = 8192,      //quadros na delay_line do eco (16 EBR)
+    parameter int unsigned CHORUS_DEPTH = 1024,    //quadros na delay_line do chorus (2 EBR)
+    parameter bit RUNTIME_ORDER = 1'b0             //1: ordem dos estagios pela entrada order
+)(
+    input logic clk_25mhz,
+    input logic reset,
+    input logic [NUM_STAGES-1:0] bypass,
+    input logic [16*NUM_STAGES-1:0] stage_param,
+    input logic [4*NUM_STAGES-1:0] order,
+
+    input logic coef_we,
+    input logic [11:0] coef_addr,
+    input logic signed [17:0] coef_data,
+
+    input logic in_valid,
+    output logic in_ready,
+    input logic signed [15:0] in_left,
+    input logic signed [15:0] in_right,
+
+    output logic out_valid,
+    input logic out_ready,
+    output logic signed [15:0] out_left,
+    output logic signed [15:0] out_right
+);
+
+function automatic int unsigned chain_latency();
+    int unsigned total = 0;
+    for (int i = 0; i < NUM_STAGES; i++) total += effect_pkg::effect_latency(STAGE_EFFECTS[8*i +: 8]);
+    return total;
+endfunction
+
+localparam int unsigned LATENCY = chain_latency();
+localparam int unsigned POS_BITS = (NUM_STAGES > 1) ? $clog2(NUM_STAGES) : 1;
+
+initial begin
+    if (NUM_STAGES > 16) $error("effect_chain: no maximo 16 estagios (coef_addr e order usam 4 bits)");
+end
+
+//entrada e saida de cada estagio; o roteamento abaixo liga os estagios na ordem pedida
+wire [NUM_STAGES-1:0] st_in_valid, st_in_ready;
+wire [NUM_STAGES-1:0] st_out_valid, st_out_ready;
+wire signed [15:0] st_in_left [0:NUM_STAGES-1];
+wire signed [15:0] st_in_right [0:NUM_STAGES-1];
+wire signed [15:0] st_out_left [0:NUM_STAGES-1];
+wire signed [15:0] st_out_right [0:NUM_STAGES-1];
+
+generate
+    for (genvar i = 0; i < NUM_STAGES; i++) begin : g_stage
+        localparam effect_pkg::effect_id_t EFFECT = STAGE_EFFECTS[8*i +: 8];
+        logic signed [15:0] param;
+        assign param = stage_param[16*i +: 16];
+
+        if (EFFECT == effect_pkg::EFFECT_CLIP) begin : g_clip
+            eff_1 #(.clock_max(clock_max)
+                )u_eff(
+                    .clk_25mhz(clk_25mhz), .reset(reset), .bypass(bypass[i]), .clip_level(param),
+                    .in_valid(st_in_valid[i]), .in_ready(st_in_ready[i]),
+                    .in_left(st_in_left[i]), .in_right(st_in_right[i]),
+                    .out_valid(st_out_valid[i]), .out_ready(st_out_ready[i]),
+                    .out_left(st_out_left[i]), .out_right(st_out_right[i])
+                );
+        end else if (EFFECT == effect_pkg::EFFECT_GAIN) begin : g_gain
+            eff_gain #(.clock_max(clock_max)
+                )u_eff(
+                    .clk_25mhz(clk_25mhz), .reset(reset), .bypass(bypass[i]), .gain(param),
+                    .in_valid(st_in_valid[i]), .in_ready(st_in_ready[i]),
+                    .in_left(st_in_left[i]), .in_right(st_in_right[i]),
+                    .out_valid(st_out_valid[i]), .out_ready(st_out_ready[i]),
+                    .out_left(st_out_left[i]), .out_right(st_out_right[i])
+                );
+        end else if (EFFECT == effect_pkg::EFFECT_ECHO) begin : g_echo
+            eff_echo #(.clock_max(clock_max), .DEPTH(ECHO_DEPTH)
+                )u_eff(
+                    .clk_25mhz(clk_25mhz), .reset(reset), .bypass(bypass[i]), .delay_samples(param),
+                    .in_valid(st_in_valid[i]), .in_ready(st_in_ready[i]),
+                    .in_left(st_in_left[i]), .in_right(st_in_right[i]),
+                    .out_valid(st_out_valid[i]), .out_ready(st_out_ready[i]),
+                    .out_left(st_out_left[i]), .out_right(st_out_right[i])
+                );
+        end else if (EFFECT == effect_pkg::EFFECT_CHORUS) begin : g_chorus
+            eff_chorus #(.clock_max(clock_max), .DEPTH(CHORUS_DEPTH)
+                )u_eff(
+                    .clk_25mhz(clk_25mhz), .reset(reset), .bypass(bypass[i]), .rate_depth(param),
+                    .in_valid(st_in_valid[i]), .in_ready(st_in_ready[i]),
+                    .in_left(st_in_left[i]), .in_right(st_in_right[i]),
+                    .out_valid(st_out_valid[i]), .out_ready(st_out_ready[i]),
+                    .out_left(st_out_left[i]), .out_right(st_out_right[i])
+                );
+        end else if (EFFECT == effect_pkg::EFFECT_BIQUAD) begin : g_biquad
+            eff_biquad #(.clock_max(clock_max), .SECTIONS(effect_pkg::BIQUAD_SECTIONS)
+                )u_eff(
+                    .clk_25mhz(clk_25mhz), .reset(reset), .bypass(bypass[i]),
+                    .coef_we(coef_we && coef_addr[11:8] == i), .coef_addr(coef_addr[7:0]), .coef_data(coef_data),
+                    .in_valid(st_in_valid[i]), .in_ready(st_in_ready[i]),
+                    .in_left(st_in_left[i]), .in_right(st_in_right[i]),
+                    .out_valid(st_out_valid[i]), .out_ready(st_out_ready[i]),
+                    .out_left(st_out_left[i]), .out_right(st_out_right[i])
+                );
+        end else begin : g_none
+            initial begin
+                if (EFFECT != effect_pkg::EFFECT_NONE) $error("effect_chain: efeito %0d desconhecido no estagio %0d", EFFECT, i);
+                //passagem combinacional: dois estagios vazios trocados fechariam um laco pelos multiplexadores
+                if (RUNTIME_ORDER) $error("effect_chain: estagio %0d vazio nao e permitido com RUNTIME_ORDER", i);
+            end
+            assign st_out_valid[i] = st_in_valid[i];
+            assign st_in_ready[i] = st_out_ready[i];
+            assign st_out_left[i] = st_in_left[i];
+            assign st_out_right[i] = st_in_right[i];
+        end
+    end
+endgenerate
+
+generate
+    if (!RUNTIME_ORDER) begin : g_fixed_order
+        //estagio i alimenta o estagio i + 1, com o ready voltando pela mesma ligacao
+        assign st_in_valid[0] = in_valid;
+        assign in_ready = st_in_ready[0];
+        assign st_in_left[0] = in_left;
+        assign st_in_right[0] = in_right;
+
+        for (genvar i = 1; i < NUM_STAGES; i++) begin : g_link
+            assign st_in_valid[i] = st_out_valid[i-1];
+            assign st_out_ready[i-1] = st_in_ready[i];
+            assign st_in_left[i] = st_out_left[i-1];
+            assign st_in_right[i] = st_out_right[i-1];
+        end
+
+        assign out_valid = st_out_valid[NUM_STAGES-1];
+        assign st_out_ready[NUM_STAGES-1] = out_ready;
+        assign out_left = st_out_left[NUM_STAGES-1];
+        assign out_right = st_out_right[NUM_STAGES-1];
+    end else begin : g_runtime_order
+        logic [3:0] stage_at [0:NUM_STAGES-1];     //ordem aplicada: estagio em cada posicao
+        logic [POS_BITS-1:0] pos_of [0:NUM_STAGES-1]; //inversa: posicao de cada estagio
+        logic [3:0] next_stage_at [0:NUM_STAGES-1];
+        logic order_change;
+        logic busy;                                //um quadro dentro da cadeia
+
+        //a ordem pedida so vale se for permutacao de 0..NUM_STAGES-1
+        always_comb begin : valida_ordem
+            logic [NUM_STAGES-1:0] seen;
+            logic ok;
+            seen = '0;
+            ok = 1'b1;
+            for (int p = 0; p < NUM_STAGES; p++) begin
+                if (order[4*p +: 4] >= NUM_STAGES || seen[order[4*p +: 4]]) ok = 1'b0;
+                else seen[order[4*p +: 4]] = 1'b1;
+            end
+            for (int p = 0; p < NUM_STAGES; p++) next_stage_at[p] = ok ? order[4*p +: 4] : 4'(p);
+        end
+
+        always_comb begin
+            order_change = 1'b0;
+            for (int p = 0; p < NUM_STAGES; p++) if (next_stage_at[p] != stage_at[p]) order_change = 1'b1;
+        end
+
+        //com a cadeia vazia a entrada para enquanto a ordem nova e aplicada
+        assign in_ready = !busy && !order_change;
+
+        always_ff @(posedge clk_25mhz or posedge reset) begin
+            if (reset) begin
+                busy <= 1'b0;
+                for (int p = 0; p < NUM_STAGES; p++) begin
+                    stage_at[p] <= 4'(p);
+                    pos_of[p] <= POS_BITS'(p);
+                end
+            end else begin
+                if (in_valid && in_ready) busy <= 1'b1;
+                else if (out_valid && out_ready) busy <= 1'b0;
+
+                if (!busy && order_change) begin
+                    for (int p = 0; p < NUM_STAGES; p++) begin
+                        stage_at[p] <= next_stage_at[p];
+                        pos_of[next_stage_at[p]] <= POS_BITS'(p);
+                    end
+                end
+            end
+        end
+
+        //cada estagio le a saida do estagio da posicao anterior; so o ultimo ve o out_ready de fora
+        for (genvar i = 0; i < NUM_STAGES; i++) begin : g_route
+            logic [3:0] source;
+            assign source = stage_at[(pos_of[i] == 0) ? 0 : pos_of[i] - 1'b1];
+
+            assign st_in_valid[i] = (pos_of[i] == 0) ? (in_valid && in_ready) : st_out_valid[source];
+            assign st_in_left[i] = (pos_of[i] == 0) ? in_left : st_out_left[source];
+            assign st_in_right[i] = (pos_of[i] == 0) ? in_right : st_out_right[source];
+            assign st_out_ready[i] = (pos_of[i] == NUM_STAGES - 1) ? out_ready : 1'b1;
+        end
+
+        assign out_valid = st_out_valid[stage_at[NUM_STAGES-1]];
+        assign out_left = st_out_left[stage_at[NUM_STAGES-1]];
+        assign out_right = st_out_right[stage_at[NUM_STAGES-1]];
+    end
+endgenerate
+
+endmodule
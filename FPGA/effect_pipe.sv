@@ -0,0 +1,66 @@
+`timescale 1ns / 1ps
+
+// Casca de handshake valid/ready para um estagio de efeito com latencia fixa.
+// O nucleo do efeito so registra quando advance = 1 e entrega wet_data alinhado com o
+// ultimo estagio; a casca atrasa o quadro original pela mesma latencia, entao o bypass
+// nao muda o tempo de passagem. O bypass e amostrado junto com o quadro na entrada.
+module effect_pipe #(
+    parameter int unsigned LATENCY = 1,  // ciclos da entrada ate out_valid, >= 1
+    parameter int unsigned WIDTH = 32    // quadro estereo {L, R}
+)(
+    input logic clk_25mhz,
+    input logic reset,
+    input logic bypass,
+
+    input logic in_valid,
+    output logic in_ready,
+    input logic [WIDTH-1:0] in_data,
+
+    output logic advance,                //enable dos registradores do nucleo
+    output logic accept,                 //quadro entrando no pipeline neste ciclo
+    input logic [WIDTH-1:0] wet_data,    //saida do nucleo no ultimo estagio
+
+    output logic out_valid,
+    input logic out_ready,
+    output logic [WIDTH-1:0] out_data
+);
+
+initial begin
+    if (LATENCY < 1) $error("effect_pipe: LATENCY deve ser >= 1");
+end
+
+logic [LATENCY-1:0] valid_pipe;
+logic [LATENCY-1:0] bypass_pipe;
+logic [WIDTH-1:0] dry_pipe [0:LATENCY-1];
+
+//o pipeline inteiro para quando o ultimo estagio tem quadro e a saida nao aceita
+assign advance = !valid_pipe[LATENCY-1] || out_ready;
+assign in_ready = advance;
+assign accept = in_valid && advance;
+
+always_ff @(posedge clk_25mhz or posedge reset) begin
+    if (reset) begin
+        valid_pipe <= '0;
+        bypass_pipe <= '0;
+    end else if (advance) begin
+        valid_pipe[0] <= in_valid;
+        bypass_pipe[0] <= bypass;
+        for (int i = 1; i < LATENCY; i++) begin
+            valid_pipe[i] <= valid_pipe[i-1];
+            bypass_pipe[i] <= bypass_pipe[i-1];
+        end
+    end
+end
+
+//caminho seco sem reset, so dado
+always_ff @(posedge clk_25mhz) begin
+    if (advance) begin
+        dry_pipe[0] <= in_data;
+        for (int i = 1; i < LATENCY; i++) dry_pipe[i] <= dry_pipe[i-1];
+    end
+end
+
+assign out_valid = valid_pipe[LATENCY-1];
+assign out_data = bypass_pipe[LATENCY-1] ? dry_pipe[LATENCY-1] : wet_data;
+
+endmodule
@@ -0,0 +1,34 @@
+`timescale 1ns / 1ps
+
+// Identificadores dos efeitos da effect_chain e a latencia fixa de cada um.
+// Compilar antes dos modulos de efeito (iverilog: primeiro arquivo da lista).
+package effect_pkg;
+
+    typedef logic [7:0] effect_id_t;
+
+    localparam effect_id_t EFFECT_NONE = 8'd0; // passagem direta, latencia 0
+    localparam effect_id_t EFFECT_CLIP = 8'd1; // eff_1: hard clipping, parametro = limite
+    localparam effect_id_t EFFECT_GAIN = 8'd2; // eff_gain: ganho Q4.12, parametro = ganho
+    localparam effect_id_t EFFECT_ECHO = 8'd3; // eff_echo: parametro = atraso em amostras
+    localparam effect_id_t EFFECT_CHORUS = 8'd4; // eff_chorus: parametro = {rate, depth}
+    localparam effect_id_t EFFECT_BIQUAD = 8'd5; // eff_biquad: coeficientes pelo barramento coef_*
+
+    localparam int unsigned CLIP_LATENCY = 1;
+    localparam int unsigned GAIN_LATENCY = 2;
+    localparam int unsigned ECHO_LATENCY = 4;   // leitura da delay_line (3) + saida do effect_step
+    localparam int unsigned CHORUS_LATENCY = 4;
+    localparam int unsigned BIQUAD_SECTIONS = 4;
+    localparam int unsigned BIQUAD_LATENCY = 2 * 6 * BIQUAD_SECTIONS + 2; // 6 ciclos por secao e canal
+
+    function automatic int unsigned effect_latency(input effect_id_t id);
+        case (id)
+            EFFECT_CLIP: return CLIP_LATENCY;
+            EFFECT_GAIN: return GAIN_LATENCY;
+            EFFECT_ECHO: return ECHO_LATENCY;
+            EFFECT_CHORUS: return CHORUS_LATENCY;
+            EFFECT_BIQUAD: return BIQUAD_LATENCY;
+            default:     return 0;
+        endcase
+    endfunction
+
+endpackage
@@ -0,0 +1,60 @@
+`timescale 1ns / 1ps
+
+// Casca de handshake valid/ready para efeitos de varios ciclos por quadro (linha de atraso,
+// filtros multiplexados no tempo). Aceita um quadro quando o nucleo esta livre, pulsa start,
+// espera done e segura a saida ate out_ready. Com o nucleo de tempo fixo a latencia e fixa;
+// em bypass o nucleo continua rodando (o estado do efeito acompanha o audio) e sai o quadro seco.
+module effect_step #(
+    parameter int unsigned WIDTH = 32    // quadro estereo {L, R}
+)(
+    input logic clk_25mhz,
+    input logic reset,
+    input logic bypass,
+
+    input logic in_valid,
+    output logic in_ready,
+    input logic [WIDTH-1:0] in_data,
+
+    output logic start,                  //quadro aceito: o nucleo comeca neste ciclo
+    input logic done,                    //pulso do nucleo com wet_data valido
+    input logic [WIDTH-1:0] wet_data,
+
+    output logic out_valid,
+    input logic out_ready,
+    output logic [WIDTH-1:0] out_data
+);
+
+logic busy;
+logic bypass_q;
+logic [WIDTH-1:0] dry_q;
+
+assign in_ready = !busy && (!out_valid || out_ready);
+assign start = in_valid && in_ready;
+
+always_ff @(posedge clk_25mhz or posedge reset) begin
+    if (reset) begin
+        busy <= 1'b0;
+        bypass_q <= 1'b0;
+        out_valid <= 1'b0;
+    end else begin
+        if (out_valid && out_ready) out_valid <= 1'b0;
+
+        if (start) begin
+            busy <= 1'b1;
+            bypass_q <= bypass;
+        end
+
+        if (done) begin
+            busy <= 1'b0;
+            out_valid <= 1'b1;
+        end
+    end
+end
+
+//so dado, sem reset
+always_ff @(posedge clk_25mhz) begin
+    if (start) dry_q <= in_data;
+    if (done) out_data <= bypass_q ? dry_q : wet_data;
+end
+
+endmodule
@@ -0,0 +1,129 @@
+`timescale 1ns / 1ps
+
+// Serializador I2S / justificado a esquerda para DACs de audio (PCM5102, CS4344...).
+// O BCLK roda sem parar a 64*fs (dois slots de 32 bits) e vem de um NCO de 32 bits sobre o
+// clk_25mhz: as bordas caem na grade de 40 ns, com a frequencia media exata de 64*fs.
+// Cada borda sai ate um ciclo (40 ns) depois da posicao ideal. A 48 kHz o BCLK e 3,072 MHz e o
+// meio periodo ideal e 162,8 ns (4,07 ciclos): os meios periodos saem com 4 ou 5 ciclos, e o jitter
+// de borda e de cerca de +-13% do meio periodo (+-20 ns). DACs que geram o clock interno por PLL a
+// partir do BCLK (PCM5102 com SCK em terra) filtram isso. DACs sem PLL, que usam o MCLK como
+// referencia do conversor (CS4344, por exemplo), precisam de um MCLK de verdade (oscilador externo
+// ou PLL da FPGA em multiplo de fs, com o BCLK dividido dele); este modulo nao gera MCLK.
+// fs vem do registrador RATE (control_regs) e pode mudar em tempo de execucao, como no
+// sample_clock: o incremento e recalculado no ciclo seguinte sem zerar a fase.
+// SDATA e LRCLK mudam na descida do BCLK; o DAC le na subida.
+module i2s_driver #(
+    parameter int unsigned clock_max = 25_000_000,
+    parameter int unsigned RATE_BITS = 17,     // taxa maxima 131071 Hz
+    parameter int unsigned DATA_BITS = 16,     // 16 ou 24 (ate 31), alinhado ao MSB do slot
+    parameter bit LEFT_JUSTIFIED = 1'b0        // 0: I2S (MSB um BCLK depois do LRCLK, LRCLK baixo = L)
+                                               // 1: justificado a esquerda (MSB junto do LRCLK, LRCLK alto = L)
+)(
+    input logic clk_25mhz,
+    input logic reset,
+    input logic [RATE_BITS-1:0] sample_rate,   // Hz
+
+    input logic load,                          // guarda left_in/right_in para o proximo quadro
+    input logic [DATA_BITS-1:0] left_in,
+    input logic [DATA_BITS-1:0] right_in,
+    output logic sample_req,                   // pulso no inicio de cada quadro: pede o quadro seguinte
+
+    output logic bclk,
+    output logic lrclk,
+    output logic sdata
+);
+
+localparam int unsigned SLOT_BITS = 32;
+localparam int unsigned FRAME_BCLKS = 2 * SLOT_BITS;
+localparam int unsigned TOGGLES_PER_FRAME = 2 * FRAME_BCLKS;    // duas bordas de BCLK por bit
+
+//incremento = 128 * sample_rate * 2^32 / clock_max, com a constante em ponto fixo de FRAC bits
+localparam int unsigned FRAC = 20;
+localparam logic [63:0] RATE_SCALE = ((64'(TOGGLES_PER_FRAME) << (32 + FRAC)) + clock_max / 2) / clock_max;
+
+initial begin
+    if ((64'(TOGGLES_PER_FRAME) << RATE_BITS) >= clock_max)
+        $error("i2s_driver: 128 * taxa maxima (%0d) precisa ser menor que o clock (%0d)", TOGGLES_PER_FRAME << RATE_BITS, clock_max);
+    if (DATA_BITS > SLOT_BITS - 1) $error("i2s_driver: DATA_BITS maximo e %0d", SLOT_BITS - 1);
+end
+
+//NCO: cada estouro do acumulador e meio periodo do BCLK
+logic [RATE_BITS+63:0] scaled;
+logic [31:0] nco_inc;
+logic [31:0] nco_acc;
+logic nco_tick;
+
+assign scaled = sample_rate * RATE_SCALE;
+
+always_ff @(posedge clk_25mhz or posedge reset) begin
+    if (reset) begin
+        nco_inc <= '0;
+        nco_acc <= '0;
+        nco_tick <= 1'b0;
+    end else begin
+        nco_inc <= scaled[FRAC +: 32];
+        {nco_tick, nco_acc} <= {1'b0, nco_acc} + {1'b0, nco_inc};
+    end
+end
+
+logic [DATA_BITS-1:0] next_left, next_right;   //quadro que entra no proximo inicio de quadro
+logic [DATA_BITS-1:0] cur_left, cur_right;     //quadro sendo serializado
+logic [5:0] bit_index;                          //posicao no quadro de 64 BCLKs
+
+logic [5:0] next_index;
+logic [4:0] slot_pos;
+logic right_slot;
+logic [DATA_BITS-1:0] slot_word;
+logic [5:0] data_pos;                           //bit da palavra a partir do MSB
+logic data_bit;
+
+assign next_index = bit_index + 1'b1;
+assign slot_pos = next_index[4:0];
+assign right_slot = next_index[5];
+//no indice 0 o quadro novo ainda nao passou para cur_*: le direto de next_*
+assign slot_word = (next_index == 6'd0) ? next_left : (right_slot ? cur_right : cur_left);
+assign data_pos = LEFT_JUSTIFIED ? {1'b0, slot_pos} : ({1'b0, slot_pos} - 1'b1);
+assign data_bit = (data_pos < DATA_BITS) ? slot_word[DATA_BITS - 1 - data_pos] : 1'b0;
+
+always_ff @(posedge clk_25mhz or posedge reset) begin
+    if (reset) begin
+        next_left <= '0;
+        next_right <= '0;
+    end else if (load) begin
+        next_left <= left_in;
+        next_right <= right_in;
+    end
+end
+
+always_ff @(posedge clk_25mhz or posedge reset) begin
+    if (reset) begin
+        bclk <= 1'b0;
+        bit_index <= 6'd63;                     //a primeira descida abre o slot esquerdo
+        lrclk <= LEFT_JUSTIFIED ? 1'b0 : 1'b1;  //nivel do slot direito
+        sdata <= 1'b0;
+        cur_left <= '0;
+        cur_right <= '0;
+        sample_req <= 1'b0;
+    end else begin
+        sample_req <= 1'b0;
+
+        if (nco_tick) begin
+            if (bclk == 1'b0) begin
+                bclk <= 1'b1;                    //subida: DAC captura sdata
+            end else begin
+                bclk <= 1'b0;                    //descida: proximo bit
+                bit_index <= next_index;
+                sdata <= data_bit;
+                lrclk <= LEFT_JUSTIFIED ? ~right_slot : right_slot;
+
+                if (next_index == 6'd0) begin
+                    cur_left <= next_left;
+                    cur_right <= next_right;
+                    sample_req <= 1'b1;
+                end
+            end
+        end
+    end
+end
+
+endmodule
@@ -0,0 +1,44 @@
+`timescale 1ns / 1ps
+
+// Relogio de amostras do FPGA: NCO de 32 bits sobre o clk_25mhz que gera um pulso tick por
+// periodo de amostra. A frequencia media e a taxa pedida (erro < 0,2 ppm); cada periodo tem
+// floor ou ceil de clock_max / sample_rate ciclos, entao o jitter fica em um ciclo (40 ns),
+// qualquer que seja o ritmo em que o Pico manda os quadros.
+// sample_rate pode mudar em tempo de execucao (control_regs); o incremento e recalculado
+// no ciclo seguinte sem zerar a fase.
+module sample_clock #(
+    parameter int unsigned clock_max = 25_000_000,
+    parameter int unsigned RATE_BITS = 17           // taxa maxima 131071 Hz
+)(
+    input logic clk_25mhz,
+    input logic reset,
+    input logic [RATE_BITS-1:0] sample_rate,        // Hz
+    output logic tick
+);
+
+//incremento = sample_rate * 2^32 / clock_max, com a constante em ponto fixo de FRAC bits
+localparam int unsigned FRAC = 20;
+localparam logic [63:0] RATE_SCALE = ((64'd1 << (32 + FRAC)) + clock_max / 2) / clock_max;
+
+initial begin
+    if ((64'd1 << RATE_BITS) >= clock_max) $error("sample_clock: RATE_BITS grande demais para o clock");
+end
+
+logic [RATE_BITS+63:0] scaled;
+logic [31:0] nco_inc;
+logic [31:0] nco_acc;
+
+assign scaled = sample_rate * RATE_SCALE;
+
+always_ff @(posedge clk_25mhz or posedge reset) begin
+    if (reset) begin
+        nco_inc <= '0;
+        nco_acc <= '0;
+        tick <= 1'b0;
+    end else begin
+        nco_inc <= scaled[FRAC +: 32];
+        {tick, nco_acc} <= {1'b0, nco_acc} + {1'b0, nco_inc};
+    end
+end
+
+endmodule
@@ -0,0 +1,72 @@
+`timescale 1ns / 1ps
+
+// FIFO de amostras em block RAM entre o receptor SPI e a cadeia de efeitos/DAC.
+// Escrita e leitura estao no mesmo clk_25mhz (o SCLK do Pico ja e sincronizado em
+// comunication.sv), entao os ponteiros nao precisam de codigo Gray.
+// A memoria nao tem reset para o sintetizador inferir EBR: DEPTH = 512 e WIDTH = 32
+// cabem em um bloco de 18 kbit do ECP5.
+module sample_fifo #(
+    parameter int unsigned WIDTH = 32,   // um quadro estereo (L + R)
+    parameter int unsigned DEPTH = 512   // potencia de 2
+)(
+    input logic clk_25mhz,
+    input logic reset,
+
+    input logic wr_en,
+    input logic [WIDTH-1:0] wr_data,
+
+    input logic rd_en,
+    output logic [WIDTH-1:0] rd_data,    //valido um ciclo depois de rd_en (leitura registrada da EBR)
+    output logic rd_valid,
+
+    output logic [$clog2(DEPTH):0] level, //quadros guardados, 0 a DEPTH
+    output logic full,
+    output logic empty,
+    output logic overflow,                //escrita com a FIFO cheia (quadro descartado), fica em 1 ate clear_flags
+    output logic underflow,               //leitura com a FIFO vazia, fica em 1 ate clear_flags
+    input logic clear_flags
+);
+
+localparam int unsigned ADDR_BITS = $clog2(DEPTH);
+
+logic [WIDTH-1:0] mem [0:DEPTH-1];
+logic [ADDR_BITS:0] wr_ptr, rd_ptr; //um bit a mais separa FIFO cheia de vazia
+
+logic do_write, do_read;
+assign do_write = wr_en && !full;
+assign do_read = rd_en && !empty;
+
+assign level = wr_ptr - rd_ptr;
+assign full = (level == DEPTH);
+assign empty = (level == 0);
+
+//porta de escrita e porta de leitura da EBR, sem reset
+always_ff @(posedge clk_25mhz) begin
+    if (do_write) mem[wr_ptr[ADDR_BITS-1:0]] <= wr_data;
+    if (do_read) rd_data <= mem[rd_ptr[ADDR_BITS-1:0]];
+end
+
+always_ff @(posedge clk_25mhz or posedge reset) begin
+    if (reset) begin
+        wr_ptr <= '0;
+        rd_ptr <= '0;
+        rd_valid <= 1'b0;
+        overflow <= 1'b0;
+        underflow <= 1'b0;
+    end else begin
+        rd_valid <= do_read;
+
+        if (do_write) wr_ptr <= wr_ptr + 1'b1;
+        if (do_read) rd_ptr <= rd_ptr + 1'b1;
+
+        if (clear_flags) begin
+            overflow <= 1'b0;
+            underflow <= 1'b0;
+        end else begin
+            if (wr_en && full) overflow <= 1'b1;
+            if (rd_en && empty) underflow <= 1'b1;
+        end
+    end
+end
+
+endmodule
@@ -6,150 +6,298 @@ module tb_comunication;
 
     // --- 1. Constantes para os Clocks ---
     // Clock principal de 25MHz (Período = 1 / 25MHz = 40 ns)
-    localparam int CLK_PERIOD = 40; 
-    
-    // Clock do SPI (SCLK) de 2MHz (Período = 500 ns)
-    // (1 / (16 * 20kHz)) = 3.125us (mínimo)
-    // (1 / 2MHz) = 500ns (muito mais rápido, ótimo)
-    localparam int SCLK_PERIOD = 500; 
+    localparam int CLK_PERIOD = 40;
+
+    // SCLK máximo suportado: clk/4 = 6,25MHz (Período = 160 ns)
+    localparam int SCLK_PERIOD = 4 * CLK_PERIOD;
+
+    // Defasagem entre SCLK e o clock principal, para as bordas não coincidirem
+    localparam int SCLK_PHASE = 7;
+
+    localparam int BITS = 16;
+    localparam int FRAMES_ONE_PER_CS = 2000;   // modo por amostra do Pico
+    localparam int BURSTS = 16;                // modo DMA do Pico
+    localparam int FRAMES_PER_BURST = 128;
+    localparam int REG_WORDS = 24;             // palavras por rajada de registrador
+
+    // Leituras de registrador: o MISO muda na descida do SCLK sincronizada, entao o Pico baixa o SCLK
+    localparam int SCLK_READ_PERIOD = 1000;    // 1 MHz
+
+    localparam logic [7:0] CMD_AUDIO = 8'h00;
+    localparam logic [7:0] CMD_WRITE = 8'h80;
+    localparam logic [7:0] CMD_READ  = 8'h40;
 
     // --- 2. Sinais do Testbench ---
     // Entradas para o DUT
     logic        tb_clk;
     logic        sclk_in;
     logic        mosi_in;
-    logic        active;
+    logic        active;   // CS ativo-baixo, como o Pico
     logic        reset;
 
+    // Saídas dos DUTs (um com canais MSB primeiro, outro com bytes little endian)
+    wire [BITS-1:0] left_msb, right_msb, left_lsb, right_lsb;
+    wire            ready_msb, ready_lsb;
 
-    // Saídas do DUT
-    wire [15:0] audio_out;
-    wire        data_ready;
+    // Barramento de registradores (so o DUT MSB e conferido; o LSB recebe o mesmo modelo)
+    wire            reg_we_msb, reg_re_msb, reg_we_lsb, reg_re_lsb;
+    wire [7:0]      reg_addr_msb, reg_addr_lsb;
+    wire [15:0]     reg_wdata_msb, reg_wdata_lsb;
+    wire            miso_msb, miso_lsb;
+    logic [23:0]    reg_writes[$];              // {endereco, dado} esperados
+    int             writes_ok = 0;
+    int             reads_ok = 0;
 
+    // Placar: quadros enviados esperando conferência
+    logic [2*BITS-1:0] expected[$];
+    int frames_sent = 0;
+    int frames_ok = 0;
+    int errors = 0;
 
-    // --- 3. Instanciar o Módulo (DUT) ---
-    // Conecta os sinais do testbench às portas do módulo
-    comunication dut (
+    // --- 3. Instanciar os Módulos (DUT) ---
+    comunication #(.BITS(BITS), .LSB_BYTE_FIRST(1'b0)) dut_msb (
         .clk_25mhz  (tb_clk),
-        
-        .sclk_in   (sclk_in),
-        .mosi_in   (mosi_in),
-        .active    (active),
-        .reset     (reset),
-        .audio_out (audio_out),
-        .data_ready(data_ready)
+        .sclk_in    (sclk_in),
+        .mosi_in    (mosi_in),
+        .active     (active),
+        .reset      (reset),
+        .frame_ready(ready_msb),
+        .audio_left (left_msb),
+        .audio_right(right_msb),
+        .reg_we     (reg_we_msb),
+        .reg_re     (reg_re_msb),
+        .reg_addr   (reg_addr_msb),
+        .reg_wdata  (reg_wdata_msb),
+        .reg_rdata  (reg_model(reg_addr_msb)),
+        .miso_out   (miso_msb)
+    );
+
+    comunication #(.BITS(BITS), .LSB_BYTE_FIRST(1'b1)) dut_lsb (
+        .clk_25mhz  (tb_clk),
+        .sclk_in    (sclk_in),
+        .mosi_in    (mosi_in),
+        .active     (active),
+        .reset      (reset),
+        .frame_ready(ready_lsb),
+        .audio_left (left_lsb),
+        .audio_right(right_lsb),
+        .reg_we     (reg_we_lsb),
+        .reg_re     (reg_re_lsb),
+        .reg_addr   (reg_addr_lsb),
+        .reg_wdata  (reg_wdata_lsb),
+        .reg_rdata  (reg_model(reg_addr_lsb)),
+        .miso_out   (miso_lsb)
     );
 
     // --- 4. Gerador de Clock Principal (25MHz) ---
     initial begin
         tb_clk = 0;
-        // 'forever' cria um loop infinito que gera o clock
         forever #(CLK_PERIOD / 2) tb_clk = ~tb_clk;
     end
 
-    // --- 5. Tarefa (Task) para simular o Pico enviando 16 bits ---
-    // Uma 'task' é como uma função para simulação
-    task send_spi_word(input [15:0] data_word);
-        // Espera o próximo ciclo de clock para sincronizar
-        @(posedge tb_clk);
-        
-        // Ativa o "Chip Select" (ativo-alto, como no seu código)
-        active <= 1'b1; 
-        sclk_in <= 1'b0;
-        
-        // Espera alguns ciclos para o DUT ver o 'active'
-        #(CLK_PERIOD * 2); 
-
-        // Loop para enviar os 16 bits, do mais significativo (MSB) ao menos (LSB)
-        for (int i = 15; i >= 0; i--) begin
-            
-            // Coloca o bit de dado na linha
-            mosi_in <= data_word[i];
-            
-            // Espera meio período do SCLK
+    // Registrador de leitura: valor conhecido derivado do endereco
+    function automatic logic [15:0] reg_model(input logic [7:0] addr);
+        reg_model = {addr ^ 8'h5A, addr};
+    endfunction
+
+    function automatic logic [BITS-1:0] swap_bytes(input logic [BITS-1:0] word);
+        logic [BITS-1:0] result;
+        for (int b = 0; b < BITS / 8; b++) result[b*8 +: 8] = word[BITS - 8 - b*8 +: 8];
+        swap_bytes = result;
+    endfunction
+
+    // --- 5. Tarefas para simular o Pico ---
+    // Envia os bits em modo 0: MOSI muda com SCLK baixo, o DUT captura na subida
+    task send_bits(input logic [2*BITS-1:0] frame, input int count);
+        for (int i = 2*BITS - 1; i >= 2*BITS - count; i--) begin
+            mosi_in <= frame[i];
             #(SCLK_PERIOD / 2);
-            
-            // Sobe o SCLK (o DUT captura o dado aqui)
             sclk_in <= 1'b1;
-            
-            // Espera meio período do SCLK
             #(SCLK_PERIOD / 2);
-            
-            // Desce o SCLK
             sclk_in <= 1'b0;
         end
-        
-        // Espera um pouco antes de desativar
-        #(CLK_PERIOD * 2);
-        active <= 1'b0; // Desativa o "Chip Select"
     endtask
 
+    task cs_begin();
+        #(SCLK_PHASE);
+        active <= 1'b0;
+        #(SCLK_PERIOD / 2);
+    endtask
+
+    task cs_end();
+        #(SCLK_PERIOD / 2);
+        active <= 1'b1;
+        #(CLK_PERIOD * 3); // Pico mantém o CS alto por ~256 ns entre janelas
+    endtask
+
+    task send_frame(input logic [2*BITS-1:0] frame);
+        expected.push_back(frame);
+        frames_sent++;
+        send_bits(frame, 2*BITS);
+    endtask
 
-    // --- 6. Sequência de Teste Principal ---
+    // Palavra de comando no inicio de cada janela de CS
+    task send_header(input logic [7:0] cmd, input logic [7:0] addr);
+        send_bits({cmd, addr, 16'h0000}, 16);
+    endtask
+
+    // Palavra de 16 bits no SCLK de leitura, capturando o MISO na subida como o Pico
+    task read_word(output logic [15:0] word);
+        for (int i = 15; i >= 0; i--) begin
+            mosi_in <= 1'b0;
+            #(SCLK_READ_PERIOD / 2);
+            sclk_in <= 1'b1;
+            word[i] = miso_msb;
+            #(SCLK_READ_PERIOD / 2);
+            sclk_in <= 1'b0;
+        end
+    endtask
+
+    // --- 6. Conferência: a cada quadro os dois DUTs devem bater com o placar ---
+    always @(posedge tb_clk) begin
+        if (ready_msb) begin : conferir
+            logic [2*BITS-1:0] frame;
+            if (expected.size() == 0) begin
+                $error("FALHA: quadro inesperado L=%h R=%h", left_msb, right_msb);
+                errors++;
+            end else begin
+                frame = expected.pop_front();
+                if (left_msb !== frame[2*BITS-1:BITS] || right_msb !== frame[BITS-1:0]) begin
+                    $error("FALHA MSB: esperado %h, recebido L=%h R=%h", frame, left_msb, right_msb);
+                    errors++;
+                end else if (!ready_lsb || left_lsb !== swap_bytes(frame[2*BITS-1:BITS]) ||
+                             right_lsb !== swap_bytes(frame[BITS-1:0])) begin
+                    $error("FALHA LSB: esperado %h trocado, recebido L=%h R=%h", frame, left_lsb, right_lsb);
+                    errors++;
+                end else begin
+                    frames_ok++;
+                end
+            end
+        end
+    end
+
+    // Escritas de registrador conferidas na ordem
+    always @(posedge tb_clk) begin
+        if (reg_we_msb) begin
+            if (reg_writes.size() == 0) begin
+                $error("FALHA: escrita inesperada addr=%h dado=%h", reg_addr_msb, reg_wdata_msb);
+                errors++;
+            end else if ({reg_addr_msb, reg_wdata_msb} !== reg_writes.pop_front()) begin
+                $error("FALHA: escrita addr=%h dado=%h", reg_addr_msb, reg_wdata_msb);
+                errors++;
+            end else begin
+                writes_ok++;
+            end
+        end
+    end
+
+    // --- 7. Sequência de Teste Principal ---
     initial begin
-        // Abre o arquivo de formas de onda (opcional, mas recomendado)
         $dumpfile("dump.vcd");
-        $dumpvars(0, tb_comunication);
+        $dumpvars(1, tb_comunication);
 
-        // Inicia a simulação com o reset ativado
         $display("Iniciando simulação... Reset ativado.");
         reset     <= 1'b1;
-        active    <= 1'b0;
+        active    <= 1'b1;
         sclk_in   <= 1'b0;
         mosi_in   <= 1'b0;
-        #100ns; // Espera 100 ns
+        #100ns;
 
-        // Libera o reset
         reset <= 1'b0;
-        $display("Reset liberado. Módulo em IDLE.");
+        $display("Reset liberado. SCLK = %0d ns (clk/4).", SCLK_PERIOD);
         @(posedge tb_clk);
-        
-        $display("TESTE 1: Enviando 16'hA5A5...");
-    
-    // 'fork' inicia um bloco paralelo
-    fork
-        // 'join_none' diz: não espere esta tarefa terminar,
-        // continue executando o código principal.
-        send_spi_word(16'hA5A5);
-    join_none
-
-    // AGORA, o 'send_spi_word' está rodando em paralelo,
-    // e esta linha @(posedge) está escutando AO MESMO TEMPO.
-    @(posedge data_ready);
-    $display("... Pulso 'data_ready' recebido!");
-    $display("... Valor em 'audio_out' = %h", audio_out);
-
-    // O resto da sua lógica de assert estava correta
-    assert (audio_out == 16'hA5A5)
-        else $error("FALHA TESTE 1: Valor esperado era A5A5, mas foi %h", audio_out);
-
-    @(posedge tb_clk);
-    assert (data_ready == 1'b0)
-        else $error("FALHA TESTE 1: 'data_ready' não voltou para 0!");
-
-    $display("TESTE 1: Concluído com sucesso!");
-    
-    #(SCLK_PERIOD * 4);
-
-    // --- TESTE 2: CORRIGIDO COM FORK...JOIN_NONE ---
-    $display("TESTE 2: Enviando 16'hBEEF...");
-    
-    fork
-        send_spi_word(16'hBEEF);
-    join_none
-    
-    @(posedge data_ready);
-    $display("... Pulso 'data_ready' recebido!");
-    $display("... Valor em 'audio_out' = %h", audio_out);
-    
-    assert (audio_out == 16'hBEEF)
-        else $error("FALHA TESTE 2: Valor esperado era BEEF, mas foi %h", audio_out);
-    
-    $display("TESTE 2: Concluído com sucesso!");
-    
-    #1000ns;
-    $display("Simulação concluída.");
-    $finish;
+
+        // TESTE 1: um quadro por janela de CS (modo por amostra)
+        $display("TESTE 1: %0d quadros, um por janela de CS...", FRAMES_ONE_PER_CS);
+        for (int n = 0; n < FRAMES_ONE_PER_CS; n++) begin
+            cs_begin();
+            send_header(CMD_AUDIO, 8'h00);
+            send_frame((n == 0) ? 32'hA5A5_BEEF : $urandom);
+            cs_end();
+        end
+
+        // TESTE 2: rajadas de quadros com o CS baixo o tempo todo (modo DMA)
+        $display("TESTE 2: %0d rajadas de %0d quadros...", BURSTS, FRAMES_PER_BURST);
+        for (int r = 0; r < BURSTS; r++) begin
+            cs_begin();
+            send_header(CMD_AUDIO, 8'h00);
+            for (int n = 0; n < FRAMES_PER_BURST; n++) send_frame($urandom);
+            cs_end();
+        end
+
+        // TESTE 3: quadro interrompido pelo CS é descartado e o próximo chega alinhado
+        $display("TESTE 3: quadro parcial descartado...");
+        cs_begin();
+        send_header(CMD_AUDIO, 8'h00);
+        send_bits(32'hFFFF_FFFF, 11);
+        cs_end();
+        cs_begin();
+        send_bits(32'h8000_0000, 9);      // cabecalho interrompido tambem e descartado
+        cs_end();
+        cs_begin();
+        send_header(CMD_AUDIO, 8'h00);
+        send_frame(32'h1234_8001);
+        cs_end();
+
+        // TESTE 4: rajadas de escrita com autoincremento do endereco, intercaladas com audio
+        $display("TESTE 4: escrita de registradores entre rajadas de audio...");
+        for (int r = 0; r < 8; r++) begin
+            logic [7:0] addr;
+            logic [15:0] data;
+            addr = $urandom;
+            cs_begin();
+            send_header(CMD_WRITE, addr);
+            for (int w = 0; w < REG_WORDS; w++) begin
+                data = $urandom;
+                reg_writes.push_back({8'(addr + w), data});
+                send_bits({data, 16'h0000}, 16);
+            end
+            cs_end();
+            cs_begin();
+            send_header(CMD_AUDIO, 8'h00);
+            for (int n = 0; n < 4; n++) send_frame($urandom);
+            cs_end();
+        end
+
+        // TESTE 5: leitura com autoincremento no SCLK de 1 MHz
+        $display("TESTE 5: leitura de registradores pelo MISO...");
+        for (int r = 0; r < 8; r++) begin
+            logic [7:0] addr;
+            logic [15:0] word;
+            addr = (r == 0) ? 8'hFE : $urandom; // a primeira passa de 0xFF para 0x00
+            cs_begin();
+            send_header(CMD_READ, addr);
+            for (int w = 0; w < REG_WORDS; w++) begin
+                read_word(word);
+                if (word !== reg_model(8'(addr + w))) begin
+                    $error("FALHA LEITURA: addr %h leu %h, esperado %h", 8'(addr + w), word, reg_model(8'(addr + w)));
+                    errors++;
+                end else begin
+                    reads_ok++;
+                end
+            end
+            cs_end();
+        end
+
+        // TESTE 6: comando desconhecido ignora a janela inteira
+        $display("TESTE 6: comando desconhecido...");
+        cs_begin();
+        send_header(8'h13, 8'h00);
+        for (int n = 0; n < 4; n++) send_bits($urandom, 32);
+        cs_end();
+
+        #(CLK_PERIOD * 10);
+        assert (expected.size() == 0)
+            else $error("FALHA: %0d quadros enviados não foram recebidos", expected.size());
+        assert (reg_writes.size() == 0)
+            else $error("FALHA: %0d escritas de registrador não chegaram", reg_writes.size());
+        assert (errors == 0)
+            else $error("FALHA: %0d quadros com erro", errors);
+
+        $display("Quadros enviados: %0d | conferidos: %0d | escritas: %0d | leituras: %0d | erros: %0d",
+                 frames_sent, frames_ok, writes_ok, reads_ok, errors);
+        $display("Simulação concluída.");
+        $finish;
     end
 
-endmodule
\ No newline at end of file
+endmodule
@@ -1,9 +1,14 @@
 `timescale 1ns / 1ps
 
-module tb_dac_driver;
+// SCLK_DIV pode ser trocado na linha de comando: iverilog -P tb_dac_driver.SCLK_DIV=4 ...
+module tb_dac_driver #(
+    parameter int SCLK_DIV = 2
+);
 
     // --- Constantes ---
     localparam int CLK_PERIOD = 40; // 40 ns = 25MHz
+    localparam int STREAM_SAMPLES = 64;
+    localparam logic [3:0] DAC_CONFIG = 4'b1000;
 
     // --- Sinais do Testbench ---
     logic        tb_clk_25mhz;
@@ -17,8 +22,21 @@ module tb_dac_driver;
     wire         w_mosi_out;
     wire         w_active_out;
 
+    // Modelo do DAC: palavras esperadas e recebidas
+    logic [15:0] expected[$];
+    logic [15:0] dac_shift;
+    int          dac_bits = 0;
+    int          words_ok = 0;
+    int          errors = 0;
+
+    // Medições
+    time t_data_ready;
+    time t_last_sclk_rise;
+    time sclk_period_ns = 0;
+    time latency_ns = 0;
+
     // --- Instanciar o DUT ---
-    dac_driver dut (
+    dac_driver #(.SCLK_DIV(SCLK_DIV), .DAC_CONFIG(DAC_CONFIG)) dut (
         .clk_25mhz    (tb_clk_25mhz),
         .reset        (tb_reset),
         .data_ready   (tb_data_ready),
@@ -35,12 +53,74 @@ module tb_dac_driver;
         forever #(CLK_PERIOD / 2) tb_clk_25mhz = ~tb_clk_25mhz;
     end
 
+    // --- Modelo do DAC: captura na subida do SCLK (modo 0) e confere ao subir o CS ---
+    always @(posedge w_sclk_out) begin
+        if (!w_active_out) begin
+            dac_shift = {dac_shift[14:0], w_mosi_out};
+            dac_bits++;
+            if (t_last_sclk_rise != 0 && sclk_period_ns == 0) sclk_period_ns = $time - t_last_sclk_rise;
+            t_last_sclk_rise = $time;
+        end
+    end
+
+    always @(negedge w_active_out) dac_bits = 0;
+
+    always @(posedge w_active_out) begin
+        if (!tb_reset) begin : conferir
+            logic [15:0] word;
+            latency_ns = $time - t_data_ready;
+            if (expected.size() == 0) begin
+                $error("FALHA: transferencia inesperada %h", dac_shift);
+                errors++;
+            end else begin
+                word = expected.pop_front();
+                if (dac_bits != 16 || dac_shift !== word) begin
+                    $error("FALHA: DAC recebeu %h (%0d bits), esperado %h", dac_shift, dac_bits, word);
+                    errors++;
+                end else begin
+                    words_ok++;
+                end
+            end
+        end
+    end
+
+    // --- Setup/hold: MOSI so pode mudar na descida do SCLK ou com o CS mudando/inativo ---
+    logic prev_sclk, prev_mosi, prev_cs;
+    always @(posedge tb_clk_25mhz) begin
+        if (!tb_reset && w_mosi_out !== prev_mosi) begin
+            if (!(prev_sclk && !w_sclk_out) && !(prev_cs != w_active_out) && !w_active_out) begin
+                $error("FALHA TIMING: MOSI mudou fora da descida do SCLK em %0t", $time);
+                errors++;
+            end
+        end
+        if (!tb_reset && w_sclk_out && !prev_sclk && w_mosi_out !== prev_mosi) begin
+            $error("FALHA TIMING: MOSI mudou junto com a subida do SCLK em %0t", $time);
+            errors++;
+        end
+        prev_sclk <= w_sclk_out;
+        prev_mosi <= w_mosi_out;
+        prev_cs <= w_active_out;
+    end
+
+    // Pulso data_ready de um ciclo, como a FIFO do top entrega
+    task send_sample(input [15:0] sample);
+        tb_audio_in <= sample;
+        tb_data_ready <= 1'b1;
+        expected.push_back({DAC_CONFIG, sample[15:4]});
+        t_data_ready = $time;
+        @(posedge tb_clk_25mhz);
+        tb_data_ready <= 1'b0;
+    endtask
+
     // --- Sequência de Teste Principal ---
-    initial begin
+    initial begin : sequencia
+        time t_stream_start;
+        time stream_period_ns;
+
         $dumpfile("dump_dac_driver.vcd");
-        $dumpvars(0, tb_dac_driver); 
+        $dumpvars(0, tb_dac_driver);
 
-        $display("Iniciando simulação do dac_driver... Reset ativado.");
+        $display("Iniciando simulação do dac_driver (SCLK_DIV = %0d)... Reset ativado.", SCLK_DIV);
         tb_reset       <= 1'b1;
         tb_data_ready  <= 1'b0;
         tb_audio_in    <= 16'b0;
@@ -53,51 +133,43 @@ module tb_dac_driver;
 
         // --- Teste 1: Enviar um valor ---
         $display("TESTE 1: Enviando áudio 16'hABCD...");
-        tb_audio_in <= 16'hABCD;
-        @(posedge tb_clk_25mhz); // Espera 1 ciclo para o valor estabilizar
-
-        // Gera o pulso data_ready
-        $display("Gerando pulso data_ready...");
-        tb_data_ready <= 1'b1;
-        @(posedge tb_clk_25mhz);
-        tb_data_ready <= 1'b0;
-        $display("Pulso data_ready enviado.");
-
-        // Monitora a atividade SPI
-        $display("Monitorando SPI...");
-        // Espera o CS (active_out) ficar ativo (baixo)
+        send_sample(16'hABCD);
         wait (w_active_out == 1'b0);
-        $display("... CS ficou ativo (baixo).");
-
-        // Espera o CS voltar a ficar inativo (alto) - indica fim da transferência
         wait (w_active_out == 1'b1);
-        $display("... CS ficou inativo (alto). Transferência concluída.");
+        $display("... SCLK medido: %0d ns (%0d kHz)", sclk_period_ns, 1_000_000 / sclk_period_ns);
+        $display("... Latencia data_ready -> CS alto: %0d ns (%0d ciclos)", latency_ns, latency_ns / CLK_PERIOD);
         $display("TESTE 1 Concluído.");
-        
+
         // --- Teste 2: Enviar outro valor ---
         #500ns; // Pequena pausa
-        
-        $display("TESTE 2: Enviando áudio 16'h1234...");
-        tb_audio_in <= 16'h1234;
-        @(posedge tb_clk_25mhz); 
-
-        $display("Gerando pulso data_ready...");
-        tb_data_ready <= 1'b1;
         @(posedge tb_clk_25mhz);
-        tb_data_ready <= 1'b0;
-        $display("Pulso data_ready enviado.");
-
-        $display("Monitorando SPI...");
+        $display("TESTE 2: Enviando áudio 16'h1234...");
+        send_sample(16'h1234);
         wait (w_active_out == 1'b0);
-        $display("... CS ficou ativo (baixo).");
         wait (w_active_out == 1'b1);
-        $display("... CS ficou inativo (alto). Transferência concluída.");
         $display("TESTE 2 Concluído.");
 
+        // --- Teste 3: amostras seguidas, cada uma assim que o DAC volta para IDLE ---
+        #500ns;
+        @(posedge tb_clk_25mhz);
+        $display("TESTE 3: %0d amostras seguidas para medir a taxa maxima...", STREAM_SAMPLES);
+        t_stream_start = $time;
+        for (int n = 0; n < STREAM_SAMPLES; n++) begin
+            send_sample($urandom);
+            @(posedge tb_clk_25mhz);
+            while (w_active_out == 1'b0) @(posedge tb_clk_25mhz);
+        end
+        stream_period_ns = ($time - t_stream_start) / STREAM_SAMPLES;
+        $display("... Periodo por amostra: %0d ns (%0d ciclos) -> taxa maxima sustentada: %0d kHz",
+                 stream_period_ns, stream_period_ns / CLK_PERIOD, 1_000_000 / stream_period_ns);
+
         // --- Fim ---
         #1000ns;
+        assert (expected.size() == 0 && errors == 0)
+            else $error("FALHA: %0d amostras pendentes, %0d erros", expected.size(), errors);
+        $display("Palavras conferidas no DAC: %0d | erros: %0d", words_ok, errors);
         $display("Simulação do dac_driver concluída.");
         $finish;
     end
 
-endmodule
\ No newline at end of file
+endmodule
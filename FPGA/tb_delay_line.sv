@@ -0,0 +1,293 @@
+`timescale 1ns / 1ps
+
+// delay_line com taps inteiros e fracionarios contra um historico de referencia, e eff_echo e
+// eff_chorus conferidos bit a bit contra modelos, com entrada em rajadas e saida travando.
+module tb_delay_line;
+
+    // --- Constantes ---
+    localparam int CLK_PERIOD = 40; // 40 ns = 25MHz
+    localparam int DEPTH = 1024;
+    localparam int FRAC_BITS = 8;
+    localparam int LINE_WRITES = 3000;
+    localparam int EFFECT_FRAMES = 4000;
+    localparam int CHORUS_BASE = 480;
+    localparam logic signed [15:0] FEEDBACK = 16'sh6000; // 0.75
+    localparam logic signed [15:0] MIX = 16'sh4000;      // 0.5
+
+    // --- Sinais do Testbench ---
+    logic tb_clk_25mhz;
+    logic tb_reset;
+
+    // delay_line sozinha
+    logic                        tb_write_en;
+    logic [31:0]                 tb_write_data;
+    logic                        tb_read_start;
+    logic [$clog2(DEPTH)+FRAC_BITS-1:0] tb_delay;
+    wire                         w_read_done;
+    wire [31:0]                  w_tap_data;
+
+    // efeitos
+    logic [15:0]                 tb_echo_delay, tb_rate_depth;
+    logic                        tb_in_valid;
+    logic signed [15:0]          tb_in_left, tb_in_right;
+    logic                        tb_out_ready;
+    wire                         w_echo_in_ready, w_echo_out_valid;
+    wire signed [15:0]           w_echo_left, w_echo_right;
+    wire                         w_chorus_in_ready, w_chorus_out_valid;
+    wire signed [15:0]           w_chorus_left, w_chorus_right;
+
+    int errors = 0;
+    int reads_ok = 0;
+
+    // --- Instanciar os DUTs ---
+    delay_line #(.DEPTH(DEPTH), .LANES(2), .FRAC_BITS(FRAC_BITS)) dut_line (
+        .clk_25mhz (tb_clk_25mhz),
+        .reset     (tb_reset),
+        .write_en  (tb_write_en),
+        .write_data(tb_write_data),
+        .read_start(tb_read_start),
+        .delay     (tb_delay),
+        .read_done (w_read_done),
+        .tap_data  (w_tap_data)
+    );
+
+    // Os dois efeitos recebem os mesmos quadros, cada um com seu handshake
+    eff_echo #(.DEPTH(DEPTH), .FEEDBACK(FEEDBACK), .MIX(MIX)) dut_echo (
+        .clk_25mhz    (tb_clk_25mhz),
+        .reset        (tb_reset),
+        .bypass       (1'b0),
+        .delay_samples(tb_echo_delay),
+        .in_valid     (tb_in_valid && w_chorus_in_ready),
+        .in_ready     (w_echo_in_ready),
+        .in_left      (tb_in_left),
+        .in_right     (tb_in_right),
+        .out_valid    (w_echo_out_valid),
+        .out_ready    (tb_out_ready),
+        .out_left     (w_echo_left),
+        .out_right    (w_echo_right)
+    );
+
+    eff_chorus #(.DEPTH(DEPTH), .BASE_DELAY(CHORUS_BASE)) dut_chorus (
+        .clk_25mhz (tb_clk_25mhz),
+        .reset     (tb_reset),
+        .bypass    (1'b0),
+        .rate_depth(tb_rate_depth),
+        .in_valid  (tb_in_valid && w_echo_in_ready),
+        .in_ready  (w_chorus_in_ready),
+        .in_left   (tb_in_left),
+        .in_right  (tb_in_right),
+        .out_valid (w_chorus_out_valid),
+        .out_ready (tb_out_ready),
+        .out_left  (w_chorus_left),
+        .out_right (w_chorus_right)
+    );
+
+    // --- Gerador de Clock ---
+    initial begin
+        tb_clk_25mhz = 1'b0;
+        forever #(CLK_PERIOD / 2) tb_clk_25mhz = ~tb_clk_25mhz;
+    end
+
+    // --- Modelos de referencia ---
+    function automatic logic signed [15:0] ref_interpolate(input logic signed [15:0] near, input logic signed [15:0] far,
+                                                           input int frac);
+        int step;
+        step = (int'(far) - int'(near)) * frac;
+        step = step >>> FRAC_BITS;
+        return 16'(int'(near) + step);
+    endfunction
+
+    function automatic logic signed [15:0] ref_saturate(input int value);
+        if (value > 32767) return 16'sd32767;
+        if (value < -32768) return -16'sd32768;
+        return 16'(value);
+    endfunction
+
+    // tap de um historico (mais antigo primeiro); antes do inicio a linha e silencio
+    function automatic logic [31:0] ref_tap(ref logic [31:0] history[$], input int delay_q8);
+        int delay_int, frac, near_index;
+        logic [31:0] near, far;
+        delay_int = delay_q8 >> FRAC_BITS;
+        frac = delay_q8 % (1 << FRAC_BITS);
+        if (delay_int == 0) begin
+            delay_int = 1;
+            frac = 0;
+        end else if (delay_int >= DEPTH - 2) begin
+            delay_int = DEPTH - 2;
+            frac = 0;
+        end
+        near_index = history.size() - delay_int;
+        near = (near_index >= 0) ? history[near_index] : 32'b0;
+        far = (near_index - 1 >= 0) ? history[near_index - 1] : 32'b0;
+        return {ref_interpolate(near[31:16], far[31:16], frac), ref_interpolate(near[15:0], far[15:0], frac)};
+    endfunction
+
+    // --- TESTE 1: delay_line sozinha ---
+    logic [31:0] line_history[$];
+
+    task check_read(input int delay_q8);
+        logic [31:0] expected;
+        expected = ref_tap(line_history, delay_q8);
+        tb_delay <= delay_q8;
+        tb_read_start <= 1'b1;
+        @(posedge tb_clk_25mhz);
+        tb_read_start <= 1'b0;
+        while (!w_read_done) @(posedge tb_clk_25mhz);
+        if (w_tap_data !== expected) begin
+            $error("FALHA LINHA: atraso %0d/256 leu %h, esperado %h", delay_q8, w_tap_data, expected);
+            errors++;
+        end else begin
+            reads_ok++;
+        end
+    endtask
+
+    // --- TESTE 2: eco e chorus ---
+    logic [31:0] echo_line[$];     // w[n] gravado pelo eco
+    logic [31:0] chorus_line[$];   // x[n] gravado pelo chorus
+    logic [31:0] echo_expected[$];
+    logic [31:0] chorus_expected[$];
+    logic [25:0] ref_phase = '0;
+    int echo_ok = 0;
+    int chorus_ok = 0;
+
+    always @(posedge tb_clk_25mhz) begin
+        if (!tb_reset) begin
+            if (w_echo_out_valid && tb_out_ready) begin
+                if (echo_expected.size() == 0 || {w_echo_left, w_echo_right} !== echo_expected.pop_front()) begin
+                    $error("FALHA ECO: saida %h %h diferente do modelo", w_echo_left, w_echo_right);
+                    errors++;
+                end else begin
+                    echo_ok++;
+                end
+            end
+            if (w_chorus_out_valid && tb_out_ready) begin
+                if (chorus_expected.size() == 0 || {w_chorus_left, w_chorus_right} !== chorus_expected.pop_front()) begin
+                    $error("FALHA CHORUS: saida %h %h diferente do modelo", w_chorus_left, w_chorus_right);
+                    errors++;
+                end else begin
+                    chorus_ok++;
+                end
+            end
+
+            // quadro aceito pelos dois efeitos no mesmo ciclo
+            if (tb_in_valid && w_echo_in_ready && w_chorus_in_ready) begin : modelo
+                logic [31:0] tap;
+                logic signed [15:0] x[2];
+                logic signed [15:0] t[2];
+                logic signed [15:0] w[2], y[2];
+                logic [15:0] tri_value;
+                int offset;
+                int delay_q8;
+                int echo_delay;
+
+                x[0] = tb_in_left;
+                x[1] = tb_in_right;
+
+                // eco: atraso inteiro, w = x + fb * tap, y = x + mix * tap
+                echo_delay = (tb_echo_delay > DEPTH - 2) ? DEPTH - 2 : tb_echo_delay;
+                tap = ref_tap(echo_line, echo_delay << FRAC_BITS);
+                t[0] = tap[31:16];
+                t[1] = tap[15:0];
+                for (int c = 0; c < 2; c++) begin
+                    w[c] = ref_saturate(int'(x[c]) + ((int'(t[c]) * int'(FEEDBACK)) >>> 15));
+                    y[c] = ref_saturate(int'(x[c]) + ((int'(t[c]) * int'(MIX)) >>> 15));
+                end
+                echo_line.push_back({w[0], w[1]});
+                echo_expected.push_back({y[0], y[1]});
+
+                // chorus: LFO triangular sobre a fase antes do passo desta amostra
+                tri_value = ref_phase[25] ? ~ref_phase[24:9] : ref_phase[24:9];
+                offset = (tb_rate_depth[7:0] * tri_value) >> 8;
+                delay_q8 = (CHORUS_BASE << FRAC_BITS) + offset;
+                tap = ref_tap(chorus_line, delay_q8);
+                t[0] = tap[31:16];
+                t[1] = tap[15:0];
+                for (int c = 0; c < 2; c++) y[c] = 16'((int'(x[c]) + int'(t[c])) >>> 1);
+                chorus_line.push_back({x[0], x[1]});
+                chorus_expected.push_back({y[0], y[1]});
+                ref_phase = ref_phase + {tb_rate_depth[15:8], 8'b0};
+            end
+        end
+    end
+
+    // --- Sequência de Teste Principal ---
+    initial begin : sequencia
+        int sent;
+
+        $dumpfile("dump_delay_line.vcd");
+        $dumpvars(1, tb_delay_line);
+
+        $display("Iniciando simulação da delay_line... Reset ativado.");
+        tb_reset      <= 1'b1;
+        tb_write_en   <= 1'b0;
+        tb_write_data <= '0;
+        tb_read_start <= 1'b0;
+        tb_delay      <= '0;
+        tb_echo_delay <= 16'd100;
+        tb_rate_depth <= {8'd40, 8'd200};
+        tb_in_valid   <= 1'b0;
+        tb_in_left    <= '0;
+        tb_in_right   <= '0;
+        tb_out_ready  <= 1'b1;
+        #100ns;
+        tb_reset <= 1'b0;
+        @(posedge tb_clk_25mhz);
+
+        // --- TESTE 1: gravacoes aleatorias, leituras inteiras, fracionarias e fora da faixa ---
+        $display("TESTE 1: %0d gravacoes com leituras intercaladas...", LINE_WRITES);
+        check_read(5 << FRAC_BITS); // linha ainda em silencio
+        for (int n = 0; n < LINE_WRITES; n++) begin
+            tb_write_en <= 1'b1;
+            tb_write_data <= $urandom;
+            @(posedge tb_clk_25mhz);
+            line_history.push_back(tb_write_data);
+            tb_write_en <= 1'b0;
+            if ($urandom % 4 == 0) begin
+                case ($urandom % 4)
+                    0: check_read($urandom_range(1, DEPTH - 2) << FRAC_BITS);
+                    1: check_read($urandom_range(1 << FRAC_BITS, ((DEPTH - 2) << FRAC_BITS) - 1));
+                    2: check_read($urandom_range(0, (1 << FRAC_BITS) - 1));            // abaixo de 1
+                    3: check_read($urandom_range((DEPTH - 2) << FRAC_BITS, (DEPTH << FRAC_BITS) - 1)); // acima do maximo
+                endcase
+            end
+        end
+        $display("TESTE 1: %0d leituras conferidas.", reads_ok);
+
+        // --- TESTE 2: eco e chorus com impulso, ruido e mudanca de parametros ---
+        $display("TESTE 2: %0d quadros no eco (atraso %0d) e no chorus...", EFFECT_FRAMES, tb_echo_delay);
+        sent = 0;
+        while (sent < EFFECT_FRAMES) begin
+            tb_in_valid <= ($urandom % 4) != 0;
+            if (sent < 400)
+                {tb_in_left, tb_in_right} <= (sent == 0) ? {16'sd20000, -16'sd20000} : 32'b0; // impulso: ecos decaindo
+            else
+                {tb_in_left, tb_in_right} <= $urandom;
+            tb_out_ready <= ($urandom % 10) < 8;
+            if (sent == EFFECT_FRAMES / 2) begin
+                tb_echo_delay <= 16'd700;
+                tb_rate_depth <= {8'd200, 8'd255};
+            end
+            if (sent == 3 * EFFECT_FRAMES / 4) tb_echo_delay <= 16'hFFFF; // limitado a DEPTH - 2
+            @(posedge tb_clk_25mhz);
+            if (tb_in_valid && w_echo_in_ready && w_chorus_in_ready) sent++;
+        end
+        tb_in_valid <= 1'b0;
+        tb_out_ready <= 1'b1;
+        wait (echo_expected.size() == 0 && chorus_expected.size() == 0);
+        repeat (4) @(posedge tb_clk_25mhz);
+
+        // --- Relatorio de block RAM ---
+        $display("EBR: delay_line DEPTH = %0d estereo -> %0d blocos de 18 kbit, atraso maximo %0d amostras (%0d us a 48 kHz)",
+                 DEPTH, (DEPTH * 32 + 16383) / 16384, DEPTH - 2, (DEPTH - 2) * 1_000_000 / 48_000);
+        $display("EBR: eco no top (DEPTH = 8192) -> %0d blocos, atraso maximo %0d amostras (%0d us a 48 kHz)",
+                 (8192 * 32 + 16383) / 16384, 8192 - 2, (8192 - 2) * 1_000_000 / 48_000);
+
+        // --- Fim ---
+        assert (errors == 0)
+            else $error("FALHA: %0d erros", errors);
+        $display("Leituras da linha: %0d | eco: %0d | chorus: %0d | erros: %0d", reads_ok, echo_ok, chorus_ok, errors);
+        $display("Simulação da delay_line concluída.");
+        $finish;
+    end
+
+endmodule
@@ -0,0 +1,296 @@
+`timescale 1ns / 1ps
+
+// Cadeia ganho -> clipping -> ganho conferida bit a bit contra um modelo de referencia,
+// com todas as combinacoes de bypass, entrada em rajadas e saida travando ao acaso.
+// Um segundo DUT com RUNTIME_ORDER = 1 confere todas as ordens dos estagios, trocadas com audio passando.
+module tb_effect_chain;
+
+    // --- Constantes ---
+    localparam int CLK_PERIOD = 40; // 40 ns = 25MHz
+    localparam int NUM_STAGES = 3;
+    localparam logic [8*NUM_STAGES-1:0] STAGE_EFFECTS =
+        {effect_pkg::EFFECT_GAIN, effect_pkg::EFFECT_CLIP, effect_pkg::EFFECT_GAIN};
+    localparam int BLOCK_FRAMES = 300;
+    localparam int STREAM_FRAMES = 256;
+
+    // --- Sinais do Testbench ---
+    logic                        tb_clk_25mhz;
+    logic                        tb_reset;
+    logic [NUM_STAGES-1:0]       tb_bypass;
+    logic [16*NUM_STAGES-1:0]    tb_param;
+    logic                        tb_in_valid;
+    logic signed [15:0]          tb_in_left, tb_in_right;
+    logic                        tb_out_ready;
+
+    wire                         w_in_ready;
+    wire                         w_out_valid;
+    wire signed [15:0]           w_out_left, w_out_right;
+
+    // DUT com ordem em tempo de execucao
+    logic [4*NUM_STAGES-1:0]     tb_order;
+    logic                        ord_in_valid;
+    logic signed [15:0]          ord_in_left, ord_in_right;
+    logic                        ord_out_ready;
+    wire                         w_ord_in_ready;
+    wire                         w_ord_out_valid;
+    wire signed [15:0]           w_ord_out_left, w_ord_out_right;
+
+    logic [31:0] expected[$];
+    logic [31:0] ord_expected[$];
+    int frames_ok = 0;
+    int errors = 0;
+    int cycle = 0;
+
+    // --- Instanciar o DUT ---
+    effect_chain #(.NUM_STAGES(NUM_STAGES), .STAGE_EFFECTS(STAGE_EFFECTS)) dut (
+        .clk_25mhz  (tb_clk_25mhz),
+        .reset      (tb_reset),
+        .bypass     (tb_bypass),
+        .stage_param(tb_param),
+        .order      ('0),
+        .coef_we    (1'b0),
+        .coef_addr  (12'd0),
+        .coef_data  (18'sd0),
+        .in_valid   (tb_in_valid),
+        .in_ready   (w_in_ready),
+        .in_left    (tb_in_left),
+        .in_right   (tb_in_right),
+        .out_valid  (w_out_valid),
+        .out_ready  (tb_out_ready),
+        .out_left   (w_out_left),
+        .out_right  (w_out_right)
+    );
+
+    effect_chain #(.NUM_STAGES(NUM_STAGES), .STAGE_EFFECTS(STAGE_EFFECTS), .RUNTIME_ORDER(1'b1)) dut_ord (
+        .clk_25mhz  (tb_clk_25mhz),
+        .reset      (tb_reset),
+        .bypass     (tb_bypass),
+        .stage_param(tb_param),
+        .order      (tb_order),
+        .coef_we    (1'b0),
+        .coef_addr  (12'd0),
+        .coef_data  (18'sd0),
+        .in_valid   (ord_in_valid),
+        .in_ready   (w_ord_in_ready),
+        .in_left    (ord_in_left),
+        .in_right   (ord_in_right),
+        .out_valid  (w_ord_out_valid),
+        .out_ready  (ord_out_ready),
+        .out_left   (w_ord_out_left),
+        .out_right  (w_ord_out_right)
+    );
+
+    // --- Gerador de Clock ---
+    initial begin
+        tb_clk_25mhz = 1'b0;
+        forever #(CLK_PERIOD / 2) tb_clk_25mhz = ~tb_clk_25mhz;
+    end
+
+    // --- Modelo de referencia ---
+    function automatic logic signed [15:0] ref_clip(input logic signed [15:0] sample, input logic signed [15:0] level);
+        if (sample > level) return level;
+        if (sample < -level) return -level;
+        return sample;
+    endfunction
+
+    function automatic logic signed [15:0] ref_gain(input logic signed [15:0] sample, input logic signed [15:0] gain);
+        longint scaled;
+        scaled = (longint'(sample) * longint'(gain) + 2048) >>> 12;
+        if (scaled > 32767) return 16'sd32767;
+        if (scaled < -32768) return -16'sd32768;
+        return 16'(scaled);
+    endfunction
+
+    function automatic logic signed [15:0] ref_stage(input int i, input logic signed [15:0] sample);
+        logic signed [15:0] value;
+        value = sample;
+        if (!tb_bypass[i]) begin
+            case (STAGE_EFFECTS[8*i +: 8])
+                effect_pkg::EFFECT_CLIP: value = ref_clip(value, tb_param[16*i +: 16]);
+                effect_pkg::EFFECT_GAIN: value = ref_gain(value, tb_param[16*i +: 16]);
+                default: ;
+            endcase
+        end
+        return value;
+    endfunction
+
+    //ordem que nao e permutacao vira a ordem fixa
+    function automatic logic signed [15:0] ref_chain_ordered(input logic signed [15:0] sample);
+        logic signed [15:0] value;
+        logic [NUM_STAGES-1:0] seen;
+        bit ok;
+        seen = '0;
+        ok = 1;
+        for (int p = 0; p < NUM_STAGES; p++) begin
+            if (tb_order[4*p +: 4] >= NUM_STAGES || seen[tb_order[4*p +: 4]]) ok = 0;
+            else seen[tb_order[4*p +: 4]] = 1'b1;
+        end
+        value = sample;
+        for (int p = 0; p < NUM_STAGES; p++) value = ref_stage(ok ? int'(tb_order[4*p +: 4]) : p, value);
+        return value;
+    endfunction
+
+    function automatic logic signed [15:0] ref_chain(input logic signed [15:0] sample);
+        logic signed [15:0] value;
+        value = sample;
+        for (int i = 0; i < NUM_STAGES; i++) value = ref_stage(i, value);
+        return value;
+    endfunction
+
+    // --- Placar: cada quadro aceito vira um esperado; cada quadro entregue e conferido ---
+    always @(posedge tb_clk_25mhz) begin
+        cycle++;
+        if (!tb_reset) begin
+            if (w_out_valid && tb_out_ready) begin
+                if (expected.size() == 0) begin
+                    $error("FALHA: quadro inesperado na saida (%h %h)", w_out_left, w_out_right);
+                    errors++;
+                end else if ({w_out_left, w_out_right} !== expected.pop_front()) begin
+                    $error("FALHA: saida %h %h diferente do modelo (bypass %b)", w_out_left, w_out_right, tb_bypass);
+                    errors++;
+                end else begin
+                    frames_ok++;
+                end
+            end
+            if (tb_in_valid && w_in_ready) expected.push_back({ref_chain(tb_in_left), ref_chain(tb_in_right)});
+
+            if (w_ord_out_valid && ord_out_ready) begin
+                if (ord_expected.size() == 0) begin
+                    $error("FALHA ORDEM: quadro inesperado na saida (%h %h)", w_ord_out_left, w_ord_out_right);
+                    errors++;
+                end else if ({w_ord_out_left, w_ord_out_right} !== ord_expected.pop_front()) begin
+                    $error("FALHA ORDEM: saida %h %h diferente do modelo (ordem %h)", w_ord_out_left, w_ord_out_right, tb_order);
+                    errors++;
+                end else begin
+                    frames_ok++;
+                end
+            end
+            //a ordem pedida ja esta aplicada quando a entrada aceita o quadro
+            if (ord_in_valid && w_ord_in_ready)
+                ord_expected.push_back({ref_chain_ordered(ord_in_left), ref_chain_ordered(ord_in_right)});
+        end
+    end
+
+    // --- Sequência de Teste Principal ---
+    initial begin : sequencia
+        int sent;
+        int latency;
+        int t_start;
+
+        $dumpfile("dump_effect_chain.vcd");
+        $dumpvars(0, tb_effect_chain);
+
+        $display("Iniciando simulação da effect_chain (%0d estagios, latencia %0d)... Reset ativado.", NUM_STAGES, dut.LATENCY);
+        tb_reset     <= 1'b1;
+        tb_bypass    <= '0;
+        tb_param     <= {16'h1000, 16'sd10000, 16'h2000}; // estagios 2..0: ganho 1x, clip 10000, ganho 2x
+        tb_in_valid  <= 1'b0;
+        tb_in_left   <= '0;
+        tb_in_right  <= '0;
+        tb_out_ready <= 1'b1;
+        tb_order     <= 12'h210;                          // ordem fixa: 0, 1, 2
+        ord_in_valid <= 1'b0;
+        ord_in_left  <= '0;
+        ord_in_right <= '0;
+        ord_out_ready <= 1'b1;
+        #100ns;
+        tb_reset <= 1'b0;
+        @(posedge tb_clk_25mhz);
+
+        // --- TESTE 1: latencia fixa com a cadeia vazia, com e sem bypass ---
+        for (int b = 0; b < 2; b++) begin
+            tb_bypass <= b ? '1 : '0;
+            tb_in_valid <= 1'b1;
+            tb_in_left <= 16'sd9000;
+            tb_in_right <= -16'sd9000;
+            @(posedge tb_clk_25mhz); // borda que aceita o quadro
+            tb_in_valid <= 1'b0;
+            latency = 0;
+            while (!w_out_valid) begin
+                @(posedge tb_clk_25mhz);
+                latency++;
+            end
+            $display("TESTE 1: bypass %b -> latencia medida %0d ciclos", tb_bypass, latency);
+            assert (latency == dut.LATENCY)
+                else $error("FALHA TESTE 1: latencia %0d, esperado %0d", latency, dut.LATENCY);
+            @(posedge tb_clk_25mhz);
+        end
+
+        // --- TESTE 2: todas as combinacoes de bypass, entrada e saida aleatorias ---
+        for (int mask = 0; mask < (1 << NUM_STAGES); mask++) begin
+            wait (expected.size() == 0);
+            @(posedge tb_clk_25mhz);
+            tb_bypass <= mask;
+            tb_param <= {16'($urandom_range(16'h0400, 16'h4000)), 16'($urandom_range(1000, 30000)),
+                         16'($urandom_range(16'h0400, 16'h4000))};
+            @(posedge tb_clk_25mhz);
+
+            sent = 0;
+            while (sent < BLOCK_FRAMES) begin
+                tb_in_valid <= $urandom % 2;
+                tb_in_left <= $urandom;
+                tb_in_right <= $urandom;
+                tb_out_ready <= ($urandom % 10) < 7;
+                @(posedge tb_clk_25mhz);
+                if (tb_in_valid && w_in_ready) sent++;
+            end
+            tb_in_valid <= 1'b0;
+            tb_out_ready <= 1'b1;
+        end
+        wait (expected.size() == 0);
+        $display("TESTE 2: %0d combinacoes de bypass conferidas.", 1 << NUM_STAGES);
+
+        // --- TESTE 3: vazao com a saida sempre pronta ---
+        @(posedge tb_clk_25mhz);
+        tb_bypass <= '0;
+        t_start = cycle;
+        for (int n = 0; n < STREAM_FRAMES; n++) begin
+            tb_in_valid <= 1'b1;
+            tb_in_left <= $urandom;
+            tb_in_right <= $urandom;
+            @(posedge tb_clk_25mhz);
+        end
+        tb_in_valid <= 1'b0;
+        wait (expected.size() == 0);
+        $display("TESTE 3: %0d quadros em %0d ciclos (orcamento a 96 kHz: %0d ciclos por quadro)",
+                 STREAM_FRAMES, cycle - t_start, 25_000_000 / 96_000);
+
+        // --- TESTE 4: ordem em tempo de execucao, trocada sem esvaziar a entrada ---
+        tb_param <= {16'h3000, 16'sd6000, 16'h0800}; // ordens diferentes dao resultados diferentes
+        for (int k = 0; k < 8; k++) begin
+            // 6 permutacoes de 3 estagios, uma ordem invalida (estagio repetido) e a volta a fixa
+            case (k)
+                0: tb_order <= 12'h012;
+                1: tb_order <= 12'h021;
+                2: tb_order <= 12'h102;
+                3: tb_order <= 12'h120;
+                4: tb_order <= 12'h201;
+                5: tb_order <= 12'h211;
+                6: tb_order <= 12'h0F1;
+                default: tb_order <= 12'h210;
+            endcase
+            sent = 0;
+            while (sent < STREAM_FRAMES / 4) begin
+                ord_in_valid <= ($urandom % 4) != 0;
+                ord_in_left <= $urandom;
+                ord_in_right <= $urandom;
+                ord_out_ready <= ($urandom % 10) < 7;
+                @(posedge tb_clk_25mhz);
+                if (ord_in_valid && w_ord_in_ready) sent++;
+            end
+        end
+        ord_in_valid <= 1'b0;
+        ord_out_ready <= 1'b1;
+        wait (ord_expected.size() == 0);
+        $display("TESTE 4: 8 ordens conferidas com o DUT de ordem em tempo de execucao (latencia %0d).", dut_ord.LATENCY);
+
+        // --- Fim ---
+        repeat (4) @(posedge tb_clk_25mhz);
+        assert (errors == 0)
+            else $error("FALHA: %0d erros", errors);
+        $display("Quadros conferidos: %0d | erros: %0d", frames_ok, errors);
+        $display("Simulação da effect_chain concluída.");
+        $finish;
+    end
+
+endmodule
@@ -0,0 +1,176 @@
+`timescale 1ns / 1ps
+
+// Um DUT em I2S 16 bits e outro justificado a esquerda 24 bits, cada um com um
+// receptor modelo que decodifica BCLK/LRCLK/SDATA e confere os quadros carregados.
+// No fim a taxa muda em tempo de execucao e a taxa de quadros do DUT I2S e medida de novo.
+module tb_i2s_driver;
+
+    // --- Constantes ---
+    localparam int CLK_PERIOD = 40; // 40 ns = 25MHz
+    localparam int SAMPLE_RATE = 48_000;
+    localparam int SAMPLE_RATE_2 = 44_100; // troca em tempo de execucao, como a escrita de RATE
+    localparam int FRAMES = 200;
+
+    // --- Sinais do Testbench ---
+    logic tb_clk_25mhz;
+    logic tb_reset;
+    logic [16:0] tb_rate = SAMPLE_RATE;
+
+    // --- Gerador de Clock ---
+    initial begin
+        tb_clk_25mhz = 1'b0;
+        forever #(CLK_PERIOD / 2) tb_clk_25mhz = ~tb_clk_25mhz;
+    end
+
+    int total_errors = 0;
+    int total_frames = 0;
+
+    // --- Um DUT por formato ---
+    for (genvar f = 0; f < 2; f++) begin : g_formato
+        localparam int BITS = (f == 0) ? 16 : 24;
+        localparam bit LJ = (f == 0) ? 1'b0 : 1'b1;
+
+        logic            load;
+        logic [BITS-1:0] left_in, right_in;
+        wire             sample_req, bclk, lrclk, sdata;
+
+        i2s_driver #(.DATA_BITS(BITS), .LEFT_JUSTIFIED(LJ)) dut (
+            .clk_25mhz (tb_clk_25mhz),
+            .reset     (tb_reset),
+            .sample_rate(tb_rate),
+            .load      (load),
+            .left_in   (left_in),
+            .right_in  (right_in),
+            .sample_req(sample_req),
+            .bclk      (bclk),
+            .lrclk     (lrclk),
+            .sdata     (sdata)
+        );
+
+        logic [2*BITS-1:0] expected[$];
+        int frames_ok = 0;
+        int frames_skipped = 0;
+        int errors = 0;
+        int loaded = 0;
+
+        // Fonte: responde cada pedido dois ciclos depois, como a FIFO do top
+        always @(posedge tb_clk_25mhz) begin
+            load <= 1'b0;
+            if (!tb_reset && sample_req && loaded < FRAMES) begin : carregar
+                logic [2*BITS-1:0] frame;
+                frame = {$urandom, $urandom};
+                @(posedge tb_clk_25mhz);
+                load <= 1'b1;
+                left_in <= frame[2*BITS-1:BITS];
+                right_in <= frame[BITS-1:0];
+                expected.push_back(frame);
+                loaded++;
+            end
+        end
+
+        // Receptor modelo: amostra na subida do BCLK e abre um slot a cada troca do LRCLK
+        logic       lr_prev;
+        logic       slot_is_left;
+        int         pos;
+        logic [31:0] slot_word;
+        logic [BITS-1:0] got_left;
+        bit         have_left = 0;
+        time        t_first_frame = 0;
+        time        t_last_frame = 0;
+        int         frames_timed = 0;
+
+        initial lr_prev = LJ ? 1'b0 : 1'b1; // nivel do slot direito depois do reset
+
+        always @(posedge bclk) begin
+            if (!tb_reset) begin
+                if (lrclk !== lr_prev) begin
+                    // fecha o slot anterior
+                    if (!slot_is_left && have_left) begin : fechar_quadro
+                        logic [2*BITS-1:0] frame;
+                        frame = {got_left, slot_word[31 -: BITS]};
+                        if (t_first_frame == 0) t_first_frame = $time;
+                        t_last_frame = $time;
+                        frames_timed++;
+                        if (expected.size() == 0 || frame == '0 && frames_ok == 0) begin
+                            frames_skipped++; // quadros de silencio antes do primeiro load
+                        end else if (frame !== expected.pop_front()) begin
+                            $error("FALHA %s: quadro recebido %h", LJ ? "LJ" : "I2S", frame);
+                            errors++;
+                        end else begin
+                            frames_ok++;
+                        end
+                    end else if (slot_is_left) begin
+                        got_left = slot_word[31 -: BITS];
+                        have_left = 1;
+                    end
+                    slot_is_left = LJ ? lrclk : !lrclk;
+                    slot_word = '0;
+                    pos = 0;
+                    lr_prev = lrclk;
+                end
+                // I2S: o MSB vem um BCLK depois da troca; LJ: junto da troca
+                if (LJ ? (pos < 32) : (pos >= 1 && pos <= 32)) slot_word[31 - (LJ ? pos : pos - 1)] = sdata;
+                pos++;
+            end
+        end
+
+        // LRCLK e SDATA so podem mudar com o BCLK caindo
+        logic bclk_d, lrclk_d, sdata_d;
+        always @(posedge tb_clk_25mhz) begin
+            if (!tb_reset && (lrclk !== lrclk_d || sdata !== sdata_d) && !(bclk_d && !bclk)) begin
+                $error("FALHA TIMING %s: LRCLK/SDATA mudou fora da descida do BCLK em %0t", LJ ? "LJ" : "I2S", $time);
+                errors++;
+            end
+            bclk_d <= bclk;
+            lrclk_d <= lrclk;
+            sdata_d <= sdata;
+        end
+    end
+
+    // --- Sequência de Teste Principal ---
+    initial begin : sequencia
+        time periodo_ns;
+
+        $dumpfile("dump_i2s_driver.vcd");
+        $dumpvars(1, tb_i2s_driver);
+
+        $display("Iniciando simulação do i2s_driver a %0d Hz... Reset ativado.", SAMPLE_RATE);
+        tb_reset <= 1'b1;
+        #100ns;
+        tb_reset <= 1'b0;
+
+        wait (g_formato[0].frames_ok + g_formato[0].errors >= FRAMES - 1 &&
+              g_formato[1].frames_ok + g_formato[1].errors >= FRAMES - 1);
+        #(CLK_PERIOD * 10);
+
+        // Taxa media de quadros medida no receptor do DUT I2S
+        periodo_ns = (g_formato[0].t_last_frame - g_formato[0].t_first_frame) / (g_formato[0].frames_timed - 1);
+        $display("Periodo medio de quadro: %0d ns -> %0d Hz (alvo %0d Hz)", periodo_ns, 1_000_000_000 / periodo_ns, SAMPLE_RATE);
+        assert (1_000_000_000 / periodo_ns >= SAMPLE_RATE - SAMPLE_RATE / 500 &&
+                1_000_000_000 / periodo_ns <= SAMPLE_RATE + SAMPLE_RATE / 500)
+            else $error("FALHA: taxa de quadros fora de 0,2%% do alvo");
+
+        // Nova taxa sem reset: o NCO segue o registrador na hora, sem resintetizar
+        tb_rate <= SAMPLE_RATE_2;
+        #(CLK_PERIOD * 4);
+        g_formato[0].t_first_frame = 0;
+        g_formato[0].frames_timed = 0;
+        wait (g_formato[0].frames_timed >= 50);
+        periodo_ns = (g_formato[0].t_last_frame - g_formato[0].t_first_frame) / (g_formato[0].frames_timed - 1);
+        $display("Depois da troca: %0d ns -> %0d Hz (alvo %0d Hz)", periodo_ns, 1_000_000_000 / periodo_ns, SAMPLE_RATE_2);
+        assert (1_000_000_000 / periodo_ns >= SAMPLE_RATE_2 - SAMPLE_RATE_2 / 500 &&
+                1_000_000_000 / periodo_ns <= SAMPLE_RATE_2 + SAMPLE_RATE_2 / 500)
+            else $error("FALHA: taxa de quadros fora de 0,2%% do alvo depois da troca");
+
+        total_errors = g_formato[0].errors + g_formato[1].errors;
+        total_frames = g_formato[0].frames_ok + g_formato[1].frames_ok;
+        assert (total_errors == 0)
+            else $error("FALHA: %0d erros", total_errors);
+
+        $display("I2S 16 bits: %0d quadros conferidos | LJ 24 bits: %0d quadros conferidos | erros: %0d",
+                 g_formato[0].frames_ok, g_formato[1].frames_ok, total_errors);
+        $display("Simulação do i2s_driver concluída.");
+        $finish;
+    end
+
+endmodule
@@ -0,0 +1,111 @@
+`timescale 1ns / 1ps
+
+// Mede o relogio de amostras do FPGA: periodo minimo/maximo entre ticks, erro de tempo de cada tick
+// contra a grade ideal (TIE) e a taxa media, para varias taxas trocadas em tempo de execucao.
+module tb_sample_clock;
+
+    // --- Constantes ---
+    localparam int CLK_PERIOD = 40; // 40 ns = 25MHz
+    localparam int CLOCK_HZ = 25_000_000;
+    localparam int TICKS = 2000;    // ticks medidos por taxa
+
+    // --- Sinais do Testbench ---
+    logic        tb_clk_25mhz;
+    logic        tb_reset;
+    logic [16:0] tb_rate;
+    wire         w_tick;
+
+    int errors = 0;
+    longint cycle = 0;
+
+    // --- Instanciar o DUT ---
+    sample_clock #(.clock_max(CLOCK_HZ)) dut (
+        .clk_25mhz  (tb_clk_25mhz),
+        .reset      (tb_reset),
+        .sample_rate(tb_rate),
+        .tick       (w_tick)
+    );
+
+    // --- Gerador de Clock ---
+    initial begin
+        tb_clk_25mhz = 1'b0;
+        forever #(CLK_PERIOD / 2) tb_clk_25mhz = ~tb_clk_25mhz;
+    end
+
+    always @(posedge tb_clk_25mhz) cycle++;
+
+    // Mede TICKS periodos na taxa atual
+    task measure(input int rate);
+        longint first, last, prev, interval;
+        longint min_interval, max_interval;
+        real ideal, tie, tie_min, tie_max, ppm;
+
+        tb_rate <= rate;
+        repeat (3) @(posedge tb_clk_25mhz);
+        @(posedge tb_clk_25mhz iff w_tick);   // descarta o primeiro periodo depois da troca
+        @(posedge tb_clk_25mhz iff w_tick);
+        first = cycle;
+        prev = cycle;
+        min_interval = 64'h7FFF_FFFF;
+        max_interval = 0;
+        tie_min = 0.0;
+        tie_max = 0.0;
+        ideal = real'(CLOCK_HZ) / rate;  // ciclos por amostra
+
+        for (int k = 1; k <= TICKS; k++) begin
+            @(posedge tb_clk_25mhz iff w_tick);
+            interval = cycle - prev;
+            prev = cycle;
+            if (interval < min_interval) min_interval = interval;
+            if (interval > max_interval) max_interval = interval;
+            tie = real'(cycle - first) - k * ideal;
+            if (tie < tie_min) tie_min = tie;
+            if (tie > tie_max) tie_max = tie;
+        end
+        last = cycle;
+        ppm = (real'(last - first) / (TICKS * ideal) - 1.0) * 1.0e6;
+
+        $display("  %6d Hz: periodo %0d..%0d ciclos (ideal %.3f) | TIE %.1f..%.1f ns | taxa media %+.2f ppm",
+                 rate, min_interval, max_interval, ideal, tie_min * CLK_PERIOD, tie_max * CLK_PERIOD, ppm);
+
+        // Periodos so podem ser floor/ceil do ideal e o erro acumulado nao passa de um ciclo
+        assert (min_interval >= $floor(ideal) && max_interval <= $ceil(ideal) && max_interval - min_interval <= 1)
+            else begin
+                $error("FALHA: periodos %0d..%0d fora de floor/ceil(%.3f)", min_interval, max_interval, ideal);
+                errors++;
+            end
+        assert (tie_max - tie_min <= 1.0)
+            else begin
+                $error("FALHA: TIE pico a pico %.2f ciclos", tie_max - tie_min);
+                errors++;
+            end
+    endtask
+
+    // --- Sequência de Teste Principal ---
+    initial begin
+        $dumpfile("dump_sample_clock.vcd");
+        $dumpvars(1, tb_sample_clock);
+
+        $display("Iniciando simulação do sample_clock... Reset ativado.");
+        tb_reset <= 1'b1;
+        tb_rate  <= 17'd44_100;
+        #100ns;
+        tb_reset <= 1'b0;
+        @(posedge tb_clk_25mhz);
+
+        $display("TESTE 1: jitter e taxa media, trocando a taxa sem reset...");
+        measure(44_100);
+        measure(48_000);
+        measure(96_000);
+        measure(22_050);
+        measure(32_000);
+        measure(44_100);
+
+        assert (errors == 0)
+            else $error("FALHA: %0d erros", errors);
+        $display("Erros: %0d", errors);
+        $display("Simulação do sample_clock concluída.");
+        $finish;
+    end
+
+endmodule
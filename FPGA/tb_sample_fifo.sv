@@ -0,0 +1,150 @@
+`timescale 1ns / 1ps
+
+module tb_sample_fifo;
+
+    // --- 1. Constantes ---
+    localparam int CLK_PERIOD = 40; // 40 ns = 25MHz
+    localparam int WIDTH = 32;
+    localparam int DEPTH = 16;      // pequeno para chegar rapido em cheia/vazia
+
+    // --- 2. Sinais do Testbench ---
+    logic             tb_clk_25mhz;
+    logic             tb_reset;
+    logic             tb_wr_en;
+    logic [WIDTH-1:0] tb_wr_data;
+    logic             tb_rd_en;
+    logic             tb_clear_flags;
+
+    wire [WIDTH-1:0]        w_rd_data;
+    wire                    w_rd_valid;
+    wire [$clog2(DEPTH):0]  w_level;
+    wire                    w_full, w_empty, w_overflow, w_underflow;
+
+    logic [WIDTH-1:0] expected[$]; // modelo de referencia
+    int reads_ok = 0;
+    int errors = 0;
+
+    // --- 3. Instanciar o DUT ---
+    sample_fifo #(.WIDTH(WIDTH), .DEPTH(DEPTH)) dut (
+        .clk_25mhz  (tb_clk_25mhz),
+        .reset      (tb_reset),
+        .wr_en      (tb_wr_en),
+        .wr_data    (tb_wr_data),
+        .rd_en      (tb_rd_en),
+        .rd_data    (w_rd_data),
+        .rd_valid   (w_rd_valid),
+        .level      (w_level),
+        .full       (w_full),
+        .empty      (w_empty),
+        .overflow   (w_overflow),
+        .underflow  (w_underflow),
+        .clear_flags(tb_clear_flags)
+    );
+
+    // --- 4. Gerador de Clock ---
+    initial begin
+        tb_clk_25mhz = 1'b0;
+        forever #(CLK_PERIOD / 2) tb_clk_25mhz = ~tb_clk_25mhz;
+    end
+
+    // --- 5. Modelo: guarda o que foi aceito e confere cada leitura ---
+    always @(posedge tb_clk_25mhz) begin
+        if (!tb_reset) begin
+            if (w_rd_valid) begin
+                if (expected.size() == 0) begin
+                    $error("FALHA: leitura sem dado esperado (%h)", w_rd_data);
+                    errors++;
+                end else if (w_rd_data !== expected.pop_front()) begin
+                    $error("FALHA: ordem da FIFO quebrada, lido %h", w_rd_data);
+                    errors++;
+                end else begin
+                    reads_ok++;
+                end
+            end
+            if (tb_wr_en && !w_full) expected.push_back(tb_wr_data);
+        end
+    end
+
+    task write_word(input [WIDTH-1:0] data);
+        tb_wr_en <= 1'b1;
+        tb_wr_data <= data;
+        @(posedge tb_clk_25mhz);
+        tb_wr_en <= 1'b0;
+    endtask
+
+    task read_word();
+        tb_rd_en <= 1'b1;
+        @(posedge tb_clk_25mhz);
+        tb_rd_en <= 1'b0;
+    endtask
+
+    // --- 6. Sequência de Teste Principal ---
+    initial begin
+        $dumpfile("dump_sample_fifo.vcd");
+        $dumpvars(0, tb_sample_fifo);
+
+        $display("Iniciando simulação da sample_fifo... Reset ativado.");
+        tb_reset       <= 1'b1;
+        tb_wr_en       <= 1'b0;
+        tb_wr_data     <= '0;
+        tb_rd_en       <= 1'b0;
+        tb_clear_flags <= 1'b0;
+        #100ns;
+        tb_reset <= 1'b0;
+        @(posedge tb_clk_25mhz);
+
+        // --- TESTE 1: encher ate DEPTH, level e full ---
+        $display("TESTE 1: Escrevendo %0d quadros...", DEPTH);
+        for (int n = 0; n < DEPTH; n++) write_word(32'hA000_0000 + n);
+        @(posedge tb_clk_25mhz);
+        assert (w_level == DEPTH && w_full && !w_overflow)
+            else $error("FALHA TESTE 1: level=%0d full=%b overflow=%b", w_level, w_full, w_overflow);
+
+        // --- TESTE 2: escrita com a FIFO cheia e descartada e marca overflow ---
+        $display("TESTE 2: Escrita com a FIFO cheia...");
+        write_word(32'hDEAD_BEEF);
+        @(posedge tb_clk_25mhz);
+        assert (w_overflow && w_level == DEPTH)
+            else $error("FALHA TESTE 2: overflow=%b level=%0d", w_overflow, w_level);
+
+        // --- TESTE 3: esvaziar na ordem de escrita ---
+        $display("TESTE 3: Lendo tudo...");
+        for (int n = 0; n < DEPTH; n++) read_word();
+        @(posedge tb_clk_25mhz);
+        assert (w_empty && w_level == 0 && !w_underflow)
+            else $error("FALHA TESTE 3: empty=%b level=%0d underflow=%b", w_empty, w_level, w_underflow);
+
+        // --- TESTE 4: leitura com a FIFO vazia marca underflow; clear_flags limpa ---
+        $display("TESTE 4: Leitura com a FIFO vazia...");
+        read_word();
+        @(posedge tb_clk_25mhz);
+        assert (w_underflow && !w_rd_valid)
+            else $error("FALHA TESTE 4: underflow=%b rd_valid=%b", w_underflow, w_rd_valid);
+        tb_clear_flags <= 1'b1;
+        @(posedge tb_clk_25mhz);
+        tb_clear_flags <= 1'b0;
+        @(posedge tb_clk_25mhz);
+        assert (!w_overflow && !w_underflow)
+            else $error("FALHA TESTE 4: flags nao foram limpos");
+
+        // --- TESTE 5: escrita e leitura aleatorias, inclusive no mesmo ciclo ---
+        $display("TESTE 5: Trafego aleatorio...");
+        for (int n = 0; n < 2000; n++) begin
+            tb_wr_en <= ($urandom % 2) && !w_full;
+            tb_wr_data <= $urandom;
+            tb_rd_en <= ($urandom % 2) && !w_empty;
+            @(posedge tb_clk_25mhz);
+        end
+        tb_wr_en <= 1'b0;
+        while (!w_empty) read_word();
+        repeat (2) @(posedge tb_clk_25mhz);
+
+        assert (expected.size() == 0 && errors == 0 && !w_overflow && !w_underflow)
+            else $error("FALHA TESTE 5: %0d pendentes, %0d erros", expected.size(), errors);
+
+        $display("Leituras conferidas: %0d | erros: %0d", reads_ok, errors);
+        $display("Simulação da sample_fifo concluída.");
+        $finish;
+    end
+
+endmodule
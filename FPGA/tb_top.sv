@@ -5,6 +5,11 @@ module tb_top;
     // --- 1. Constantes ---
     localparam int CLK_PERIOD           = 40;  // 40 ns = 25MHz
     localparam int SPI_PICO_SCLK_PERIOD = 500; // 500 ns = 2MHz (Clock do SPI vindo do Pico)
+    localparam int SPI_BURST_SCLK_PERIOD = 160; // 160 ns = 6,25MHz, SCLK maximo do receptor
+    localparam int BURST_FRAMES         = 8;   // quadros seguidos, mais rapido do que o DAC consegue enviar
+    localparam int SPI_READ_SCLK_PERIOD = 1000; // 1 MHz: SCLK das leituras de registrador pelo MISO
+    localparam int SAMPLE_RATE          = 44_100; // taxa de reset do sample_clock do top
+    localparam real SAMPLE_CYCLES       = 25_000_000.0 / SAMPLE_RATE; // ciclos de 25MHz por amostra
 
     // --- 2. Sinais do Testbench ---
     // Sinais para conectar às ENTRADAS do DUT (pedal_top)
@@ -20,6 +25,12 @@ module tb_top;
     wire         w_spi_dac_sclk;
     wire        w_spi_dac_mosi;
     wire         w_spi_dac_cs;
+    wire         w_fifo_overflow;
+    wire         w_fifo_underflow;
+    wire         w_spi_pico_miso;
+    wire         w_spi_pico_request;
+
+    int dac_transfers = 0; // uma borda de descida do CS do DAC por amostra enviada
 
     // --- 3. Instanciar o DUT (Device Under Test) ---
     // Conecta os sinais 'tb_' às entradas e 'w_' às saídas do pedal_top
@@ -31,15 +42,29 @@ module tb_top;
         .com_sclk_in  (tb_spi_pico_sclk),
         .com_mosi_in  (tb_spi_pico_mosi),
         .com_active    (tb_spi_pico_cs),
+        .com_miso_out  (w_spi_pico_miso),
+        .com_request_out (w_spi_pico_request),
         
         //.bypass_switch  (tb_bypass_switch),
         
         //conexões modulo dac_driver
         .spi_audio_clk   (w_spi_dac_sclk),
         .spi_mosi_out  (w_spi_dac_mosi),
-        .spi_active_out     (w_spi_dac_cs)
+        .spi_active_out     (w_spi_dac_cs),
+        .spi_miso_out   (tb_spi_dac_miso),
+
+        //diagnostico da FIFO
+        .fifo_overflow  (w_fifo_overflow),
+        .fifo_underflow (w_fifo_underflow)
     );
 
+    // Instante de cada quadro no DAC: o intervalo entre eles mede o jitter da saida
+    realtime dac_times[$];
+    always @(negedge w_spi_dac_cs) begin
+        dac_transfers++;
+        dac_times.push_back($realtime);
+    end
+
     // --- 4. Gerador de Clock Principal ---
     initial begin
         tb_clk_25mhz = 1'b0;
@@ -48,16 +73,77 @@ module tb_top;
 
     // --- 5. Tarefa para Simular o Pico enviando SPI ---
     // (A mesma tarefa do testbench anterior, adaptada para os nomes dos sinais)
-    task send_spi_word(input [15:0] data_word);
+    // Palavra de 16 bits MSB primeiro com o CS ja baixo; o MISO e lido na subida do SCLK
+    task spi_word(input [15:0] word_out, output [15:0] word_in, input int period);
+        for (int i = 15; i >= 0; i--) begin
+            tb_spi_pico_mosi <= word_out[i];
+            #(period / 2);
+            tb_spi_pico_sclk <= 1'b1;
+            word_in[i] = w_spi_pico_miso;
+            #(period / 2);
+            tb_spi_pico_sclk <= 1'b0;
+        end
+    endtask
+
+    // Janela de registrador: palavra de comando {cmd, endereco} e depois as palavras de dado
+    task write_registers(input [7:0] addr, input logic [15:0] data[$]);
+        logic [15:0] ignored;
+        @(posedge tb_clk_25mhz);
+        tb_spi_pico_cs <= 1'b0;
+        tb_spi_pico_sclk <= 1'b0;
+        #(CLK_PERIOD * 2);
+        spi_word({8'h80, addr}, ignored, SPI_BURST_SCLK_PERIOD);
+        foreach (data[i]) spi_word(data[i], ignored, SPI_BURST_SCLK_PERIOD);
+        #(CLK_PERIOD * 2);
+        tb_spi_pico_cs <= 1'b1;
+        #(CLK_PERIOD * 4);
+    endtask
+
+    task read_register(input [7:0] addr, output [15:0] data);
+        logic [15:0] ignored;
+        @(posedge tb_clk_25mhz);
+        tb_spi_pico_cs <= 1'b0;
+        tb_spi_pico_sclk <= 1'b0;
+        #(CLK_PERIOD * 2);
+        spi_word({8'h40, addr}, ignored, SPI_READ_SCLK_PERIOD);
+        spi_word(16'h0000, data, SPI_READ_SCLK_PERIOD);
+        #(CLK_PERIOD * 2);
+        tb_spi_pico_cs <= 1'b1;
+        #(CLK_PERIOD * 4);
+    endtask
+
+    // Rajada CMD_READ: count palavras a partir de addr na mesma janela de CS
+    task read_registers(input [7:0] addr, input int count, output logic [15:0] data[$]);
+        logic [15:0] ignored, word;
+        data = {};
+        @(posedge tb_clk_25mhz);
+        tb_spi_pico_cs <= 1'b0;
+        tb_spi_pico_sclk <= 1'b0;
+        #(CLK_PERIOD * 2);
+        spi_word({8'h40, addr}, ignored, SPI_READ_SCLK_PERIOD);
+        for (int i = 0; i < count; i++) begin
+            spi_word(16'h0000, word, SPI_READ_SCLK_PERIOD);
+            data.push_back(word);
+        end
+        #(CLK_PERIOD * 2);
+        tb_spi_pico_cs <= 1'b1;
+        #(CLK_PERIOD * 4);
+    endtask
+
+    // Um quadro estereo por janela de CS: esquerdo e depois direito, MSB primeiro.
+    // Toda janela de audio comeca com a palavra de comando 0x0000
+    task send_spi_frame(input [15:0] left_word, input [15:0] right_word);
+        logic [47:0] frame;
+        frame = {16'h0000, left_word, right_word};
         @(posedge tb_clk_25mhz); // Sincroniza com o clock principal
         
-        tb_spi_pico_cs <= 1'b1; // Ativa o CS (assumindo ativo-alto)
+        tb_spi_pico_cs <= 1'b0; // Ativa o CS (ativo-baixo, como o Pico)
         tb_spi_pico_sclk <= 1'b0;
         
         #(CLK_PERIOD * 2); 
 
-        for (int i = 15; i >= 0; i--) begin
-            tb_spi_pico_mosi <= data_word[i];       // Coloca o bit
+        for (int i = 47; i >= 0; i--) begin
+            tb_spi_pico_mosi <= frame[i];           // Coloca o bit
             #(SPI_PICO_SCLK_PERIOD / 2);
             tb_spi_pico_sclk <= 1'b1;               // Sobe o clock SPI
             #(SPI_PICO_SCLK_PERIOD / 2);
@@ -65,7 +151,32 @@ module tb_top;
         end
         
         #(CLK_PERIOD * 2);
-        tb_spi_pico_cs <= 1'b0; // Desativa o CS
+        tb_spi_pico_cs <= 1'b1; // Desativa o CS
+    endtask
+
+    // Rajada de quadros em uma unica janela de CS, como o modo DMA do Pico
+    task send_spi_burst(input int frames);
+        logic [31:0] frame;
+        logic [15:0] ignored;
+        @(posedge tb_clk_25mhz);
+        tb_spi_pico_cs <= 1'b0;
+        tb_spi_pico_sclk <= 1'b0;
+        #(CLK_PERIOD * 2);
+        spi_word(16'h0000, ignored, SPI_BURST_SCLK_PERIOD);
+
+        for (int n = 0; n < frames; n++) begin
+            frame = {16'(n * 16'h0100), 16'(n * 16'h0100)};
+            for (int i = 31; i >= 0; i--) begin
+                tb_spi_pico_mosi <= frame[i];
+                #(SPI_BURST_SCLK_PERIOD / 2);
+                tb_spi_pico_sclk <= 1'b1;
+                #(SPI_BURST_SCLK_PERIOD / 2);
+                tb_spi_pico_sclk <= 1'b0;
+            end
+        end
+
+        #(CLK_PERIOD * 2);
+        tb_spi_pico_cs <= 1'b1;
     endtask
 
     // --- 6. Sequência de Teste Principal ---
@@ -78,7 +189,7 @@ module tb_top;
         tb_reset          <= 1'b1; // Ativa o reset
         tb_spi_pico_sclk  <= 1'b0;
         tb_spi_pico_mosi  <= 1'b0;
-        tb_spi_pico_cs    <= 1'b0; // CS inativo
+        tb_spi_pico_cs    <= 1'b1; // CS inativo
         tb_bypass_switch  <= 1'b1; // **IMPORTANTE: Coloca no modo BYPASS**
         tb_spi_dac_miso   <= 1'b0; // Deixa a entrada MISO flutuando (alta impedância)
         
@@ -88,25 +199,25 @@ module tb_top;
         $display("Reset liberado. Módulo top em IDLE.");
         
         @(posedge tb_clk_25mhz);
+        @(posedge tb_clk_25mhz);
+        assert (w_spi_pico_request == 1'b1)
+            else $error("FALHA: FIFO vazia sem pedido de quadros ao Pico");
         
         // --- TESTE PASSTHROUGH ---
-        $display("TESTE PASSTHROUGH: Enviando 16'hC0DE...");
+        $display("TESTE PASSTHROUGH: Enviando L = R = 16'hC0DE...");
         
         // Inicia o envio SPI em paralelo
         fork
-            send_spi_word(16'hC0DE);
+            send_spi_frame(16'hC0DE, 16'hC0DE);
         join_none
 
-        // Espera o sinal INTERNO 'data_is_ready' do DUT pulsar.
+        // Espera o quadro sair da cadeia de efeitos (sinal INTERNO 'chain_out_valid' do DUT).
         // Precisamos usar o caminho hierárquico para acessá-lo.
-        @(posedge dut.data_is_ready); 
-        $display("... Pulso 'data_is_ready' (interno do DUT) detectado!(%h)", dut.data_is_ready);
-        $display("... Conteudo em mosi_out!(%h)", dut.spi_mosi_out);
+        @(posedge dut.chain_out_valid); 
+        #1;
+        $display("... Pulso 'chain_out_valid' (interno do DUT) detectado!(%h)", dut.chain_out_valid);
 
-        // Espera mais um ciclo para o MUX atualizar sua saída
-        @(posedge tb_clk_25mhz);
-
-        // Verifica o sinal INTERNO 'audio_selected_16b' do DUT.
+        // Com os efeitos em bypass (EFFECT_BYPASS = 2'b11) o quadro passa intacto pela cadeia.
         // Este é o sinal que DEVE ir para o dac_driver.
         $display("... Verificando sinal na entrada do dac_driver ('dut.output_audio')...");
         assert (dut.output_audio == 16'hC0DE)
@@ -115,6 +226,152 @@ module tb_top;
         $display("... Valor correto (%h) chegou à entrada do dac_driver.", dut.output_audio);
         $display("Valor de saída truncado em dac_driver (%h)", dut.spi_mosi_out);
         $display("TESTE PASSTHROUGH: Concluído com sucesso!");
+
+        // --- TESTE MIXAGEM: o DAC e mono, recebe a media dos canais ---
+        #2000ns;
+        $display("TESTE MIXAGEM: Enviando L = 16'h1000, R = 16'h3000...");
+        fork
+            send_spi_frame(16'h1000, 16'h3000);
+        join_none
+
+        @(posedge dut.data_is_ready);
+        @(posedge tb_clk_25mhz);
+        assert (dut.audio_left == 16'h1000 && dut.audio_right == 16'h3000)
+            else $error("FALHA MIXAGEM: canais recebidos L=%h R=%h", dut.audio_left, dut.audio_right);
+        @(posedge dut.chain_out_valid);
+        #1;
+        assert (dut.output_audio == 16'h2000)
+            else $error("FALHA MIXAGEM: media esperada 2000, mas foi %h", dut.output_audio);
+        $display("TESTE MIXAGEM: Concluído com sucesso!");
+
+        // --- TESTE RAJADA: quadros chegam bem mais rapido que o relogio de amostras e esperam na FIFO ---
+        // Entre os testes a FIFO fica vazia e cada tick marca underflow: logo depois de um tick as
+        // flags sao limpas pelo registrador CONTROL e a rajada chega antes do tick seguinte.
+        #10000ns; // DAC termina a amostra anterior
+        $display("TESTE RAJADA: %0d quadros a 6,25MHz em uma janela de CS...", BURST_FRAMES);
+        @(posedge dut.sample_tick);
+        begin : limpa_flags
+            logic [15:0] words[$];
+            words = {16'h0001};
+            write_registers(8'h08, words);
+        end
+        dac_transfers = 0;
+        dac_times.delete();
+        send_spi_burst(BURST_FRAMES);
+        fork : espera_rajada
+            wait (dac_transfers == BURST_FRAMES);
+            #((BURST_FRAMES + 2) * SAMPLE_CYCLES * CLK_PERIOD);
+        join_any
+        disable espera_rajada;
+        wait (w_spi_dac_cs == 1'b1);
+        #(CLK_PERIOD * 40);
+        assert (dac_transfers == BURST_FRAMES)
+            else $error("FALHA RAJADA: %0d quadros enviados, %0d chegaram ao DAC", BURST_FRAMES, dac_transfers);
+        assert (!w_fifo_overflow && !w_fifo_underflow)
+            else $error("FALHA RAJADA: flags da FIFO overflow=%b underflow=%b", w_fifo_overflow, w_fifo_underflow);
+        $display("TESTE RAJADA: %0d amostras no DAC. Concluído com sucesso!", dac_transfers);
+
+        // --- TESTE JITTER: a rajada chega de uma vez, mas sai no ritmo do sample_clock ---
+        begin : jitter
+            real interval, min_interval, max_interval;
+            min_interval = 1.0e9;
+            max_interval = 0.0;
+            for (int i = 1; i < dac_times.size(); i++) begin
+                interval = (dac_times[i] - dac_times[i-1]) / CLK_PERIOD;
+                if (interval < min_interval) min_interval = interval;
+                if (interval > max_interval) max_interval = interval;
+            end
+            $display("TESTE JITTER: intervalo entre quadros no DAC %.0f..%.0f ciclos (ideal %.2f)",
+                     min_interval, max_interval, SAMPLE_CYCLES);
+            assert (min_interval >= $floor(SAMPLE_CYCLES) && max_interval <= $ceil(SAMPLE_CYCLES))
+                else $error("FALHA JITTER: intervalos fora de floor/ceil do periodo de amostra");
+        end
+
+        // --- TESTE REGISTRADORES: liga o drive (estagio 0) pelo SPI e le o diagnostico pelo MISO ---
+        $display("TESTE REGISTRADORES: ID, contador de quadros e bypass pelo SPI...");
+        begin : registradores
+            logic [15:0] value;
+            logic [15:0] words[$];
+
+            read_register(8'h00, value);
+            assert (value == 16'hEF01)
+                else $error("FALHA REGISTRADORES: ID lido %h, esperado EF01", value);
+
+            read_register(8'h03, value);
+            assert (value == 16'(BURST_FRAMES + 2))
+                else $error("FALHA REGISTRADORES: %0d quadros contados, esperado %0d", value, BURST_FRAMES + 2);
+
+            // BYPASS = 11110: so o drive (ganho 2.0) ativo
+            words = {16'b11110};
+            write_registers(8'h09, words);
+            read_register(8'h09, value);
+            assert (value == 16'b11110)
+                else $error("FALHA REGISTRADORES: BYPASS lido %b", value);
+
+            wait (w_spi_dac_cs == 1'b1);
+            fork
+                send_spi_frame(16'h0800, 16'h0800);
+            join_none
+            @(posedge dut.chain_out_valid);
+            #1;
+            assert (dut.output_audio == 16'h1000)
+                else $error("FALHA REGISTRADORES: drive 2x esperado 1000, saiu %h", dut.output_audio);
+
+            // ganho 1.0 no drive pelo PARAM do estagio 0
+            words = {16'h1000};
+            write_registers(8'h10, words);
+            wait (w_spi_dac_cs == 1'b1);
+            #(CLK_PERIOD * 40);
+            fork
+                send_spi_frame(16'h0800, 16'h0800);
+            join_none
+            @(posedge dut.chain_out_valid);
+            #1;
+            assert (dut.output_audio == 16'h0800)
+                else $error("FALHA REGISTRADORES: drive 1x esperado 0800, saiu %h", dut.output_audio);
+
+            words = {16'b11111};
+            write_registers(8'h09, words);
+        end
+        $display("TESTE REGISTRADORES: Concluído com sucesso!");
+
+        // --- TESTE FRAMES: FRAMES_LO/FRAMES_HI lidos na mesma rajada formam um valor de 32 bits so ---
+        $display("TESTE FRAMES: leitura de FRAMES_LO/HI atravessando o carry de 16 bits...");
+        begin : frames_snapshot
+            logic [15:0] words[$];
+
+            // HI diferente de zero: a rajada a partir de 0x03 tem que congelar o HI atual
+            @(posedge tb_clk_25mhz);
+            force dut.u_control_regs.frames = 32'h0001_FFFF;
+            @(posedge tb_clk_25mhz);
+            release dut.u_control_regs.frames;
+            read_registers(8'h03, 2, words);
+            assert ({words[1], words[0]} == 32'h0001_FFFF)
+                else $error("FALHA FRAMES: lido %h_%h, esperado 0001_FFFF", words[1], words[0]);
+
+            // O contador passa de 0x0002FFFF para 0x00030000 depois de LO capturado e antes de HI:
+            // HI tem que vir do valor congelado junto com LO, nunca 0x0003FFFF
+            @(posedge tb_clk_25mhz);
+            force dut.u_control_regs.frames = 32'h0002_FFFF;
+            @(posedge tb_clk_25mhz);
+            release dut.u_control_regs.frames;
+            fork
+                read_registers(8'h03, 2, words);
+                begin
+                    wait (dut.reg_addr == 8'h03);   // cabecalho decodificado
+                    wait (dut.reg_addr == 8'h04);   // FRAMES_LO capturado
+                    @(posedge tb_clk_25mhz);
+                    force dut.u_control_regs.frames = 32'h0003_0000;
+                    @(posedge tb_clk_25mhz);
+                    release dut.u_control_regs.frames;
+                end
+            join
+            assert ({words[1], words[0]} == 32'h0002_FFFF)
+                else $error("FALHA FRAMES: lido %h_%h atravessando o carry, esperado 0002_FFFF", words[1], words[0]);
+            assert (dut.u_control_regs.frames == 32'h0003_0000)
+                else $error("FALHA FRAMES: o carry nao aconteceu durante a rajada");
+        end
+        $display("TESTE FRAMES: Concluído com sucesso!");
         
         // Espera um pouco antes de terminar
         #2000ns; 
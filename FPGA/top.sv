@@ -1,64 +1,237 @@
 module top#(
-    parameter int unsigned clock_max = 25_000_000
+    parameter int unsigned clock_max = 25_000_000,
+    parameter bit SPI_LSB_BYTE_FIRST = 1'b0, //1: o Pico manda cada canal em bytes little endian
+    parameter int unsigned FIFO_DEPTH = 512, //quadros estereo guardados entre o receptor e o DAC
+    parameter int unsigned DAC_SCLK_DIV = 2, //SCLK do DAC = 25MHz / DAC_SCLK_DIV (2 -> 12,5MHz)
+
+    //relogio de amostras do FPGA: o DAC recebe um quadro por tick do sample_clock, nao quando o Pico manda.
+    //SAMPLE_RATE e o valor de reset do registrador RATE, que o Pico troca pela taxa do WAV.
+    parameter int unsigned SAMPLE_RATE = 44_100,
+    parameter int unsigned REQUEST_FRAMES = 128,    //quadros por rajada do Pico (um bloco de 512 bytes)
+
+    //cadeia de efeitos: estagio 0 = drive (eff_gain), 1 = hard clipping (eff_1),
+    //2 = biquads (eff_biquad: EQ/tom/wah/simulador de caixa, coeficientes identidade no reset),
+    //3 = chorus (eff_chorus, 2 EBR), 4 = eco (eff_echo, ECHO_DEPTH / 512 EBR)
+    //os valores abaixo sao so os de reset: o Pico troca bypass, parametros, ordem dos estagios e
+    //coeficientes em tempo de execucao pelo banco control_regs (comandos de registrador no SPI)
+    parameter logic [4:0] EFFECT_BYPASS = 5'b11111,  //1 = estagio em bypass (audio original)
+    parameter logic signed [15:0] DRIVE_GAIN = 16'sh2000, //Q4.12: 2.0
+    parameter logic signed [15:0] CLIP_LEVEL = 16'sd10000,
+    parameter logic [15:0] CHORUS_RATE_DEPTH = {8'd20, 8'd96}, //LFO ~3,7 Hz, desvio de ate 2 ms a 48 kHz
+    parameter logic [15:0] ECHO_DELAY = 16'd7200,    //amostras (150 ms a 48 kHz); limitado a ECHO_DEPTH - 2
+    parameter int unsigned ECHO_DEPTH = 8192,        //8192 -> 16 EBR, ate 170 ms a 48 kHz
+
+    //saida de audio: 0 = dac_driver (SPI mono, 12 bits), 1 = i2s_driver (estereo, I2S ou justificado a esquerda)
+    parameter bit USE_I2S = 1'b0,
+    parameter bit I2S_LEFT_JUSTIFIED = 1'b0,
+    parameter int unsigned I2S_BITS = 16           //16 ou 24; o audio do Pico ocupa os 16 bits mais significativos
 )(
     //entradas globais
     input logic clk_25mhz, reset, 
     //input logic mode_sound, //um botão que ativa o audio modificado,  
 
-    //pinos de entrada de dados SPI, comunication.sv
+    //pinos de entrada de dados SPI, comunication.sv (MISO devolve as leituras de registrador)
     input logic com_sclk_in, com_mosi_in, com_active,
+    output logic com_miso_out,
+    output logic com_request_out, //1 = a FIFO tem espaco para mais duas rajadas do Pico
 
-    //pinos de saida de dados do dac_driver.sv
+    //pinos de saida de dados do dac_driver.sv (com USE_I2S: BCLK, SDATA e LRCLK)
     output logic spi_audio_clk, 
     output logic spi_mosi_out, 
     output logic spi_active_out,
-    input logic  spi_miso_out
+    input logic  spi_miso_out,
+
+    //diagnostico da fila de amostras (ficam em 1 ate o reset)
+    output logic fifo_overflow,
+    output logic fifo_underflow
 );
 
-logic data_is_ready;  //sinal interno do top-level
-logic [15:0] original_audio; //faixa de audio original de comunication.sv
-logic [15:0] modified_audio; //faixa de saida de modulos de efeito
-logic [15:0] output_audio;  //faixa que irá para saida do fpga
+logic data_is_ready;  //sinal interno do top-level, um pulso por quadro estereo
+logic signed [15:0] audio_left, audio_right; //canais recebidos do pico
+logic sample_valid;   //quadro saindo da FIFO para a cadeia de efeitos
+logic [31:0] fifo_frame;
+logic signed [15:0] fifo_left, fifo_right;
+logic signed [15:0] chain_left, chain_right; //quadro saindo da cadeia de efeitos
+logic signed [16:0] soma_canais;
+logic [15:0] output_audio;  //faixa que irá para saida do fpga (media de L e R, o DAC e mono)
+
+//barramento de registradores entre comunication e control_regs
+logic reg_we, reg_re;
+logic [7:0] reg_addr;
+logic [15:0] reg_wdata, reg_rdata;
 
 
 //copia modulo comunication
-    comunication #(.clock_max(clock_max) 
+    comunication #(.clock_max(clock_max), .BITS(16),
+        .LSB_BYTE_FIRST(SPI_LSB_BYTE_FIRST), .ACTIVE_LOW(1'b1)
         )u_comunication(
             .clk_25mhz(clk_25mhz), .sclk_in(com_sclk_in), 
             .mosi_in(com_mosi_in), .active(com_active),
-            .reset(reset), .audio_out(original_audio),
-            .data_ready(data_is_ready)
+            .reset(reset), .audio_left(audio_left),
+            .audio_right(audio_right), .frame_ready(data_is_ready),
+            .reg_we(reg_we), .reg_re(reg_re), .reg_addr(reg_addr),
+            .reg_wdata(reg_wdata), .reg_rdata(reg_rdata), .miso_out(com_miso_out)
+        );
+
+
+//copia modulo sample_fifo: guarda os quadros que chegam enquanto o DAC esta ocupado em DAC_TRANSFER
+logic fifo_rd_en, fifo_full, fifo_empty;
+logic [$clog2(FIFO_DEPTH):0] fifo_level;
+logic fifo_clear_flags;
+logic sample_tick;    //um pulso por periodo de amostra: puxa o proximo quadro da FIFO
+logic stream_started; //primeiro quadro recebido: a partir dai tick com a FIFO vazia e underflow
+logic [31:0] sample_rate;
+
+initial begin
+    if (FIFO_DEPTH < 2 * REQUEST_FRAMES) $error("top: FIFO_DEPTH precisa de espaco para duas rajadas (%0d quadros)", 2 * REQUEST_FRAMES);
+end
+
+    sample_fifo #(.WIDTH(32), .DEPTH(FIFO_DEPTH)
+        )u_sample_fifo(
+            .clk_25mhz(clk_25mhz), .reset(reset),
+            .wr_en(data_is_ready), .wr_data({audio_left, audio_right}),
+            .rd_en(fifo_rd_en), .rd_data(fifo_frame), .rd_valid(sample_valid),
+            .level(fifo_level), .full(fifo_full), .empty(fifo_empty),
+            .overflow(fifo_overflow), .underflow(fifo_underflow), .clear_flags(fifo_clear_flags)
+        );
+
+assign fifo_left = fifo_frame[31:16];
+assign fifo_right = fifo_frame[15:0];
+
+always_ff @(posedge clk_25mhz or posedge reset) begin
+    if (reset) stream_started <= 1'b0;
+    else if (data_is_ready) stream_started <= 1'b1;
+end
+
+//pedido ao Pico: com o nivel abaixo de FIFO_DEPTH - 2 rajadas cabe a rajada em andamento e mais uma
+always_ff @(posedge clk_25mhz or posedge reset) begin
+    if (reset) com_request_out <= 1'b0;
+    else com_request_out <= (fifo_level <= FIFO_DEPTH - 2 * REQUEST_FRAMES);
+end
+
+
+//copia modulo control_regs: parametros da cadeia de efeitos e diagnostico lidos pelo Pico
+logic [4:0] chain_bypass;
+logic [19:0] chain_order;
+logic [16*5-1:0] chain_param;
+logic coef_we;
+logic [11:0] coef_addr;
+logic signed [17:0] coef_data;
+
+    control_regs #(.NUM_STAGES(5), .BYPASS_RESET(EFFECT_BYPASS),
+        .PARAM_RESET({ECHO_DELAY, CHORUS_RATE_DEPTH, 16'd0, CLIP_LEVEL, DRIVE_GAIN}), .RATE_RESET(SAMPLE_RATE)
+        )u_control_regs(
+            .clk_25mhz(clk_25mhz), .reset(reset),
+            .reg_we(reg_we), .reg_re(reg_re), .reg_addr(reg_addr),
+            .reg_wdata(reg_wdata), .reg_rdata(reg_rdata),
+            .frame_received(data_is_ready), .fifo_level(16'(fifo_level)),
+            .fifo_full(fifo_full), .fifo_empty(fifo_empty),
+            .fifo_overflow(fifo_overflow), .fifo_underflow(fifo_underflow),
+            .overflow_event(data_is_ready && fifo_full), .underflow_event(fifo_rd_en && fifo_empty),
+            .fifo_request(com_request_out),
+            .clear_fifo_flags(fifo_clear_flags), .sample_rate(sample_rate),
+            .bypass(chain_bypass), .order(chain_order), .stage_param(chain_param),
+            .coef_we(coef_we), .coef_addr(coef_addr), .coef_data(coef_data)
         );
 
 
-logic modified_status; //armazena se aplicação de efeito terminou
-//copia modulo eff_1
-    eff_1 #(.clock_max(clock_max) 
-        )u_eff_1(
-            .clk_25mhz(clk_25mhz), .data_ready(data_is_ready), 
-            .audio_in(original_audio), .audio_out(modified_audio), 
-            .process_status(modified_status)
+//quadro lido da FIFO esperando a cadeia aceitar (rd_data fica estavel ate a proxima leitura)
+logic frame_pending;
+logic chain_in_valid, chain_in_ready;
+logic chain_out_valid, chain_out_ready;
+
+assign chain_in_valid = sample_valid || frame_pending;
+
+always_ff @(posedge clk_25mhz or posedge reset) begin
+    if (reset) frame_pending <= 1'b0;
+    else if (chain_in_valid && chain_in_ready) frame_pending <= 1'b0;
+    else if (sample_valid) frame_pending <= 1'b1;
+end
+
+//copia modulo effect_chain: latencia fixa, com ou sem bypass; ordem dos estagios pelo control_regs
+    effect_chain #(.clock_max(clock_max), .NUM_STAGES(5),
+        .STAGE_EFFECTS({effect_pkg::EFFECT_ECHO, effect_pkg::EFFECT_CHORUS, effect_pkg::EFFECT_BIQUAD,
+                        effect_pkg::EFFECT_CLIP, effect_pkg::EFFECT_GAIN}),
+        .ECHO_DEPTH(ECHO_DEPTH), .CHORUS_DEPTH(1024), .RUNTIME_ORDER(1'b1)
+        )u_effect_chain(
+            .clk_25mhz(clk_25mhz), .reset(reset),
+            .bypass(chain_bypass), .stage_param(chain_param), .order(chain_order),
+            .coef_we(coef_we), .coef_addr(coef_addr), .coef_data(coef_data),
+            .in_valid(chain_in_valid), .in_ready(chain_in_ready),
+            .in_left(fifo_left), .in_right(fifo_right),
+            .out_valid(chain_out_valid), .out_ready(chain_out_ready),
+            .out_left(chain_left), .out_right(chain_right)
         );
 
-//passagem da faixa de audio, original ou modificada,
-logic mode_sound = 1'b0; 
-assign output_audio = (mode_sound)?  modified_audio: original_audio;
-
-//copia modulo dac_driver
-    dac_driver #(.clock_max(clock_max) 
-        )u_dac_driver(
-            //entradas do fpga -> dac
-            .clk_25mhz(clk_25mhz),
-            .data_ready(data_is_ready),
-            .mosi_in(output_audio),
-            .reset(reset),
-
-            //saidas do dac -> amplificador
-            .sclk_out(spi_audio_clk), //SCLK_OUT está muito mais lento do que preciso 
-            .mosi_out(spi_mosi_out),
-            .active_out(spi_active_out), 
-            .miso_out(spi_miso_out) 
-    );
+assign soma_canais = chain_left + chain_right;
+assign output_audio = soma_canais[16:1];
+
+generate
+    if (USE_I2S) begin : g_i2s
+        //BCLK continuo: o driver pede um quadro por periodo de amostra (o NCO do i2s_driver faz o
+        //papel do sample_clock e segue o mesmo registrador RATE); a FIFO entrega no ciclo seguinte
+        //e a cadeia de efeitos LATENCY ciclos depois, bem antes do proximo quadro.
+        //Depois do primeiro quadro recebido, pedido com a FIFO vazia marca underflow.
+        //O BCLK vem do NCO na grade de 40 ns (jitter de ~+-13% do meio periodo a 48 kHz): serve a
+        //DACs com PLL interno; DAC sem PLL precisa de MCLK externo (ver i2s_driver.sv).
+        logic i2s_req;
+        logic i2s_load;
+        logic [15:0] i2s_left, i2s_right;
+        logic [I2S_BITS-1:0] i2s_left_word, i2s_right_word; //16 bits alinhados ao MSB, zeros abaixo
+
+        assign sample_tick = i2s_req;
+        assign fifo_rd_en = sample_tick && stream_started;
+
+        //o driver aceita o quadro a qualquer momento: a cadeia nunca trava neste modo
+        assign chain_out_ready = 1'b1;
+        assign i2s_load = chain_out_valid;
+        assign i2s_left = chain_left;
+        assign i2s_right = chain_right;
+        assign i2s_left_word = {i2s_left, {I2S_BITS{1'b0}}} >> 16;
+        assign i2s_right_word = {i2s_right, {I2S_BITS{1'b0}}} >> 16;
+
+        i2s_driver #(.clock_max(clock_max),
+            .DATA_BITS(I2S_BITS), .LEFT_JUSTIFIED(I2S_LEFT_JUSTIFIED)
+            )u_i2s_driver(
+                .clk_25mhz(clk_25mhz), .reset(reset),
+                .sample_rate(sample_rate[16:0]),
+                .load(i2s_load),
+                .left_in(i2s_left_word),
+                .right_in(i2s_right_word),
+                .sample_req(i2s_req),
+                .bclk(spi_audio_clk), .lrclk(spi_active_out), .sdata(spi_mosi_out)
+            );
+    end else begin : g_spi_dac
+        //o sample_clock puxa um quadro da FIFO por periodo de amostra; ele chega ao DAC com a
+        //latencia fixa da FIFO + cadeia, entao o jitter da saida e o do NCO (um ciclo de 40 ns)
+        //e nao o do SPI do Pico. O dac_driver mantem active_out em 1 so em DAC_IDLE e termina
+        //um quadro em ~40 ciclos, muito antes do proximo tick.
+        sample_clock #(.clock_max(clock_max)
+            )u_sample_clock(
+                .clk_25mhz(clk_25mhz), .reset(reset),
+                .sample_rate(sample_rate[16:0]), .tick(sample_tick)
+            );
+
+        assign fifo_rd_en = sample_tick && stream_started;
+        assign chain_out_ready = spi_active_out;
+
+        //copia modulo dac_driver
+        dac_driver #(.clock_max(clock_max), .SCLK_DIV(DAC_SCLK_DIV)
+            )u_dac_driver(
+                //entradas do fpga -> dac
+                .clk_25mhz(clk_25mhz),
+                .data_ready(chain_out_valid && spi_active_out),
+                .mosi_in(output_audio),
+                .reset(reset),
+
+                //saidas do dac -> amplificador
+                .sclk_out(spi_audio_clk), //ate 12,5MHz com DAC_SCLK_DIV = 2
+                .mosi_out(spi_mosi_out),
+                .active_out(spi_active_out), 
+                .miso_out(spi_miso_out) 
+        );
+    end
+endgenerate
 
 
 endmodule
\ No newline at end of file
@@ -0,0 +1,472 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "CartaoSD.h"
+#include "Instrumentacao.h"
+
+#ifdef CARTAO_SD_HOST
+#include "EmuladorCartaoSd.h"
+#endif
+
+// Mesma ligacao do projeto principal (SPI0)
+#define SPI_CARTAO spi0
+#define PINO_SPI_MISO_CARTAO 16u
+#define PINO_SPI_MOSI_CARTAO 19u
+#define PINO_SPI_SCK_CARTAO 18u
+#define PINO_SPI_CS_CARTAO 17u
+
+// Saida em CSV, dois tipos de linha (linhas com # sao comentarios):
+//   ensaio,nome,cluster_bytes,bloco_bytes,total_bytes,operacoes,tempo_us,kb_por_s,us_por_operacao
+//   camada,nome,cluster_bytes,camada,chamadas,tempo_us,bytes,maximo_us
+// As linhas camada detalham o ensaio impresso logo antes; os tempos de camada sao inclusivos.
+
+namespace {
+
+constexpr const char *ARQUIVO_SEQUENCIAL = "/bench_seq.bin";
+constexpr const char *ARQUIVO_FRAGMENTADO = "/bench_frag.bin";
+constexpr const char *ARQUIVO_INTERCALADO = "/bench_intercalado.bin";
+constexpr const char *DIRETORIO_ENUMERACAO = "/bench_dir";
+constexpr uint32_t BYTES_POR_ENSAIO = 1024u * 1024u;
+constexpr uint32_t BYTES_FRAGMENTADO = 256u * 1024u;
+constexpr size_t TAMANHO_MAXIMO_BLOCO = 16u * 1024u;
+constexpr size_t TAMANHOS_BLOCO_ESCRITA[] = {512u, 4096u, TAMANHO_MAXIMO_BLOCO};
+constexpr size_t TAMANHOS_BLOCO_LEITURA[] = {512u, 1024u, 4096u, TAMANHO_MAXIMO_BLOCO};
+constexpr uint32_t OPERACOES_ALEATORIAS = 256u;
+constexpr uint32_t ENTRADAS_DIRETORIO = 64u;
+
+#ifdef CARTAO_SD_HOST
+// No host cada tamanho de cluster e um volume formatado de novo
+constexpr uint32_t TAMANHOS_CLUSTER[] = {2048u, 8192u, 32768u};
+#endif
+
+uint8_t bufferDados[TAMANHO_MAXIMO_BLOCO];
+cartao_sd::PoolBlocosFluxo poolFluxo;
+uint32_t clusterAtual = 0u;
+uint32_t ensaiosFalhos = 0u;
+
+struct ResultadoEnsaio {
+    const char *nome;
+    uint32_t bloco_bytes;
+    uint64_t total_bytes;
+    uint32_t operacoes;
+    uint64_t tempo_us;
+};
+
+// Gerador congruente: as posicoes "aleatorias" sao as mesmas em toda execucao
+uint32_t proximoAleatorio(uint32_t &estado) {
+    estado = estado * 1664525u + 1013904223u;
+    return estado >> 8u;
+}
+
+void imprimirResultado(const ResultadoEnsaio &resultado) {
+    uint64_t kb_por_s = 0u;
+    if (resultado.tempo_us > 0u) {
+        kb_por_s = (resultado.total_bytes * 1000000u) / (resultado.tempo_us * 1024u);
+    }
+    uint64_t us_por_operacao = (resultado.operacoes > 0u) ? resultado.tempo_us / resultado.operacoes : 0u;
+
+    printf("ensaio,%s,%lu,%lu,%llu,%lu,%llu,%llu,%llu\r\n",
+           resultado.nome,
+           (unsigned long)clusterAtual,
+           (unsigned long)resultado.bloco_bytes,
+           (unsigned long long)resultado.total_bytes,
+           (unsigned long)resultado.operacoes,
+           (unsigned long long)resultado.tempo_us,
+           (unsigned long long)kb_por_s,
+           (unsigned long long)us_por_operacao);
+
+    for (uint8_t indice = 0; indice < static_cast<uint8_t>(cartao_sd::CamadaSd::QUANTIDADE); ++indice) {
+        cartao_sd::CamadaSd camada = static_cast<cartao_sd::CamadaSd>(indice);
+        cartao_sd::MedidaCamada medida;
+        cartao_sd::obterMedidaCamada(camada, medida);
+        if (medida.chamadas == 0u) {
+            continue;
+        }
+#ifdef CARTAO_SD_HOST
+        // Camada so de CPU (cache, f_close, f_lseek): o relogio virtual nao a enxerga
+        if (medida.tempo_us == 0u) {
+            continue;
+        }
+#endif
+        printf("camada,%s,%lu,%s,%lu,%llu,%llu,%lu\r\n",
+               resultado.nome,
+               (unsigned long)clusterAtual,
+               cartao_sd::nomeCamada(camada),
+               (unsigned long)medida.chamadas,
+               (unsigned long long)medida.tempo_us,
+               (unsigned long long)medida.bytes,
+               (unsigned long)medida.tempo_maximo_us);
+    }
+}
+
+void registrarFalha(const char *ensaio, const char *etapa, FRESULT resultado) {
+    printf("# falha em %s (%s): %d\r\n", ensaio, etapa, resultado);
+    ensaiosFalhos++;
+}
+
+// Grava BYTES_POR_ENSAIO em blocos de tamanho_bloco; o arquivo fica para os ensaios de leitura
+void medirEscritaSequencial(CartaoSD &cartao, size_t tamanho_bloco) {
+    cartao.removerArquivo(ARQUIVO_SEQUENCIAL);
+
+    ArquivoSd arquivo = cartao.abrir(ARQUIVO_SEQUENCIAL, MODO_ESCRITA);
+    if (!arquivo.estaAberto()) {
+        registrarFalha("escrita_sequencial", "abrir", arquivo.resultadoOperacao());
+        return;
+    }
+
+    cartao_sd::zerarInstrumentacao();
+    uint64_t inicio = time_us_64();
+    uint32_t gravados = 0u;
+    uint32_t operacoes = 0u;
+
+    while (gravados < BYTES_POR_ENSAIO) {
+        size_t escritos = arquivo.escreverBytes(bufferDados, tamanho_bloco);
+        if (escritos != tamanho_bloco) {
+            registrarFalha("escrita_sequencial", "escreverBytes", arquivo.resultadoOperacao());
+            arquivo.fechar();
+            return;
+        }
+        gravados += static_cast<uint32_t>(escritos);
+        operacoes++;
+    }
+
+    bool sincronizou = arquivo.sincronizar();
+    uint64_t fim = time_us_64();
+    arquivo.fechar();
+
+    if (!sincronizou) {
+        registrarFalha("escrita_sequencial", "sincronizar", arquivo.resultadoOperacao());
+        return;
+    }
+
+    imprimirResultado({"escrita_sequencial", static_cast<uint32_t>(tamanho_bloco), gravados, operacoes, fim - inicio});
+}
+
+// Le o arquivo inteiro em blocos de tamanho_bloco
+void medirLeituraSequencial(CartaoSD &cartao, const char *nome, const char *caminho, int modo, size_t tamanho_bloco) {
+    ArquivoSd arquivo = cartao.abrir(caminho, modo);
+    if (!arquivo.estaAberto()) {
+        registrarFalha(nome, "abrir", arquivo.resultadoOperacao());
+        return;
+    }
+
+    long tamanho_arquivo = arquivo.tamanho();
+
+    cartao_sd::zerarInstrumentacao();
+    uint64_t inicio = time_us_64();
+    uint64_t lidos = 0u;
+    uint32_t operacoes = 0u;
+
+    while (true) {
+        size_t recebidos = arquivo.lerBytes(bufferDados, tamanho_bloco);
+        if (recebidos == 0u) {
+            break;
+        }
+        lidos += recebidos;
+        operacoes++;
+    }
+
+    uint64_t fim = time_us_64();
+    FRESULT resultado = arquivo.resultadoOperacao();
+    arquivo.fechar();
+
+    if (resultado != FR_OK || lidos != static_cast<uint64_t>(tamanho_arquivo)) {
+        registrarFalha(nome, "lerBytes", resultado);
+        return;
+    }
+
+    imprimirResultado({nome, static_cast<uint32_t>(tamanho_bloco), lidos, operacoes, fim - inicio});
+}
+
+// Le o arquivo inteiro pelo fluxo: cada bloco vem do pool, ja preenchido ate a fronteira de cluster
+void medirLeituraFluxo(CartaoSD &cartao, const char *nome, int modo) {
+    ArquivoSd arquivo = cartao.abrir(ARQUIVO_SEQUENCIAL, modo);
+    if (!arquivo.estaAberto()) {
+        registrarFalha(nome, "abrir", arquivo.resultadoOperacao());
+        return;
+    }
+
+    long tamanho_arquivo = arquivo.tamanho();
+
+    cartao_sd::zerarInstrumentacao();
+    uint64_t inicio = time_us_64();
+    uint64_t lidos = 0u;
+    uint32_t operacoes = 0u;
+
+    cartao_sd::BlocoFluxoSd bloco;
+    while (arquivo.obterBlocoFluxo(poolFluxo, bloco)) {
+        lidos += bloco.bytes;
+        operacoes++;
+        poolFluxo.liberar(bloco);
+    }
+
+    uint64_t fim = time_us_64();
+    FRESULT resultado = arquivo.resultadoOperacao();
+    arquivo.fechar();
+
+    if (resultado != FR_OK || lidos != static_cast<uint64_t>(tamanho_arquivo)) {
+        registrarFalha(nome, "obterBlocoFluxo", resultado);
+        return;
+    }
+
+    imprimirResultado({nome, static_cast<uint32_t>(cartao_sd::PoolBlocosFluxo::BYTES_BLOCO), lidos, operacoes,
+                       fim - inicio});
+}
+
+// Leituras de 512 bytes alinhadas ao setor em posicoes aleatorias do arquivo sequencial
+void medirLeituraAleatoria(CartaoSD &cartao) {
+    constexpr uint32_t BLOCO = 512u;
+    ArquivoSd arquivo = cartao.abrir(ARQUIVO_SEQUENCIAL, MODO_LEITURA);
+    if (!arquivo.estaAberto()) {
+        registrarFalha("leitura_aleatoria", "abrir", arquivo.resultadoOperacao());
+        return;
+    }
+
+    uint32_t setores = static_cast<uint32_t>(arquivo.tamanho()) / BLOCO;
+    uint32_t semente = 12345u;
+
+    cartao_sd::zerarInstrumentacao();
+    uint64_t inicio = time_us_64();
+
+    for (uint32_t operacao = 0; operacao < OPERACOES_ALEATORIAS; ++operacao) {
+        uint32_t setor = proximoAleatorio(semente) % setores;
+        if (!arquivo.buscar(static_cast<long>(setor * BLOCO)) || arquivo.lerBytes(bufferDados, BLOCO) != BLOCO) {
+            registrarFalha("leitura_aleatoria", "buscar/lerBytes", arquivo.resultadoOperacao());
+            arquivo.fechar();
+            return;
+        }
+    }
+
+    uint64_t fim = time_us_64();
+    arquivo.fechar();
+    imprimirResultado({"leitura_aleatoria", BLOCO, static_cast<uint64_t>(OPERACOES_ALEATORIAS) * BLOCO,
+                       OPERACOES_ALEATORIAS, fim - inicio});
+}
+
+#ifndef CARTAO_SD_HOST
+// So f_lseek para posicoes aleatorias: mede a caminhada pela cadeia de clusters na FAT,
+// ou o calculo direto na tabela de clusters com MODO_MAPA_CLUSTERS
+void medirBusca(CartaoSD &cartao, const char *nome, int modo) {
+    ArquivoSd arquivo = cartao.abrir(ARQUIVO_SEQUENCIAL, modo);
+    if (!arquivo.estaAberto()) {
+        registrarFalha(nome, "abrir", arquivo.resultadoOperacao());
+        return;
+    }
+
+    uint32_t tamanho = static_cast<uint32_t>(arquivo.tamanho());
+    uint32_t semente = 54321u;
+
+    cartao_sd::zerarInstrumentacao();
+    uint64_t inicio = time_us_64();
+
+    for (uint32_t operacao = 0; operacao < OPERACOES_ALEATORIAS; ++operacao) {
+        if (!arquivo.buscar(static_cast<long>(proximoAleatorio(semente) % tamanho))) {
+            registrarFalha(nome, "buscar", arquivo.resultadoOperacao());
+            arquivo.fechar();
+            return;
+        }
+    }
+
+    uint64_t fim = time_us_64();
+    arquivo.fechar();
+    imprimirResultado({nome, 0u, 0u, OPERACOES_ALEATORIAS, fim - inicio});
+}
+
+#endif
+
+// Dois arquivos crescendo um cluster de cada vez, alternados: nenhum cluster do primeiro
+// fica colado ao seguinte, e a leitura nao consegue juntar setores de clusters vizinhos
+bool criarArquivoFragmentado(CartaoSD &cartao) {
+    cartao.removerArquivo(ARQUIVO_FRAGMENTADO);
+    cartao.removerArquivo(ARQUIVO_INTERCALADO);
+
+    size_t passo = clusterAtual;
+    if (passo == 0u || passo > sizeof(bufferDados)) {
+        passo = sizeof(bufferDados);
+    }
+
+    for (uint32_t gravados = 0u; gravados < BYTES_FRAGMENTADO; gravados += static_cast<uint32_t>(passo)) {
+        for (const char *caminho : {ARQUIVO_FRAGMENTADO, ARQUIVO_INTERCALADO}) {
+            ArquivoSd arquivo = cartao.abrir(caminho, MODO_ACRESCENTAR);
+            if (!arquivo.estaAberto() || arquivo.escreverBytes(bufferDados, passo) != passo || !arquivo.fechar()) {
+                registrarFalha("leitura_fragmentada", "preparar", arquivo.resultadoOperacao());
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+#ifndef CARTAO_SD_HOST
+// Percorre um diretorio com ENTRADAS_DIRETORIO arquivos vazios, como a lista de faixas do player
+void medirEnumeracao(CartaoSD &cartao) {
+    cartao.removerDiretorioRecursivo(DIRETORIO_ENUMERACAO);
+    if (!cartao.criarDiretorio(DIRETORIO_ENUMERACAO)) {
+        registrarFalha("enumeracao_diretorio", "criarDiretorio", cartao.resultadoOperacao());
+        return;
+    }
+
+    for (uint32_t indice = 0; indice < ENTRADAS_DIRETORIO; ++indice) {
+        char caminho[64];
+        snprintf(caminho, sizeof(caminho), "%s/faixa_%03lu.wav", DIRETORIO_ENUMERACAO, (unsigned long)indice);
+        ArquivoSd arquivo = cartao.abrir(caminho, MODO_ESCRITA);
+        if (!arquivo.estaAberto()) {
+            registrarFalha("enumeracao_diretorio", "criar entrada", arquivo.resultadoOperacao());
+            return;
+        }
+        arquivo.fechar();
+    }
+
+    cartao_sd::zerarInstrumentacao();
+    uint64_t inicio = time_us_64();
+
+    ArquivoSd diretorio = cartao.abrir(DIRETORIO_ENUMERACAO, MODO_DIRETORIO);
+    uint32_t entradas = 0u;
+    while (diretorio.estaAberto()) {
+        ArquivoSd entrada = diretorio.abrirProximaEntrada();
+        if (!entrada.estaAberto()) {
+            break;
+        }
+        entradas++;
+    }
+    diretorio.fechar();
+
+    uint64_t fim = time_us_64();
+
+    if (entradas != ENTRADAS_DIRETORIO) {
+        registrarFalha("enumeracao_diretorio", "abrirProximaEntrada", diretorio.resultadoOperacao());
+    } else {
+        imprimirResultado({"enumeracao_diretorio", 0u, 0u, entradas, fim - inicio});
+    }
+    cartao.removerDiretorioRecursivo(DIRETORIO_ENUMERACAO);
+}
+#endif
+
+void executarEnsaios(CartaoSD &cartao) {
+    EstatisticaEspacoLivreFat espaco;
+    clusterAtual = 0u;
+    if (cartao.obterEspacoLivre("0:", espaco)) {
+        clusterAtual = espaco.setores_por_cluster * espaco.bytes_por_setor;
+    }
+
+    for (size_t tamanho_bloco : TAMANHOS_BLOCO_ESCRITA) {
+        medirEscritaSequencial(cartao, tamanho_bloco);
+    }
+    for (size_t tamanho_bloco : TAMANHOS_BLOCO_LEITURA) {
+        medirLeituraSequencial(cartao, "leitura_sequencial", ARQUIVO_SEQUENCIAL, MODO_LEITURA, tamanho_bloco);
+    }
+    // Arquivo gravado em volume recem-formatado: contiguo, lido direto do cartao pela tabela de clusters
+    for (size_t tamanho_bloco : TAMANHOS_BLOCO_LEITURA) {
+        medirLeituraSequencial(cartao, "leitura_sequencial_mapa", ARQUIVO_SEQUENCIAL,
+                               MODO_LEITURA | MODO_MAPA_CLUSTERS, tamanho_bloco);
+    }
+    medirLeituraFluxo(cartao, "leitura_fluxo", MODO_LEITURA);
+    medirLeituraFluxo(cartao, "leitura_fluxo_mapa", MODO_LEITURA | MODO_MAPA_CLUSTERS);
+    medirLeituraAleatoria(cartao);
+#ifndef CARTAO_SD_HOST
+    medirBusca(cartao, "busca", MODO_LEITURA);
+    medirBusca(cartao, "busca_mapa", MODO_LEITURA | MODO_MAPA_CLUSTERS);
+#endif
+
+    if (criarArquivoFragmentado(cartao)) {
+        medirLeituraSequencial(cartao, "leitura_fragmentada", ARQUIVO_FRAGMENTADO, MODO_LEITURA, 4096u);
+    }
+#ifndef CARTAO_SD_HOST
+    medirEnumeracao(cartao);
+#endif
+
+    cartao.removerArquivo(ARQUIVO_SEQUENCIAL);
+    cartao.removerArquivo(ARQUIVO_FRAGMENTADO);
+    cartao.removerArquivo(ARQUIVO_INTERCALADO);
+}
+
+#ifdef CARTAO_SD_HOST
+// Volume novo com o cluster pedido
+bool formatarImagem(CartaoSD &cartao, uint32_t tamanho_cluster) {
+    static uint8_t area_formatacao[4096];
+    ParametrosFormatacaoFat parametros = {FM_ANY, 0u, 0u, 0u, tamanho_cluster};
+    cartao.desmontarSistemaArquivos();
+    return cartao.formatar("0:", parametros, area_formatacao, sizeof(area_formatacao)) &&
+           cartao.montarSistemaArquivos();
+}
+#endif
+
+} // namespace
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    stdio_init_all();
+    while (!stdio_usb_connected()) sleep_ms(100);
+    printf("\r\n# Benchmark do cartao SD\r\n");
+
+#ifdef CARTAO_SD_HOST
+    // No host o cartao e o emulador sobre uma imagem nova; os tempos medidos sao os do relogio virtual
+    const char *caminho_imagem = (argc > 1) ? argv[1] : "bench_cartao.img";
+    remove(caminho_imagem);
+    cartao_sd::EmuladorCartaoSd emulador(caminho_imagem, cartao_sd::configuracaoPadraoEmuladorSd());
+    if (!emulador.imagemAberta()) {
+        printf("Falha ao criar a imagem %s\r\n", caminho_imagem);
+        return 1;
+    }
+    cartao_sd::conectarDispositivoSpiHost(SPI_CARTAO, PINO_SPI_CS_CARTAO, &emulador);
+#endif
+
+    CartaoSD cartao(SPI_CARTAO,
+                    PINO_SPI_MISO_CARTAO,
+                    PINO_SPI_MOSI_CARTAO,
+                    PINO_SPI_SCK_CARTAO,
+                    PINO_SPI_CS_CARTAO);
+
+    if (!cartao.iniciarSpi()) {
+        printf("Falha ao preparar o cartao: %d\r\n", cartao.resultadoOperacao());
+#ifdef CARTAO_SD_HOST
+        return 1;
+#else
+        while (true) tight_loop_contents();
+#endif
+    }
+
+#ifndef CARTAO_SD_INSTRUMENTACAO
+    printf("# sem CARTAO_SD_INSTRUMENTACAO: nenhuma linha camada sera impressa\r\n");
+#endif
+
+    for (size_t indice = 0; indice < sizeof(bufferDados); ++indice) {
+        bufferDados[indice] = static_cast<uint8_t>(indice);
+    }
+
+    printf("# ensaio,nome,cluster_bytes,bloco_bytes,total_bytes,operacoes,tempo_us,kb_por_s,us_por_operacao\r\n");
+    printf("# camada,nome,cluster_bytes,camada,chamadas,tempo_us,bytes,maximo_us\r\n");
+#ifdef CARTAO_SD_HOST
+    // Com a FAT e o diretorio no cache esses ensaios sao so CPU, e o relogio virtual so anda com o SPI:
+    // dariam 0 us e busca igual a busca_mapa. Ficam para o RP2040.
+    printf("# busca, busca_mapa, enumeracao_diretorio: nao mensuraveis no host (relogio virtual), so no RP2040\r\n");
+#endif
+
+#ifdef CARTAO_SD_HOST
+    for (uint32_t tamanho_cluster : TAMANHOS_CLUSTER) {
+        if (!formatarImagem(cartao, tamanho_cluster)) {
+            registrarFalha("formatar", "formatar/montar", cartao.resultadoOperacao());
+            continue;
+        }
+        executarEnsaios(cartao);
+    }
+    cartao.desmontarSistemaArquivos();
+#else
+    // No cartao real o volume nao e reformatado: mede o cluster que ja existe
+    if (cartao.montarSistemaArquivos()) {
+        executarEnsaios(cartao);
+        cartao.desmontarSistemaArquivos();
+    } else {
+        registrarFalha("montar", "montarSistemaArquivos", cartao.resultadoOperacao());
+    }
+#endif
+
+    printf("# Benchmark concluido: %lu falhas.\r\n", (unsigned long)ensaiosFalhos);
+
+#ifndef CARTAO_SD_HOST
+    while (true) tight_loop_contents();
+#endif
+    return (ensaiosFalhos == 0u) ? 0 : 1;
+}
@@ -0,0 +1,40 @@
+#ifndef BARRAMENTOSPIHOST_H
+#define BARRAMENTOSPIHOST_H
+
+#include <stdint.h>
+
+#include "hardware/spi.h"
+
+namespace cartao_sd {
+
+// Dispositivo do outro lado de um SPI do host. O barramento chama trocarByte uma vez por byte
+// com o instante (relogio virtual, em ns) do inicio do byte; o retorno e o que o MISO trouxe.
+class DispositivoSpiHost {
+public:
+    virtual ~DispositivoSpiHost() = default;
+    virtual void selecionar(bool selecionado, uint64_t agora_ns) = 0;
+    virtual uint8_t trocarByte(uint8_t mosi, uint64_t agora_ns) = 0;
+};
+
+// Liga o dispositivo a instancia SPI; gpio_put(gpio_cs, 0) o seleciona. nullptr desconecta.
+void conectarDispositivoSpiHost(spi_inst_t *instancia_spi, uint8_t gpio_cs, DispositivoSpiHost *dispositivo);
+
+// Transferencias pedidas ao SPI do host desde o ultimo zerar: quantas chamadas bloqueantes e quantas
+// partidas de DMA cada operacao custa
+struct EstatisticasBarramentoSpiHost {
+    uint32_t chamadas_bloqueantes;      // spi_write_read_blocking, spi_write_blocking e spi_read_blocking
+    uint32_t partidas_dma;              // dma_start_channel_mask que moveram bytes em um SPI
+    uint64_t bytes_bloqueantes;
+    uint64_t bytes_dma;
+};
+
+void obterEstatisticasBarramentoSpiHost(EstatisticasBarramentoSpiHost &destino);
+void zerarEstatisticasBarramentoSpiHost();
+
+// Relogio virtual do host: bytes do SPI e sleep_* o avancam; time_us_64() devolve o mesmo valor em us
+uint64_t relogioVirtualNs();
+void avancarRelogioVirtual(uint64_t nanossegundos);
+
+} // namespace cartao_sd
+
+#endif
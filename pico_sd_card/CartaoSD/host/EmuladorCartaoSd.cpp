@@ -0,0 +1,560 @@
+#include "EmuladorCartaoSd.h"
+
+#include <string.h>
+#include <unistd.h>
+
+namespace cartao_sd {
+
+namespace {
+constexpr uint8_t COMANDO_GO_IDLE = 0u;
+constexpr uint8_t COMANDO_SEND_IF_COND = 8u;
+constexpr uint8_t COMANDO_SEND_CSD = 9u;
+constexpr uint8_t COMANDO_STOP_TRANSMISSION = 12u;
+constexpr uint8_t COMANDO_SET_BLOCKLEN = 16u;
+constexpr uint8_t COMANDO_READ_SINGLE = 17u;
+constexpr uint8_t COMANDO_READ_MULTIPLE = 18u;
+constexpr uint8_t COMANDO_WRITE_SINGLE = 24u;
+constexpr uint8_t COMANDO_WRITE_MULTIPLE = 25u;
+constexpr uint8_t COMANDO_APP_CMD = 55u;
+constexpr uint8_t COMANDO_READ_OCR = 58u;
+constexpr uint8_t COMANDO_APP_SEND_OP_COND = 41u;
+constexpr uint8_t COMANDO_APP_SET_WR_BLK = 23u;
+constexpr uint8_t TOKEN_INICIO_DADOS = 0xFEu;
+constexpr uint8_t TOKEN_INICIO_MULTIPLO = 0xFCu;
+constexpr uint8_t TOKEN_PARADA_MULTIPLO = 0xFDu;
+constexpr uint8_t TOKEN_ERRO_FORA_DA_FAIXA = 0x08u;
+constexpr uint8_t RESPOSTA_DADOS_ACEITOS = 0xE5u;
+constexpr uint8_t RESPOSTA_DADOS_ERRO_ESCRITA = 0xEDu;
+constexpr uint8_t R1_IDLE = 0x01u;
+constexpr uint8_t R1_COMANDO_ILEGAL = 0x04u;
+constexpr uint8_t R1_ERRO_CRC = 0x08u;
+constexpr uint8_t R1_ERRO_ENDERECO = 0x20u;
+constexpr uint8_t R1_ERRO_PARAMETRO = 0x40u;
+constexpr uint32_t MAXIMO_BYTES_NCR = 8u;
+constexpr uint32_t SETORES_POR_UNIDADE_CSD_V2 = 1024u;
+constexpr uint32_t SETORES_POR_UNIDADE_CSD_V1 = 512u;    // C_SIZE_MULT = 7 e READ_BL_LEN = 9
+constexpr uint32_t MAXIMO_C_SIZE_CSD_V1 = 4095u;
+}
+
+ConfiguracaoEmuladorSd configuracaoPadraoEmuladorSd() {
+    ConfiguracaoEmuladorSd configuracao;
+    configuracao.setores = 131072u;
+    configuracao.alta_capacidade = true;
+    configuracao.consultas_inicializacao = 3u;
+    configuracao.bytes_ncr = 1u;
+    configuracao.latencia_leitura_us = 100u;
+    configuracao.intervalo_blocos_us = 10u;
+    configuracao.ocupado_escrita_us = 250u;
+    configuracao.ocupado_bloco_cmd25_us = 100u;
+    configuracao.ocupado_parada_us = 500u;
+    configuracao.ocupado_parada_leitura_us = 20u;
+    return configuracao;
+}
+
+EmuladorCartaoSd::EmuladorCartaoSd(const char *caminho_imagem, const ConfiguracaoEmuladorSd &configuracao_inicial)
+    : imagem(nullptr),
+      config(configuracao_inicial),
+      setoresImagem(0u),
+      estado(Estado::DESLIGADO),
+      selecionado(false),
+      emIdle(true),
+      comandoAplicativo(false),
+      consultasAcmd41(0u),
+      indiceComando(0u),
+      esperaArmada(false),
+      duracaoEsperaNs(0u),
+      esperaOcupado(false),
+      liberadoEmNs(0u),
+      saidaOcupado(false),
+      setorAtual(0u),
+      lendoRegistrador(false),
+      indiceBloco(0u) {
+    zerarEstatisticas();
+    memset(comando, 0, sizeof(comando));
+    memset(blocoRegistrador, 0, sizeof(blocoRegistrador));
+
+    imagem = fopen(caminho_imagem, "r+b");
+    if (imagem == nullptr) {
+        imagem = fopen(caminho_imagem, "w+b");
+    }
+    if (imagem == nullptr) {
+        return;
+    }
+
+    // Imagem nova ou redimensionada fica esparsa: setores nunca gravados leem zero
+    if (config.setores != 0u) {
+        if (ftruncate(fileno(imagem), static_cast<off_t>(config.setores * TAMANHO_SETOR)) != 0) {
+            fclose(imagem);
+            imagem = nullptr;
+            return;
+        }
+        setoresImagem = config.setores;
+    } else {
+        fseeko(imagem, 0, SEEK_END);
+        setoresImagem = static_cast<uint64_t>(ftello(imagem)) / TAMANHO_SETOR;
+        config.setores = setoresImagem;
+    }
+}
+
+EmuladorCartaoSd::~EmuladorCartaoSd() {
+    if (imagem != nullptr) {
+        fclose(imagem);
+    }
+}
+
+bool EmuladorCartaoSd::imagemAberta() const {
+    return imagem != nullptr;
+}
+
+uint64_t EmuladorCartaoSd::quantidadeSetores() const {
+    return setoresImagem;
+}
+
+ConfiguracaoEmuladorSd &EmuladorCartaoSd::configuracao() {
+    return config;
+}
+
+void EmuladorCartaoSd::obterEstatisticas(EstatisticasEmuladorSd &destino) const {
+    destino = estatisticas;
+}
+
+void EmuladorCartaoSd::zerarEstatisticas() {
+    memset(&estatisticas, 0, sizeof(estatisticas));
+}
+
+bool EmuladorCartaoSd::lerSetorImagem(uint32_t setor, uint8_t *destino) {
+    if (imagem == nullptr || setor >= setoresImagem) {
+        return false;
+    }
+
+    if (fseeko(imagem, static_cast<off_t>(setor) * TAMANHO_SETOR, SEEK_SET) != 0) {
+        return false;
+    }
+    size_t lidos = fread(destino, 1u, TAMANHO_SETOR, imagem);
+    memset(destino + lidos, 0, TAMANHO_SETOR - lidos);
+    return true;
+}
+
+bool EmuladorCartaoSd::escreverSetorImagem(uint32_t setor, const uint8_t *origem) {
+    if (imagem == nullptr || setor >= setoresImagem) {
+        return false;
+    }
+
+    if (fseeko(imagem, static_cast<off_t>(setor) * TAMANHO_SETOR, SEEK_SET) != 0) {
+        return false;
+    }
+    return fwrite(origem, 1u, TAMANHO_SETOR, imagem) == TAMANHO_SETOR;
+}
+
+void EmuladorCartaoSd::selecionar(bool selecionado_agora, uint64_t agora_ns) {
+    (void)agora_ns;
+    selecionado = selecionado_agora;
+
+    // Um comando pela metade nao sobrevive ao CS; busy e leituras em andamento continuam
+    if (!selecionado) {
+        indiceComando = 0u;
+    }
+}
+
+uint8_t EmuladorCartaoSd::trocarByte(uint8_t mosi, uint64_t agora_ns) {
+    if (!selecionado) {
+        return 0xFFu;
+    }
+
+    estatisticas.bytes_trocados++;
+
+    uint8_t miso = 0xFFu;
+    if (!saida.empty()) {
+        miso = retirarSaida(agora_ns);
+    } else if (agora_ns < liberadoEmNs) {
+        miso = saidaOcupado ? 0x00u : 0xFFu;
+    } else if (estado == Estado::LENDO_BLOCO || estado == Estado::LENDO_MULTIPLO) {
+        carregarProximoBloco();
+        miso = retirarSaida(agora_ns);
+    }
+
+    switch (estado) {
+        case Estado::RECEBENDO_BLOCO:
+        case Estado::RECEBENDO_BLOCO_MULTIPLO:
+            receberByteDados(mosi);
+            return miso;
+        case Estado::ESPERANDO_TOKEN:
+            if (mosi == TOKEN_INICIO_DADOS) {
+                estado = Estado::RECEBENDO_BLOCO;
+                indiceBloco = 0u;
+            }
+            return miso;
+        case Estado::ESPERANDO_TOKEN_MULTIPLO:
+            if (mosi == TOKEN_INICIO_MULTIPLO) {
+                estado = Estado::RECEBENDO_BLOCO_MULTIPLO;
+                indiceBloco = 0u;
+            } else if (mosi == TOKEN_PARADA_MULTIPLO) {
+                // Um byte de enchimento e o cartao fica ocupado fechando a escrita
+                const uint8_t enchimento = 0xFFu;
+                saida.push_back(enchimento);
+                armarEspera(config.ocupado_parada_us, true);
+                estado = Estado::COMANDO;
+            }
+            return miso;
+        default:
+            break;
+    }
+
+    // Comandos comecam com 01xxxxxx; o 0xFF dos bytes de espera nunca inicia um
+    if (indiceComando == 0u && (mosi & 0xC0u) != 0x40u) {
+        return miso;
+    }
+
+    comando[indiceComando] = mosi;
+    indiceComando = indiceComando + 1u;
+    if (indiceComando == sizeof(comando)) {
+        indiceComando = 0u;
+        executarComando();
+    }
+
+    return miso;
+}
+
+uint8_t EmuladorCartaoSd::retirarSaida(uint64_t agora_ns) {
+    uint8_t valor = saida.front();
+    saida.pop_front();
+
+    // A espera armada comeca quando o ultimo byte decidido sai
+    if (saida.empty() && esperaArmada) {
+        liberadoEmNs = agora_ns + duracaoEsperaNs;
+        saidaOcupado = esperaOcupado;
+        esperaArmada = false;
+    }
+
+    return valor;
+}
+
+void EmuladorCartaoSd::reiniciar() {
+    estado = Estado::COMANDO;
+    emIdle = true;
+    comandoAplicativo = false;
+    consultasAcmd41 = 0u;
+    lendoRegistrador = false;
+    indiceBloco = 0u;
+}
+
+uint8_t EmuladorCartaoSd::r1() const {
+    return emIdle ? R1_IDLE : 0x00u;
+}
+
+void EmuladorCartaoSd::responder(const uint8_t *resposta, size_t tamanho) {
+    uint32_t ncr = config.bytes_ncr;
+    if (ncr < 1u) {
+        ncr = 1u;
+    } else if (ncr > MAXIMO_BYTES_NCR) {
+        ncr = MAXIMO_BYTES_NCR;
+    }
+
+    for (uint32_t indice = 1u; indice < ncr; ++indice) {
+        saida.push_back(0xFFu);
+    }
+    for (size_t indice = 0; indice < tamanho; ++indice) {
+        saida.push_back(resposta[indice]);
+    }
+}
+
+void EmuladorCartaoSd::armarEspera(uint32_t duracao_us, bool ocupado) {
+    esperaArmada = true;
+    duracaoEsperaNs = static_cast<uint64_t>(duracao_us) * 1000u;
+    esperaOcupado = ocupado;
+}
+
+bool EmuladorCartaoSd::converterEndereco(uint32_t argumento, uint32_t &setor) const {
+    if (config.alta_capacidade) {
+        setor = argumento;
+    } else {
+        if ((argumento % TAMANHO_SETOR) != 0u) {
+            return false;
+        }
+        setor = argumento / TAMANHO_SETOR;
+    }
+    return setor < setoresImagem;
+}
+
+void EmuladorCartaoSd::executarComando() {
+    uint8_t indice = comando[0] & 0x3Fu;
+    uint32_t argumento = (static_cast<uint32_t>(comando[1]) << 24u) |
+                         (static_cast<uint32_t>(comando[2]) << 16u) |
+                         (static_cast<uint32_t>(comando[3]) << 8u) |
+                         comando[4];
+
+    // CMD0 e CMD8 sao conferidos mesmo com o CRC desligado no modo SPI
+    bool crc_valido = ((calcularCrc7(comando, 5u) << 1u) | 0x01u) == comando[5];
+    if (indice == COMANDO_GO_IDLE && !crc_valido) {
+        estatisticas.erros_crc++;
+        return;
+    }
+
+    // Ainda no modo SD o cartao so entende o CMD0
+    if (estado == Estado::DESLIGADO && indice != COMANDO_GO_IDLE) {
+        return;
+    }
+
+    estatisticas.comandos++;
+    bool aplicativo = comandoAplicativo;
+    comandoAplicativo = false;
+
+    // Um comando novo descarta a resposta anterior que o host nao leu
+    bool parando_leitura = (indice == COMANDO_STOP_TRANSMISSION) && (estado == Estado::LENDO_MULTIPLO);
+    saida.clear();
+    esperaArmada = false;
+    liberadoEmNs = 0u;
+
+    bool exige_pronto = (indice == COMANDO_SEND_CSD) ||
+                        (indice == COMANDO_READ_SINGLE) || (indice == COMANDO_READ_MULTIPLE) ||
+                        (indice == COMANDO_WRITE_SINGLE) || (indice == COMANDO_WRITE_MULTIPLE);
+    if (exige_pronto && emIdle) {
+        uint8_t resposta = r1() | R1_COMANDO_ILEGAL;
+        responder(&resposta, 1u);
+        return;
+    }
+
+    if (aplicativo && indice == COMANDO_APP_SEND_OP_COND) {
+        consultasAcmd41 = consultasAcmd41 + 1u;
+        if (consultasAcmd41 > config.consultas_inicializacao) {
+            emIdle = false;
+        }
+        uint8_t resposta = r1();
+        responder(&resposta, 1u);
+        return;
+    }
+
+    if (aplicativo && indice == COMANDO_APP_SET_WR_BLK) {
+        estatisticas.pre_apagamentos++;
+        uint8_t resposta = r1();
+        responder(&resposta, 1u);
+        return;
+    }
+
+    switch (indice) {
+        case COMANDO_GO_IDLE: {
+            reiniciar();
+            uint8_t resposta = R1_IDLE;
+            responder(&resposta, 1u);
+            break;
+        }
+        case COMANDO_SEND_IF_COND: {
+            if (!crc_valido) {
+                estatisticas.erros_crc++;
+                uint8_t resposta = r1() | R1_ERRO_CRC;
+                responder(&resposta, 1u);
+                break;
+            }
+            // R7: tensao aceita e padrao de verificacao devolvidos
+            uint8_t resposta[5] = {r1(), 0x00u, 0x00u,
+                                   static_cast<uint8_t>((argumento >> 8u) & 0x0Fu),
+                                   static_cast<uint8_t>(argumento & 0xFFu)};
+            responder(resposta, sizeof(resposta));
+            break;
+        }
+        case COMANDO_APP_CMD: {
+            comandoAplicativo = true;
+            uint8_t resposta = r1();
+            responder(&resposta, 1u);
+            break;
+        }
+        case COMANDO_READ_OCR: {
+            // OCR: [31] fim da inicializacao, [30] CCS, janela de 2,7 a 3,6 V
+            uint8_t ocr_alto = 0x00u;
+            if (!emIdle) {
+                ocr_alto = config.alta_capacidade ? 0xC0u : 0x80u;
+            }
+            uint8_t resposta[5] = {r1(), ocr_alto, 0xFFu, 0x80u, 0x00u};
+            responder(resposta, sizeof(resposta));
+            break;
+        }
+        case COMANDO_SEND_CSD: {
+            montarCsd();
+            uint8_t resposta = r1();
+            responder(&resposta, 1u);
+            armarEspera(config.latencia_leitura_us, false);
+            lendoRegistrador = true;
+            estado = Estado::LENDO_BLOCO;
+            break;
+        }
+        case COMANDO_STOP_TRANSMISSION: {
+            // O cartao devolve um byte de enchimento antes do R1 e fica ocupado em seguida
+            uint8_t resposta[2] = {0xFFu, r1()};
+            responder(resposta, sizeof(resposta));
+            if (parando_leitura) {
+                armarEspera(config.ocupado_parada_leitura_us, true);
+            }
+            estado = Estado::COMANDO;
+            break;
+        }
+        case COMANDO_SET_BLOCKLEN: {
+            uint8_t resposta = r1();
+            if (!config.alta_capacidade && argumento != TAMANHO_SETOR) {
+                resposta = resposta | R1_ERRO_PARAMETRO;
+            }
+            responder(&resposta, 1u);
+            break;
+        }
+        case COMANDO_READ_SINGLE:
+        case COMANDO_READ_MULTIPLE:
+        case COMANDO_WRITE_SINGLE:
+        case COMANDO_WRITE_MULTIPLE: {
+            uint32_t setor = 0u;
+            if (!converterEndereco(argumento, setor)) {
+                bool desalinhado = !config.alta_capacidade && (argumento % TAMANHO_SETOR) != 0u;
+                uint8_t resposta = r1() | (desalinhado ? R1_ERRO_ENDERECO : R1_ERRO_PARAMETRO);
+                responder(&resposta, 1u);
+                estado = Estado::COMANDO;
+                break;
+            }
+
+            uint8_t resposta = r1();
+            responder(&resposta, 1u);
+            setorAtual = setor;
+
+            if (indice == COMANDO_READ_SINGLE) {
+                estatisticas.leituras_unicas++;
+                armarEspera(config.latencia_leitura_us, false);
+                estado = Estado::LENDO_BLOCO;
+            } else if (indice == COMANDO_READ_MULTIPLE) {
+                estatisticas.leituras_multiplas++;
+                armarEspera(config.latencia_leitura_us, false);
+                estado = Estado::LENDO_MULTIPLO;
+            } else if (indice == COMANDO_WRITE_SINGLE) {
+                estatisticas.escritas_unicas++;
+                estado = Estado::ESPERANDO_TOKEN;
+            } else {
+                estatisticas.escritas_multiplas++;
+                estado = Estado::ESPERANDO_TOKEN_MULTIPLO;
+            }
+            break;
+        }
+        default: {
+            uint8_t resposta = r1() | R1_COMANDO_ILEGAL;
+            responder(&resposta, 1u);
+            break;
+        }
+    }
+}
+
+void EmuladorCartaoSd::carregarProximoBloco() {
+    if (lendoRegistrador) {
+        saida.push_back(TOKEN_INICIO_DADOS);
+        saida.insert(saida.end(), blocoRegistrador, blocoRegistrador + sizeof(blocoRegistrador));
+        uint16_t crc = calcularCrc16(blocoRegistrador, sizeof(blocoRegistrador));
+        saida.push_back(static_cast<uint8_t>(crc >> 8u));
+        saida.push_back(static_cast<uint8_t>(crc & 0xFFu));
+        lendoRegistrador = false;
+        estado = Estado::COMANDO;
+        return;
+    }
+
+    // Passou do fim do cartao no meio de um CMD18: token de erro, o host encerra com CMD12
+    uint8_t *setor = bufferBloco;
+    if (!lerSetorImagem(setorAtual, setor)) {
+        saida.push_back(TOKEN_ERRO_FORA_DA_FAIXA);
+        estado = Estado::COMANDO;
+        return;
+    }
+
+    saida.push_back(TOKEN_INICIO_DADOS);
+    saida.insert(saida.end(), setor, setor + TAMANHO_SETOR);
+    uint16_t crc = calcularCrc16(setor, TAMANHO_SETOR);
+    saida.push_back(static_cast<uint8_t>(crc >> 8u));
+    saida.push_back(static_cast<uint8_t>(crc & 0xFFu));
+    estatisticas.setores_lidos++;
+
+    if (estado == Estado::LENDO_MULTIPLO) {
+        setorAtual = setorAtual + 1u;
+        armarEspera(config.intervalo_blocos_us, false);
+    } else {
+        estado = Estado::COMANDO;
+    }
+}
+
+void EmuladorCartaoSd::receberByteDados(uint8_t mosi) {
+    bufferBloco[indiceBloco] = mosi;
+    indiceBloco = indiceBloco + 1u;
+    if (indiceBloco < sizeof(bufferBloco)) {
+        return;
+    }
+
+    // Bloco e CRC completos (o CRC dos dados e ignorado, como no modo SPI padrao)
+    bool gravou = escreverSetorImagem(setorAtual, bufferBloco);
+    if (gravou) {
+        estatisticas.setores_escritos++;
+    }
+    saida.push_back(gravou ? RESPOSTA_DADOS_ACEITOS : RESPOSTA_DADOS_ERRO_ESCRITA);
+    bool multiplo = estado == Estado::RECEBENDO_BLOCO_MULTIPLO;
+    armarEspera(multiplo ? config.ocupado_bloco_cmd25_us : config.ocupado_escrita_us, true);
+
+    if (multiplo) {
+        setorAtual = setorAtual + 1u;
+        estado = Estado::ESPERANDO_TOKEN_MULTIPLO;
+    } else {
+        estado = Estado::COMANDO;
+    }
+}
+
+void EmuladorCartaoSd::montarCsd() {
+    memset(blocoRegistrador, 0, sizeof(blocoRegistrador));
+    blocoRegistrador[1] = 0x0Eu;    // TAAC
+    blocoRegistrador[3] = 0x32u;    // TRAN_SPEED: 25 MHz
+    blocoRegistrador[4] = 0x5Bu;    // CCC
+    blocoRegistrador[5] = 0x59u;    // CCC | READ_BL_LEN = 9 (512 bytes)
+
+    if (config.alta_capacidade) {
+        // CSD v2: setores = (C_SIZE + 1) * 1024
+        uint32_t c_size = static_cast<uint32_t>(setoresImagem / SETORES_POR_UNIDADE_CSD_V2) - 1u;
+        blocoRegistrador[0] = 0x40u;
+        blocoRegistrador[7] = static_cast<uint8_t>((c_size >> 16u) & 0x3Fu);
+        blocoRegistrador[8] = static_cast<uint8_t>((c_size >> 8u) & 0xFFu);
+        blocoRegistrador[9] = static_cast<uint8_t>(c_size & 0xFFu);
+        blocoRegistrador[10] = 0x7Fu;
+    } else {
+        // CSD v1 com C_SIZE_MULT = 7: setores = (C_SIZE + 1) * 512, ate 1 GB
+        uint32_t c_size = static_cast<uint32_t>(setoresImagem / SETORES_POR_UNIDADE_CSD_V1) - 1u;
+        if (c_size > MAXIMO_C_SIZE_CSD_V1) {
+            c_size = MAXIMO_C_SIZE_CSD_V1;
+        }
+        blocoRegistrador[6] = static_cast<uint8_t>((c_size >> 10u) & 0x03u);
+        blocoRegistrador[7] = static_cast<uint8_t>((c_size >> 2u) & 0xFFu);
+        blocoRegistrador[8] = static_cast<uint8_t>((c_size & 0x03u) << 6u);
+        blocoRegistrador[9] = 0x03u;
+        blocoRegistrador[10] = 0x80u;
+    }
+
+    blocoRegistrador[11] = 0x80u;
+    blocoRegistrador[12] = 0x0Au;
+    blocoRegistrador[13] = 0x40u;
+    blocoRegistrador[15] = static_cast<uint8_t>((calcularCrc7(blocoRegistrador, 15u) << 1u) | 0x01u);
+}
+
+uint8_t EmuladorCartaoSd::calcularCrc7(const uint8_t *dados, size_t tamanho) {
+    uint8_t crc = 0u;
+    for (size_t indice = 0; indice < tamanho; ++indice) {
+        uint8_t byte = dados[indice];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = static_cast<uint8_t>(crc << 1u);
+            if (((byte & 0x80u) ^ (crc & 0x80u)) != 0u) {
+                crc = crc ^ 0x09u;
+            }
+            byte = static_cast<uint8_t>(byte << 1u);
+        }
+    }
+    return crc & 0x7Fu;
+}
+
+uint16_t EmuladorCartaoSd::calcularCrc16(const uint8_t *dados, size_t tamanho) {
+    // CRC16-CCITT (x^16 + x^12 + x^5 + 1) dos blocos de dados
+    uint16_t crc = 0u;
+    for (size_t indice = 0; indice < tamanho; ++indice) {
+        crc = static_cast<uint16_t>(crc ^ (static_cast<uint16_t>(dados[indice]) << 8u));
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x8000u) ? static_cast<uint16_t>((crc << 1u) ^ 0x1021u) : static_cast<uint16_t>(crc << 1u);
+        }
+    }
+    return crc;
+}
+
+} // namespace cartao_sd
@@ -0,0 +1,129 @@
+#ifndef EMULADORCARTAOSD_H
+#define EMULADORCARTAOSD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <deque>
+
+#include "BarramentoSpiHost.h"
+
+namespace cartao_sd {
+
+// Tempos do cartao emulado, medidos no relogio virtual a partir do ultimo byte da resposta
+struct ConfiguracaoEmuladorSd {
+    uint64_t setores;                   // Capacidade; 0 usa o tamanho da imagem existente
+    bool alta_capacidade;               // SDHC/SDXC (endereco em setores, CSD v2) ou SDSC (endereco em bytes, CSD v1)
+    uint32_t consultas_inicializacao;   // ACMD41 respondidos com "idle" antes do cartao ficar pronto
+    uint32_t bytes_ncr;                 // Bytes do comando ate o R1 (1 a 8)
+    uint32_t latencia_leitura_us;       // R1 do CMD17/CMD18/CMD9 ate o token do primeiro bloco
+    uint32_t intervalo_blocos_us;       // Entre o fim de um bloco e o token do proximo no CMD18
+    uint32_t ocupado_escrita_us;        // Busy (MISO em 0) depois da resposta de um bloco do CMD24
+    uint32_t ocupado_bloco_cmd25_us;    // Busy depois de cada bloco do CMD25 (area pre-apagada, buffer interno)
+    uint32_t ocupado_parada_us;         // Busy depois do token de parada do CMD25 (fecha a gravacao)
+    uint32_t ocupado_parada_leitura_us; // Busy do R1b do CMD12; numa leitura nao ha nada a gravar
+};
+
+struct EstatisticasEmuladorSd {
+    uint32_t comandos;
+    uint32_t leituras_unicas;           // CMD17
+    uint32_t leituras_multiplas;        // CMD18
+    uint32_t escritas_unicas;           // CMD24
+    uint32_t escritas_multiplas;        // CMD25
+    uint32_t pre_apagamentos;           // ACMD23
+    uint32_t setores_lidos;
+    uint32_t setores_escritos;
+    uint32_t erros_crc;                 // CMD0/CMD8 com CRC7 errado
+    uint64_t bytes_trocados;
+};
+
+// Configuracao com tempos de um cartao classe 10 comum: 64 MB, SDHC, 100 us ate o primeiro bloco
+ConfiguracaoEmuladorSd configuracaoPadraoEmuladorSd();
+
+// Cartao SD em modo SPI sobre um arquivo de imagem. Responde CMD0, 8, 9, 12, 16, 17, 18, 24, 25,
+// 55, 58 e ACMD23/41 byte a byte, como o cartao real: R1 depois de Ncr bytes, token de dados depois
+// da latencia de leitura e busy depois de cada escrita, tudo no relogio virtual do barramento.
+// Comandos desconhecidos recebem R1 com "comando ilegal".
+class EmuladorCartaoSd : public DispositivoSpiHost {
+public:
+    // Abre a imagem (cria se nao existir) e a ajusta para configuracao.setores, quando nao nulo
+    EmuladorCartaoSd(const char *caminho_imagem, const ConfiguracaoEmuladorSd &configuracao_inicial);
+    ~EmuladorCartaoSd() override;
+
+    EmuladorCartaoSd(const EmuladorCartaoSd &) = delete;
+    EmuladorCartaoSd &operator=(const EmuladorCartaoSd &) = delete;
+
+    bool imagemAberta() const;
+    uint64_t quantidadeSetores() const;
+
+    // Os tempos podem mudar entre ensaios; capacidade e tipo valem so a partir do proximo CMD0
+    ConfiguracaoEmuladorSd &configuracao();
+    void obterEstatisticas(EstatisticasEmuladorSd &destino) const;
+    void zerarEstatisticas();
+
+    // Acesso direto a imagem, sem passar pelo barramento (preparar e conferir ensaios)
+    bool lerSetorImagem(uint32_t setor, uint8_t *destino);
+    bool escreverSetorImagem(uint32_t setor, const uint8_t *origem);
+
+    void selecionar(bool selecionado, uint64_t agora_ns) override;
+    uint8_t trocarByte(uint8_t mosi, uint64_t agora_ns) override;
+
+    static constexpr uint32_t TAMANHO_SETOR = 512u;
+
+private:
+    enum class Estado {
+        DESLIGADO,              // Antes do primeiro CMD0: modo SD, ignora o SPI
+        COMANDO,                // Esperando o proximo comando
+        LENDO_BLOCO,            // CMD17/CMD9: um bloco depois da latencia
+        LENDO_MULTIPLO,         // CMD18: blocos ate o CMD12
+        ESPERANDO_TOKEN,        // CMD24: espera 0xFE
+        ESPERANDO_TOKEN_MULTIPLO, // CMD25: espera 0xFC ou 0xFD
+        RECEBENDO_BLOCO,
+        RECEBENDO_BLOCO_MULTIPLO
+    };
+
+    FILE *imagem;
+    ConfiguracaoEmuladorSd config;
+    EstatisticasEmuladorSd estatisticas;
+    uint64_t setoresImagem;
+    Estado estado;
+    bool selecionado;
+    bool emIdle;
+    bool comandoAplicativo;
+    uint32_t consultasAcmd41;
+
+    uint8_t comando[6];
+    size_t indiceComando;
+
+    // Saida: bytes ja decididos; depois deles, a espera armada (0xFF ou busy em 0x00)
+    std::deque<uint8_t> saida;
+    bool esperaArmada;
+    uint64_t duracaoEsperaNs;
+    bool esperaOcupado;
+    uint64_t liberadoEmNs;
+    bool saidaOcupado;
+
+    uint32_t setorAtual;
+    bool lendoRegistrador;      // O bloco de LENDO_BLOCO e o CSD (16 bytes), nao um setor
+    uint8_t blocoRegistrador[16];
+    uint8_t bufferBloco[TAMANHO_SETOR + 2u];
+    size_t indiceBloco;
+
+    void reiniciar();
+    uint8_t retirarSaida(uint64_t agora_ns);
+    void executarComando();
+    void responder(const uint8_t *resposta, size_t tamanho);
+    void armarEspera(uint32_t duracao_us, bool ocupado);
+    bool converterEndereco(uint32_t argumento, uint32_t &setor) const;
+    void carregarProximoBloco();
+    void receberByteDados(uint8_t mosi);
+    void montarCsd();
+    uint8_t r1() const;
+    static uint8_t calcularCrc7(const uint8_t *dados, size_t tamanho);
+    static uint16_t calcularCrc16(const uint8_t *dados, size_t tamanho);
+};
+
+} // namespace cartao_sd
+
+#endif
@@ -0,0 +1,412 @@
+#include <assert.h>
+#include <string.h>
+
+#include "BarramentoSpiHost.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/spi.h"
+#include "pico/mutex.h"
+#include "pico/stdlib.h"
+
+spi_inst_t spi_host_instancias[2];
+
+namespace {
+
+constexpr uint32_t FREQUENCIA_CLK_PERI_HZ = 125000000u;
+constexpr uint32_t QUANTIDADE_GPIOS = 30u;
+constexpr size_t QUANTIDADE_INSTANCIAS_SPI = sizeof(spi_host_instancias) / sizeof(spi_host_instancias[0]);
+
+struct ConexaoSpi {
+    cartao_sd::DispositivoSpiHost *dispositivo;
+    uint8_t gpioCs;
+};
+
+struct CanalDma {
+    bool reservado;
+    dma_channel_config configuracao;
+    volatile void *escrita;
+    const volatile void *leitura;
+    uint quantidade;
+};
+
+uint64_t relogioNs = 0u;
+ConexaoSpi conexoes[QUANTIDADE_INSTANCIAS_SPI] = {};
+bool estadoGpio[QUANTIDADE_GPIOS] = {};
+CanalDma canaisDma[NUM_DMA_CHANNELS] = {};
+cartao_sd::EstatisticasBarramentoSpiHost estatisticasBarramento = {};
+
+// Mesmo calculo do SDK: prescaler par de 2 a 254 e pos-divisor de 1 a 256 sobre o clk_peri
+uint calcularBaudrate(uint baudrate) {
+    uint32_t prescaler;
+    uint32_t posdivisor;
+
+    for (prescaler = 2u; prescaler <= 254u; prescaler += 2u) {
+        if (FREQUENCIA_CLK_PERI_HZ < (prescaler + 2u) * 256u * static_cast<uint64_t>(baudrate)) {
+            break;
+        }
+    }
+
+    for (posdivisor = 256u; posdivisor > 1u; --posdivisor) {
+        if (FREQUENCIA_CLK_PERI_HZ / (prescaler * (posdivisor - 1u)) > baudrate) {
+            break;
+        }
+    }
+
+    return FREQUENCIA_CLK_PERI_HZ / (prescaler * posdivisor);
+}
+
+ConexaoSpi &conexaoDe(const spi_inst_t *spi) {
+    return conexoes[spi_get_index(spi)];
+}
+
+uint8_t trocarByteSpi(spi_inst_t *spi, uint8_t mosi) {
+    ConexaoSpi &conexao = conexaoDe(spi);
+    uint8_t miso = 0xFFu;
+    if (conexao.dispositivo != nullptr && !estadoGpio[conexao.gpioCs]) {
+        miso = conexao.dispositivo->trocarByte(mosi, relogioNs);
+    }
+
+    // Um quadro de bits_dados bits por byte, sem intervalo entre quadros (FIFO sempre cheio)
+    relogioNs += (static_cast<uint64_t>(spi->bits_dados) * 1000000000u) / spi->baudrate;
+    return miso;
+}
+
+spi_inst_t *instanciaDoRegistrador(const volatile void *endereco) {
+    for (size_t indice = 0; indice < QUANTIDADE_INSTANCIAS_SPI; ++indice) {
+        if (endereco == &spi_host_instancias[indice].hw.dr) {
+            return &spi_host_instancias[indice];
+        }
+    }
+    return nullptr;
+}
+
+} // namespace
+
+namespace cartao_sd {
+
+void conectarDispositivoSpiHost(spi_inst_t *instancia_spi, uint8_t gpio_cs, DispositivoSpiHost *dispositivo) {
+    assert(gpio_cs < QUANTIDADE_GPIOS);
+    ConexaoSpi &conexao = conexaoDe(instancia_spi);
+    conexao.dispositivo = dispositivo;
+    conexao.gpioCs = gpio_cs;
+    estadoGpio[gpio_cs] = true;
+}
+
+void obterEstatisticasBarramentoSpiHost(EstatisticasBarramentoSpiHost &destino) {
+    destino = estatisticasBarramento;
+}
+
+void zerarEstatisticasBarramentoSpiHost() {
+    estatisticasBarramento = {};
+}
+
+uint64_t relogioVirtualNs() {
+    return relogioNs;
+}
+
+void avancarRelogioVirtual(uint64_t nanossegundos) {
+    relogioNs += nanossegundos;
+}
+
+} // namespace cartao_sd
+
+extern "C" {
+
+// --- pico/time ---
+
+uint64_t time_us_64(void) {
+    return relogioNs / 1000u;
+}
+
+uint32_t time_us_32(void) {
+    return static_cast<uint32_t>(time_us_64());
+}
+
+absolute_time_t get_absolute_time(void) {
+    return time_us_64();
+}
+
+absolute_time_t make_timeout_time_us(uint64_t us) {
+    return time_us_64() + us;
+}
+
+absolute_time_t make_timeout_time_ms(uint32_t ms) {
+    return time_us_64() + static_cast<uint64_t>(ms) * 1000u;
+}
+
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) {
+    return static_cast<int64_t>(to - from);
+}
+
+void sleep_us(uint64_t us) {
+    relogioNs += us * 1000u;
+}
+
+void sleep_ms(uint32_t ms) {
+    relogioNs += static_cast<uint64_t>(ms) * 1000000u;
+}
+
+void busy_wait_us(uint64_t us) {
+    relogioNs += us * 1000u;
+}
+
+// --- pico/mutex ---
+
+void mutex_init(mutex_t *mtx) {
+    mtx->travado = false;
+}
+
+void mutex_enter_blocking(mutex_t *mtx) {
+    assert(!mtx->travado);
+    mtx->travado = true;
+}
+
+bool mutex_try_enter(mutex_t *mtx, uint32_t *owner_out) {
+    if (owner_out != nullptr) {
+        *owner_out = 0u;
+    }
+    if (mtx->travado) {
+        return false;
+    }
+    mtx->travado = true;
+    return true;
+}
+
+void mutex_exit(mutex_t *mtx) {
+    assert(mtx->travado);
+    mtx->travado = false;
+}
+
+// --- pico/stdlib ---
+
+bool stdio_init_all(void) {
+    return true;
+}
+
+bool stdio_usb_connected(void) {
+    return true;
+}
+
+// --- hardware/gpio ---
+
+void gpio_init(uint gpio) {
+    // O nivel anterior e mantido: o CS de um dispositivo conectado comeca alto (solto)
+    assert(gpio < QUANTIDADE_GPIOS);
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+    (void)gpio;
+    (void)out;
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn) {
+    (void)gpio;
+    (void)fn;
+}
+
+void gpio_pull_up(uint gpio) {
+    (void)gpio;
+}
+
+void gpio_pull_down(uint gpio) {
+    (void)gpio;
+}
+
+void gpio_put(uint gpio, bool value) {
+    assert(gpio < QUANTIDADE_GPIOS);
+    if (estadoGpio[gpio] == value) {
+        return;
+    }
+    estadoGpio[gpio] = value;
+
+    for (ConexaoSpi &conexao : conexoes) {
+        if (conexao.dispositivo != nullptr && conexao.gpioCs == gpio) {
+            conexao.dispositivo->selecionar(!value, relogioNs);
+        }
+    }
+}
+
+bool gpio_get(uint gpio) {
+    assert(gpio < QUANTIDADE_GPIOS);
+    return estadoGpio[gpio];
+}
+
+// --- hardware/spi ---
+
+uint spi_init(spi_inst_t *spi, uint baudrate) {
+    spi->bits_dados = 8u;
+    return spi_set_baudrate(spi, baudrate);
+}
+
+void spi_deinit(spi_inst_t *spi) {
+    spi->baudrate = 0u;
+}
+
+uint spi_set_baudrate(spi_inst_t *spi, uint baudrate) {
+    spi->baudrate = calcularBaudrate(baudrate);
+    return spi->baudrate;
+}
+
+uint spi_get_baudrate(const spi_inst_t *spi) {
+    return spi->baudrate;
+}
+
+void spi_set_format(spi_inst_t *spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order) {
+    (void)cpol;
+    (void)cpha;
+    (void)order;
+    // Quadros de 16 bits nao sao emulados: o barramento do cartao trabalha so com bytes
+    assert(data_bits == 8u);
+    spi->bits_dados = data_bits;
+}
+
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len) {
+    estatisticasBarramento.chamadas_bloqueantes++;
+    estatisticasBarramento.bytes_bloqueantes += len;
+    for (size_t indice = 0; indice < len; ++indice) {
+        dst[indice] = trocarByteSpi(spi, src[indice]);
+    }
+    return static_cast<int>(len);
+}
+
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len) {
+    estatisticasBarramento.chamadas_bloqueantes++;
+    estatisticasBarramento.bytes_bloqueantes += len;
+    for (size_t indice = 0; indice < len; ++indice) {
+        trocarByteSpi(spi, src[indice]);
+    }
+    return static_cast<int>(len);
+}
+
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len) {
+    estatisticasBarramento.chamadas_bloqueantes++;
+    estatisticasBarramento.bytes_bloqueantes += len;
+    for (size_t indice = 0; indice < len; ++indice) {
+        dst[indice] = trocarByteSpi(spi, repeated_tx_data);
+    }
+    return static_cast<int>(len);
+}
+
+bool spi_is_busy(const spi_inst_t *spi) {
+    (void)spi;
+    return false;
+}
+
+// --- hardware/dma ---
+
+int dma_claim_unused_channel(bool required) {
+    for (uint canal = 0; canal < NUM_DMA_CHANNELS; ++canal) {
+        if (!canaisDma[canal].reservado) {
+            canaisDma[canal].reservado = true;
+            return static_cast<int>(canal);
+        }
+    }
+    assert(!required);
+    return -1;
+}
+
+void dma_channel_unclaim(uint channel) {
+    assert(channel < NUM_DMA_CHANNELS);
+    canaisDma[channel].reservado = false;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+    (void)channel;
+    dma_channel_config configuracao;
+    configuracao.tamanho = DMA_SIZE_32;
+    configuracao.incrementa_leitura = true;
+    configuracao.incrementa_escrita = false;
+    configuracao.dreq = 0x3Fu;
+    return configuracao;
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) {
+    c->tamanho = size;
+}
+
+void channel_config_set_read_increment(dma_channel_config *c, bool incr) {
+    c->incrementa_leitura = incr;
+}
+
+void channel_config_set_write_increment(dma_channel_config *c, bool incr) {
+    c->incrementa_escrita = incr;
+}
+
+void channel_config_set_dreq(dma_channel_config *c, uint dreq) {
+    c->dreq = dreq;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger) {
+    assert(channel < NUM_DMA_CHANNELS);
+    CanalDma &canal = canaisDma[channel];
+    canal.configuracao = *config;
+    canal.escrita = write_addr;
+    canal.leitura = read_addr;
+    canal.quantidade = transfer_count;
+
+    if (trigger) {
+        dma_start_channel_mask(1u << channel);
+    }
+}
+
+void dma_start_channel_mask(uint32_t chan_mask) {
+    // Procura o canal de TX (escreve no DR) de cada SPI e o de RX (le do mesmo DR) na mascara
+    for (size_t indice_spi = 0; indice_spi < QUANTIDADE_INSTANCIAS_SPI; ++indice_spi) {
+        spi_inst_t *spi = &spi_host_instancias[indice_spi];
+        CanalDma *tx = nullptr;
+        CanalDma *rx = nullptr;
+
+        for (uint canal = 0; canal < NUM_DMA_CHANNELS; ++canal) {
+            if ((chan_mask & (1u << canal)) == 0u) {
+                continue;
+            }
+            if (instanciaDoRegistrador(canaisDma[canal].escrita) == spi) {
+                tx = &canaisDma[canal];
+            } else if (instanciaDoRegistrador(canaisDma[canal].leitura) == spi) {
+                rx = &canaisDma[canal];
+            }
+        }
+
+        if (tx == nullptr && rx == nullptr) {
+            continue;
+        }
+        assert(tx == nullptr || tx->configuracao.tamanho == DMA_SIZE_8);
+        assert(rx == nullptr || rx->configuracao.tamanho == DMA_SIZE_8);
+        assert(tx == nullptr || rx == nullptr || tx->quantidade == rx->quantidade);
+
+        uint quantidade = (tx != nullptr) ? tx->quantidade : rx->quantidade;
+        const volatile uint8_t *origem = (tx != nullptr) ? static_cast<const volatile uint8_t *>(tx->leitura) : nullptr;
+        volatile uint8_t *destino = (rx != nullptr) ? static_cast<volatile uint8_t *>(rx->escrita) : nullptr;
+
+        // Sem canal de TX o SPI nao gera clock; no RP2040 o RX ficaria esperando para sempre
+        assert(tx != nullptr);
+
+        estatisticasBarramento.partidas_dma++;
+        estatisticasBarramento.bytes_dma += quantidade;
+
+        for (uint indice = 0; indice < quantidade; ++indice) {
+            uint8_t miso = trocarByteSpi(spi, *origem);
+            if (tx->configuracao.incrementa_leitura) {
+                ++origem;
+            }
+            if (destino != nullptr) {
+                *destino = miso;
+                if (rx->configuracao.incrementa_escrita) {
+                    ++destino;
+                }
+            }
+        }
+    }
+}
+
+void dma_channel_wait_for_finish_blocking(uint channel) {
+    (void)channel;
+}
+
+bool dma_channel_is_busy(uint channel) {
+    (void)channel;
+    return false;
+}
+
+} // extern "C"
@@ -0,0 +1,46 @@
+#ifndef _HARDWARE_DMA_H
+#define _HARDWARE_DMA_H
+
+// Subconjunto de hardware/dma.h. Os canais sao executados de forma sincrona em
+// dma_start_channel_mask: um canal que escreve no DR de um SPI e o canal que le do mesmo DR
+// formam uma transferencia full-duplex, byte a byte, como o DREQ faria no RP2040.
+// So transferencias de 8 bits sao suportadas (as unicas que a CartaoSD usa).
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NUM_DMA_CHANNELS 12u
+
+enum dma_channel_transfer_size {
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2
+};
+
+typedef struct {
+    enum dma_channel_transfer_size tamanho;
+    bool incrementa_leitura;
+    bool incrementa_escrita;
+    uint dreq;
+} dma_channel_config;
+
+int dma_claim_unused_channel(bool required);
+void dma_channel_unclaim(uint channel);
+dma_channel_config dma_channel_get_default_config(uint channel);
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size);
+void channel_config_set_read_increment(dma_channel_config *c, bool incr);
+void channel_config_set_write_increment(dma_channel_config *c, bool incr);
+void channel_config_set_dreq(dma_channel_config *c, uint dreq);
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger);
+void dma_start_channel_mask(uint32_t chan_mask);
+void dma_channel_wait_for_finish_blocking(uint channel);
+bool dma_channel_is_busy(uint channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
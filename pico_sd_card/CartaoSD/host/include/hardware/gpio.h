@@ -0,0 +1,35 @@
+#ifndef _HARDWARE_GPIO_H
+#define _HARDWARE_GPIO_H
+
+// Subconjunto de hardware/gpio.h. gpio_put no pino de CS de um dispositivo conectado com
+// conectarDispositivoSpiHost() seleciona ou libera o dispositivo.
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GPIO_OUT 1
+#define GPIO_IN 0
+
+enum gpio_function {
+    GPIO_FUNC_SPI = 1,
+    GPIO_FUNC_UART = 2,
+    GPIO_FUNC_I2C = 3,
+    GPIO_FUNC_SIO = 5,
+    GPIO_FUNC_NULL = 0x1f
+};
+
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+void gpio_pull_up(uint gpio);
+void gpio_pull_down(uint gpio);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef _HARDWARE_SPI_H
+#define _HARDWARE_SPI_H
+
+// Subconjunto de hardware/spi.h. Cada byte trocado vai ao dispositivo conectado na instancia
+// (ou volta 0xFF) e avanca o relogio virtual em 8 periodos do SCLK.
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    volatile uint32_t dr;       // Alvo dos canais DMA, como no SDK
+} spi_hw_t;
+
+typedef struct spi_inst {
+    spi_hw_t hw;
+    uint baudrate;
+    uint bits_dados;
+} spi_inst_t;
+
+extern spi_inst_t spi_host_instancias[2];
+
+#define spi0 (&spi_host_instancias[0])
+#define spi1 (&spi_host_instancias[1])
+
+typedef enum {
+    SPI_CPHA_0 = 0,
+    SPI_CPHA_1 = 1
+} spi_cpha_t;
+
+typedef enum {
+    SPI_CPOL_0 = 0,
+    SPI_CPOL_1 = 1
+} spi_cpol_t;
+
+typedef enum {
+    SPI_LSB_FIRST = 0,
+    SPI_MSB_FIRST = 1
+} spi_order_t;
+
+uint spi_init(spi_inst_t *spi, uint baudrate);
+void spi_deinit(spi_inst_t *spi);
+uint spi_set_baudrate(spi_inst_t *spi, uint baudrate);
+uint spi_get_baudrate(const spi_inst_t *spi);
+void spi_set_format(spi_inst_t *spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order);
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len);
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len);
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len);
+bool spi_is_busy(const spi_inst_t *spi);
+
+static inline spi_hw_t *spi_get_hw(spi_inst_t *spi) {
+    return &spi->hw;
+}
+
+static inline uint spi_get_index(const spi_inst_t *spi) {
+    return (uint)(spi - spi_host_instancias);
+}
+
+static inline uint spi_get_dreq(spi_inst_t *spi, bool is_tx) {
+    return 16u + 2u * spi_get_index(spi) + (is_tx ? 0u : 1u);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef _PICO_MUTEX_H
+#define _PICO_MUTEX_H
+
+// Subconjunto de pico/mutex.h: o host roda em uma thread so, entao o mutex apenas
+// confere que ninguem tenta entrar duas vezes (no RP2040 isso travaria o nucleo)
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    bool travado;
+} mutex_t;
+
+void mutex_init(mutex_t *mtx);
+void mutex_enter_blocking(mutex_t *mtx);
+bool mutex_try_enter(mutex_t *mtx, uint32_t *owner_out);
+void mutex_exit(mutex_t *mtx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef _PICO_STDLIB_H
+#define _PICO_STDLIB_H
+
+// Subconjunto de pico/stdlib.h para o build de host da CartaoSD
+#include <stdio.h>
+
+#include "pico/types.h"
+#include "pico/time.h"
+#include "hardware/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool stdio_init_all(void);
+bool stdio_usb_connected(void);
+
+static inline void tight_loop_contents(void) {}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
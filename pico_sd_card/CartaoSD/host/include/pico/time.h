@@ -0,0 +1,26 @@
+#ifndef _PICO_TIME_H
+#define _PICO_TIME_H
+
+// Subconjunto de pico/time.h. O tempo do host e virtual: avanca com os bytes trocados no SPI
+// (na frequencia configurada) e com as esperas sleep_*, entao timeouts e medicoes sao deterministicos.
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+absolute_time_t get_absolute_time(void);
+absolute_time_t make_timeout_time_us(uint64_t us);
+absolute_time_t make_timeout_time_ms(uint32_t ms);
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to);
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+void busy_wait_us(uint64_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef _PICO_TYPES_H
+#define _PICO_TYPES_H
+
+// Subconjunto de pico/types.h do Pico SDK para o build de host da CartaoSD
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+
+// No SDK e um uint64_t opaco em us; no host conta o relogio virtual do barramento
+typedef uint64_t absolute_time_t;
+
+#endif
@@ -0,0 +1,277 @@
+#include "CacheSetores.h"
+
+#include <string.h>
+
+namespace cartao_sd {
+
+namespace {
+constexpr size_t TAMANHO_SETOR_BYTES = 512u;
+
+uint8_t dadosLinhas[CacheSetores::QUANTIDADE_CONJUNTOS][CacheSetores::QUANTIDADE_VIAS][TAMANHO_SETOR_BYTES];
+}
+
+CacheSetores::CacheSetores(DriverCartaoSd &driver_cartao)
+    : driver(driver_cartao),
+      relogioUso(0u),
+      inicioRegiaoFat(0u),
+      fimRegiaoFat(0u),
+      politicaFat(PoliticaEscritaCache::ESCRITA_POSTERGADA),
+      politicaDados(PoliticaEscritaCache::ESCRITA_DIRETA) {
+    invalidar();
+    zerarEstatisticas();
+}
+
+bool CacheSetores::lerSetores(uint8_t *destino, uint32_t setor_inicial, uint32_t quantidade) {
+    if (destino == nullptr) {
+        return false;
+    }
+
+    if (quantidade == 1u) {
+        return lerSetorUnico(destino, setor_inicial);
+    }
+
+    // Leituras longas (dados de arquivo) nao passam pelo cache para nao expulsar FAT e diretorios
+    return lerSemAlocar(destino, setor_inicial, quantidade);
+}
+
+bool CacheSetores::lerSemAlocar(uint8_t *destino, uint32_t setor_inicial, uint32_t quantidade) {
+    if (destino == nullptr) {
+        return false;
+    }
+
+    if (!driver.lerSetores(destino, setor_inicial, quantidade)) {
+        return false;
+    }
+    estatisticas.leituras_diretas++;
+
+    // Linhas sujas sao mais novas que o cartao e sobrepoem o que foi lido
+    for (uint32_t conjunto = 0; conjunto < QUANTIDADE_CONJUNTOS; ++conjunto) {
+        for (uint32_t via = 0; via < QUANTIDADE_VIAS; ++via) {
+            const LinhaCache &linha = linhas[conjunto][via];
+            if (!linha.valida || !linha.suja) {
+                continue;
+            }
+            if (linha.setor < setor_inicial || linha.setor - setor_inicial >= quantidade) {
+                continue;
+            }
+            uint8_t *destino_setor = destino + ((linha.setor - setor_inicial) * TAMANHO_SETOR_BYTES);
+            memcpy(destino_setor, dadosLinhas[conjunto][via], TAMANHO_SETOR_BYTES);
+        }
+    }
+
+    return true;
+}
+
+bool CacheSetores::escreverSetores(const uint8_t *origem, uint32_t setor_inicial, uint32_t quantidade) {
+    if (origem == nullptr) {
+        return false;
+    }
+
+    if (quantidade == 1u) {
+        return escreverSetorUnico(origem, setor_inicial);
+    }
+
+    if (!driver.escreverSetores(origem, setor_inicial, quantidade)) {
+        return false;
+    }
+
+    // O cartao passa a ter a versao mais nova; linhas presentes sao atualizadas e ficam limpas
+    for (uint32_t conjunto = 0; conjunto < QUANTIDADE_CONJUNTOS; ++conjunto) {
+        for (uint32_t via = 0; via < QUANTIDADE_VIAS; ++via) {
+            LinhaCache &linha = linhas[conjunto][via];
+            if (!linha.valida) {
+                continue;
+            }
+            if (linha.setor < setor_inicial || linha.setor - setor_inicial >= quantidade) {
+                continue;
+            }
+            const uint8_t *origem_setor = origem + ((linha.setor - setor_inicial) * TAMANHO_SETOR_BYTES);
+            memcpy(dadosLinhas[conjunto][via], origem_setor, TAMANHO_SETOR_BYTES);
+            linha.suja = false;
+        }
+    }
+
+    return true;
+}
+
+bool CacheSetores::descarregar() {
+    bool sucesso = true;
+
+    for (uint32_t conjunto = 0; conjunto < QUANTIDADE_CONJUNTOS; ++conjunto) {
+        for (uint32_t via = 0; via < QUANTIDADE_VIAS; ++via) {
+            if (!gravarLinha(conjunto, via)) {
+                sucesso = false;
+            }
+        }
+    }
+
+    return sucesso;
+}
+
+void CacheSetores::invalidar() {
+    for (uint32_t conjunto = 0; conjunto < QUANTIDADE_CONJUNTOS; ++conjunto) {
+        for (uint32_t via = 0; via < QUANTIDADE_VIAS; ++via) {
+            LinhaCache &linha = linhas[conjunto][via];
+            linha.setor = 0u;
+            linha.ultimoUso = 0u;
+            linha.valida = false;
+            linha.suja = false;
+        }
+    }
+    relogioUso = 0u;
+}
+
+void CacheSetores::definirRegiaoFat(uint32_t setor_inicial, uint32_t setor_final) {
+    inicioRegiaoFat = setor_inicial;
+    fimRegiaoFat = setor_final;
+}
+
+void CacheSetores::definirPoliticas(PoliticaEscritaCache politica_fat, PoliticaEscritaCache politica_dados) {
+    politicaFat = politica_fat;
+    politicaDados = politica_dados;
+}
+
+void CacheSetores::obterEstatisticas(EstatisticasCacheSetores &destino) const {
+    destino = estatisticas;
+}
+
+void CacheSetores::zerarEstatisticas() {
+    memset(&estatisticas, 0, sizeof(estatisticas));
+}
+
+bool CacheSetores::lerSetorUnico(uint8_t *destino, uint32_t setor) {
+    uint32_t conjunto = setor % QUANTIDADE_CONJUNTOS;
+    uint32_t via = localizarVia(conjunto, setor);
+
+    if (via != VIA_INEXISTENTE) {
+        estatisticas.acertos++;
+        marcarUso(linhas[conjunto][via]);
+        memcpy(destino, dadosLinhas[conjunto][via], TAMANHO_SETOR_BYTES);
+        return true;
+    }
+
+    estatisticas.falhas++;
+
+    via = escolherVitima(conjunto);
+    if (!liberarVia(conjunto, via)) {
+        return false;
+    }
+
+    if (!driver.lerSetores(dadosLinhas[conjunto][via], setor, 1u)) {
+        return false;
+    }
+
+    LinhaCache &linha = linhas[conjunto][via];
+    linha.setor = setor;
+    linha.valida = true;
+    linha.suja = false;
+    marcarUso(linha);
+
+    memcpy(destino, dadosLinhas[conjunto][via], TAMANHO_SETOR_BYTES);
+    return true;
+}
+
+bool CacheSetores::escreverSetorUnico(const uint8_t *origem, uint32_t setor) {
+    uint32_t conjunto = setor % QUANTIDADE_CONJUNTOS;
+    uint32_t via = localizarVia(conjunto, setor);
+    bool postergar = politicaDoSetor(setor) == PoliticaEscritaCache::ESCRITA_POSTERGADA;
+
+    if (!postergar) {
+        if (!driver.escreverSetores(origem, setor, 1u)) {
+            return false;
+        }
+    }
+
+    if (via == VIA_INEXISTENTE) {
+        via = escolherVitima(conjunto);
+        if (!liberarVia(conjunto, via)) {
+            return false;
+        }
+    }
+
+    LinhaCache &linha = linhas[conjunto][via];
+    memcpy(dadosLinhas[conjunto][via], origem, TAMANHO_SETOR_BYTES);
+    linha.setor = setor;
+    linha.valida = true;
+    linha.suja = postergar;
+    marcarUso(linha);
+
+    if (postergar) {
+        estatisticas.escritas_postergadas++;
+    }
+
+    return true;
+}
+
+uint32_t CacheSetores::localizarVia(uint32_t conjunto, uint32_t setor) const {
+    for (uint32_t via = 0; via < QUANTIDADE_VIAS; ++via) {
+        const LinhaCache &linha = linhas[conjunto][via];
+        if (linha.valida && linha.setor == setor) {
+            return via;
+        }
+    }
+
+    return VIA_INEXISTENTE;
+}
+
+uint32_t CacheSetores::escolherVitima(uint32_t conjunto) const {
+    uint32_t vitima = 0u;
+
+    for (uint32_t via = 0; via < QUANTIDADE_VIAS; ++via) {
+        const LinhaCache &linha = linhas[conjunto][via];
+        if (!linha.valida) {
+            return via;
+        }
+        // Diferenca relativa ao relogio evita erro quando o contador da volta
+        if ((relogioUso - linha.ultimoUso) > (relogioUso - linhas[conjunto][vitima].ultimoUso)) {
+            vitima = via;
+        }
+    }
+
+    return vitima;
+}
+
+bool CacheSetores::liberarVia(uint32_t conjunto, uint32_t via) {
+    LinhaCache &linha = linhas[conjunto][via];
+    if (!linha.valida) {
+        return true;
+    }
+
+    if (!gravarLinha(conjunto, via)) {
+        return false;
+    }
+
+    linha.valida = false;
+    estatisticas.despejos++;
+    return true;
+}
+
+bool CacheSetores::gravarLinha(uint32_t conjunto, uint32_t via) {
+    LinhaCache &linha = linhas[conjunto][via];
+    if (!linha.valida || !linha.suja) {
+        return true;
+    }
+
+    if (!driver.escreverSetores(dadosLinhas[conjunto][via], linha.setor, 1u)) {
+        return false;
+    }
+
+    linha.suja = false;
+    estatisticas.setores_descarregados++;
+    return true;
+}
+
+void CacheSetores::marcarUso(LinhaCache &linha) {
+    relogioUso = relogioUso + 1u;
+    linha.ultimoUso = relogioUso;
+}
+
+PoliticaEscritaCache CacheSetores::politicaDoSetor(uint32_t setor) const {
+    if (setor >= inicioRegiaoFat && setor < fimRegiaoFat) {
+        return politicaFat;
+    }
+
+    return politicaDados;
+}
+
+} // namespace cartao_sd
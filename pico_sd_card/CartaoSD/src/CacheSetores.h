@@ -0,0 +1,87 @@
+#ifndef CACHESETORES_H
+#define CACHESETORES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "DriverCartaoSd.h"
+
+// Geometria do cache: memoria ocupada = conjuntos * vias * 512 bytes (padrao 8 x 4 = 16 KB)
+#ifndef CARTAO_SD_CACHE_CONJUNTOS
+#define CARTAO_SD_CACHE_CONJUNTOS 8u
+#endif
+
+#ifndef CARTAO_SD_CACHE_VIAS
+#define CARTAO_SD_CACHE_VIAS 4u
+#endif
+
+namespace cartao_sd {
+
+enum class PoliticaEscritaCache : uint8_t {
+    ESCRITA_DIRETA,
+    ESCRITA_POSTERGADA
+};
+
+struct EstatisticasCacheSetores {
+    uint32_t acertos;
+    uint32_t falhas;
+    uint32_t leituras_diretas;
+    uint32_t despejos;
+    uint32_t escritas_postergadas;
+    uint32_t setores_descarregados;
+};
+
+// Cache associativo por conjunto entre o FatFs e o DriverCartaoSd.
+// Leituras de um setor passam pelo cache; leituras e escritas de varios setores
+// vao direto ao cartao e apenas mantem as linhas existentes coerentes.
+// lerSemAlocar faz o mesmo para qualquer quantidade (leitura antecipada de dados).
+// Os dados das linhas ficam em memoria estatica: existe uma unica instancia por programa.
+class CacheSetores {
+public:
+    explicit CacheSetores(DriverCartaoSd &driver_cartao);
+
+    bool lerSetores(uint8_t *destino, uint32_t setor_inicial, uint32_t quantidade);
+    bool lerSemAlocar(uint8_t *destino, uint32_t setor_inicial, uint32_t quantidade);
+    bool escreverSetores(const uint8_t *origem, uint32_t setor_inicial, uint32_t quantidade);
+    bool descarregar();
+    void invalidar();
+    void definirRegiaoFat(uint32_t setor_inicial, uint32_t setor_final);
+    void definirPoliticas(PoliticaEscritaCache politica_fat, PoliticaEscritaCache politica_dados);
+    void obterEstatisticas(EstatisticasCacheSetores &destino) const;
+    void zerarEstatisticas();
+
+    static constexpr uint32_t QUANTIDADE_CONJUNTOS = CARTAO_SD_CACHE_CONJUNTOS;
+    static constexpr uint32_t QUANTIDADE_VIAS = CARTAO_SD_CACHE_VIAS;
+
+private:
+    struct LinhaCache {
+        uint32_t setor;
+        uint32_t ultimoUso;
+        bool valida;
+        bool suja;
+    };
+
+    static constexpr uint32_t VIA_INEXISTENTE = 0xFFFFFFFFu;
+
+    DriverCartaoSd &driver;
+    LinhaCache linhas[QUANTIDADE_CONJUNTOS][QUANTIDADE_VIAS];
+    uint32_t relogioUso;
+    uint32_t inicioRegiaoFat;
+    uint32_t fimRegiaoFat;
+    PoliticaEscritaCache politicaFat;
+    PoliticaEscritaCache politicaDados;
+    EstatisticasCacheSetores estatisticas;
+
+    bool lerSetorUnico(uint8_t *destino, uint32_t setor);
+    bool escreverSetorUnico(const uint8_t *origem, uint32_t setor);
+    uint32_t localizarVia(uint32_t conjunto, uint32_t setor) const;
+    uint32_t escolherVitima(uint32_t conjunto) const;
+    bool liberarVia(uint32_t conjunto, uint32_t via);
+    bool gravarLinha(uint32_t conjunto, uint32_t via);
+    void marcarUso(LinhaCache &linha);
+    PoliticaEscritaCache politicaDoSetor(uint32_t setor) const;
+};
+
+} // namespace cartao_sd
+
+#endif
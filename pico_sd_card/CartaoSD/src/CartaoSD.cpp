@@ -4,11 +4,29 @@
 #include <string.h>
 
 #include "FatFsPort.h"
+#include "Instrumentacao.h"
+
+extern "C" {
+#include "diskio.h"
+}
 
 namespace {
 
 constexpr size_t TAMANHO_CAMINHO_TRABALHO = 512u;
 
+// Enquanto existir, os disk_read da area de dados sao deste arquivo (leitura antecipada por arquivo)
+class LeituraArquivoAtiva {
+public:
+    explicit LeituraArquivoAtiva(const FIL &arquivo) {
+        cartao_sd::iniciarLeituraArquivoFatFs(arquivo);
+    }
+    ~LeituraArquivoAtiva() {
+        cartao_sd::encerrarLeituraArquivoFatFs();
+    }
+    LeituraArquivoAtiva(const LeituraArquivoAtiva &) = delete;
+    LeituraArquivoAtiva &operator=(const LeituraArquivoAtiva &) = delete;
+};
+
 void limparInformacoesEntrada(InformacoesEntradaFat &destino) {
     destino.tamanho_bytes = 0u;
     destino.data_modificacao = 0u;
@@ -60,6 +78,41 @@ ArquivoSd::ArquivoSd() {
     memset(&arquivo, 0, sizeof(arquivo));
     memset(&diretorio, 0, sizeof(diretorio));
     memset(&infoEntrada, 0, sizeof(infoEntrada));
+    memset(tabelaClusters, 0, sizeof(tabelaClusters));
+    contiguo = false;
+    setorInicialContiguo = 0u;
+}
+
+ArquivoSd::ArquivoSd(const ArquivoSd &outro) {
+    copiarEstado(outro);
+}
+
+ArquivoSd &ArquivoSd::operator=(const ArquivoSd &outro) {
+    if (this != &outro) {
+        copiarEstado(outro);
+    }
+    return *this;
+}
+
+void ArquivoSd::copiarEstado(const ArquivoSd &origem) {
+    memcpy(&arquivo, &origem.arquivo, sizeof(arquivo));
+    memcpy(&diretorio, &origem.diretorio, sizeof(diretorio));
+    memcpy(&infoEntrada, &origem.infoEntrada, sizeof(infoEntrada));
+    aberto = origem.aberto;
+    ehDiretorio = origem.ehDiretorio;
+    ehEntradaEnumerada = origem.ehEntradaEnumerada;
+    modoAbertura = origem.modoAbertura;
+    ultimoResultado = origem.ultimoResultado;
+    memcpy(caminho, origem.caminho, sizeof(caminho));
+    memcpy(tabelaClusters, origem.tabelaClusters, sizeof(tabelaClusters));
+    contiguo = origem.contiguo;
+    setorInicialContiguo = origem.setorInicialContiguo;
+#if FF_USE_FASTSEEK
+    // O FIL copiado ainda aponta para a tabela do original, que pode ser destruido ou reaberto
+    if (origem.arquivo.cltbl == origem.tabelaClusters) {
+        arquivo.cltbl = tabelaClusters;
+    }
+#endif
 }
 
 bool ArquivoSd::validoParaArquivo() {
@@ -104,6 +157,7 @@ bool ArquivoSd::fechar() {
         invalidar();
         return true;
     }
+    CARTAO_SD_MEDIR(F_CLOSE, 0u);
     FRESULT resultado = ehDiretorio ? f_closedir(&diretorio) : f_close(&arquivo);
     registrarResultado(resultado);
     if (resultado != FR_OK) {
@@ -166,6 +220,7 @@ size_t ArquivoSd::escreverBytes(const uint8_t* dados, size_t tamanho) {
         return 0;
     }
 
+    CARTAO_SD_MEDIR(F_WRITE, tamanho);
     UINT quantidade_escrita = 0;
     FRESULT resultado_escrita = f_write(&arquivo, dados, (UINT)tamanho, &quantidade_escrita);
     registrarResultado(resultado_escrita);
@@ -179,6 +234,16 @@ size_t ArquivoSd::lerBytes(uint8_t* buffer, size_t tamanho) {
     if (!validoParaArquivo()) {
         return 0;
     }
+    CARTAO_SD_MEDIR(F_READ, tamanho);
+    LeituraArquivoAtiva leitura_ativa(arquivo);
+    return lerBytesDireto(buffer, tamanho);
+}
+
+// Sem avisar a leitura antecipada: os disk_read deste trecho passam direto ao cache
+size_t ArquivoSd::lerBytesDireto(uint8_t* buffer, size_t tamanho) {
+    if (contiguo) {
+        return lerBytesContiguo(buffer, tamanho);
+    }
     UINT quantidade_lida = 0;
     FRESULT resultado_leitura = f_read(&arquivo, buffer, (UINT)tamanho, &quantidade_lida);
     registrarResultado(resultado_leitura);
@@ -188,12 +253,115 @@ size_t ArquivoSd::lerBytes(uint8_t* buffer, size_t tamanho) {
     return static_cast<size_t>(quantidade_lida);
 }
 
+// Arquivo contiguo: setores inteiros vao do cartao direto ao buffer em um so disk_read, mesmo
+// atravessando clusters; so o comeco e o fim fora do alinhamento passam pelo buffer do FIL
+size_t ArquivoSd::lerBytesContiguo(uint8_t* buffer, size_t tamanho) {
+    FATFS *sistema = arquivo.obj.fs;
+    FSIZE_t posicao_atual = f_tell(&arquivo);
+    FSIZE_t tamanho_total = f_size(&arquivo);
+    FSIZE_t restante = (tamanho_total > posicao_atual) ? tamanho_total - posicao_atual : 0u;
+    if (static_cast<FSIZE_t>(tamanho) > restante) {
+        tamanho = static_cast<size_t>(restante);
+    }
+
+    size_t lidos = 0u;
+    while (lidos < tamanho) {
+        FSIZE_t posicao = f_tell(&arquivo);
+        size_t falta = tamanho - lidos;
+        UINT setores = static_cast<UINT>(falta / FF_MAX_SS);
+
+        if ((posicao % FF_MAX_SS) != 0u || setores == 0u) {
+            // Ate o proximo limite de setor (ou o fim pedido) pelo caminho normal do FatFs
+            UINT parte = static_cast<UINT>(FF_MAX_SS - (posicao % FF_MAX_SS));
+            if (parte > falta) {
+                parte = static_cast<UINT>(falta);
+            }
+            UINT quantidade_lida = 0;
+            FRESULT resultado_leitura = f_read(&arquivo, buffer + lidos, parte, &quantidade_lida);
+            registrarResultado(resultado_leitura);
+            if (resultado_leitura != FR_OK) {
+                return 0;
+            }
+            lidos += quantidade_lida;
+            if (quantidade_lida < parte) {
+                break;
+            }
+            continue;
+        }
+
+        LBA_t setor = setorInicialContiguo + static_cast<LBA_t>(posicao / FF_MAX_SS);
+        if (disk_read(sistema->pdrv, buffer + lidos, setor, setores) != RES_OK) {
+            registrarResultado(FR_DISK_ERR);
+            return 0;
+        }
+
+        // Com a tabela de clusters o f_lseek so recalcula o cluster, sem ler a FAT nem o setor
+        size_t bytes = static_cast<size_t>(setores) * FF_MAX_SS;
+        FRESULT resultado_seek = f_lseek(&arquivo, posicao + bytes);
+        registrarResultado(resultado_seek);
+        if (resultado_seek != FR_OK) {
+            return 0;
+        }
+        lidos += bytes;
+    }
+    return lidos;
+}
+
+bool ArquivoSd::obterBlocoFluxo(cartao_sd::PoolBlocosFluxo &pool, cartao_sd::BlocoFluxoSd &bloco) {
+    bloco.dados = nullptr;
+    bloco.bytes = 0u;
+    bloco.posicao = 0u;
+    bloco.indice = 0u;
+    if (!validoParaArquivo()) {
+        return false;
+    }
+
+    FSIZE_t posicao_atual = f_tell(&arquivo);
+    if (posicao_atual >= f_size(&arquivo)) {
+        registrarResultado(FR_OK);
+        return false;
+    }
+
+    uint8_t indice = 0u;
+    if (!pool.reservar(indice)) {
+        registrarResultado(FR_NOT_ENOUGH_CORE);
+        return false;
+    }
+
+    // O bloco espelha o alinhamento do arquivo: o byte k do bloco e o byte (inicio do setor + k).
+    // Assim, depois do trecho inicial fora do alinhamento, cada setor cai inteiro no bloco e o f_read
+    // (ou a leitura contigua) copia do cartao direto para ele, sem passar pelo buffer do FIL.
+    size_t deslocamento = static_cast<size_t>(posicao_atual % FF_MAX_SS);
+    size_t bytes_cluster = static_cast<size_t>(arquivo.obj.fs->csize) * FF_MAX_SS;
+    size_t ate_fim_cluster = bytes_cluster - static_cast<size_t>((posicao_atual - deslocamento) % bytes_cluster);
+    size_t pedido = cartao_sd::PoolBlocosFluxo::BYTES_BLOCO;
+    if (ate_fim_cluster < pedido) {
+        pedido = ate_fim_cluster + ((pedido - ate_fim_cluster) / bytes_cluster) * bytes_cluster;
+    }
+
+    // Fora da leitura antecipada: o anel dela seria uma segunda copia entre o SPI e o bloco
+    uint8_t *area = pool.areaBloco(indice);
+    CARTAO_SD_MEDIR(F_READ, pedido - deslocamento);
+    size_t lidos = lerBytesDireto(area + deslocamento, pedido - deslocamento);
+
+    bloco.dados = area + deslocamento;
+    bloco.indice = indice;
+    if (lidos == 0u) {
+        pool.liberar(bloco);
+        return false;
+    }
+    bloco.bytes = lidos;
+    bloco.posicao = static_cast<uint32_t>(posicao_atual);
+    return true;
+}
+
 int ArquivoSd::lerCaractere() {
     if (!validoParaArquivo()) {
         return -1;
     }
     uint8_t caractere = 0;
     UINT quantidade_lida = 0;
+    LeituraArquivoAtiva leitura_ativa(arquivo);
     FRESULT resultado_leitura = f_read(&arquivo, &caractere, 1, &quantidade_lida);
     registrarResultado(resultado_leitura);
     if (resultado_leitura != FR_OK) {
@@ -222,6 +390,7 @@ int ArquivoSd::espiar() {
     FSIZE_t posicao_atual = f_tell(&arquivo);
     uint8_t caractere = 0;
     UINT quantidade_lida = 0;
+    LeituraArquivoAtiva leitura_ativa(arquivo);
     FRESULT resultado_leitura = f_read(&arquivo, &caractere, 1, &quantidade_lida);
     registrarResultado(resultado_leitura);
     if (resultado_leitura != FR_OK) {
@@ -245,6 +414,7 @@ bool ArquivoSd::buscar(long posicao) {
     if (posicao < 0) {
         return false;
     }
+    CARTAO_SD_MEDIR_ARGUMENTO(F_LSEEK, 0u, static_cast<uint32_t>(posicao));
     FRESULT resultado_seek = f_lseek(&arquivo, (FSIZE_t)posicao);
     registrarResultado(resultado_seek);
     if (resultado_seek == FR_OK) {
@@ -323,6 +493,45 @@ bool ArquivoSd::estaAberto() {
     return aberto;
 }
 
+bool ArquivoSd::temMapaClusters() const {
+#if FF_USE_FASTSEEK
+    return aberto && arquivo.cltbl != nullptr;
+#else
+    return false;
+#endif
+}
+
+bool ArquivoSd::eContiguo() const {
+    return aberto && contiguo;
+}
+
+// Monta a tabela de clusters no FIL. Sem itens suficientes (arquivo muito fragmentado) o arquivo
+// continua aberto sem tabela, e as buscas voltam a percorrer a FAT.
+bool ArquivoSd::prepararMapaClusters() {
+#if FF_USE_FASTSEEK
+    tabelaClusters[0] = CARTAO_SD_MAPA_CLUSTERS_ITENS;
+    arquivo.cltbl = tabelaClusters;
+    FRESULT resultado = f_lseek(&arquivo, CREATE_LINKMAP);
+    if (resultado != FR_OK) {
+        arquivo.cltbl = nullptr;
+        if (resultado == FR_NOT_ENOUGH_CORE) {
+            CARTAO_SD_LOG("tabela de clusters pequena: %lu itens necessarios\r\n", (unsigned long)tabelaClusters[0]);
+            return true;
+        }
+        registrarResultado(resultado);
+        return false;
+    }
+
+    // Um so fragmento: [tamanho, itens usados][clusters, cluster inicial][0]
+    if (tabelaClusters[1] != 0u && tabelaClusters[3] == 0u) {
+        FATFS *sistema = arquivo.obj.fs;
+        contiguo = true;
+        setorInicialContiguo = sistema->database + static_cast<LBA_t>(sistema->csize) * (tabelaClusters[2] - 2u);
+    }
+#endif
+    return true;
+}
+
 void ArquivoSd::invalidar() {
     aberto = false;
     ehDiretorio = false;
@@ -331,6 +540,11 @@ void ArquivoSd::invalidar() {
     modoAbertura = 0;
     ultimoResultado = FR_OK;
     memset(&infoEntrada, 0, sizeof(infoEntrada));
+    contiguo = false;
+    setorInicialContiguo = 0u;
+#if FF_USE_FASTSEEK
+    arquivo.cltbl = nullptr;
+#endif
 }
 
 bool ArquivoSd::truncar() {
@@ -350,6 +564,7 @@ bool ArquivoSd::sincronizar() {
     if (!validoParaArquivo()) {
         return false;
     }
+    CARTAO_SD_MEDIR(F_SYNC, 0u);
     FRESULT resultado = f_sync(&arquivo);
     registrarResultado(resultado);
     return resultado == FR_OK;
@@ -364,6 +579,7 @@ bool ArquivoSd::encaminharDados(FuncaoEncaminhamentoFat funcao_encaminhamento, U
     }
     bytes_processados = 0u;
 #if FF_USE_FORWARD
+    LeituraArquivoAtiva leitura_ativa(arquivo);
     FRESULT resultado = f_forward(&arquivo, funcao_encaminhamento, bytes_transferir, &bytes_processados);
     registrarResultado(resultado);
     return resultado == FR_OK;
@@ -448,6 +664,7 @@ bool ArquivoSd::lerLinha(char* destino, size_t capacidade) {
     if (capacidade == 0u) {
         return false;
     }
+    LeituraArquivoAtiva leitura_ativa(arquivo);
     char* leitura = f_gets(destino, static_cast<int>(capacidade), &arquivo);
     if (leitura == nullptr) {
         registrarResultado(static_cast<FRESULT>(f_error(&arquivo)));
@@ -516,11 +733,16 @@ void ArquivoSd::registrarResultado(FRESULT resultado) {
 CartaoSD::CartaoSD(spi_inst_t* instanciaSpi, uint8_t gpioMiso, uint8_t gpioMosi, uint8_t gpioSck, uint8_t gpioCs)
     : controladorSpi(instanciaSpi, gpioMiso, gpioMosi, gpioSck, gpioCs, FREQUENCIA_SPI_BAIXA, FREQUENCIA_SPI_ALTA),
       driverSd(controladorSpi),
+      cacheSetores(driverSd),
+      leituraAntecipada(cacheSetores),
+      profundidadeAntecipacaoClusters(0u),
       montado(false),
       unidadeLogica("0:"),
       ultimoResultado(FR_OK) {
     memset(&sistemaArquivos, 0, sizeof(sistemaArquivos));
     cartao_sd::registrarDriverFatFs(&driverSd);
+    cartao_sd::registrarCacheFatFs(&cacheSetores);
+    cartao_sd::registrarLeituraAntecipadaFatFs(&leituraAntecipada);
 }
 
 CartaoSD::~CartaoSD() {
@@ -555,7 +777,12 @@ bool CartaoSD::montarSistemaArquivos() {
     FRESULT resultado_montagem = f_mount(&sistemaArquivos, unidadeLogica, 1);
     ultimoResultado = resultado_montagem;
     if (resultado_montagem == FR_OK) {
+        // Tabelas FAT (e a raiz fixa de FAT12/16) ficam entre fatbase e database
+        cacheSetores.definirRegiaoFat(static_cast<uint32_t>(sistemaArquivos.fatbase),
+                                      static_cast<uint32_t>(sistemaArquivos.database));
         montado = true;
+        // Um anel menor que a profundidade pedida desliga so a antecipacao, nao a montagem
+        aplicarLeituraAntecipada();
         return true;
     }
 
@@ -572,7 +799,16 @@ bool CartaoSD::desmontarSistemaArquivos() {
     FRESULT resultado_desmontagem = f_unmount(unidadeLogica);
     ultimoResultado = resultado_desmontagem;
     if (resultado_desmontagem == FR_OK) {
+        leituraAntecipada.configurar(0u, 0u);
+        bool descarregou = cacheSetores.descarregar();
+        cacheSetores.invalidar();
+        cacheSetores.definirRegiaoFat(0u, 0u);
         montado = false;
+        if (!descarregou) {
+            ultimoResultado = FR_DISK_ERR;
+            CARTAO_SD_LOG("falha ao descarregar cache de setores\r\n");
+            return false;
+        }
         return true;
     }
 
@@ -721,6 +957,7 @@ ArquivoSd CartaoSD::abrir(const char* caminho_abrir, int modo) {
     if (!montarSistemaArquivos()) {
         return handle;
     }
+    CARTAO_SD_MEDIR(F_OPEN, 0u);
     if ((modo & MODO_DIRETORIO) != 0) {
         FRESULT resultado = f_opendir(&handle.diretorio, caminho_abrir);
         ultimoResultado = resultado;
@@ -750,6 +987,15 @@ ArquivoSd CartaoSD::abrir(const char* caminho_abrir, int modo) {
     handle.modoAbertura = modo;
     strncpy(handle.caminho, caminho_abrir, sizeof(handle.caminho) - 1u);
     handle.caminho[sizeof(handle.caminho) - 1u] = 0;
+    if ((modo & MODO_MAPA_CLUSTERS) != 0 && (modo & (MODO_ESCRITA | MODO_ACRESCENTAR)) == 0) {
+        if (!handle.prepararMapaClusters()) {
+            ultimoResultado = handle.resultadoOperacao();
+            handle.fechar();
+            ArquivoSd handle_invalido;
+            return handle_invalido;
+        }
+        return handle;
+    }
     if ((modo & MODO_ACRESCENTAR) == 0) {
         return handle;
     }
@@ -1043,6 +1289,52 @@ bool CartaoSD::finalizarBusca(ContextoBuscaFat &contexto) {
     return resultado == FR_OK;
 }
 
+void CartaoSD::definirPoliticasCache(cartao_sd::PoliticaEscritaCache politica_fat, cartao_sd::PoliticaEscritaCache politica_dados) {
+    cacheSetores.definirPoliticas(politica_fat, politica_dados);
+}
+
+void CartaoSD::obterEstatisticasCache(cartao_sd::EstatisticasCacheSetores &destino) const {
+    cacheSetores.obterEstatisticas(destino);
+}
+
+void CartaoSD::zerarEstatisticasCache() {
+    cacheSetores.zerarEstatisticas();
+}
+
+bool CartaoSD::configurarLeituraAntecipada(uint32_t profundidade_clusters) {
+    profundidadeAntecipacaoClusters = profundidade_clusters;
+    if (montado && !aplicarLeituraAntecipada()) {
+        ultimoResultado = FR_NOT_ENOUGH_CORE;
+        return false;
+    }
+    ultimoResultado = FR_OK;
+    return true;
+}
+
+bool CartaoSD::servicoLeituraAntecipada() {
+    if (!montado) {
+        return false;
+    }
+    return leituraAntecipada.reabastecer();
+}
+
+void CartaoSD::obterEstatisticasLeituraAntecipada(cartao_sd::EstatisticasLeituraAntecipada &destino) const {
+    leituraAntecipada.obterEstatisticas(destino);
+}
+
+bool CartaoSD::aplicarLeituraAntecipada() {
+    // A profundidade e pedida em clusters; se nao couber no anel a antecipacao fica desligada
+    uint32_t profundidade_setores = profundidadeAntecipacaoClusters * sistemaArquivos.csize;
+    uint64_t total_setores = driverSd.obterQuantidadeSetores();
+    if (!leituraAntecipada.configurar(profundidade_setores, static_cast<uint32_t>(total_setores))) {
+        CARTAO_SD_LOG("leitura antecipada desligada: %lu setores pedidos, anel de %lu\r\n",
+                      (unsigned long)profundidade_setores,
+                      (unsigned long)cartao_sd::LeituraAntecipada::CAPACIDADE_SETORES);
+        return false;
+    }
+    return true;
+}
+
 FRESULT CartaoSD::resultadoOperacao() const {
     return ultimoResultado;
 }
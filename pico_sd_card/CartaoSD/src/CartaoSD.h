@@ -6,8 +6,11 @@
 
 #include "hardware/spi.h"
 
+#include "CacheSetores.h"
 #include "ControladorSpiCartao.h"
 #include "DriverCartaoSd.h"
+#include "FluxoLeitura.h"
+#include "LeituraAntecipada.h"
 #include "ff.h"
 
 #ifdef HABILITAR_LOG_CARTAO_SD
@@ -21,6 +24,14 @@ constexpr uint8_t MODO_LEITURA = 0x01u;
 constexpr uint8_t MODO_ESCRITA = 0x02u;
 constexpr uint8_t MODO_ACRESCENTAR = 0x04u;
 constexpr uint8_t MODO_DIRETORIO = 0x08u;
+// So com MODO_LEITURA: monta a tabela de clusters do FatFs (busca sem percorrer a FAT) e,
+// se o arquivo for contiguo, le setores inteiros direto do cartao, sem o buffer do FIL
+constexpr uint8_t MODO_MAPA_CLUSTERS = 0x10u;
+
+// Itens DWORD da tabela de clusters de cada ArquivoSd: 2 por fragmento mais 1 (ate 15 fragmentos)
+#ifndef CARTAO_SD_MAPA_CLUSTERS_ITENS
+#define CARTAO_SD_MAPA_CLUSTERS_ITENS 32u
+#endif
 
 struct CarimboTempoFat {
     uint16_t data;
@@ -64,6 +75,9 @@ using FuncaoEncaminhamentoFat = UINT (*)(const BYTE*, UINT);
 class ArquivoSd {
 public:
     ArquivoSd();
+    // A copia aponta o FIL para a propria tabela de clusters, nao para a do original
+    ArquivoSd(const ArquivoSd &outro);
+    ArquivoSd &operator=(const ArquivoSd &outro);
     bool fechar();
     bool escreverTexto(const char* texto);
     size_t escreverBytes(const uint8_t* dados, size_t tamanho);
@@ -111,6 +125,12 @@ public:
     FRESULT resultadoOperacao() const;
     bool reiniciarPosicao();
     bool obterInformacoes(InformacoesEntradaFat &destino) const;
+    bool temMapaClusters() const;
+    bool eContiguo() const;
+    // Le a partir da posicao atual para um bloco do pool, ate o fim do ultimo cluster que cabe nele.
+    // Setores inteiros vao do cartao direto ao bloco; falso no fim do arquivo, em erro ou sem bloco
+    // livre (FR_NOT_ENOUGH_CORE). O bloco volta ao pool com pool.liberar(bloco).
+    bool obterBlocoFluxo(cartao_sd::PoolBlocosFluxo &pool, cartao_sd::BlocoFluxoSd &bloco);
 private:
     FIL arquivo;
     DIR diretorio;
@@ -123,11 +143,18 @@ private:
     static constexpr size_t TAMANHO_MAXIMO_CAMINHO = 256u;
     static constexpr size_t TAMANHO_MAXIMO_NOME = 256u;
     char caminho[TAMANHO_MAXIMO_CAMINHO];
+    DWORD tabelaClusters[CARTAO_SD_MAPA_CLUSTERS_ITENS];
+    bool contiguo;
+    LBA_t setorInicialContiguo;
     bool validoParaArquivo();
     bool validoParaDiretorio();
     bool abrirParaAcrescentar();
     void invalidar();
     void registrarResultado(FRESULT resultado);
+    void copiarEstado(const ArquivoSd &origem);
+    bool prepararMapaClusters();
+    size_t lerBytesDireto(uint8_t* buffer, size_t tamanho);
+    size_t lerBytesContiguo(uint8_t* buffer, size_t tamanho);
     friend class CartaoSD;
 };
 
@@ -160,15 +187,26 @@ public:
     bool buscarPrimeiro(const char* caminho, const char* padrao, InformacoesEntradaFat &destino, ContextoBuscaFat &contexto);
     bool buscarProximo(InformacoesEntradaFat &destino, ContextoBuscaFat &contexto);
     bool finalizarBusca(ContextoBuscaFat &contexto);
+    void definirPoliticasCache(cartao_sd::PoliticaEscritaCache politica_fat, cartao_sd::PoliticaEscritaCache politica_dados);
+    void obterEstatisticasCache(cartao_sd::EstatisticasCacheSetores &destino) const;
+    void zerarEstatisticasCache();
+    // Falso (FR_NOT_ENOUGH_CORE) quando os clusters pedidos nao cabem no anel; a antecipacao fica desligada
+    bool configurarLeituraAntecipada(uint32_t profundidade_clusters);
+    bool servicoLeituraAntecipada();
+    void obterEstatisticasLeituraAntecipada(cartao_sd::EstatisticasLeituraAntecipada &destino) const;
     FRESULT resultadoOperacao() const;
 private:
     cartao_sd::ControladorSpiCartao controladorSpi;
     cartao_sd::DriverCartaoSd driverSd;
+    cartao_sd::CacheSetores cacheSetores;
+    cartao_sd::LeituraAntecipada leituraAntecipada;
+    uint32_t profundidadeAntecipacaoClusters;
     FATFS sistemaArquivos;
     bool montado;
     const char* unidadeLogica;
     mutable FRESULT ultimoResultado;
     bool garantirInicio();
+    bool aplicarLeituraAntecipada();
     static constexpr uint32_t FREQUENCIA_SPI_BAIXA = 400000u;
     static constexpr uint32_t FREQUENCIA_SPI_ALTA = 12500000u;
 };
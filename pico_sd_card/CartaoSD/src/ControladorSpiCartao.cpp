@@ -2,13 +2,24 @@
 
 #include <string.h>
 
+#include "hardware/dma.h"
 #include "hardware/gpio.h"
 #include "pico/stdlib.h"
 
+#include "Instrumentacao.h"
+
 namespace cartao_sd {
 
 namespace {
 constexpr uint8_t SPI_FILL_CHAR = 0xFFu;
+constexpr int CANAL_DMA_INVALIDO = -1;
+// Abaixo deste tamanho o custo de configurar os canais supera o ganho do DMA
+constexpr size_t LIMIAR_TRANSFERENCIA_DMA = 16u;
+
+// Origem fixa do modo somente leitura e destino descartavel do modo somente escrita.
+// Ficam em RAM para que o DMA nao dependa do cache de XIP.
+uint8_t bytePreenchimentoDma = SPI_FILL_CHAR;
+uint8_t byteDescarteDma = 0u;
 }
 
 ControladorSpiCartao::ControladorSpiCartao(spi_inst_t *instancia_spi,
@@ -25,7 +36,9 @@ ControladorSpiCartao::ControladorSpiCartao(spi_inst_t *instancia_spi,
       gpioCs(gpio_cs),
       frequenciaBaixaHz(frequencia_baixa_hz),
       frequenciaAltaHz(frequencia_alta_hz),
-      hardwareInicializado(false) {
+      hardwareInicializado(false),
+      canalDmaTx(CANAL_DMA_INVALIDO),
+      canalDmaRx(CANAL_DMA_INVALIDO) {
     mutex_init(&mutexAcesso);
 }
 
@@ -44,6 +57,8 @@ bool ControladorSpiCartao::configurarHardware() {
     gpio_set_function(gpioSck, GPIO_FUNC_SPI);
     spi_set_format(instanciaSpi, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
 
+    configurarDma();
+
     hardwareInicializado = true;
     return true;
 }
@@ -108,15 +123,83 @@ uint8_t ControladorSpiCartao::transferirByte(uint8_t dado) {
     return recebido;
 }
 
+void ControladorSpiCartao::configurarDma() {
+    canalDmaTx = dma_claim_unused_channel(false);
+    canalDmaRx = dma_claim_unused_channel(false);
+
+    if (canalDmaTx >= 0 && canalDmaRx >= 0) {
+        return;
+    }
+
+    // Sem os dois canais o controlador segue apenas com transferencias por byte
+    if (canalDmaTx >= 0) {
+        dma_channel_unclaim(static_cast<uint>(canalDmaTx));
+    }
+    if (canalDmaRx >= 0) {
+        dma_channel_unclaim(static_cast<uint>(canalDmaRx));
+    }
+
+    canalDmaTx = CANAL_DMA_INVALIDO;
+    canalDmaRx = CANAL_DMA_INVALIDO;
+}
+
+bool ControladorSpiCartao::dmaDisponivel() const {
+    return canalDmaTx != CANAL_DMA_INVALIDO && canalDmaRx != CANAL_DMA_INVALIDO;
+}
+
 bool ControladorSpiCartao::transferirBuffer(const uint8_t *origem, uint8_t *destino, size_t quantidade) {
     if (quantidade == 0) {
         return true;
     }
 
+    CARTAO_SD_MEDIR(TRANSFERIR_BUFFER, quantidade);
+
     if (origem == nullptr && destino == nullptr) {
         return false;
     }
 
+    if (dmaDisponivel() && quantidade >= LIMIAR_TRANSFERENCIA_DMA) {
+        return transferirBufferDma(origem, destino, quantidade);
+    }
+
+    return transferirBufferBytes(origem, destino, quantidade);
+}
+
+bool ControladorSpiCartao::transferirBufferDma(const uint8_t *origem, uint8_t *destino, size_t quantidade) {
+    uint canal_tx = static_cast<uint>(canalDmaTx);
+    uint canal_rx = static_cast<uint>(canalDmaRx);
+    volatile void *registrador_dados = &spi_get_hw(instanciaSpi)->dr;
+
+    // TX: percorre a origem ou repete 0xFF quando for apenas leitura
+    dma_channel_config configuracao_tx = dma_channel_get_default_config(canal_tx);
+    channel_config_set_transfer_data_size(&configuracao_tx, DMA_SIZE_8);
+    channel_config_set_dreq(&configuracao_tx, spi_get_dreq(instanciaSpi, true));
+    channel_config_set_read_increment(&configuracao_tx, origem != nullptr);
+    channel_config_set_write_increment(&configuracao_tx, false);
+
+    const uint8_t *leitura_tx = (origem != nullptr) ? origem : &bytePreenchimentoDma;
+    dma_channel_configure(canal_tx, &configuracao_tx, registrador_dados, leitura_tx, quantidade, false);
+
+    // RX: captura no destino ou descarta quando for apenas escrita
+    dma_channel_config configuracao_rx = dma_channel_get_default_config(canal_rx);
+    channel_config_set_transfer_data_size(&configuracao_rx, DMA_SIZE_8);
+    channel_config_set_dreq(&configuracao_rx, spi_get_dreq(instanciaSpi, false));
+    channel_config_set_read_increment(&configuracao_rx, false);
+    channel_config_set_write_increment(&configuracao_rx, destino != nullptr);
+
+    uint8_t *escrita_rx = (destino != nullptr) ? destino : &byteDescarteDma;
+    dma_channel_configure(canal_rx, &configuracao_rx, escrita_rx, registrador_dados, quantidade, false);
+
+    // Os dois canais partem juntos para que o FIFO de RX nunca transborde
+    dma_start_channel_mask((1u << canal_tx) | (1u << canal_rx));
+
+    // O ultimo byte recebido so chega depois do ultimo enviado, entao basta esperar o RX
+    dma_channel_wait_for_finish_blocking(canal_rx);
+
+    return true;
+}
+
+bool ControladorSpiCartao::transferirBufferBytes(const uint8_t *origem, uint8_t *destino, size_t quantidade) {
     const uint8_t *ponteiro_origem = origem;
     uint8_t *ponteiro_destino = destino;
     size_t indice = 0;
@@ -28,6 +28,7 @@ public:
     void desselecionarPulso();
     uint8_t transferirByte(uint8_t dado);
     bool transferirBuffer(const uint8_t *origem, uint8_t *destino, size_t quantidade);
+    bool dmaDisponivel() const;
     uint8_t obterGpioCs() const;
 
 private:
@@ -39,10 +40,15 @@ private:
     uint32_t frequenciaBaixaHz;
     uint32_t frequenciaAltaHz;
     bool hardwareInicializado;
+    int canalDmaTx;
+    int canalDmaRx;
     mutex_t mutexAcesso;
 
     void selecionar();
     void desselecionar();
+    void configurarDma();
+    bool transferirBufferDma(const uint8_t *origem, uint8_t *destino, size_t quantidade);
+    bool transferirBufferBytes(const uint8_t *origem, uint8_t *destino, size_t quantidade);
 };
 
 } // namespace cartao_sd
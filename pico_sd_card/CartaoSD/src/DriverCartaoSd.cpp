@@ -5,6 +5,8 @@
 #include "pico/stdlib.h"
 #include "pico/time.h"
 
+#include "Instrumentacao.h"
+
 namespace cartao_sd {
 
 namespace {
@@ -15,12 +17,23 @@ constexpr uint8_t COMANDO_SEND_CSD = 9u;
 constexpr uint8_t COMANDO_STOP_TRANSMISSION = 12u;
 constexpr uint8_t COMANDO_SET_BLOCKLEN = 16u;
 constexpr uint8_t COMANDO_READ_SINGLE = 17u;
+constexpr uint8_t COMANDO_READ_MULTIPLE = 18u;
 constexpr uint8_t COMANDO_WRITE_SINGLE = 24u;
+constexpr uint8_t COMANDO_WRITE_MULTIPLE = 25u;
 constexpr uint8_t COMANDO_APP_CMD = 55u;
 constexpr uint8_t COMANDO_READ_OCR = 58u;
 constexpr uint8_t COMANDO_APP_SEND_OP_COND = 41u;
 constexpr uint8_t COMANDO_APP_SET_WR_BLK = 23u;
 constexpr uint8_t TOKEN_INICIO_DADOS = 0xFEu;
+constexpr uint8_t TOKEN_INICIO_MULTIPLO = 0xFCu;
+constexpr uint8_t TOKEN_PARADA_MULTIPLO = 0xFDu;
+constexpr uint32_t MASCARA_CONTAGEM_PRE_APAGAMENTO = 0x007FFFFFu;
+// CMD18 troca a latencia de acesso de cada setor seguinte por CMD12 e o busy dele; abaixo disto o
+// ganho nao cobre a parada em cartoes com busy longo, e CMD17 por setor sai mais barato
+constexpr uint32_t LIMIAR_LEITURA_MULTIPLA = 4u;
+// CMD25 paga ACMD23, CMD25 e o busy do token de parada uma vez so; o busy de cada bloco e menor que o
+// do CMD24 porque o cartao grava em area pre-apagada, mas so compensa a parada a partir de alguns setores
+constexpr uint32_t LIMIAR_ESCRITA_MULTIPLA = 4u;
 constexpr uint8_t RESPOSTA_IDLE = 0x01u;
 constexpr uint8_t RESPOSTA_PRONTA = 0x00u;
 constexpr uint32_t ARGUMENTO_HCS = 0x40000000u;
@@ -38,7 +51,8 @@ DriverCartaoSd::DriverCartaoSd(ControladorSpiCartao &controlador_spi)
     : controlador(controlador_spi),
       cartaoInicializado(false),
       cartaoAltaCapacidade(false),
-      quantidadeSetores(0u) {}
+      quantidadeSetores(0u),
+      ocupadoPendente(false) {}
 
 bool DriverCartaoSd::iniciar() {
     if (cartaoInicializado) {
@@ -51,6 +65,7 @@ bool DriverCartaoSd::iniciar() {
 
     controlador.ajustarFrequenciaBaixa();
     controlador.enviarClocksInicializacao();
+    ocupadoPendente = false;
 
     controlador.adquirirBarramento();
 
@@ -151,17 +166,19 @@ bool DriverCartaoSd::lerSetores(uint8_t *destino, uint32_t setor_inicial, uint32
         return false;
     }
 
-    uint32_t indice = 0;
+    if (quantidade == 0u) {
+        return true;
+    }
 
-    while (indice < quantidade) {
-        uint32_t setor_atual = setor_inicial + indice;
-        uint8_t *destino_bloco = destino + (indice * TAMANHO_SETOR_BYTES);
+    if (quantidade >= LIMIAR_LEITURA_MULTIPLA) {
+        return lerBlocosMultiplos(destino, setor_inicial, quantidade);
+    }
 
-        bool leu = lerBloco(destino_bloco, setor_atual);
-        if (!leu) {
+    uint32_t indice = 0;
+    while (indice < quantidade) {
+        if (!lerBloco(destino + (indice * TAMANHO_SETOR_BYTES), setor_inicial + indice)) {
             return false;
         }
-
         indice = indice + 1;
     }
 
@@ -177,17 +194,19 @@ bool DriverCartaoSd::escreverSetores(const uint8_t *origem, uint32_t setor_inici
         return false;
     }
 
-    uint32_t indice = 0;
+    if (quantidade == 0u) {
+        return true;
+    }
 
-    while (indice < quantidade) {
-        uint32_t setor_atual = setor_inicial + indice;
-        const uint8_t *origem_bloco = origem + (indice * TAMANHO_SETOR_BYTES);
+    if (quantidade >= LIMIAR_ESCRITA_MULTIPLA) {
+        return escreverBlocosMultiplos(origem, setor_inicial, quantidade);
+    }
 
-        bool escreveu = escreverBloco(origem_bloco, setor_atual);
-        if (!escreveu) {
+    uint32_t indice = 0;
+    while (indice < quantidade) {
+        if (!escreverBloco(origem + (indice * TAMANHO_SETOR_BYTES), setor_inicial + indice)) {
             return false;
         }
-
         indice = indice + 1;
     }
 
@@ -203,6 +222,12 @@ bool DriverCartaoSd::enviarComando(uint8_t comando, uint32_t argumento, uint8_t
         return false;
     }
 
+    // Busy do CMD12 anterior: so precisa terminar antes do proximo comando
+    if (ocupadoPendente && !aguardarPronto(TEMPO_TIMEOUT_DADOS_MS)) {
+        return false;
+    }
+
+    CARTAO_SD_MEDIR_ARGUMENTO(COMANDO, tamanho_resposta, comando);
     uint8_t pacote[6];
     pacote[0] = static_cast<uint8_t>(0x40u | comando);
     pacote[1] = static_cast<uint8_t>((argumento >> 24u) & 0xFFu);
@@ -221,6 +246,11 @@ bool DriverCartaoSd::enviarComando(uint8_t comando, uint32_t argumento, uint8_t
 
     controlador.transferirBuffer(pacote, nullptr, sizeof(pacote));
 
+    // Depois do CMD12 o cartao ainda devolve um byte de enchimento antes do R1
+    if (comando == COMANDO_STOP_TRANSMISSION) {
+        controlador.transferirByte(0xFFu);
+    }
+
     absolute_time_t tempo_limite = make_timeout_time_ms(TEMPO_TIMEOUT_COMANDO_MS);
 
     while (absolute_time_diff_us(get_absolute_time(), tempo_limite) > 0) {
@@ -252,11 +282,13 @@ bool DriverCartaoSd::enviarComandoAplicativo(uint8_t comando, uint32_t argumento
 }
 
 bool DriverCartaoSd::aguardarPronto(uint32_t tempo_limite_ms) {
+    CARTAO_SD_MEDIR(AGUARDAR_PRONTO, 0u);
     absolute_time_t tempo_limite = make_timeout_time_ms(tempo_limite_ms);
 
     while (absolute_time_diff_us(get_absolute_time(), tempo_limite) > 0) {
         uint8_t valor = controlador.transferirByte(0xFFu);
         if (valor == 0xFFu) {
+            ocupadoPendente = false;
             return true;
         }
     }
@@ -265,6 +297,7 @@ bool DriverCartaoSd::aguardarPronto(uint32_t tempo_limite_ms) {
 }
 
 bool DriverCartaoSd::aguardarToken(uint8_t token, uint32_t tempo_limite_ms, uint8_t &valor_recebido) {
+    CARTAO_SD_MEDIR_ARGUMENTO(AGUARDAR_TOKEN, 0u, token);
     absolute_time_t tempo_limite = make_timeout_time_ms(tempo_limite_ms);
 
     while (absolute_time_diff_us(get_absolute_time(), tempo_limite) > 0) {
@@ -285,6 +318,7 @@ bool DriverCartaoSd::aguardarToken(uint8_t token, uint32_t tempo_limite_ms, uint
 }
 
 bool DriverCartaoSd::lerBloco(uint8_t *destino, uint32_t setor) {
+    CARTAO_SD_MEDIR_ARGUMENTO(LER_BLOCO, TAMANHO_SETOR_BYTES, setor);
     controlador.adquirirBarramento();
 
     uint8_t resposta_cmd[1] = {0};
@@ -311,7 +345,54 @@ bool DriverCartaoSd::lerBloco(uint8_t *destino, uint32_t setor) {
     return leu;
 }
 
+bool DriverCartaoSd::lerBlocosMultiplos(uint8_t *destino, uint32_t setor_inicial, uint32_t quantidade) {
+    CARTAO_SD_MEDIR_ARGUMENTO(LER_BLOCOS_MULTIPLOS, quantidade * TAMANHO_SETOR_BYTES, setor_inicial);
+    controlador.adquirirBarramento();
+
+    uint8_t resposta_cmd[1] = {0};
+    uint32_t argumento = ajustarArgumentoSetor(setor_inicial);
+
+    bool enviou = enviarComando(COMANDO_READ_MULTIPLE, argumento, resposta_cmd, sizeof(resposta_cmd));
+    if (!enviou || resposta_cmd[0] != RESPOSTA_PRONTA) {
+        controlador.liberarBarramento();
+        return false;
+    }
+
+    bool leu = true;
+    uint32_t indice = 0;
+
+    while (indice < quantidade) {
+        uint8_t token = 0u;
+        bool recebeu_token = aguardarToken(TOKEN_INICIO_DADOS, TEMPO_TIMEOUT_DADOS_MS, token);
+        if (!recebeu_token || token != TOKEN_INICIO_DADOS) {
+            leu = false;
+            break;
+        }
+
+        uint8_t *destino_bloco = destino + (indice * TAMANHO_SETOR_BYTES);
+        if (!controlador.transferirBuffer(nullptr, destino_bloco, TAMANHO_SETOR_BYTES)) {
+            leu = false;
+            break;
+        }
+        controlador.transferirByte(0xFFu);
+        controlador.transferirByte(0xFFu);
+
+        indice = indice + 1;
+    }
+
+    // CMD12 encerra a leitura continua mesmo quando um bloco falhou no meio. O busy do R1b nao e
+    // esperado aqui: o cartao o mantem com CS alto e o proximo comando aguarda antes de sair
+    uint8_t resposta_cmd12[1] = {0};
+    bool parou = enviarComando(COMANDO_STOP_TRANSMISSION, 0u, resposta_cmd12, sizeof(resposta_cmd12));
+    ocupadoPendente = true;
+
+    controlador.liberarBarramento();
+
+    return leu && parou && resposta_cmd12[0] == RESPOSTA_PRONTA;
+}
+
 bool DriverCartaoSd::escreverBloco(const uint8_t *origem, uint32_t setor) {
+    CARTAO_SD_MEDIR_ARGUMENTO(ESCREVER_BLOCOS, TAMANHO_SETOR_BYTES, setor);
     controlador.adquirirBarramento();
 
     bool pronto = aguardarPronto(TEMPO_TIMEOUT_DADOS_MS);
@@ -345,6 +426,67 @@ bool DriverCartaoSd::escreverBloco(const uint8_t *origem, uint32_t setor) {
     return escreveu && aceitou && finalizou;
 }
 
+bool DriverCartaoSd::escreverBlocosMultiplos(const uint8_t *origem, uint32_t setor_inicial, uint32_t quantidade) {
+    CARTAO_SD_MEDIR_ARGUMENTO(ESCREVER_BLOCOS, quantidade * TAMANHO_SETOR_BYTES, setor_inicial);
+    controlador.adquirirBarramento();
+
+    bool pronto = aguardarPronto(TEMPO_TIMEOUT_DADOS_MS);
+    if (!pronto) {
+        controlador.liberarBarramento();
+        return false;
+    }
+
+    // ACMD23 e apenas uma dica de pre-apagamento; se o cartao recusar, a escrita segue normalmente
+    uint8_t resposta_acmd23[1] = {0};
+    enviarComandoAplicativo(COMANDO_APP_SET_WR_BLK,
+                            quantidade & MASCARA_CONTAGEM_PRE_APAGAMENTO,
+                            resposta_acmd23,
+                            sizeof(resposta_acmd23));
+
+    uint8_t resposta_cmd[1] = {0};
+    uint32_t argumento = ajustarArgumentoSetor(setor_inicial);
+
+    bool enviou = enviarComando(COMANDO_WRITE_MULTIPLE, argumento, resposta_cmd, sizeof(resposta_cmd));
+    if (!enviou || resposta_cmd[0] != RESPOSTA_PRONTA) {
+        controlador.liberarBarramento();
+        return false;
+    }
+
+    bool escreveu = true;
+    uint32_t indice = 0;
+
+    while (indice < quantidade) {
+        const uint8_t *origem_bloco = origem + (indice * TAMANHO_SETOR_BYTES);
+
+        controlador.transferirByte(TOKEN_INICIO_MULTIPLO);
+        bool enviou_bloco = controlador.transferirBuffer(origem_bloco, nullptr, TAMANHO_SETOR_BYTES);
+        controlador.transferirByte(0xFFu);
+        controlador.transferirByte(0xFFu);
+
+        uint8_t resposta_dados = controlador.transferirByte(0xFFu);
+        bool aceitou = (resposta_dados & MASCARA_RESPOSTA_ESCRITA) == RESPOSTA_ESCRITA_OK;
+
+        // No SPI o cartao segura MISO em 0 ate aceitar o proximo token; a espera por bloco e obrigatoria
+        bool gravou = aguardarPronto(TEMPO_TIMEOUT_DADOS_MS);
+
+        if (!enviou_bloco || !aceitou || !gravou) {
+            escreveu = false;
+            break;
+        }
+
+        indice = indice + 1;
+    }
+
+    // O token de parada encerra o CMD25 mesmo quando um bloco foi rejeitado
+    controlador.transferirByte(TOKEN_PARADA_MULTIPLO);
+    controlador.transferirByte(0xFFu);
+    bool finalizou = aguardarPronto(TEMPO_TIMEOUT_DADOS_MS);
+
+    controlador.liberarBarramento();
+
+    return escreveu && finalizou;
+}
+
 bool DriverCartaoSd::atualizarQuantidadeSetores() {
     uint8_t csd[16];
     bool leu_csd = lerCsd(csd, sizeof(csd));
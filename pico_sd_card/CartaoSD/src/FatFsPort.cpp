@@ -1,5 +1,7 @@
 #include "FatFsPort.h"
 
+#include "Instrumentacao.h"
+
 extern "C" {
 #include "ff.h"
 #include "diskio.h"
@@ -7,6 +9,8 @@ extern "C" {
 
 namespace {
 cartao_sd::DriverCartaoSd *driverRegistrado = nullptr;
+cartao_sd::CacheSetores *cacheRegistrado = nullptr;
+cartao_sd::LeituraAntecipada *leituraAntecipadaRegistrada = nullptr;
 constexpr BYTE UNIDADE_UNICA = 0;
 }
 
@@ -16,6 +20,26 @@ void registrarDriverFatFs(DriverCartaoSd *driver) {
     driverRegistrado = driver;
 }
 
+void registrarCacheFatFs(CacheSetores *cache) {
+    cacheRegistrado = cache;
+}
+
+void registrarLeituraAntecipadaFatFs(LeituraAntecipada *leitura_antecipada) {
+    leituraAntecipadaRegistrada = leitura_antecipada;
+}
+
+void iniciarLeituraArquivoFatFs(const FIL &arquivo) {
+    if (leituraAntecipadaRegistrada != nullptr) {
+        leituraAntecipadaRegistrada->iniciarLeituraArquivo(arquivo);
+    }
+}
+
+void encerrarLeituraArquivoFatFs() {
+    if (leituraAntecipadaRegistrada != nullptr) {
+        leituraAntecipadaRegistrada->encerrarLeituraArquivo();
+    }
+}
+
 } // namespace cartao_sd
 
 extern "C" {
@@ -54,7 +78,15 @@ DRESULT disk_read(BYTE unidade, BYTE *buffer, LBA_t setor, UINT quantidade) {
         return RES_PARERR;
     }
 
-    bool leu = driverRegistrado->lerSetores(buffer, static_cast<uint32_t>(setor), quantidade);
+    CARTAO_SD_MEDIR_ARGUMENTO(DISK_READ, quantidade * FF_MAX_SS, static_cast<uint32_t>(setor));
+    bool leu = false;
+    if (leituraAntecipadaRegistrada != nullptr) {
+        leu = leituraAntecipadaRegistrada->lerSetores(buffer, static_cast<uint32_t>(setor), quantidade);
+    } else if (cacheRegistrado != nullptr) {
+        leu = cacheRegistrado->lerSetores(buffer, static_cast<uint32_t>(setor), quantidade);
+    } else {
+        leu = driverRegistrado->lerSetores(buffer, static_cast<uint32_t>(setor), quantidade);
+    }
     return leu ? RES_OK : RES_ERROR;
 }
 
@@ -68,7 +100,17 @@ DRESULT disk_write(BYTE unidade, const BYTE *buffer, LBA_t setor, UINT quantidad
         return RES_PARERR;
     }
 
-    bool escreveu = driverRegistrado->escreverSetores(buffer, static_cast<uint32_t>(setor), quantidade);
+    CARTAO_SD_MEDIR_ARGUMENTO(DISK_WRITE, quantidade * FF_MAX_SS, static_cast<uint32_t>(setor));
+    if (leituraAntecipadaRegistrada != nullptr) {
+        leituraAntecipadaRegistrada->invalidarIntervalo(static_cast<uint32_t>(setor), quantidade);
+    }
+
+    bool escreveu = false;
+    if (cacheRegistrado != nullptr) {
+        escreveu = cacheRegistrado->escreverSetores(buffer, static_cast<uint32_t>(setor), quantidade);
+    } else {
+        escreveu = driverRegistrado->escreverSetores(buffer, static_cast<uint32_t>(setor), quantidade);
+    }
     return escreveu ? RES_OK : RES_ERROR;
 }
 #endif
@@ -80,6 +122,9 @@ DRESULT disk_ioctl(BYTE unidade, BYTE comando, void *buffer) {
 
     switch (comando) {
         case CTRL_SYNC:
+            if (cacheRegistrado != nullptr && !cacheRegistrado->descarregar()) {
+                return RES_ERROR;
+            }
             return RES_OK;
         case GET_BLOCK_SIZE: {
             if (buffer == nullptr) {
@@ -1,11 +1,18 @@
 #ifndef FATFSPORT_H
 #define FATFSPORT_H
 
+#include "CacheSetores.h"
 #include "DriverCartaoSd.h"
+#include "LeituraAntecipada.h"
 
 namespace cartao_sd {
 
 void registrarDriverFatFs(DriverCartaoSd *driver);
+void registrarCacheFatFs(CacheSetores *cache);
+void registrarLeituraAntecipadaFatFs(LeituraAntecipada *leitura_antecipada);
+// Os disk_read entre as duas chamadas sao do arquivo dado; a leitura antecipada segue a cadeia dele
+void iniciarLeituraArquivoFatFs(const FIL &arquivo);
+void encerrarLeituraArquivoFatFs();
 
 } // namespace cartao_sd
 
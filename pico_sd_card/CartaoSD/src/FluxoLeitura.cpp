@@ -0,0 +1,49 @@
+#include "FluxoLeitura.h"
+
+namespace cartao_sd {
+
+PoolBlocosFluxo::PoolBlocosFluxo() {
+    for (std::atomic<bool> &bloco_em_uso : emUso) {
+        bloco_em_uso.store(false, std::memory_order_relaxed);
+    }
+}
+
+bool PoolBlocosFluxo::reservar(uint8_t &indice) {
+    for (uint32_t candidato = 0; candidato < QUANTIDADE_BLOCOS; ++candidato) {
+        if (!emUso[candidato].load(std::memory_order_acquire)) {
+            emUso[candidato].store(true, std::memory_order_relaxed);
+            indice = static_cast<uint8_t>(candidato);
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t *PoolBlocosFluxo::areaBloco(uint8_t indice) {
+    if (indice >= QUANTIDADE_BLOCOS) {
+        return nullptr;
+    }
+    return blocos[indice];
+}
+
+void PoolBlocosFluxo::liberar(BlocoFluxoSd &bloco) {
+    if (bloco.dados == nullptr || bloco.indice >= QUANTIDADE_BLOCOS) {
+        return;
+    }
+    // release: o consumidor terminou de ler o bloco antes de ele voltar ao pool
+    emUso[bloco.indice].store(false, std::memory_order_release);
+    bloco.dados = nullptr;
+    bloco.bytes = 0u;
+}
+
+uint32_t PoolBlocosFluxo::blocosLivres() const {
+    uint32_t livres = 0u;
+    for (const std::atomic<bool> &bloco_em_uso : emUso) {
+        if (!bloco_em_uso.load(std::memory_order_relaxed)) {
+            livres++;
+        }
+    }
+    return livres;
+}
+
+} // namespace cartao_sd
@@ -0,0 +1,60 @@
+#ifndef FLUXOLEITURA_H
+#define FLUXOLEITURA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+// Pool de blocos do fluxo de leitura (padrao 4 x 4 KB = 16 KB)
+#ifndef CARTAO_SD_FLUXO_BLOCOS
+#define CARTAO_SD_FLUXO_BLOCOS 4u
+#endif
+
+// Tamanho de cada bloco; multiplo de 512 (setor)
+#ifndef CARTAO_SD_FLUXO_BYTES_BLOCO
+#define CARTAO_SD_FLUXO_BYTES_BLOCO 4096u
+#endif
+
+namespace cartao_sd {
+
+// Trecho do arquivo entregue por ArquivoSd::obterBlocoFluxo. dados fica dentro de um bloco do pool
+// ate PoolBlocosFluxo::liberar; dados[0] e o byte posicao do arquivo.
+struct BlocoFluxoSd {
+    const uint8_t *dados;
+    size_t bytes;
+    uint32_t posicao;
+    uint8_t indice;
+};
+
+// Blocos alinhados ao setor (512 bytes) em RAM estatica (nao na pilha): cada bloco e destino direto
+// do SPI/DMA e o byte k do bloco cai no byte k do setor. O pool deve viver em uma variavel global ou
+// estatica. Um nucleo reserva e qualquer outro libera, sem trava: cada
+// bloco tem um so escritor por transicao (reservar: livre -> em uso, liberar: em uso -> livre).
+class PoolBlocosFluxo {
+public:
+    PoolBlocosFluxo();
+
+    PoolBlocosFluxo(const PoolBlocosFluxo &) = delete;
+    PoolBlocosFluxo &operator=(const PoolBlocosFluxo &) = delete;
+
+    bool reservar(uint8_t &indice);
+    uint8_t *areaBloco(uint8_t indice);
+    void liberar(BlocoFluxoSd &bloco);
+    uint32_t blocosLivres() const;
+
+    static constexpr uint32_t QUANTIDADE_BLOCOS = CARTAO_SD_FLUXO_BLOCOS;
+    static constexpr size_t BYTES_BLOCO = CARTAO_SD_FLUXO_BYTES_BLOCO;
+    static constexpr size_t ALINHAMENTO_BLOCO = 512u;
+
+private:
+    static_assert(BYTES_BLOCO > 0u && (BYTES_BLOCO % 512u) == 0u, "bloco do fluxo deve ter setores inteiros");
+    static_assert(QUANTIDADE_BLOCOS > 0u && QUANTIDADE_BLOCOS <= 255u, "indice do bloco cabe em uint8_t");
+
+    alignas(ALINHAMENTO_BLOCO) uint8_t blocos[QUANTIDADE_BLOCOS][BYTES_BLOCO];
+    std::atomic<bool> emUso[QUANTIDADE_BLOCOS];
+};
+
+} // namespace cartao_sd
+
+#endif
@@ -0,0 +1,246 @@
+#include "Instrumentacao.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+
+namespace cartao_sd {
+
+namespace {
+constexpr size_t QUANTIDADE_CAMADAS = static_cast<size_t>(CamadaSd::QUANTIDADE);
+
+MedidaCamada medidas[QUANTIDADE_CAMADAS];
+
+const char *const NOMES_CAMADAS[] = {
+    "transferirBuffer",
+    "comando",
+    "aguardarPronto",
+    "aguardarToken",
+    "lerBloco",
+    "lerBlocosMultiplos",
+    "escreverBlocos",
+    "disk_read",
+    "disk_write",
+    "f_read",
+    "f_write",
+    "f_lseek",
+    "f_open",
+    "f_close",
+    "f_sync"
+};
+static_assert(sizeof(NOMES_CAMADAS) / sizeof(NOMES_CAMADAS[0]) == QUANTIDADE_CAMADAS,
+              "um nome por camada, na ordem de CamadaSd");
+
+#ifdef CARTAO_SD_RASTREAMENTO
+// marcador = 2 * sequencia + 1 enquanto o produtor escreve e 2 * sequencia + 2 quando o evento
+// esta completo; 0 e posicao nunca usada
+struct PosicaoRastreamento {
+    std::atomic<uint32_t> marcador;
+    EventoRastreamento evento;
+};
+
+PosicaoRastreamento anelRastreamento[CARTAO_SD_RASTREAMENTO_EVENTOS];
+std::atomic<uint32_t> proximaSequencia{0u};
+std::atomic<bool> rastreamentoPausado{false};
+
+void registrarEventoRastreamento(CamadaSd camada, uint64_t inicio_us, uint32_t duracao_us, size_t bytes, uint32_t argumento) {
+    if (camada == CamadaSd::TRANSFERIR_BUFFER || rastreamentoPausado.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    // So um produtor: carregar e guardar basta, sem fetch_add (o Cortex-M0+ nao tem LDREX/STREX)
+    uint32_t sequencia = proximaSequencia.load(std::memory_order_relaxed);
+    PosicaoRastreamento &posicao = anelRastreamento[sequencia % CARTAO_SD_RASTREAMENTO_EVENTOS];
+
+    posicao.marcador.store(2u * sequencia + 1u, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    posicao.evento.inicio_us = inicio_us;
+    posicao.evento.duracao_us = duracao_us;
+    posicao.evento.bytes = static_cast<uint32_t>(bytes);
+    posicao.evento.argumento = argumento;
+    posicao.evento.sequencia = sequencia;
+    posicao.evento.camada = camada;
+    posicao.marcador.store(2u * sequencia + 2u, std::memory_order_release);
+
+    proximaSequencia.store(sequencia + 1u, std::memory_order_release);
+}
+
+// Copia o evento de numero sequencia se ele ainda estiver inteiro no anel
+bool lerEventoRastreamento(uint32_t sequencia, EventoRastreamento &destino) {
+    const PosicaoRastreamento &posicao = anelRastreamento[sequencia % CARTAO_SD_RASTREAMENTO_EVENTOS];
+    uint32_t esperado = 2u * sequencia + 2u;
+
+    if (posicao.marcador.load(std::memory_order_acquire) != esperado) {
+        return false;
+    }
+    destino = posicao.evento;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return posicao.marcador.load(std::memory_order_relaxed) == esperado;
+}
+
+uint32_t primeiraSequenciaRastreamento(uint32_t fim) {
+    return (fim > CARTAO_SD_RASTREAMENTO_EVENTOS) ? fim - CARTAO_SD_RASTREAMENTO_EVENTOS : 0u;
+}
+#endif
+}
+
+void zerarInstrumentacao() {
+    memset(medidas, 0, sizeof(medidas));
+}
+
+void obterMedidaCamada(CamadaSd camada, MedidaCamada &destino) {
+    size_t indice = static_cast<size_t>(camada);
+    if (indice >= QUANTIDADE_CAMADAS) {
+        memset(&destino, 0, sizeof(destino));
+        return;
+    }
+    destino = medidas[indice];
+}
+
+const char *nomeCamada(CamadaSd camada) {
+    size_t indice = static_cast<size_t>(camada);
+    if (indice >= QUANTIDADE_CAMADAS) {
+        return "?";
+    }
+    return NOMES_CAMADAS[indice];
+}
+
+void registrarMedidaCamada(CamadaSd camada, uint64_t inicio_us, uint64_t fim_us, size_t bytes, uint32_t argumento) {
+    size_t indice = static_cast<size_t>(camada);
+    if (indice >= QUANTIDADE_CAMADAS) {
+        return;
+    }
+
+    MedidaCamada &medida = medidas[indice];
+    uint32_t duracao = static_cast<uint32_t>(fim_us - inicio_us);
+    medida.chamadas++;
+    medida.tempo_us += duracao;
+    medida.bytes += bytes;
+    if (duracao > medida.tempo_maximo_us) {
+        medida.tempo_maximo_us = duracao;
+    }
+
+#ifdef CARTAO_SD_RASTREAMENTO
+    registrarEventoRastreamento(camada, inicio_us, duracao, bytes, argumento);
+#else
+    (void)argumento;
+#endif
+}
+
+void zerarRastreamento() {
+#ifdef CARTAO_SD_RASTREAMENTO
+    for (PosicaoRastreamento &posicao : anelRastreamento) {
+        posicao.marcador.store(0u, std::memory_order_relaxed);
+    }
+    proximaSequencia.store(0u, std::memory_order_release);
+#endif
+}
+
+void pausarRastreamento(bool pausado) {
+#ifdef CARTAO_SD_RASTREAMENTO
+    rastreamentoPausado.store(pausado, std::memory_order_relaxed);
+#else
+    (void)pausado;
+#endif
+}
+
+uint32_t totalEventosRastreamento() {
+#ifdef CARTAO_SD_RASTREAMENTO
+    return proximaSequencia.load(std::memory_order_acquire);
+#else
+    return 0u;
+#endif
+}
+
+size_t copiarRastreamento(EventoRastreamento *destino, size_t capacidade) {
+    size_t copiados = 0u;
+#ifdef CARTAO_SD_RASTREAMENTO
+    if (destino == nullptr) {
+        return 0u;
+    }
+
+    uint32_t fim = proximaSequencia.load(std::memory_order_acquire);
+    uint32_t sequencia = primeiraSequenciaRastreamento(fim);
+    if (fim - sequencia > capacidade) {
+        sequencia = fim - static_cast<uint32_t>(capacidade);
+    }
+
+    while (sequencia != fim) {
+        if (lerEventoRastreamento(sequencia, destino[copiados])) {
+            copiados++;
+        }
+        sequencia++;
+    }
+#else
+    (void)destino;
+    (void)capacidade;
+#endif
+    return copiados;
+}
+
+void imprimirRastreamento() {
+#ifdef CARTAO_SD_RASTREAMENTO
+    uint32_t fim = proximaSequencia.load(std::memory_order_acquire);
+    printf("# rastro,sequencia,camada,inicio_us,duracao_us,bytes,argumento (%lu eventos registrados)\r\n",
+           (unsigned long)fim);
+
+    for (uint32_t sequencia = primeiraSequenciaRastreamento(fim); sequencia != fim; ++sequencia) {
+        EventoRastreamento evento;
+        if (!lerEventoRastreamento(sequencia, evento)) {
+            continue;
+        }
+        printf("rastro,%lu,%s,%llu,%lu,%lu,%lu\r\n",
+               (unsigned long)evento.sequencia,
+               nomeCamada(evento.camada),
+               (unsigned long long)evento.inicio_us,
+               (unsigned long)evento.duracao_us,
+               (unsigned long)evento.bytes,
+               (unsigned long)evento.argumento);
+    }
+#endif
+}
+
+#ifdef CARTAO_SD_HOST
+bool exportarRastreamentoChrome(const char *caminho) {
+    FILE *saida = fopen(caminho, "w");
+    if (saida == nullptr) {
+        return false;
+    }
+
+    // Eventos "X" (completos) em um unico thread: o visualizador empilha as camadas pelo tempo
+    fprintf(saida, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool primeiro = true;
+#ifdef CARTAO_SD_RASTREAMENTO
+    uint32_t fim = proximaSequencia.load(std::memory_order_acquire);
+    for (uint32_t sequencia = primeiraSequenciaRastreamento(fim); sequencia != fim; ++sequencia) {
+        EventoRastreamento evento;
+        if (!lerEventoRastreamento(sequencia, evento)) {
+            continue;
+        }
+
+        char nome[24];
+        if (evento.camada == CamadaSd::COMANDO) {
+            snprintf(nome, sizeof(nome), "CMD%lu", (unsigned long)evento.argumento);
+        } else {
+            snprintf(nome, sizeof(nome), "%s", nomeCamada(evento.camada));
+        }
+
+        fprintf(saida, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%lu,"
+                       "\"pid\":1,\"tid\":1,\"args\":{\"bytes\":%lu,\"argumento\":%lu}}",
+                primeiro ? "" : ",\n",
+                nome,
+                nomeCamada(evento.camada),
+                (unsigned long long)evento.inicio_us,
+                (unsigned long)evento.duracao_us,
+                (unsigned long)evento.bytes,
+                (unsigned long)evento.argumento);
+        primeiro = false;
+    }
+#endif
+    fprintf(saida, "%s]}\n", primeiro ? "" : "\n");
+    return fclose(saida) == 0;
+}
+#endif
+
+} // namespace cartao_sd
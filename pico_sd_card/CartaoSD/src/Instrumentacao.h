@@ -0,0 +1,111 @@
+#ifndef INSTRUMENTACAO_H
+#define INSTRUMENTACAO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pico/time.h"
+
+namespace cartao_sd {
+
+#ifndef CARTAO_SD_RASTREAMENTO_EVENTOS
+#define CARTAO_SD_RASTREAMENTO_EVENTOS 256u
+#endif
+
+// Camadas medidas, de baixo (barramento) para cima (FatFs). Os tempos sao inclusivos:
+// DISK_READ contem o LER_BLOCO que contem o TRANSFERIR_BUFFER.
+enum class CamadaSd : uint8_t {
+    TRANSFERIR_BUFFER,      // ControladorSpiCartao::transferirBuffer
+    COMANDO,                // DriverCartaoSd::enviarComando; argumento = indice do comando
+    AGUARDAR_PRONTO,        // DriverCartaoSd::aguardarPronto (busy depois de escrita/CMD12)
+    AGUARDAR_TOKEN,         // DriverCartaoSd::aguardarToken; argumento = token esperado
+    LER_BLOCO,              // DriverCartaoSd::lerBloco (CMD17)
+    LER_BLOCOS_MULTIPLOS,   // DriverCartaoSd::lerBlocosMultiplos (CMD18)
+    ESCREVER_BLOCOS,        // DriverCartaoSd::escreverBloco / escreverBlocosMultiplos
+    DISK_READ,
+    DISK_WRITE,
+    F_READ,                 // ArquivoSd::lerBytes
+    F_WRITE,                // ArquivoSd::escreverBytes
+    F_LSEEK,                // ArquivoSd::buscar
+    F_OPEN,                 // CartaoSD::abrir
+    F_CLOSE,                // ArquivoSd::fechar
+    F_SYNC,                 // ArquivoSd::sincronizar
+    QUANTIDADE
+};
+
+struct MedidaCamada {
+    uint32_t chamadas;
+    uint64_t tempo_us;
+    uint64_t bytes;
+    uint32_t tempo_maximo_us;
+};
+
+// Acumuladores globais, sem trava: a pilha do cartao roda em um nucleo so.
+// Sem CARTAO_SD_INSTRUMENTACAO nada e medido e as medidas ficam zeradas.
+void zerarInstrumentacao();
+void obterMedidaCamada(CamadaSd camada, MedidaCamada &destino);
+const char *nomeCamada(CamadaSd camada);
+void registrarMedidaCamada(CamadaSd camada, uint64_t inicio_us, uint64_t fim_us, size_t bytes, uint32_t argumento);
+
+// Um evento do rastreamento. argumento depende da camada: setor (disk_read/disk_write, lerBloco,
+// escreverBlocos), indice do comando (COMANDO), token (AGUARDAR_TOKEN) ou posicao (F_LSEEK).
+struct EventoRastreamento {
+    uint64_t inicio_us;
+    uint32_t duracao_us;
+    uint32_t bytes;
+    uint32_t argumento;
+    uint32_t sequencia;
+    CamadaSd camada;
+};
+
+// Anel em RAM com os ultimos CARTAO_SD_RASTREAMENTO_EVENTOS eventos, menos TRANSFERIR_BUFFER, que
+// encheria o anel em poucos comandos. Um produtor (o nucleo que usa o cartao) e qualquer leitor,
+// sem trava: o leitor descarta o evento que o produtor sobrescreveu durante a copia.
+// Sem CARTAO_SD_RASTREAMENTO o anel nao existe e as funcoes nao devolvem eventos.
+void zerarRastreamento();
+// Pausado, o anel guarda o historico ate o instante da pausa (ex.: o primeiro underrun)
+void pausarRastreamento(bool pausado);
+// Eventos registrados desde zerarRastreamento(), inclusive os ja sobrescritos
+uint32_t totalEventosRastreamento();
+// Copia os eventos ainda no anel, do mais antigo ao mais novo; devolve quantos copiou
+size_t copiarRastreamento(EventoRastreamento *destino, size_t capacidade);
+// Imprime o anel pelo stdio (USB CDC no Pico): "rastro,sequencia,camada,inicio_us,duracao_us,bytes,argumento"
+void imprimirRastreamento();
+#ifdef CARTAO_SD_HOST
+// Grava o anel no formato JSON de trace do Chrome (chrome://tracing ou ui.perfetto.dev)
+bool exportarRastreamentoChrome(const char *caminho);
+#endif
+
+// Mede o escopo em que foi criada
+class MedicaoCamada {
+public:
+    MedicaoCamada(CamadaSd camada_medida, size_t bytes_medidos, uint32_t argumento_medido = 0u)
+        : camada(camada_medida), bytes(bytes_medidos), argumento(argumento_medido), inicioUs(time_us_64()) {}
+
+    ~MedicaoCamada() {
+        registrarMedidaCamada(camada, inicioUs, time_us_64(), bytes, argumento);
+    }
+
+    MedicaoCamada(const MedicaoCamada &) = delete;
+    MedicaoCamada &operator=(const MedicaoCamada &) = delete;
+
+private:
+    CamadaSd camada;
+    size_t bytes;
+    uint32_t argumento;
+    uint64_t inicioUs;
+};
+
+} // namespace cartao_sd
+
+#if defined(CARTAO_SD_INSTRUMENTACAO) || defined(CARTAO_SD_RASTREAMENTO)
+#define CARTAO_SD_MEDIR(camada, bytes) \
+    cartao_sd::MedicaoCamada medicao_camada_sd(cartao_sd::CamadaSd::camada, (bytes))
+#define CARTAO_SD_MEDIR_ARGUMENTO(camada, bytes, argumento) \
+    cartao_sd::MedicaoCamada medicao_camada_sd(cartao_sd::CamadaSd::camada, (bytes), (argumento))
+#else
+#define CARTAO_SD_MEDIR(camada, bytes)
+#define CARTAO_SD_MEDIR_ARGUMENTO(camada, bytes, argumento)
+#endif
+
+#endif
@@ -0,0 +1,269 @@
+#include "LeitorWav.h"
+
+#include <string.h>
+
+namespace cartao_sd {
+
+namespace {
+constexpr size_t TAMANHO_CABECALHO_RIFF = 12u;
+constexpr size_t TAMANHO_CABECALHO_CHUNK = 8u;
+constexpr size_t TAMANHO_FMT_MINIMO = 16u;
+constexpr size_t TAMANHO_FMT_EXTENSIVEL = 40u;
+constexpr size_t OFFSET_SUBFORMATO = 24u;
+constexpr size_t TAMANHO_DESCARTE = 32u;
+
+uint16_t lerU16(const uint8_t *origem) {
+    return static_cast<uint16_t>(origem[0] | (origem[1] << 8));
+}
+
+uint32_t lerU32(const uint8_t *origem) {
+    return static_cast<uint32_t>(origem[0]) |
+           (static_cast<uint32_t>(origem[1]) << 8) |
+           (static_cast<uint32_t>(origem[2]) << 16) |
+           (static_cast<uint32_t>(origem[3]) << 24);
+}
+
+bool idIgual(const uint8_t *origem, const char *id) {
+    return memcmp(origem, id, 4u) == 0;
+}
+
+// Amostra de 8 bits e sem sinal; nas demais os dois bytes mais significativos formam o valor de 16 bits
+int16_t amostraPara16(const uint8_t *origem, uint16_t bytes_amostra) {
+    if (bytes_amostra == 1u) {
+        return static_cast<int16_t>((static_cast<int32_t>(origem[0]) - 128) * 256);
+    }
+    return static_cast<int16_t>(lerU16(origem + (bytes_amostra - 2u)));
+}
+}
+
+LeitorWav::LeitorWav(FuncaoLeituraWav funcao_leitura, FuncaoAvancoWav funcao_avanco, void *contexto)
+    : lerFonte(funcao_leitura),
+      avancarFonte(funcao_avanco),
+      contextoFonte(contexto),
+      posicao(0u),
+      restantesDados(0u) {
+    memset(&formatoAtual, 0, sizeof(formatoAtual));
+}
+
+ResultadoWav LeitorWav::analisarCabecalho() {
+    uint8_t cabecalho[TAMANHO_CABECALHO_RIFF];
+    if (!lerExato(cabecalho, sizeof(cabecalho))) {
+        return ResultadoWav::FIM_PREMATURO;
+    }
+    if (!idIgual(cabecalho, "RIFF")) {
+        return ResultadoWav::NAO_E_RIFF;
+    }
+    if (!idIgual(cabecalho + 8u, "WAVE")) {
+        return ResultadoWav::NAO_E_WAVE;
+    }
+
+    // Fim do RIFF em 64 bits: o campo de tamanho nao conta os 8 bytes de "RIFF" e dele mesmo
+    uint64_t fim_riff = static_cast<uint64_t>(lerU32(cabecalho + 4u)) + 8u;
+    bool fmt_encontrado = false;
+    while (true) {
+        uint8_t chunk[TAMANHO_CABECALHO_CHUNK];
+        if (!lerExato(chunk, sizeof(chunk))) {
+            return fmt_encontrado ? ResultadoWav::SEM_DATA : ResultadoWav::SEM_FMT;
+        }
+        uint32_t tamanho_chunk = lerU32(chunk + 4u);
+        bool chunk_data = idIgual(chunk, "data");
+
+        // Tamanho corrompido ou desconhecido (0xFFFFFFFF): pular o corpo daria a volta no uint32_t
+        // e o leitor seguiria em lixo. So o data pode passar do RIFF (arquivo gravado em fluxo).
+        if (!chunk_data && static_cast<uint64_t>(posicao) + tamanho_chunk > fim_riff) {
+            return ResultadoWav::CHUNK_FORA_DO_RIFF;
+        }
+
+        if (idIgual(chunk, "fmt ")) {
+            ResultadoWav resultado = analisarFmt(tamanho_chunk);
+            if (resultado != ResultadoWav::OK) {
+                return resultado;
+            }
+            fmt_encontrado = true;
+        } else if (chunk_data) {
+            if (!fmt_encontrado) {
+                return ResultadoWav::SEM_FMT;
+            }
+            formatoAtual.inicio_dados = posicao;
+            formatoAtual.tamanho_dados = tamanho_chunk;
+            restantesDados = tamanho_chunk;
+            return ResultadoWav::OK;
+        } else {
+            // LIST, fact, cue, etc.: pula o corpo e o byte de alinhamento dos chunks de tamanho impar
+            if (!pular(tamanho_chunk + (tamanho_chunk & 1u))) {
+                return fmt_encontrado ? ResultadoWav::SEM_DATA : ResultadoWav::SEM_FMT;
+            }
+        }
+    }
+}
+
+ResultadoWav LeitorWav::analisarFmt(uint32_t tamanho_chunk) {
+    if (tamanho_chunk < TAMANHO_FMT_MINIMO) {
+        return ResultadoWav::FMT_INVALIDO;
+    }
+
+    uint8_t fmt[TAMANHO_FMT_LIDO];
+    size_t tamanho_lido = (tamanho_chunk < TAMANHO_FMT_LIDO) ? tamanho_chunk : TAMANHO_FMT_LIDO;
+    if (!lerExato(fmt, tamanho_lido)) {
+        return ResultadoWav::FIM_PREMATURO;
+    }
+    uint32_t sobra = tamanho_chunk - static_cast<uint32_t>(tamanho_lido);
+    if (!pular(sobra + (tamanho_chunk & 1u))) {
+        return ResultadoWav::FIM_PREMATURO;
+    }
+
+    formatoAtual.formato_audio = lerU16(fmt);
+    formatoAtual.canais = lerU16(fmt + 2u);
+    formatoAtual.taxa_amostragem = lerU32(fmt + 4u);
+    formatoAtual.bytes_por_segundo = lerU32(fmt + 8u);
+    formatoAtual.alinhamento_bloco = lerU16(fmt + 12u);
+    formatoAtual.bits_por_amostra = lerU16(fmt + 14u);
+
+    if (formatoAtual.formato_audio == FORMATO_EXTENSIVEL) {
+        if (tamanho_lido < TAMANHO_FMT_EXTENSIVEL) {
+            return ResultadoWav::FMT_INVALIDO;
+        }
+        formatoAtual.formato_audio = lerU16(fmt + OFFSET_SUBFORMATO);
+    }
+
+    if (formatoAtual.formato_audio != FORMATO_PCM) {
+        return ResultadoWav::FORMATO_NAO_SUPORTADO;
+    }
+    if (formatoAtual.canais == 0u || formatoAtual.canais > MAXIMO_CANAIS || formatoAtual.taxa_amostragem == 0u) {
+        return ResultadoWav::FORMATO_NAO_SUPORTADO;
+    }
+
+    uint16_t bits = formatoAtual.bits_por_amostra;
+    if (bits == 0u || bits > 32u) {
+        return ResultadoWav::FORMATO_NAO_SUPORTADO;
+    }
+    // O recipiente de cada amostra e o alinhamento dividido pelos canais (20 bits em 3 bytes, por exemplo)
+    uint16_t bytes_amostra = static_cast<uint16_t>((bits + 7u) / 8u);
+    if (formatoAtual.alinhamento_bloco != formatoAtual.canais * bytes_amostra) {
+        return ResultadoWav::FMT_INVALIDO;
+    }
+    return ResultadoWav::OK;
+}
+
+const FormatoWav &LeitorWav::formato() const {
+    return formatoAtual;
+}
+
+bool LeitorWav::estereo16Bits() const {
+    return formatoAtual.canais == 2u && formatoAtual.bits_por_amostra == 16u;
+}
+
+size_t LeitorWav::lerDados(uint8_t *destino, size_t tamanho) {
+    if (tamanho > restantesDados) {
+        tamanho = restantesDados;
+    }
+    if (tamanho == 0u) {
+        return 0u;
+    }
+
+    size_t lidos = lerFonte(contextoFonte, destino, tamanho);
+    posicao += static_cast<uint32_t>(lidos);
+    restantesDados -= static_cast<uint32_t>(lidos);
+    if (lidos < tamanho) {
+        restantesDados = 0u; // Arquivo truncado: o chunk data acaba onde o arquivo acaba
+    }
+    return lidos;
+}
+
+size_t LeitorWav::lerQuadrosEstereo16(int16_t *destino, size_t quadros, uint8_t *area_trabalho, size_t tamanho_area) {
+    uint16_t alinhamento = formatoAtual.alinhamento_bloco;
+    if (alinhamento == 0u) {
+        return 0u;
+    }
+
+    size_t convertidos = 0u;
+    while (convertidos < quadros) {
+        size_t lote = quadros - convertidos;
+        if (lote > tamanho_area / alinhamento) {
+            lote = tamanho_area / alinhamento;
+        }
+        if (lote == 0u) {
+            break;
+        }
+
+        size_t lidos = lerDados(area_trabalho, lote * alinhamento) / alinhamento;
+        converterQuadrosEstereo16(formatoAtual, area_trabalho, lidos, destino + (convertidos * 2u));
+        convertidos += lidos;
+        if (lidos < lote) {
+            break;
+        }
+    }
+    return convertidos;
+}
+
+uint32_t LeitorWav::bytesRestantes() const {
+    return restantesDados;
+}
+
+size_t LeitorWav::tamanhoPrimeiraLeitura(size_t tamanho_bloco) const {
+    size_t alinhamento = (formatoAtual.alinhamento_bloco != 0u) ? formatoAtual.alinhamento_bloco : 1u;
+    size_t tamanho = tamanho_bloco - (formatoAtual.inicio_dados % tamanho_bloco);
+    tamanho -= tamanho % alinhamento;
+    if (tamanho == 0u) {
+        tamanho = tamanho_bloco - (tamanho_bloco % alinhamento);
+    }
+    return tamanho;
+}
+
+void LeitorWav::converterQuadrosEstereo16(const FormatoWav &formato, const uint8_t *origem, size_t quadros, int16_t *destino) {
+    uint16_t bytes_amostra = static_cast<uint16_t>(formato.alinhamento_bloco / formato.canais);
+    size_t offset_direito = (formato.canais > 1u) ? bytes_amostra : 0u;
+
+    // Com mais de dois canais so os dois primeiros (frente esquerda e direita) sao mantidos
+    for (size_t i = 0u; i < quadros; ++i) {
+        const uint8_t *quadro = origem + (i * formato.alinhamento_bloco);
+        destino[i * 2u] = amostraPara16(quadro, bytes_amostra);
+        destino[(i * 2u) + 1u] = amostraPara16(quadro + offset_direito, bytes_amostra);
+    }
+}
+
+const char *LeitorWav::descreverResultado(ResultadoWav resultado) {
+    switch (resultado) {
+        case ResultadoWav::OK: return "ok";
+        case ResultadoWav::FIM_PREMATURO: return "arquivo termina antes do cabecalho";
+        case ResultadoWav::NAO_E_RIFF: return "nao e um arquivo RIFF";
+        case ResultadoWav::NAO_E_WAVE: return "RIFF sem tipo WAVE";
+        case ResultadoWav::FMT_INVALIDO: return "chunk fmt invalido";
+        case ResultadoWav::SEM_FMT: return "chunk fmt ausente";
+        case ResultadoWav::SEM_DATA: return "chunk data ausente";
+        case ResultadoWav::CHUNK_FORA_DO_RIFF: return "chunk passa do fim do RIFF";
+        case ResultadoWav::FORMATO_NAO_SUPORTADO: return "formato nao suportado";
+    }
+    return "desconhecido";
+}
+
+bool LeitorWav::lerExato(uint8_t *destino, size_t tamanho) {
+    size_t lidos = lerFonte(contextoFonte, destino, tamanho);
+    posicao += static_cast<uint32_t>(lidos);
+    return lidos == tamanho;
+}
+
+bool LeitorWav::pular(uint32_t bytes) {
+    if (bytes == 0u) {
+        return true;
+    }
+    if (avancarFonte != nullptr) {
+        if (!avancarFonte(contextoFonte, bytes)) {
+            return false;
+        }
+        posicao += bytes;
+        return true;
+    }
+
+    uint8_t descarte[TAMANHO_DESCARTE];
+    while (bytes > 0u) {
+        size_t parte = (bytes < TAMANHO_DESCARTE) ? bytes : TAMANHO_DESCARTE;
+        if (!lerExato(descarte, parte)) {
+            return false;
+        }
+        bytes -= static_cast<uint32_t>(parte);
+    }
+    return true;
+}
+
+} // namespace cartao_sd
@@ -0,0 +1,83 @@
+#ifndef LEITORWAV_H
+#define LEITORWAV_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace cartao_sd {
+
+// Fonte de bytes do leitor: devolve quantos bytes copiou (0 no fim)
+using FuncaoLeituraWav = size_t (*)(void *contexto, uint8_t *destino, size_t tamanho);
+// Pula bytes da fonte sem copia-los; pode ser nula (o leitor descarta lendo)
+using FuncaoAvancoWav = bool (*)(void *contexto, uint32_t bytes);
+
+enum class ResultadoWav {
+    OK,
+    FIM_PREMATURO,
+    NAO_E_RIFF,
+    NAO_E_WAVE,
+    FMT_INVALIDO,
+    SEM_FMT,
+    SEM_DATA,
+    CHUNK_FORA_DO_RIFF,
+    FORMATO_NAO_SUPORTADO
+};
+
+struct FormatoWav {
+    uint16_t formato_audio;       // 1 = PCM (WAVE_FORMAT_EXTENSIBLE ja resolvido para o subformato)
+    uint16_t canais;
+    uint32_t taxa_amostragem;
+    uint32_t bytes_por_segundo;
+    uint16_t alinhamento_bloco;   // Bytes por quadro (todos os canais de um instante)
+    uint16_t bits_por_amostra;
+    uint32_t inicio_dados;        // Posicao do primeiro byte do chunk data no arquivo
+    uint32_t tamanho_dados;       // Tamanho do chunk data em bytes
+};
+
+// Analisa o RIFF/WAVE chunk a chunk ate achar `fmt ` e `data`, sem alocar e sem
+// ler o arquivo inteiro. Depois da analise a fonte fica no primeiro byte de audio
+// e lerDados() nunca passa do fim do chunk data (chunks LIST finais nao tocam).
+// Suporta PCM inteiro de 8, 16, 24 e 32 bits com 1 a 8 canais.
+class LeitorWav {
+public:
+    LeitorWav(FuncaoLeituraWav funcao_leitura, FuncaoAvancoWav funcao_avanco, void *contexto);
+
+    ResultadoWav analisarCabecalho();
+    const FormatoWav &formato() const;
+    bool estereo16Bits() const;
+
+    size_t lerDados(uint8_t *destino, size_t tamanho);
+    size_t lerQuadrosEstereo16(int16_t *destino, size_t quadros, uint8_t *area_trabalho, size_t tamanho_area);
+    uint32_t bytesRestantes() const;
+    // Tamanho da primeira lerDados de um fluxo em blocos de tamanho_bloco bytes: ate a proxima
+    // fronteira de bloco no arquivo, arredondado para quadros inteiros. Se o data nao comeca em
+    // fronteira de quadro as leituras seguintes saem do alinhamento do setor, mas nenhum bloco
+    // termina no meio de um quadro (tamanho_bloco deve ser multiplo do alinhamento).
+    size_t tamanhoPrimeiraLeitura(size_t tamanho_bloco) const;
+
+    // Converte quadros crus no formato analisado para pares L/R de 16 bits (mono vira L = R)
+    static void converterQuadrosEstereo16(const FormatoWav &formato, const uint8_t *origem, size_t quadros, int16_t *destino);
+    static const char *descreverResultado(ResultadoWav resultado);
+
+    static constexpr uint16_t FORMATO_PCM = 0x0001u;
+    static constexpr uint16_t FORMATO_EXTENSIVEL = 0xFFFEu;
+    static constexpr uint16_t MAXIMO_CANAIS = 8u;
+
+private:
+    static constexpr size_t TAMANHO_FMT_LIDO = 40u;
+
+    FuncaoLeituraWav lerFonte;
+    FuncaoAvancoWav avancarFonte;
+    void *contextoFonte;
+    FormatoWav formatoAtual;
+    uint32_t posicao;
+    uint32_t restantesDados;
+
+    bool lerExato(uint8_t *destino, size_t tamanho);
+    bool pular(uint32_t bytes);
+    ResultadoWav analisarFmt(uint32_t tamanho_chunk);
+};
+
+} // namespace cartao_sd
+
+#endif
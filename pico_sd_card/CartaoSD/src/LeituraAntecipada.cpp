@@ -0,0 +1,306 @@
+#include "LeituraAntecipada.h"
+
+#include <string.h>
+
+namespace cartao_sd {
+
+namespace {
+constexpr size_t TAMANHO_SETOR_BYTES = 512u;
+constexpr BYTE CADEIA_CONTIGUA = 2u;            // exFAT: clusters seguidos, sem entradas na FAT
+constexpr BYTE CADEIA_SO_NO_ARQUIVO = 3u;       // exFAT: fragmentos ainda nao gravados na FAT
+constexpr DWORD MASCARA_ENTRADA_FAT32 = 0x0FFFFFFFu;
+
+uint8_t anelSetores[LeituraAntecipada::CAPACIDADE_SETORES][TAMANHO_SETOR_BYTES];
+uint8_t setorFat[TAMANHO_SETOR_BYTES];
+
+uint32_t menor(uint32_t a, uint32_t b) {
+    return (a < b) ? a : b;
+}
+}
+
+LeituraAntecipada::LeituraAntecipada(CacheSetores &cache_setores)
+    : cache(cache_setores),
+      profundidade(0u),
+      totalSetores(0u),
+      sistema(nullptr),
+      clusterInicialArquivo(0u),
+      tamanhoArquivo(0u),
+      estadoCadeia(0u),
+      lendoArquivo(false),
+      indiceLeitura(0u),
+      quantidadeValida(0u),
+      proximoSetorAntecipar(FIM_DA_CADEIA),
+      proximoSetorEsperado(FIM_DA_CADEIA),
+      leiturasSequenciais(0u) {
+    memset(setoresAnel, 0, sizeof(setoresAnel));
+    zerarEstatisticas();
+}
+
+bool LeituraAntecipada::configurar(uint32_t profundidade_setores, uint32_t total_setores) {
+    invalidar();
+    totalSetores = total_setores;
+
+    // Limitar em silencio deixaria clusters maiores que o anel sem antecipacao alguma
+    if (profundidade_setores > CAPACIDADE_SETORES) {
+        profundidade = 0u;
+        return false;
+    }
+
+    profundidade = profundidade_setores;
+    return true;
+}
+
+void LeituraAntecipada::iniciarLeituraArquivo(const FIL &arquivo) {
+    if (arquivo.obj.fs != sistema || arquivo.obj.sclust != clusterInicialArquivo) {
+        // Outro arquivo: a sequencia e o anel do anterior nao valem para ele
+        descartarAnel();
+        sistema = arquivo.obj.fs;
+        clusterInicialArquivo = arquivo.obj.sclust;
+        leiturasSequenciais = 0u;
+        proximoSetorEsperado = FIM_DA_CADEIA;
+        proximoSetorAntecipar = FIM_DA_CADEIA;
+    }
+
+    tamanhoArquivo = arquivo.obj.objsize;
+    estadoCadeia = static_cast<BYTE>(arquivo.obj.stat & 0x03u);
+    lendoArquivo = true;
+}
+
+void LeituraAntecipada::encerrarLeituraArquivo() {
+    lendoArquivo = false;
+}
+
+bool LeituraAntecipada::lerSetores(uint8_t *destino, uint32_t setor_inicial, uint32_t quantidade) {
+    // Fora de uma leitura de arquivo (FAT, diretorios) o anel e a sequencia ficam intactos
+    if (profundidade == 0u || !lendoArquivo || setor_inicial < sistema->database) {
+        return cache.lerSetores(destino, setor_inicial, quantidade);
+    }
+
+    if (setor_inicial == proximoSetorEsperado) {
+        if (leiturasSequenciais < LIMIAR_SEQUENCIA) {
+            leiturasSequenciais = leiturasSequenciais + 1u;
+        }
+    } else {
+        leiturasSequenciais = 0u;
+        if (quantidadeValida > 0u && setoresAnel[indiceLeitura] != setor_inicial) {
+            descartarAnel();
+        }
+    }
+
+    uint32_t entregues = 0u;
+    while (entregues < quantidade && quantidadeValida > 0u && setoresAnel[indiceLeitura] == setor_inicial + entregues) {
+        memcpy(destino + (entregues * TAMANHO_SETOR_BYTES), anelSetores[indiceLeitura], TAMANHO_SETOR_BYTES);
+        indiceLeitura = (indiceLeitura + 1u) % CAPACIDADE_SETORES;
+        quantidadeValida = quantidadeValida - 1u;
+        entregues = entregues + 1u;
+        estatisticas.acertos_setores++;
+    }
+
+    if (entregues < quantidade) {
+        uint32_t restantes = quantidade - entregues;
+        bool leu = cache.lerSetores(destino + (entregues * TAMANHO_SETOR_BYTES), setor_inicial + entregues, restantes);
+        descartarAnel();
+        if (!leu) {
+            return false;
+        }
+        estatisticas.falhas_setores += restantes;
+    }
+
+    proximoSetorEsperado = setorSeguinte(setor_inicial + quantidade - 1u);
+    if (quantidadeValida == 0u) {
+        proximoSetorAntecipar = proximoSetorEsperado;
+    }
+
+    // Uma falha ao reabastecer nao invalida os dados ja entregues
+    reabastecer();
+    return true;
+}
+
+void LeituraAntecipada::invalidarIntervalo(uint32_t setor_inicial, uint32_t quantidade) {
+    uint32_t fim_intervalo = setor_inicial + quantidade;
+    for (uint32_t indice = 0u; indice < quantidadeValida; ++indice) {
+        uint32_t setor = setoresAnel[(indiceLeitura + indice) % CAPACIDADE_SETORES];
+        if (setor >= setor_inicial && setor < fim_intervalo) {
+            descartarAnel();
+            return;
+        }
+    }
+}
+
+void LeituraAntecipada::invalidar() {
+    quantidadeValida = 0u;
+    indiceLeitura = 0u;
+    sistema = nullptr;
+    clusterInicialArquivo = 0u;
+    tamanhoArquivo = 0u;
+    estadoCadeia = 0u;
+    lendoArquivo = false;
+    proximoSetorAntecipar = FIM_DA_CADEIA;
+    proximoSetorEsperado = FIM_DA_CADEIA;
+    leiturasSequenciais = 0u;
+}
+
+bool LeituraAntecipada::reabastecer() {
+    if (profundidade == 0u || sistema == nullptr || !sequenciaAtiva()) {
+        return true;
+    }
+    // So completa o anel quando ele cai abaixo da metade: cada reabastecimento le pelo menos
+    // meia profundidade e ainda sobram setores para o consumidor enquanto ele acontece
+    if (quantidadeValida * 2u >= profundidade) {
+        return true;
+    }
+
+    uint32_t inicio_dados = static_cast<uint32_t>(sistema->database);
+    uint32_t setores_cluster = sistema->csize;
+
+    while (quantidadeValida < profundidade && proximoSetorAntecipar != FIM_DA_CADEIA) {
+        uint32_t primeiro = proximoSetorAntecipar;
+        if (totalSetores != 0u && primeiro >= totalSetores) {
+            proximoSetorAntecipar = FIM_DA_CADEIA;
+            return true;
+        }
+
+        uint32_t indice_escrita = (indiceLeitura + quantidadeValida) % CAPACIDADE_SETORES;
+        uint32_t limite = menor(profundidade - quantidadeValida, CAPACIDADE_SETORES - indice_escrita);
+        if (totalSetores != 0u) {
+            limite = menor(limite, totalSetores - primeiro);
+        }
+
+        // Segue a cadeia do arquivo; clusters vizinhos na cadeia viram uma so leitura de varios blocos
+        uint32_t quantidade = 0u;
+        uint32_t seguinte = primeiro;
+        while (quantidade < limite && seguinte == primeiro + quantidade) {
+            uint32_t ate_fim_cluster = setores_cluster - ((seguinte - inicio_dados) % setores_cluster);
+            quantidade = quantidade + menor(limite - quantidade, ate_fim_cluster);
+            seguinte = setorSeguinte(primeiro + quantidade - 1u);
+        }
+
+        // Sem alocar linhas: a leitura que sobra na volta do anel pode ter um setor so, e dados
+        // de um arquivo tocado em sequencia expulsariam FAT e diretorios do cache
+        if (!cache.lerSemAlocar(anelSetores[indice_escrita], primeiro, quantidade)) {
+            return false;
+        }
+
+        for (uint32_t indice = 0u; indice < quantidade; ++indice) {
+            setoresAnel[indice_escrita + indice] = primeiro + indice;
+        }
+        quantidadeValida = quantidadeValida + quantidade;
+        proximoSetorAntecipar = seguinte;
+        estatisticas.setores_antecipados += quantidade;
+    }
+
+    return true;
+}
+
+bool LeituraAntecipada::sequenciaAtiva() const {
+    return leiturasSequenciais >= LIMIAR_SEQUENCIA;
+}
+
+void LeituraAntecipada::obterEstatisticas(EstatisticasLeituraAntecipada &destino) const {
+    destino = estatisticas;
+}
+
+void LeituraAntecipada::zerarEstatisticas() {
+    memset(&estatisticas, 0, sizeof(estatisticas));
+}
+
+// Setor do arquivo depois de setor: o vizinho dentro do cluster ou o primeiro do proximo cluster
+uint32_t LeituraAntecipada::setorSeguinte(uint32_t setor) {
+    uint32_t inicio_dados = static_cast<uint32_t>(sistema->database);
+    uint32_t setores_cluster = sistema->csize;
+    uint32_t relativo = setor - inicio_dados;
+    if (((relativo + 1u) % setores_cluster) != 0u) {
+        return setor + 1u;
+    }
+
+    DWORD seguinte = clusterSeguinte(static_cast<DWORD>(relativo / setores_cluster) + 2u);
+    if (seguinte == FIM_DA_CADEIA) {
+        return FIM_DA_CADEIA;
+    }
+    return inicio_dados + (static_cast<uint32_t>(seguinte) - 2u) * setores_cluster;
+}
+
+DWORD LeituraAntecipada::clusterSeguinte(DWORD cluster) {
+    if (sistema->fs_type == FS_EXFAT && estadoCadeia == CADEIA_CONTIGUA) {
+        DWORD bytes_cluster = static_cast<DWORD>(sistema->csize) * TAMANHO_SETOR_BYTES;
+        DWORD clusters = static_cast<DWORD>((tamanhoArquivo + bytes_cluster - 1u) / bytes_cluster);
+        return (cluster + 1u < clusterInicialArquivo + clusters) ? cluster + 1u : FIM_DA_CADEIA;
+    }
+    if (sistema->fs_type == FS_EXFAT && estadoCadeia == CADEIA_SO_NO_ARQUIVO) {
+        return FIM_DA_CADEIA;
+    }
+
+    uint8_t entrada[4] = {0u, 0u, 0u, 0u};
+    DWORD valor = 0u;
+
+    switch (sistema->fs_type) {
+        case FS_FAT12: {
+            if (!lerBytesFat(cluster + (cluster / 2u), entrada, 2u)) {
+                return FIM_DA_CADEIA;
+            }
+            DWORD par = static_cast<DWORD>(entrada[0]) | (static_cast<DWORD>(entrada[1]) << 8u);
+            valor = ((cluster & 1u) != 0u) ? (par >> 4u) : (par & 0x0FFFu);
+            break;
+        }
+        case FS_FAT16: {
+            if (!lerBytesFat(cluster * 2u, entrada, 2u)) {
+                return FIM_DA_CADEIA;
+            }
+            valor = static_cast<DWORD>(entrada[0]) | (static_cast<DWORD>(entrada[1]) << 8u);
+            break;
+        }
+        case FS_FAT32:
+        case FS_EXFAT: {
+            if (!lerBytesFat(cluster * 4u, entrada, 4u)) {
+                return FIM_DA_CADEIA;
+            }
+            valor = static_cast<DWORD>(entrada[0]) | (static_cast<DWORD>(entrada[1]) << 8u) |
+                    (static_cast<DWORD>(entrada[2]) << 16u) | (static_cast<DWORD>(entrada[3]) << 24u);
+            // exFAT usa os 32 bits; no FAT32 os 4 de cima sao reservados
+            if (sistema->fs_type == FS_FAT32) {
+                valor = valor & MASCARA_ENTRADA_FAT32;
+            }
+            break;
+        }
+        default:
+            return FIM_DA_CADEIA;
+    }
+
+    // Fim de cadeia, cluster livre ou defeituoso: nada mais a antecipar
+    if (valor < 2u || valor >= sistema->n_fatent) {
+        return FIM_DA_CADEIA;
+    }
+    return valor;
+}
+
+// Bytes da primeira FAT pelo cache (a regiao FAT fica nas linhas dele); uma janela do FatFs ainda
+// nao gravada tem precedencia sobre o setor no cartao
+bool LeituraAntecipada::lerBytesFat(uint32_t deslocamento, uint8_t *destino, uint32_t quantidade) {
+    while (quantidade > 0u) {
+        uint32_t setor = static_cast<uint32_t>(sistema->fatbase) + (deslocamento / TAMANHO_SETOR_BYTES);
+        uint32_t dentro = deslocamento % TAMANHO_SETOR_BYTES;
+        uint32_t parte = menor(quantidade, static_cast<uint32_t>(TAMANHO_SETOR_BYTES) - dentro);
+
+        const uint8_t *origem = setorFat;
+        if (sistema->wflag != 0u && sistema->winsect == setor) {
+            origem = sistema->win;
+        } else if (!cache.lerSetores(setorFat, setor, 1u)) {
+            return false;
+        }
+
+        memcpy(destino, origem + dentro, parte);
+        destino = destino + parte;
+        deslocamento = deslocamento + parte;
+        quantidade = quantidade - parte;
+    }
+    return true;
+}
+
+void LeituraAntecipada::descartarAnel() {
+    estatisticas.setores_descartados += quantidadeValida;
+    quantidadeValida = 0u;
+    indiceLeitura = 0u;
+    proximoSetorAntecipar = proximoSetorEsperado;
+}
+
+} // namespace cartao_sd
@@ -0,0 +1,78 @@
+#ifndef LEITURAANTECIPADA_H
+#define LEITURAANTECIPADA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "CacheSetores.h"
+#include "ff.h"
+
+// Capacidade do anel de setores antecipados (padrao 32 x 512 bytes = 16 KB)
+#ifndef CARTAO_SD_LEITURA_ANTECIPADA_SETORES
+#define CARTAO_SD_LEITURA_ANTECIPADA_SETORES 32u
+#endif
+
+namespace cartao_sd {
+
+struct EstatisticasLeituraAntecipada {
+    uint32_t acertos_setores;
+    uint32_t falhas_setores;
+    uint32_t setores_antecipados;
+    uint32_t setores_descartados;
+};
+
+// Acompanha a leitura de um arquivo por vez. Entre iniciarLeituraArquivo e encerrarLeituraArquivo
+// as leituras da area de dados sao desse arquivo; depois de duas leituras seguidas, os proximos
+// setores sao buscados pela cadeia de clusters (FAT, ou cluster seguinte num arquivo exFAT contiguo),
+// nunca o setor fisico seguinte de outro arquivo, e guardados em um anel estatico.
+// Leituras da regiao FAT e de diretorios fora de um arquivo nao interrompem a sequencia.
+// O reabastecimento e sincrono: roda dentro do disk_read (ou de reabastecer()) e segura quem chamou
+// ate a leitura de varios blocos terminar. Chamar reabastecer() fora do caminho critico evita que
+// essa espera caia sobre a leitura seguinte do arquivo.
+class LeituraAntecipada {
+public:
+    explicit LeituraAntecipada(CacheSetores &cache_setores);
+
+    // Falso, e antecipacao desligada, quando a profundidade pedida nao cabe no anel
+    bool configurar(uint32_t profundidade_setores, uint32_t total_setores);
+    void iniciarLeituraArquivo(const FIL &arquivo);
+    void encerrarLeituraArquivo();
+    bool lerSetores(uint8_t *destino, uint32_t setor_inicial, uint32_t quantidade);
+    void invalidarIntervalo(uint32_t setor_inicial, uint32_t quantidade);
+    void invalidar();
+    bool reabastecer();
+    bool sequenciaAtiva() const;
+    void obterEstatisticas(EstatisticasLeituraAntecipada &destino) const;
+    void zerarEstatisticas();
+
+    static constexpr uint32_t CAPACIDADE_SETORES = CARTAO_SD_LEITURA_ANTECIPADA_SETORES;
+
+private:
+    static constexpr uint32_t LIMIAR_SEQUENCIA = 2u;
+    static constexpr uint32_t FIM_DA_CADEIA = 0u;
+
+    CacheSetores &cache;
+    uint32_t profundidade;
+    uint32_t totalSetores;
+    const FATFS *sistema;
+    DWORD clusterInicialArquivo;
+    FSIZE_t tamanhoArquivo;
+    BYTE estadoCadeia;
+    bool lendoArquivo;
+    uint32_t setoresAnel[CAPACIDADE_SETORES];
+    uint32_t indiceLeitura;
+    uint32_t quantidadeValida;
+    uint32_t proximoSetorAntecipar;
+    uint32_t proximoSetorEsperado;
+    uint32_t leiturasSequenciais;
+    EstatisticasLeituraAntecipada estatisticas;
+
+    uint32_t setorSeguinte(uint32_t setor);
+    DWORD clusterSeguinte(DWORD cluster);
+    bool lerBytesFat(uint32_t deslocamento, uint8_t *destino, uint32_t quantidade);
+    void descartarAnel();
+};
+
+} // namespace cartao_sd
+
+#endif
@@ -0,0 +1,1400 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "CartaoSD.h"
+#include "EmuladorCartaoSd.h"
+#include "Instrumentacao.h"
+#include "LeitorWav.h"
+#include "pico/stdlib.h"
+
+// Regressao da CartaoSD no host: a pilha inteira (ControladorSpiCartao, DriverCartaoSd, cache,
+// leitura antecipada, FatFs e ArquivoSd) roda sobre o EmuladorCartaoSd, byte a byte no SPI virtual.
+// Cada caso usa a propria imagem no diretorio de build; sem argumentos todos os casos rodam.
+
+#define SPI_CARTAO spi0
+#define PINO_SPI_MISO_CARTAO 16u
+#define PINO_SPI_MOSI_CARTAO 19u
+#define PINO_SPI_SCK_CARTAO 18u
+#define PINO_SPI_CS_CARTAO 17u
+
+#define VERIFICAR(condicao)                                                         \
+    do {                                                                            \
+        if (!(condicao)) {                                                          \
+            printf("%s:%d: falhou: %s\n", __FILE__, __LINE__, #condicao);           \
+            return false;                                                           \
+        }                                                                           \
+    } while (0)
+
+namespace {
+
+using cartao_sd::ConfiguracaoEmuladorSd;
+using cartao_sd::EmuladorCartaoSd;
+using cartao_sd::EstatisticasEmuladorSd;
+
+constexpr uint32_t TAMANHO_SETOR = 512u;
+constexpr uint32_t FREQUENCIA_TESTE_BAIXA = 400000u;
+constexpr uint32_t FREQUENCIA_TESTE_ALTA = 12500000u;
+
+uint8_t padraoByte(uint32_t posicao, uint32_t semente) {
+    uint32_t valor = (posicao + semente) * 2654435761u;
+    return static_cast<uint8_t>(valor >> 24u);
+}
+
+void preencherPadrao(uint8_t *destino, size_t tamanho, uint32_t inicio, uint32_t semente) {
+    for (size_t indice = 0; indice < tamanho; ++indice) {
+        destino[indice] = padraoByte(static_cast<uint32_t>(inicio + indice), semente);
+    }
+}
+
+bool conferirPadrao(const uint8_t *dados, size_t tamanho, uint32_t inicio, uint32_t semente) {
+    for (size_t indice = 0; indice < tamanho; ++indice) {
+        if (dados[indice] != padraoByte(static_cast<uint32_t>(inicio + indice), semente)) {
+            printf("byte %lu difere\n", static_cast<unsigned long>(inicio + indice));
+            return false;
+        }
+    }
+    return true;
+}
+
+// Caminho da imagem no diretorio de build (CARTAO_SD_DIRETORIO_IMAGENS), nunca no diretorio atual
+const char *prepararImagem(char *destino, size_t capacidade, const char *nome) {
+    snprintf(destino, capacidade, "%s/%s", CARTAO_SD_DIRETORIO_IMAGENS, nome);
+    remove(destino);
+    return destino;
+}
+
+// Imagem nova, conectada ao SPI0
+struct CartaoEmulado {
+    char caminho[512];
+    EmuladorCartaoSd emulador;
+
+    CartaoEmulado(const char *nome, const ConfiguracaoEmuladorSd &configuracao)
+        : emulador(prepararImagem(caminho, sizeof(caminho), nome), configuracao) {
+        cartao_sd::conectarDispositivoSpiHost(SPI_CARTAO, PINO_SPI_CS_CARTAO, &emulador);
+    }
+
+    ~CartaoEmulado() {
+        cartao_sd::conectarDispositivoSpiHost(SPI_CARTAO, PINO_SPI_CS_CARTAO, nullptr);
+    }
+};
+
+bool formatarEMontar(CartaoSD &cartao) {
+    static uint8_t area_formatacao[4096];
+    ParametrosFormatacaoFat parametros = {FM_ANY, 0u, 0u, 0u, 0u};
+    if (!cartao.formatar("0:", parametros, area_formatacao, sizeof(area_formatacao))) {
+        printf("formatar: %d\n", cartao.resultadoOperacao());
+        return false;
+    }
+    return cartao.montarSistemaArquivos();
+}
+
+bool gravarArquivoPadrao(CartaoSD &cartao, const char *caminho, uint32_t tamanho, size_t bloco, uint32_t semente) {
+    static uint8_t buffer[8192];
+    ArquivoSd arquivo = cartao.abrir(caminho, MODO_ESCRITA);
+    VERIFICAR(arquivo.estaAberto());
+
+    uint32_t gravados = 0u;
+    while (gravados < tamanho) {
+        size_t parte = bloco;
+        if (parte > sizeof(buffer)) {
+            parte = sizeof(buffer);
+        }
+        if (parte > tamanho - gravados) {
+            parte = tamanho - gravados;
+        }
+        preencherPadrao(buffer, parte, gravados, semente);
+        VERIFICAR(arquivo.escreverBytes(buffer, parte) == parte);
+        gravados += static_cast<uint32_t>(parte);
+    }
+
+    VERIFICAR(arquivo.fechar());
+    return true;
+}
+
+bool lerArquivoPadrao(CartaoSD &cartao, const char *caminho, uint32_t tamanho, size_t bloco, uint32_t semente) {
+    static uint8_t buffer[8192];
+    ArquivoSd arquivo = cartao.abrir(caminho, MODO_LEITURA);
+    VERIFICAR(arquivo.estaAberto());
+    VERIFICAR(arquivo.tamanho() == static_cast<long>(tamanho));
+
+    uint32_t lidos = 0u;
+    while (lidos < tamanho) {
+        size_t parte = (bloco > sizeof(buffer)) ? sizeof(buffer) : bloco;
+        size_t recebidos = arquivo.lerBytes(buffer, parte);
+        VERIFICAR(recebidos > 0u);
+        VERIFICAR(conferirPadrao(buffer, recebidos, lidos, semente));
+        lidos += static_cast<uint32_t>(recebidos);
+    }
+
+    VERIFICAR(lidos == tamanho);
+    VERIFICAR(arquivo.lerBytes(buffer, 1u) == 0u);
+    arquivo.fechar();
+    return true;
+}
+
+bool iniciarDriver(cartao_sd::DriverCartaoSd &driver, EmuladorCartaoSd &emulador) {
+    VERIFICAR(driver.iniciar());
+    VERIFICAR(driver.obterQuantidadeSetores() == emulador.quantidadeSetores());
+    return true;
+}
+
+// CMD17/18/24/25 sobre setores crus, com enderecamento de bloco (SDHC) e de byte (SDSC)
+bool testeSetoresCrus() {
+    for (bool alta_capacidade : {true, false}) {
+        ConfiguracaoEmuladorSd configuracao = cartao_sd::configuracaoPadraoEmuladorSd();
+        configuracao.alta_capacidade = alta_capacidade;
+        configuracao.setores = 65536u;
+        CartaoEmulado cartao("setores_crus.img", configuracao);
+        VERIFICAR(cartao.emulador.imagemAberta());
+
+        cartao_sd::ControladorSpiCartao controlador(SPI_CARTAO, PINO_SPI_MISO_CARTAO, PINO_SPI_MOSI_CARTAO,
+                                                    PINO_SPI_SCK_CARTAO, PINO_SPI_CS_CARTAO,
+                                                    FREQUENCIA_TESTE_BAIXA, FREQUENCIA_TESTE_ALTA);
+        cartao_sd::DriverCartaoSd driver(controlador);
+        if (!iniciarDriver(driver, cartao.emulador)) {
+            return false;
+        }
+
+        static uint8_t escrita[8 * TAMANHO_SETOR];
+        static uint8_t leitura[8 * TAMANHO_SETOR];
+        preencherPadrao(escrita, sizeof(escrita), 0u, alta_capacidade ? 1u : 2u);
+        cartao.emulador.zerarEstatisticas();
+
+        VERIFICAR(driver.escreverSetores(escrita, 1000u, 8u));
+        VERIFICAR(driver.escreverSetores(escrita, 2000u, 1u));
+        VERIFICAR(driver.lerSetores(leitura, 1000u, 8u));
+        VERIFICAR(memcmp(escrita, leitura, sizeof(escrita)) == 0);
+        VERIFICAR(driver.lerSetores(leitura, 2000u, 1u));
+        VERIFICAR(memcmp(escrita, leitura, TAMANHO_SETOR) == 0);
+
+        EstatisticasEmuladorSd estatisticas;
+        cartao.emulador.obterEstatisticas(estatisticas);
+        VERIFICAR(estatisticas.escritas_multiplas == 1u);
+        VERIFICAR(estatisticas.pre_apagamentos == 1u);
+        VERIFICAR(estatisticas.escritas_unicas == 1u);
+        VERIFICAR(estatisticas.leituras_multiplas == 1u);
+        VERIFICAR(estatisticas.leituras_unicas == 1u);
+        VERIFICAR(estatisticas.setores_escritos == 9u);
+
+        // A imagem tem exatamente o que passou pelo barramento
+        uint8_t setor[TAMANHO_SETOR];
+        VERIFICAR(cartao.emulador.lerSetorImagem(1007u, setor));
+        VERIFICAR(memcmp(setor, escrita + 7u * TAMANHO_SETOR, TAMANHO_SETOR) == 0);
+
+        // Abaixo do limiar do CMD25 a escrita vai por CMD24, sem ACMD23 nem token de parada
+        cartao.emulador.zerarEstatisticas();
+        VERIFICAR(driver.escreverSetores(escrita, 3000u, 2u));
+        cartao.emulador.obterEstatisticas(estatisticas);
+        VERIFICAR(estatisticas.escritas_unicas == 2u && estatisticas.escritas_multiplas == 0u);
+        VERIFICAR(estatisticas.pre_apagamentos == 0u);
+        VERIFICAR(cartao.emulador.lerSetorImagem(3001u, setor));
+        VERIFICAR(memcmp(setor, escrita + TAMANHO_SETOR, TAMANHO_SETOR) == 0);
+    }
+    return true;
+}
+
+// Leituras e escritas alem do fim do cartao falham sem travar o barramento
+bool testeForaDaFaixa() {
+    ConfiguracaoEmuladorSd configuracao = cartao_sd::configuracaoPadraoEmuladorSd();
+    configuracao.setores = 2048u;
+    CartaoEmulado cartao("fora_da_faixa.img", configuracao);
+
+    cartao_sd::ControladorSpiCartao controlador(SPI_CARTAO, PINO_SPI_MISO_CARTAO, PINO_SPI_MOSI_CARTAO,
+                                                PINO_SPI_SCK_CARTAO, PINO_SPI_CS_CARTAO,
+                                                FREQUENCIA_TESTE_BAIXA, FREQUENCIA_TESTE_ALTA);
+    cartao_sd::DriverCartaoSd driver(controlador);
+    if (!iniciarDriver(driver, cartao.emulador)) {
+        return false;
+    }
+
+    static uint8_t buffer[4 * TAMANHO_SETOR];
+    VERIFICAR(!driver.lerSetores(buffer, 2048u, 1u));
+    VERIFICAR(!driver.lerSetores(buffer, 2046u, 4u));
+    VERIFICAR(!driver.escreverSetores(buffer, 2048u, 1u));
+    VERIFICAR(driver.lerSetores(buffer, 2044u, 4u));
+    return true;
+}
+
+// Latencia e busy configurados aparecem no relogio virtual; busy acima do timeout do driver falha
+bool testeTempos() {
+    ConfiguracaoEmuladorSd configuracao = cartao_sd::configuracaoPadraoEmuladorSd();
+    CartaoEmulado cartao("tempos.img", configuracao);
+
+    cartao_sd::ControladorSpiCartao controlador(SPI_CARTAO, PINO_SPI_MISO_CARTAO, PINO_SPI_MOSI_CARTAO,
+                                                PINO_SPI_SCK_CARTAO, PINO_SPI_CS_CARTAO,
+                                                FREQUENCIA_TESTE_BAIXA, FREQUENCIA_TESTE_ALTA);
+    cartao_sd::DriverCartaoSd driver(controlador);
+    if (!iniciarDriver(driver, cartao.emulador)) {
+        return false;
+    }
+
+    static uint8_t buffer[TAMANHO_SETOR];
+
+    // 515 bytes de dados a 12,5 MHz levam 330 us; o resto e latencia
+    cartao.emulador.configuracao().latencia_leitura_us = 0u;
+    uint64_t inicio = time_us_64();
+    VERIFICAR(driver.lerSetores(buffer, 10u, 1u));
+    uint64_t sem_latencia = time_us_64() - inicio;
+
+    cartao.emulador.configuracao().latencia_leitura_us = 2000u;
+    inicio = time_us_64();
+    VERIFICAR(driver.lerSetores(buffer, 10u, 1u));
+    uint64_t com_latencia = time_us_64() - inicio;
+    VERIFICAR(sem_latencia >= 330u && sem_latencia < 400u);
+    VERIFICAR(com_latencia >= sem_latencia + 2000u && com_latencia < sem_latencia + 2010u);
+
+    cartao.emulador.configuracao().ocupado_escrita_us = 3000u;
+    inicio = time_us_64();
+    VERIFICAR(driver.escreverSetores(buffer, 10u, 1u));
+    VERIFICAR(time_us_64() - inicio >= 3000u);
+
+    // O busy do CMD12 fica para o comando seguinte, que so sai depois dele
+    static uint8_t multiplos[4 * TAMANHO_SETOR];
+    cartao.emulador.configuracao().latencia_leitura_us = 0u;
+    cartao.emulador.configuracao().ocupado_parada_leitura_us = 3000u;
+    inicio = time_us_64();
+    VERIFICAR(driver.lerSetores(multiplos, 20u, 4u));
+    uint64_t leitura_multipla = time_us_64() - inicio;
+    VERIFICAR(leitura_multipla < 3000u);
+    VERIFICAR(driver.lerSetores(buffer, 10u, 1u));
+    VERIFICAR(time_us_64() - inicio >= 3000u + sem_latencia);
+
+    // Abaixo do limiar do driver cada setor e um CMD17, sem CMD12
+    EstatisticasEmuladorSd estatisticas;
+    cartao.emulador.zerarEstatisticas();
+    VERIFICAR(driver.lerSetores(multiplos, 20u, 2u));
+    cartao.emulador.obterEstatisticas(estatisticas);
+    VERIFICAR(estatisticas.leituras_unicas == 2u && estatisticas.leituras_multiplas == 0u);
+
+    // O driver desiste do busy depois de 500 ms
+    cartao.emulador.configuracao().ocupado_escrita_us = 800000u;
+    VERIFICAR(!driver.escreverSetores(buffer, 11u, 1u));
+    return true;
+}
+
+// A fase de dados de cada setor e uma unica partida de DMA, nao 512 chamadas de byte no SPI
+bool testeTransferenciasSetor() {
+    ConfiguracaoEmuladorSd configuracao = cartao_sd::configuracaoPadraoEmuladorSd();
+    configuracao.latencia_leitura_us = 0u;
+    CartaoEmulado cartao("transferencias_setor.img", configuracao);
+
+    cartao_sd::ControladorSpiCartao controlador(SPI_CARTAO, PINO_SPI_MISO_CARTAO, PINO_SPI_MOSI_CARTAO,
+                                                PINO_SPI_SCK_CARTAO, PINO_SPI_CS_CARTAO,
+                                                FREQUENCIA_TESTE_BAIXA, FREQUENCIA_TESTE_ALTA);
+    cartao_sd::DriverCartaoSd driver(controlador);
+    if (!iniciarDriver(driver, cartao.emulador)) {
+        return false;
+    }
+    VERIFICAR(controlador.dmaDisponivel());
+
+    static uint8_t escrita[4 * TAMANHO_SETOR];
+    static uint8_t leitura[4 * TAMANHO_SETOR];
+    preencherPadrao(escrita, sizeof(escrita), 0u, 3u);
+    for (uint32_t indice = 0; indice < 4u; ++indice) {
+        VERIFICAR(cartao.emulador.escreverSetorImagem(300u + indice, escrita + indice * TAMANHO_SETOR));
+    }
+
+    // CMD17: comando, R1, token e CRC byte a byte; os 512 bytes de dados em uma transferencia
+    cartao_sd::EstatisticasBarramentoSpiHost barramento;
+    cartao_sd::zerarEstatisticasBarramentoSpiHost();
+    VERIFICAR(driver.lerSetores(leitura, 300u, 1u));
+    cartao_sd::obterEstatisticasBarramentoSpiHost(barramento);
+    VERIFICAR(memcmp(leitura, escrita, TAMANHO_SETOR) == 0);
+    VERIFICAR(barramento.partidas_dma == 1u);
+    VERIFICAR(barramento.bytes_dma == TAMANHO_SETOR);
+    VERIFICAR(barramento.chamadas_bloqueantes < 32u);
+
+    // CMD18: uma partida por bloco
+    cartao_sd::zerarEstatisticasBarramentoSpiHost();
+    VERIFICAR(driver.lerSetores(leitura, 300u, 4u));
+    cartao_sd::obterEstatisticasBarramentoSpiHost(barramento);
+    VERIFICAR(memcmp(leitura, escrita, sizeof(escrita)) == 0);
+    VERIFICAR(barramento.partidas_dma == 4u);
+    VERIFICAR(barramento.bytes_dma == 4u * TAMANHO_SETOR);
+
+    // CMD24: o bloco gravado tambem sai por DMA
+    cartao_sd::zerarEstatisticasBarramentoSpiHost();
+    VERIFICAR(driver.escreverSetores(escrita, 400u, 1u));
+    cartao_sd::obterEstatisticasBarramentoSpiHost(barramento);
+    VERIFICAR(barramento.partidas_dma == 1u);
+    VERIFICAR(barramento.bytes_dma == TAMANHO_SETOR);
+
+    uint8_t setor[TAMANHO_SETOR];
+    VERIFICAR(cartao.emulador.lerSetorImagem(400u, setor));
+    VERIFICAR(memcmp(setor, escrita, TAMANHO_SETOR) == 0);
+    return true;
+}
+
+// Arquivo grande gravado e lido em pedacos desalinhados, busca e remontagem
+bool testeArquivos() {
+    CartaoEmulado emulado("arquivos.img", cartao_sd::configuracaoPadraoEmuladorSd());
+    CartaoSD cartao(SPI_CARTAO, PINO_SPI_MISO_CARTAO, PINO_SPI_MOSI_CARTAO, PINO_SPI_SCK_CARTAO, PINO_SPI_CS_CARTAO);
+    VERIFICAR(formatarEMontar(cartao));
+
+    constexpr uint32_t TAMANHO = 300000u;
+    VERIFICAR(gravarArquivoPadrao(cartao, "/dados.bin", TAMANHO, 1000u, 7u));
+    VERIFICAR(lerArquivoPadrao(cartao, "/dados.bin", TAMANHO, 4096u, 7u));
+    VERIFICAR(lerArquivoPadrao(cartao, "/dados.bin", TAMANHO, 333u, 7u));
+
+    ArquivoSd arquivo = cartao.abrir("/dados.bin", MODO_LEITURA);
+    VERIFICAR(arquivo.estaAberto());
+    uint8_t trecho[700];
+    VERIFICAR(arquivo.buscar(123457));
+    VERIFICAR(arquivo.lerBytes(trecho, sizeof(trecho)) == sizeof(trecho));
+    VERIFICAR(conferirPadrao(trecho, sizeof(trecho), 123457u, 7u));
+    VERIFICAR(arquivo.buscar(TAMANHO - 10));
+    VERIFICAR(arquivo.lerBytes(trecho, sizeof(trecho)) == 10u);
+    arquivo.fechar();
+
+    // O que ficou no cache com escrita postergada chega a imagem na desmontagem
+    VERIFICAR(cartao.desmontarSistemaArquivos());
+    VERIFICAR(cartao.montarSistemaArquivos());
+    VERIFICAR(lerArquivoPadrao(cartao, "/dados.bin", TAMANHO, 8192u, 7u));
+
+    EstatisticaEspacoLivreFat espaco;
+    VERIFICAR(cartao.obterEspacoLivre("0:", espaco));
+    VERIFICAR(espaco.clusters_livres < espaco.clusters_totais);
+    return true;
+}
+
+// Criacao, enumeracao e remocao recursiva de diretorios
+bool testeDiretorios() {
+    CartaoEmulado emulado("diretorios.img", cartao_sd::configuracaoPadraoEmuladorSd());
+    CartaoSD cartao(SPI_CARTAO, PINO_SPI_MISO_CARTAO, PINO_SPI_MOSI_CARTAO, PINO_SPI_SCK_CARTAO, PINO_SPI_CS_CARTAO);
+    VERIFICAR(formatarEMontar(cartao));
+
+    VERIFICAR(cartao.criarDiretorio("/musicas"));
+    VERIFICAR(cartao.criarDiretorio("/musicas/album"));
+    constexpr uint32_t QUANTIDADE_ARQUIVOS = 40u;
+    for (uint32_t indice = 0; indice < QUANTIDADE_ARQUIVOS; ++indice) {
+        char caminho[64];
+        snprintf(caminho, sizeof(caminho), "/musicas/album/faixa com nome longo %02lu.wav", static_cast<unsigned long>(indice));
+        VERIFICAR(gravarArquivoPadrao(cartao, caminho, 600u + indice, 512u, indice));
+    }
+
+    ArquivoSd diretorio = cartao.abrir("/musicas/album", MODO_DIRETORIO);
+    VERIFICAR(diretorio.estaAberto());
+    VERIFICAR(diretorio.eDiretorio());
+    uint32_t encontrados = 0u;
+    while (true) {
+        ArquivoSd entrada = diretorio.abrirProximaEntrada();
+        if (!entrada.estaAberto()) {
+            break;
+        }
+        VERIFICAR(!entrada.eDiretorio());
+        encontrados++;
+    }
+    VERIFICAR(encontrados == QUANTIDADE_ARQUIVOS);
+    diretorio.fechar();
+
+    VERIFICAR(lerArquivoPadrao(cartao, "/musicas/album/faixa com nome longo 17.wav", 617u, 100u, 17u));
+    VERIFICAR(cartao.removerDiretorioRecursivo("/musicas"));
+    VERIFICAR(!cartao.existeCaminho("/musicas"));
+    return true;
+}
+
+uint16_t lerLe16(const uint8_t *origem) {
+    return static_cast<uint16_t>(origem[0] | (origem[1] << 8));
+}
+
+// Inicio da FAT e da area de dados de um volume FAT12/16, lidos da imagem (com ou sem MBR)
+bool localizarRegioesFat(EmuladorCartaoSd &emulador, uint32_t &inicio_fat, uint32_t &inicio_dados) {
+    uint8_t setor[TAMANHO_SETOR];
+    VERIFICAR(emulador.lerSetorImagem(0u, setor));
+    uint32_t volume = 0u;
+    if (setor[0] != 0xEBu && setor[0] != 0xE9u) {
+        volume = lerLe16(setor + 0x1C6) | (static_cast<uint32_t>(lerLe16(setor + 0x1C8)) << 16u);
+        VERIFICAR(emulador.lerSetorImagem(volume, setor));
+    }
+    VERIFICAR(lerLe16(setor + 11) == TAMANHO_SETOR);
+    VERIFICAR(lerLe16(setor + 22) != 0u); // BPB_FATSz16: FAT32 guarda a raiz em um cluster
+
+    uint32_t tamanho_fat = lerLe16(setor + 22);
+    uint32_t setores_raiz = (lerLe16(setor + 17) * 32u + TAMANHO_SETOR - 1u) / TAMANHO_SETOR;
+    inicio_fat = volume + lerLe16(setor + 14);
+    inicio_dados = inicio_fat + setor[16] * tamanho_fat + setores_raiz;
+    return true;
+}
+
+// Cache de setores: acertos e falhas, LRU dentro do conjunto, FAT postergada ate o CTRL_SYNC,
+// dados gravados direto e linhas sujas sobrepostas as leituras de varios setores
+bool testeCacheSetores() {
+    ConfiguracaoEmuladorSd configuracao = cartao_sd::configuracaoPadraoEmuladorSd();
+    configuracao.setores = 32768u;
+    CartaoEmulado emulado("cache_setores.img", configuracao);
+
+    {
+        cartao_sd::ControladorSpiCartao controlador(SPI_CARTAO, PINO_SPI_MISO_CARTAO, PINO_SPI_MOSI_CARTAO,
+                                                    PINO_SPI_SCK_CARTAO, PINO_SPI_CS_CARTAO,
+                                                    FREQUENCIA_TESTE_BAIXA, FREQUENCIA_TESTE_ALTA);
+        cartao_sd::DriverCartaoSd driver(controlador);
+        if (!iniciarDriver(driver, emulado.emulador)) {
+            return false;
+        }
+        cartao_sd::CacheSetores cache(driver);
+        cache.definirRegiaoFat(100u, 200u);
+
+        static uint8_t setores[4 * TAMANHO_SETOR];
+        static uint8_t setor[TAMANHO_SETOR];
+        cartao_sd::EstatisticasCacheSetores estatisticas;
+
+        // Um setor a mais que as vias no conjunto 0: sai o menos usado (16, nao o primeiro lido)
+        constexpr uint32_t VIAS = cartao_sd::CacheSetores::QUANTIDADE_VIAS;
+        constexpr uint32_t CONJUNTOS = cartao_sd::CacheSetores::QUANTIDADE_CONJUNTOS;
+        for (uint32_t via = 1u; via <= VIAS; ++via) {
+            VERIFICAR(cache.lerSetores(setor, via * CONJUNTOS, 1u));
+        }
+        VERIFICAR(cache.lerSetores(setor, CONJUNTOS, 1u));
+        VERIFICAR(cache.lerSetores(setor, (VIAS + 1u) * CONJUNTOS, 1u));
+        cache.obterEstatisticas(estatisticas);
+        VERIFICAR(estatisticas.falhas == VIAS + 1u);
+        VERIFICAR(estatisticas.acertos == 1u);
+        VERIFICAR(estatisticas.despejos == 1u);
+
+        EstatisticasEmuladorSd cartao_estatisticas;
+        emulado.emulador.zerarEstatisticas();
+        cache.zerarEstatisticas();
+        for (uint32_t via = 1u; via <= VIAS + 1u; ++via) {
+            if (via != 2u) {
+                VERIFICAR(cache.lerSetores(setor, via * CONJUNTOS, 1u));
+            }
+        }
+        VERIFICAR(cache.lerSetores(setor, 2u * CONJUNTOS, 1u));
+        cache.obterEstatisticas(estatisticas);
+        emulado.emulador.obterEstatisticas(cartao_estatisticas);
+        VERIFICAR(estatisticas.acertos == VIAS);
+        VERIFICAR(estatisticas.falhas == 1u);
+        VERIFICAR(cartao_estatisticas.leituras_unicas == 1u);
+
+        // Setor da FAT fica sujo no cache; setor de dados chega ao cartao na hora
+        uint8_t vazio[TAMANHO_SETOR];
+        VERIFICAR(emulado.emulador.lerSetorImagem(150u, vazio));
+        preencherPadrao(setores, sizeof(setores), 0u, 21u);
+        VERIFICAR(cache.escreverSetores(setores, 150u, 1u));
+        VERIFICAR(cache.escreverSetores(setores + TAMANHO_SETOR, 1000u, 1u));
+        VERIFICAR(emulado.emulador.lerSetorImagem(150u, setor));
+        VERIFICAR(memcmp(setor, vazio, TAMANHO_SETOR) == 0);
+        VERIFICAR(emulado.emulador.lerSetorImagem(1000u, setor));
+        VERIFICAR(memcmp(setor, setores + TAMANHO_SETOR, TAMANHO_SETOR) == 0);
+
+        // CMD18 traz o setor velho do cartao; a linha suja o substitui no destino
+        static uint8_t leitura[4 * TAMANHO_SETOR];
+        VERIFICAR(cache.lerSetores(leitura, 148u, 4u));
+        VERIFICAR(memcmp(leitura + 2u * TAMANHO_SETOR, setores, TAMANHO_SETOR) == 0);
+        VERIFICAR(memcmp(leitura + 3u * TAMANHO_SETOR, vazio, TAMANHO_SETOR) == 0);
+
+        cache.zerarEstatisticas();
+        VERIFICAR(cache.descarregar());
+        cache.obterEstatisticas(estatisticas);
+        VERIFICAR(estatisticas.setores_descarregados == 1u);
+        VERIFICAR(emulado.emulador.lerSetorImagem(150u, setor));
+        VERIFICAR(memcmp(setor, setores, TAMANHO_SETOR) == 0);
+        cache.invalidar();
+    }
+
+    // FAT16 com clusters de 4 setores: 256 entradas por setor da FAT, o arquivo ocupa dois setores dela.
+    // Cada escrita e um cluster inteiro, que o FatFs grava com CMD25 sem alocar linhas do cache.
+    CartaoSD cartao(SPI_CARTAO, PINO_SPI_MISO_CARTAO, PINO_SPI_MOSI_CARTAO, PINO_SPI_SCK_CARTAO, PINO_SPI_CS_CARTAO);
+    static uint8_t area_formatacao[4096];
+    constexpr uint32_t TAMANHO_CLUSTER = 4u * TAMANHO_SETOR;
+    ParametrosFormatacaoFat parametros = {FM_FAT, 0u, 0u, 0u, TAMANHO_CLUSTER};
+    VERIFICAR(cartao.formatar("0:", parametros, area_formatacao, sizeof(area_formatacao)));
+    VERIFICAR(cartao.montarSistemaArquivos());
+    uint32_t inicio_fat = 0u;
+    uint32_t inicio_dados = 0u;
+    if (!localizarRegioesFat(emulado.emulador, inicio_fat, inicio_dados)) {
+        return false;
+    }
+
+    constexpr uint32_t TAMANHO = 300u * TAMANHO_CLUSTER;
+    static uint8_t buffer[TAMANHO_CLUSTER];
+    uint8_t setor_fat[TAMANHO_SETOR];
+    uint8_t setor_dados[TAMANHO_SETOR];
+    cartao_sd::EstatisticasCacheSetores estatisticas;
+    cartao.zerarEstatisticasCache();
+
+    // O FatFs so entrega o primeiro setor da FAT ao disk_write quando a cadeia passa para o segundo
+    ArquivoSd arquivo = cartao.abrir("/cache.bin", MODO_ESCRITA);
+    VERIFICAR(arquivo.estaAberto());
+    for (uint32_t gravados = 0u; gravados < TAMANHO; gravados += TAMANHO_CLUSTER) {
+        preencherPadrao(buffer, TAMANHO_CLUSTER, gravados, 23u);
+        VERIFICAR(arquivo.escreverBytes(buffer, TAMANHO_CLUSTER) == TAMANHO_CLUSTER);
+    }
+    cartao.obterEstatisticasCache(estatisticas);
+    VERIFICAR(estatisticas.escritas_postergadas > 0u);
+    VERIFICAR(estatisticas.setores_descarregados == 0u);
+    VERIFICAR(emulado.emulador.lerSetorImagem(inicio_fat, setor_fat));
+    VERIFICAR(lerLe16(setor_fat + 2u * 2u) == 0u);       // Cluster 2 ainda livre na imagem
+    VERIFICAR(emulado.emulador.lerSetorImagem(inicio_dados, setor_dados));
+    VERIFICAR(conferirPadrao(setor_dados, TAMANHO_SETOR, 0u, 23u));
+
+    // fechar -> f_sync -> CTRL_SYNC descarrega as linhas da FAT
+    VERIFICAR(arquivo.fechar());
+    cartao.obterEstatisticasCache(estatisticas);
+    VERIFICAR(estatisticas.setores_descarregados > 0u);
+    VERIFICAR(emulado.emulador.lerSetorImagem(inicio_fat, setor_fat));
+    VERIFICAR(lerLe16(setor_fat + 2u * 2u) == 3u);
+
+    for (uint32_t indice = 0; indice < 20u; ++indice) {
+        char caminho[48];
+        snprintf(caminho, sizeof(caminho), "/faixa com nome longo %02lu.wav", static_cast<unsigned long>(indice));
+        VERIFICAR(gravarArquivoPadrao(cartao, caminho, 100u, 100u, indice));
+    }
+
+    // Segunda passada de busca e de f_findnext: FAT e diretorio saem todos do cache
+    for (uint32_t passada = 0u; passada < 2u; ++passada) {
+        emulado.emulador.zerarEstatisticas();
+        cartao.zerarEstatisticasCache();
+
+        ArquivoSd leitura = cartao.abrir("/cache.bin", MODO_LEITURA);
+        VERIFICAR(leitura.estaAberto());
+        for (long posicao : {static_cast<long>(TAMANHO - 100u), 700L, static_cast<long>(TAMANHO / 2u)}) {
+            VERIFICAR(leitura.buscar(posicao));
+        }
+        leitura.fechar();
+
+        InformacoesEntradaFat entrada;
+        ContextoBuscaFat busca;
+        uint32_t encontrados = 0u;
+        bool achou = cartao.buscarPrimeiro("/", "*.wav", entrada, busca);
+        while (achou) {
+            encontrados++;
+            achou = cartao.buscarProximo(entrada, busca);
+        }
+        cartao.finalizarBusca(busca);
+        VERIFICAR(encontrados == 20u);
+
+        cartao.obterEstatisticasCache(estatisticas);
+        EstatisticasEmuladorSd cartao_estatisticas;
+        emulado.emulador.obterEstatisticas(cartao_estatisticas);
+        VERIFICAR(estatisticas.acertos > 0u);
+        if (passada == 1u) {
+            VERIFICAR(estatisticas.falhas == 0u);
+            VERIFICAR(cartao_estatisticas.leituras_unicas == 0u);
+        }
+    }
+    return true;
+}
+
+// Leitura sequencial com antecipacao: os dados continuam certos e o anel e de fato usado
+bool testeLeituraAntecipada() {
+    CartaoEmulado emulado("leitura_antecipada.img", cartao_sd::configuracaoPadraoEmuladorSd());
+    CartaoSD cartao(SPI_CARTAO, PINO_SPI_MISO_CARTAO, PINO_SPI_MOSI_CARTAO, PINO_SPI_SCK_CARTAO, PINO_SPI_CS_CARTAO);
+    VERIFICAR(formatarEMontar(cartao));
+
+    constexpr uint32_t TAMANHO = 200000u;
+    VERIFICAR(gravarArquivoPadrao(cartao, "/audio.raw", TAMANHO, 4096u, 3u));
+
+    VERIFICAR(cartao.configurarLeituraAntecipada(2u));
+    cartao.zerarEstatisticasCache();
+    ArquivoSd arquivo = cartao.abrir("/audio.raw", MODO_LEITURA);
+    VERIFICAR(arquivo.estaAberto());
+
+    // Leituras de um setor (menores que o setor, como no laco de reproducao) acionam a antecipacao
+    static uint8_t buffer[256];
+    uint32_t lidos = 0u;
+    while (lidos < TAMANHO) {
+        size_t recebidos = arquivo.lerBytes(buffer, sizeof(buffer));
+        VERIFICAR(recebidos > 0u);
+        VERIFICAR(conferirPadrao(buffer, recebidos, lidos, 3u));
+        lidos += static_cast<uint32_t>(recebidos);
+        cartao.servicoLeituraAntecipada();
+    }
+    arquivo.fechar();
+
+    cartao_sd::EstatisticasLeituraAntecipada antecipacao{};
+    cartao.obterEstatisticasLeituraAntecipada(antecipacao);
+    VERIFICAR(antecipacao.acertos_setores > 0u);
+    VERIFICAR(antecipacao.setores_antecipados > 0u);
+
+    // Os setores antecipados nao ocupam linhas do cache: so FAT e diretorio falham, nada e despejado,
+    // e o anel e completado em leituras de varios setores, nao um setor a cada servico
+    cartao_sd::EstatisticasCacheSetores cache;
+    cartao.obterEstatisticasCache(cache);
+    VERIFICAR(cache.falhas < 8u);
+    VERIFICAR(cache.despejos == 0u);
+    VERIFICAR(cache.leituras_diretas * 4u <= antecipacao.setores_antecipados);
+
+    // Dois arquivos crescendo intercalados, um cluster de cada vez: os clusters de um nao sao
+    // vizinhos no cartao e o anel tem de seguir a cadeia, sem trazer setores do outro arquivo
+    EstatisticaEspacoLivreFat espaco;
+    VERIFICAR(cartao.obterEspacoLivre("0:", espaco));
+    uint32_t bytes_cluster = espaco.setores_por_cluster * espaco.bytes_por_setor;
+    constexpr uint32_t CLUSTERS_TRILHA = 24u;
+    static uint8_t bloco_cluster[32768];
+    VERIFICAR(bytes_cluster <= sizeof(bloco_cluster));
+    for (uint32_t cluster = 0u; cluster < CLUSTERS_TRILHA; ++cluster) {
+        uint32_t gravados = cluster * bytes_cluster;
+        preencherPadrao(bloco_cluster, bytes_cluster, gravados, 4u);
+        for (const char *caminho : {"/trilha.raw", "/vizinho.raw"}) {
+            ArquivoSd trecho = cartao.abrir(caminho, MODO_ACRESCENTAR);
+            VERIFICAR(trecho.estaAberto());
+            VERIFICAR(trecho.escreverBytes(bloco_cluster, bytes_cluster) == bytes_cluster);
+            VERIFICAR(trecho.fechar());
+        }
+    }
+
+    // Reconfigurar esvazia o anel que sobrou do arquivo anterior
+    VERIFICAR(cartao.configurarLeituraAntecipada(2u));
+    cartao_sd::EstatisticasLeituraAntecipada antes{};
+    cartao.obterEstatisticasLeituraAntecipada(antes);
+    ArquivoSd trilha = cartao.abrir("/trilha.raw", MODO_LEITURA);
+    VERIFICAR(trilha.estaAberto());
+    uint32_t tamanho_trilha = CLUSTERS_TRILHA * bytes_cluster;
+    lidos = 0u;
+    while (lidos < tamanho_trilha) {
+        size_t recebidos = trilha.lerBytes(buffer, sizeof(buffer));
+        VERIFICAR(recebidos > 0u);
+        VERIFICAR(conferirPadrao(buffer, recebidos, lidos, 4u));
+        lidos += static_cast<uint32_t>(recebidos);
+        cartao.servicoLeituraAntecipada();
+    }
+    trilha.fechar();
+
+    cartao.obterEstatisticasLeituraAntecipada(antecipacao);
+    uint32_t setores_trilha = tamanho_trilha / TAMANHO_SETOR;
+    VERIFICAR(antecipacao.setores_descartados == antes.setores_descartados);
+    VERIFICAR(antecipacao.setores_antecipados - antes.setores_antecipados <= setores_trilha);
+    VERIFICAR(antecipacao.acertos_setores - antes.acertos_setores + 2u * espaco.setores_por_cluster >= setores_trilha);
+
+    // Profundidade maior que o anel: recusada e relatada, nao reduzida em silencio
+    uint32_t clusters_demais = cartao_sd::LeituraAntecipada::CAPACIDADE_SETORES / espaco.setores_por_cluster + 1u;
+    VERIFICAR(!cartao.configurarLeituraAntecipada(clusters_demais));
+    VERIFICAR(cartao.resultadoOperacao() == FR_NOT_ENOUGH_CORE);
+    VERIFICAR(cartao.configurarLeituraAntecipada(1u));
+    return true;
+}
+
+size_t lerArquivoWav(void *contexto, uint8_t *destino, size_t tamanho) {
+    return static_cast<ArquivoSd *>(contexto)->lerBytes(destino, tamanho);
+}
+
+void escreverLe16(uint8_t *destino, uint16_t valor) {
+    destino[0] = static_cast<uint8_t>(valor & 0xFFu);
+    destino[1] = static_cast<uint8_t>(valor >> 8u);
+}
+
+void escreverLe32(uint8_t *destino, uint32_t valor) {
+    escreverLe16(destino, static_cast<uint16_t>(valor & 0xFFFFu));
+    escreverLe16(destino + 2, static_cast<uint16_t>(valor >> 16u));
+}
+
+// WAV com LIST antes do data e metadados depois, lido pelo LeitorWav direto de um ArquivoSd
+bool testeWav() {
+    CartaoEmulado emulado("wav.img", cartao_sd::configuracaoPadraoEmuladorSd());
+    CartaoSD cartao(SPI_CARTAO, PINO_SPI_MISO_CARTAO, PINO_SPI_MOSI_CARTAO, PINO_SPI_SCK_CARTAO, PINO_SPI_CS_CARTAO);
+    VERIFICAR(formatarEMontar(cartao));
+
+    constexpr uint32_t QUADROS = 5000u;
+    constexpr uint32_t TAMANHO_LIST = 26u;
+    constexpr uint32_t TAMANHO_DADOS = QUADROS * 4u;
+
+    uint8_t cabecalho[12 + 24 + 8 + TAMANHO_LIST + 8];
+    uint8_t *ponteiro = cabecalho;
+    memcpy(ponteiro, "RIFF", 4);
+    escreverLe32(ponteiro + 4, sizeof(cabecalho) - 8u + TAMANHO_DADOS + 12u);
+    memcpy(ponteiro + 8, "WAVE", 4);
+    ponteiro += 12;
+    memcpy(ponteiro, "fmt ", 4);
+    escreverLe32(ponteiro + 4, 16u);
+    escreverLe16(ponteiro + 8, 1u);
+    escreverLe16(ponteiro + 10, 2u);
+    escreverLe32(ponteiro + 12, 44100u);
+    escreverLe32(ponteiro + 16, 44100u * 4u);
+    escreverLe16(ponteiro + 20, 4u);
+    escreverLe16(ponteiro + 22, 16u);
+    ponteiro += 24;
+    memcpy(ponteiro, "LIST", 4);
+    escreverLe32(ponteiro + 4, TAMANHO_LIST);
+    memset(ponteiro + 8, 'x', TAMANHO_LIST);
+    ponteiro += 8 + TAMANHO_LIST;
+    memcpy(ponteiro, "data", 4);
+    escreverLe32(ponteiro + 4, TAMANHO_DADOS);
+
+    ArquivoSd arquivo = cartao.abrir("/teste.wav", MODO_ESCRITA);
+    VERIFICAR(arquivo.estaAberto());
+    VERIFICAR(arquivo.escreverBytes(cabecalho, sizeof(cabecalho)) == sizeof(cabecalho));
+    for (uint32_t quadro = 0; quadro < QUADROS; ++quadro) {
+        uint8_t amostras[4];
+        escreverLe16(amostras, static_cast<uint16_t>(quadro));
+        escreverLe16(amostras + 2, static_cast<uint16_t>(~quadro));
+        VERIFICAR(arquivo.escreverBytes(amostras, sizeof(amostras)) == sizeof(amostras));
+    }
+    uint8_t rodape[12];
+    memcpy(rodape, "id3 ", 4);
+    escreverLe32(rodape + 4, 4u);
+    memset(rodape + 8, 0x7F, 4);
+    VERIFICAR(arquivo.escreverBytes(rodape, sizeof(rodape)) == sizeof(rodape));
+    VERIFICAR(arquivo.fechar());
+
+    arquivo = cartao.abrir("/teste.wav", MODO_LEITURA);
+    VERIFICAR(arquivo.estaAberto());
+    cartao_sd::LeitorWav leitor(lerArquivoWav, nullptr, &arquivo);
+    VERIFICAR(leitor.analisarCabecalho() == cartao_sd::ResultadoWav::OK);
+    VERIFICAR(leitor.estereo16Bits());
+    VERIFICAR(leitor.formato().taxa_amostragem == 44100u);
+    VERIFICAR(leitor.formato().tamanho_dados == TAMANHO_DADOS);
+    VERIFICAR(leitor.formato().inicio_dados == sizeof(cabecalho));
+
+    static uint8_t dados[TAMANHO_DADOS + 64u];
+    size_t total = 0u;
+    while (true) {
+        size_t lidos = leitor.lerDados(dados + total, 1000u);
+        if (lidos == 0u) {
+            break;
+        }
+        total += lidos;
+    }
+    VERIFICAR(total == TAMANHO_DADOS);
+    for (uint32_t quadro = 0; quadro < QUADROS; ++quadro) {
+        uint16_t esquerdo = static_cast<uint16_t>(dados[quadro * 4u] | (dados[quadro * 4u + 1u] << 8u));
+        uint16_t direito = static_cast<uint16_t>(dados[quadro * 4u + 2u] | (dados[quadro * 4u + 3u] << 8u));
+        VERIFICAR(esquerdo == static_cast<uint16_t>(quadro));
+        VERIFICAR(direito == static_cast<uint16_t>(~quadro));
+    }
+    arquivo.fechar();
+    return true;
+}
+
+// Fonte em memoria para o LeitorWav: o corpus nao precisa de cartao nem de imagem
+struct FonteMemoriaWav {
+    const uint8_t *dados;
+    size_t tamanho;
+    size_t posicao;
+};
+
+size_t lerMemoriaWav(void *contexto, uint8_t *destino, size_t tamanho) {
+    FonteMemoriaWav *fonte = static_cast<FonteMemoriaWav *>(contexto);
+    size_t restantes = fonte->tamanho - fonte->posicao;
+    if (tamanho > restantes) {
+        tamanho = restantes;
+    }
+    memcpy(destino, fonte->dados + fonte->posicao, tamanho);
+    fonte->posicao += tamanho;
+    return tamanho;
+}
+
+bool avancarMemoriaWav(void *contexto, uint32_t bytes) {
+    FonteMemoriaWav *fonte = static_cast<FonteMemoriaWav *>(contexto);
+    if (bytes > fonte->tamanho - fonte->posicao) {
+        return false;
+    }
+    fonte->posicao += bytes;
+    return true;
+}
+
+// Variacoes de estrutura do arquivo montado por montarWav
+constexpr uint32_t WAV_LIST_IMPAR = 1u << 0;        // LIST de tamanho impar (com byte de alinhamento) antes do fmt
+constexpr uint32_t WAV_SEM_FMT = 1u << 1;
+constexpr uint32_t WAV_SEM_DATA = 1u << 2;
+constexpr uint32_t WAV_ALINHAMENTO_ERRADO = 1u << 3; // nBlockAlign diferente de canais * bytes por amostra
+constexpr uint32_t WAV_RIFX = 1u << 4;
+constexpr uint32_t WAV_AVI = 1u << 5;
+constexpr uint32_t WAV_TRUNCADO = 1u << 6;          // Termina no meio do cabecalho RIFF
+constexpr uint32_t WAV_LIST_GIGANTE = 1u << 7;      // LIST com tamanho 0xFFFFFFFF antes do fmt
+
+constexpr uint32_t QUADROS_CORPUS = 37u;            // Impar: 8 bits mono deixa o chunk data impar
+constexpr size_t TAMANHO_LIST_IMPAR = 5u;
+
+struct CasoWav {
+    const char *nome;
+    uint16_t formato_audio;                         // wFormatTag
+    uint16_t subformato;                            // Dois primeiros bytes do GUID, so com fmt de 40 bytes
+    uint16_t canais;
+    uint32_t taxa_amostragem;
+    uint16_t bits_por_amostra;
+    uint32_t tamanho_fmt;
+    uint32_t estrutura;
+    cartao_sd::ResultadoWav esperado;
+};
+
+// Amostra de 16 bits de referencia do canal; os canais alem do segundo levam lixo que a conversao descarta
+int16_t amostraCorpus(uint32_t quadro, uint16_t canal) {
+    int32_t base = static_cast<int32_t>(quadro * 1777u) - 30000;
+    if (canal == 0u) {
+        return static_cast<int16_t>(base);
+    }
+    if (canal == 1u) {
+        return static_cast<int16_t>(-base - 1);
+    }
+    return static_cast<int16_t>(0x7A5A);
+}
+
+// Valor de 16 bits que converterQuadrosEstereo16 deve devolver: 8 bits perde o byte baixo
+int16_t amostraCorpusConvertida(uint32_t quadro, uint16_t canal, uint16_t bits) {
+    int16_t amostra = amostraCorpus(quadro, canal);
+    if (bits <= 8u) {
+        return static_cast<int16_t>(static_cast<uint16_t>(amostra) & 0xFF00u);
+    }
+    return amostra;
+}
+
+// 8 bits sem sinal; 24 e 32 bits com a amostra de 16 bits nos bytes mais significativos
+void escreverAmostraCorpus(uint8_t *destino, int16_t amostra, uint16_t bytes_amostra) {
+    uint16_t valor = static_cast<uint16_t>(amostra);
+    if (bytes_amostra == 1u) {
+        destino[0] = static_cast<uint8_t>((valor >> 8u) ^ 0x80u);
+        return;
+    }
+    for (uint16_t indice = 0; indice + 2u < bytes_amostra; ++indice) {
+        destino[indice] = 0xA5u;
+    }
+    escreverLe16(destino + (bytes_amostra - 2u), valor);
+}
+
+void escreverChunk(uint8_t *&ponteiro, const char *id, uint32_t tamanho) {
+    memcpy(ponteiro, id, 4);
+    escreverLe32(ponteiro + 4, tamanho);
+    ponteiro += 8;
+}
+
+// Monta o arquivo do caso: RIFF, [LIST impar], fmt, data com QUADROS_CORPUS quadros e um LIST final
+// impar que o leitor nao pode entregar como audio. Devolve o tamanho e onde comeca o audio.
+size_t montarWav(const CasoWav &caso, uint8_t *destino, uint32_t &inicio_dados, uint32_t &tamanho_dados) {
+    uint16_t bytes_amostra = static_cast<uint16_t>((caso.bits_por_amostra + 7u) / 8u);
+    uint16_t alinhamento = static_cast<uint16_t>(caso.canais * bytes_amostra);
+    uint8_t *ponteiro = destino;
+
+    memcpy(ponteiro, (caso.estrutura & WAV_RIFX) ? "RIFX" : "RIFF", 4);
+    memcpy(ponteiro + 8, (caso.estrutura & WAV_AVI) ? "AVI " : "WAVE", 4);
+    ponteiro += 12;
+
+    if (caso.estrutura & WAV_LIST_IMPAR) {
+        escreverChunk(ponteiro, "LIST", TAMANHO_LIST_IMPAR);
+        memset(ponteiro, 'i', TAMANHO_LIST_IMPAR + 1u);
+        ponteiro += TAMANHO_LIST_IMPAR + 1u;
+    }
+
+    // Pular 0xFFFFFFFF + 1 bytes daria 0 em 32 bits e o leitor acharia o fmt logo depois
+    if (caso.estrutura & WAV_LIST_GIGANTE) {
+        escreverChunk(ponteiro, "LIST", 0xFFFFFFFFu);
+    }
+
+    if (!(caso.estrutura & WAV_SEM_FMT)) {
+        uint16_t alinhamento_fmt = alinhamento;
+        if (caso.estrutura & WAV_ALINHAMENTO_ERRADO) {
+            alinhamento_fmt = static_cast<uint16_t>(alinhamento_fmt + 1u);
+        }
+        escreverChunk(ponteiro, "fmt ", caso.tamanho_fmt);
+        memset(ponteiro, 0, caso.tamanho_fmt + (caso.tamanho_fmt & 1u));
+        escreverLe16(ponteiro, caso.formato_audio);
+        escreverLe16(ponteiro + 2, caso.canais);
+        escreverLe32(ponteiro + 4, caso.taxa_amostragem);
+        escreverLe32(ponteiro + 8, caso.taxa_amostragem * alinhamento_fmt);
+        escreverLe16(ponteiro + 12, alinhamento_fmt);
+        escreverLe16(ponteiro + 14, caso.bits_por_amostra);
+        if (caso.tamanho_fmt >= 18u) {
+            escreverLe16(ponteiro + 16, static_cast<uint16_t>(caso.tamanho_fmt - 18u));
+        }
+        if (caso.tamanho_fmt >= 40u) {
+            static const uint8_t RESTO_GUID[14] = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80,
+                                                   0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+            escreverLe16(ponteiro + 18, caso.bits_por_amostra);
+            escreverLe32(ponteiro + 20, 0x3u);
+            escreverLe16(ponteiro + 24, caso.subformato);
+            memcpy(ponteiro + 26, RESTO_GUID, sizeof(RESTO_GUID));
+        }
+        ponteiro += caso.tamanho_fmt + (caso.tamanho_fmt & 1u);
+    }
+
+    tamanho_dados = QUADROS_CORPUS * alinhamento;
+    if (!(caso.estrutura & WAV_SEM_DATA)) {
+        escreverChunk(ponteiro, "data", tamanho_dados);
+        inicio_dados = static_cast<uint32_t>(ponteiro - destino);
+        for (uint32_t quadro = 0; quadro < QUADROS_CORPUS; ++quadro) {
+            for (uint16_t canal = 0; canal < caso.canais; ++canal) {
+                escreverAmostraCorpus(ponteiro, amostraCorpus(quadro, canal), bytes_amostra);
+                ponteiro += bytes_amostra;
+            }
+        }
+        if (tamanho_dados & 1u) {
+            *ponteiro++ = 0u;
+        }
+    }
+
+    escreverChunk(ponteiro, "LIST", 3u);
+    memset(ponteiro, 0x7F, 4);
+    ponteiro += 4;
+
+    size_t tamanho = static_cast<size_t>(ponteiro - destino);
+    escreverLe32(destino + 4, static_cast<uint32_t>(tamanho - 8u));
+    return (caso.estrutura & WAV_TRUNCADO) ? 10u : tamanho;
+}
+
+const CasoWav CORPUS_WAV[] = {
+    {"pcm16_estereo_44k", 1u, 0u, 2u, 44100u, 16u, 16u, 0u, cartao_sd::ResultadoWav::OK},
+    {"pcm16_mono_48k", 1u, 0u, 1u, 48000u, 16u, 16u, 0u, cartao_sd::ResultadoWav::OK},
+    {"pcm8_mono_impar", 1u, 0u, 1u, 22050u, 8u, 16u, WAV_LIST_IMPAR, cartao_sd::ResultadoWav::OK},
+    {"pcm8_estereo", 1u, 0u, 2u, 44100u, 8u, 16u, 0u, cartao_sd::ResultadoWav::OK},
+    {"pcm24_estereo_48k", 1u, 0u, 2u, 48000u, 24u, 16u, 0u, cartao_sd::ResultadoWav::OK},
+    {"pcm32_estereo", 1u, 0u, 2u, 44100u, 32u, 18u, WAV_LIST_IMPAR, cartao_sd::ResultadoWav::OK},
+    {"pcm16_estereo_fmt18", 1u, 0u, 2u, 44100u, 16u, 18u, 0u, cartao_sd::ResultadoWav::OK},
+    {"pcm16_estereo_list_impar", 1u, 0u, 2u, 48000u, 16u, 16u, WAV_LIST_IMPAR, cartao_sd::ResultadoWav::OK},
+    {"fmt_impar", 1u, 0u, 2u, 44100u, 16u, 17u, 0u, cartao_sd::ResultadoWav::OK},
+    {"extensivel_24_seis_canais", 0xFFFEu, 1u, 6u, 48000u, 24u, 40u, 0u, cartao_sd::ResultadoWav::OK},
+    {"extensivel_16_mono", 0xFFFEu, 1u, 1u, 44100u, 16u, 40u, WAV_LIST_IMPAR, cartao_sd::ResultadoWav::OK},
+    {"truncado", 1u, 0u, 2u, 44100u, 16u, 16u, WAV_TRUNCADO, cartao_sd::ResultadoWav::FIM_PREMATURO},
+    {"rifx", 1u, 0u, 2u, 44100u, 16u, 16u, WAV_RIFX, cartao_sd::ResultadoWav::NAO_E_RIFF},
+    {"avi", 1u, 0u, 2u, 44100u, 16u, 16u, WAV_AVI, cartao_sd::ResultadoWav::NAO_E_WAVE},
+    {"sem_fmt", 1u, 0u, 2u, 44100u, 16u, 16u, WAV_SEM_FMT, cartao_sd::ResultadoWav::SEM_FMT},
+    {"sem_fmt_nem_data", 1u, 0u, 2u, 44100u, 16u, 16u, WAV_SEM_FMT | WAV_SEM_DATA | WAV_LIST_IMPAR,
+     cartao_sd::ResultadoWav::SEM_FMT},
+    {"sem_data", 1u, 0u, 2u, 44100u, 16u, 16u, WAV_SEM_DATA, cartao_sd::ResultadoWav::SEM_DATA},
+    {"list_gigante", 1u, 0u, 2u, 44100u, 16u, 16u, WAV_LIST_GIGANTE, cartao_sd::ResultadoWav::CHUNK_FORA_DO_RIFF},
+    {"fmt_curto", 1u, 0u, 2u, 44100u, 16u, 14u, 0u, cartao_sd::ResultadoWav::FMT_INVALIDO},
+    {"alinhamento_errado", 1u, 0u, 2u, 44100u, 16u, 16u, WAV_ALINHAMENTO_ERRADO,
+     cartao_sd::ResultadoWav::FMT_INVALIDO},
+    {"extensivel_curto", 0xFFFEu, 1u, 2u, 44100u, 16u, 18u, 0u, cartao_sd::ResultadoWav::FMT_INVALIDO},
+    {"ponto_flutuante", 3u, 0u, 2u, 44100u, 32u, 16u, 0u, cartao_sd::ResultadoWav::FORMATO_NAO_SUPORTADO},
+    {"extensivel_flutuante", 0xFFFEu, 3u, 2u, 44100u, 32u, 40u, 0u,
+     cartao_sd::ResultadoWav::FORMATO_NAO_SUPORTADO},
+    {"sem_canais", 1u, 0u, 0u, 44100u, 16u, 16u, 0u, cartao_sd::ResultadoWav::FORMATO_NAO_SUPORTADO},
+    {"nove_canais", 1u, 0u, 9u, 44100u, 16u, 16u, 0u, cartao_sd::ResultadoWav::FORMATO_NAO_SUPORTADO},
+    {"taxa_zero", 1u, 0u, 2u, 0u, 16u, 16u, 0u, cartao_sd::ResultadoWav::FORMATO_NAO_SUPORTADO},
+    {"amostra_40_bits", 1u, 0u, 2u, 44100u, 40u, 16u, 0u, cartao_sd::ResultadoWav::FORMATO_NAO_SUPORTADO},
+};
+
+bool conferirCasoWav(const CasoWav &caso, bool com_avanco) {
+    static uint8_t arquivo[2048];
+    uint32_t inicio_dados = 0u;
+    uint32_t tamanho_dados = 0u;
+    size_t tamanho = montarWav(caso, arquivo, inicio_dados, tamanho_dados);
+
+    FonteMemoriaWav fonte = {arquivo, tamanho, 0u};
+    cartao_sd::LeitorWav leitor(lerMemoriaWav, com_avanco ? avancarMemoriaWav : nullptr, &fonte);
+    cartao_sd::ResultadoWav resultado = leitor.analisarCabecalho();
+    if (resultado != caso.esperado) {
+        printf("%s: %s, esperado %s\n", caso.nome, cartao_sd::LeitorWav::descreverResultado(resultado),
+               cartao_sd::LeitorWav::descreverResultado(caso.esperado));
+        return false;
+    }
+    VERIFICAR(strcmp(cartao_sd::LeitorWav::descreverResultado(resultado), "desconhecido") != 0);
+    if (resultado != cartao_sd::ResultadoWav::OK) {
+        return true;
+    }
+
+    const cartao_sd::FormatoWav &formato = leitor.formato();
+    VERIFICAR(formato.formato_audio == cartao_sd::LeitorWav::FORMATO_PCM);
+    VERIFICAR(formato.canais == caso.canais);
+    VERIFICAR(formato.taxa_amostragem == caso.taxa_amostragem);
+    VERIFICAR(formato.bits_por_amostra == caso.bits_por_amostra);
+    VERIFICAR(formato.inicio_dados == inicio_dados);
+    VERIFICAR(formato.tamanho_dados == tamanho_dados);
+    VERIFICAR(fonte.posicao == inicio_dados);
+    VERIFICAR(leitor.estereo16Bits() == (caso.canais == 2u && caso.bits_por_amostra == 16u));
+
+    // Area de trabalho de poucos quadros: a conversao acontece em varios lotes
+    uint8_t area[5u * 6u * 4u];
+    static int16_t quadros[2u * (QUADROS_CORPUS + 4u)];
+    size_t area_usada = 5u * formato.alinhamento_bloco;
+    VERIFICAR(area_usada <= sizeof(area));
+    size_t convertidos = leitor.lerQuadrosEstereo16(quadros, QUADROS_CORPUS + 4u, area, area_usada);
+    VERIFICAR(convertidos == QUADROS_CORPUS);
+    VERIFICAR(leitor.bytesRestantes() == 0u);
+    VERIFICAR(leitor.lerQuadrosEstereo16(quadros, 1u, area, area_usada) == 0u);
+
+    for (uint32_t quadro = 0; quadro < QUADROS_CORPUS; ++quadro) {
+        uint16_t canal_direito = (caso.canais > 1u) ? 1u : 0u;
+        VERIFICAR(quadros[quadro * 2u] == amostraCorpusConvertida(quadro, 0u, caso.bits_por_amostra));
+        VERIFICAR(quadros[quadro * 2u + 1u] == amostraCorpusConvertida(quadro, canal_direito, caso.bits_por_amostra));
+    }
+
+    // converterQuadrosEstereo16 direto sobre o chunk data cru da o mesmo resultado
+    static int16_t convertidos_direto[2u * QUADROS_CORPUS];
+    cartao_sd::LeitorWav::converterQuadrosEstereo16(formato, arquivo + inicio_dados, QUADROS_CORPUS, convertidos_direto);
+    VERIFICAR(memcmp(convertidos_direto, quadros, sizeof(convertidos_direto)) == 0);
+    return true;
+}
+
+// Enche slots de tamanho_bloco como ler_e_encher_anel no core1 (primeira leitura ate a fronteira,
+// so quadros completos publicados) e confere que o audio do anel sai na ordem, com L e R no lugar
+bool conferirAnelWav(const CasoWav &caso, size_t tamanho_bloco) {
+    static uint8_t arquivo[2048];
+    uint32_t inicio_dados = 0u;
+    uint32_t tamanho_dados = 0u;
+    size_t tamanho = montarWav(caso, arquivo, inicio_dados, tamanho_dados);
+
+    FonteMemoriaWav fonte = {arquivo, tamanho, 0u};
+    cartao_sd::LeitorWav leitor(lerMemoriaWav, avancarMemoriaWav, &fonte);
+    VERIFICAR(leitor.analisarCabecalho() == cartao_sd::ResultadoWav::OK);
+    VERIFICAR(leitor.estereo16Bits());
+
+    static uint8_t slot[512];
+    static int16_t anel[2u * (QUADROS_CORPUS + 4u)];
+    VERIFICAR(tamanho_bloco <= sizeof(slot));
+    size_t tamanho_leitura = leitor.tamanhoPrimeiraLeitura(tamanho_bloco);
+    VERIFICAR(tamanho_leitura > 0u && tamanho_leitura % 4u == 0u);
+    VERIFICAR(tamanho_leitura <= tamanho_bloco);
+
+    size_t publicados = 0u;
+    bool fim = false;
+    while (!fim) {
+        size_t lidos = leitor.lerDados(slot, tamanho_leitura);
+        size_t bytes_amostras = lidos - (lidos % 4u);
+        VERIFICAR(publicados + bytes_amostras <= sizeof(anel));
+        memcpy(reinterpret_cast<uint8_t *>(anel) + publicados, slot, bytes_amostras);
+        publicados += bytes_amostras;
+        fim = lidos < tamanho_leitura;
+        tamanho_leitura = tamanho_bloco;
+    }
+
+    VERIFICAR(publicados == QUADROS_CORPUS * 4u);
+    for (uint32_t quadro = 0; quadro < QUADROS_CORPUS; ++quadro) {
+        VERIFICAR(anel[quadro * 2u] == amostraCorpus(quadro, 0u));
+        VERIFICAR(anel[quadro * 2u + 1u] == amostraCorpus(quadro, 1u));
+    }
+    return true;
+}
+
+// Corpus em memoria: profundidades, canais, taxas, WAVE_FORMAT_EXTENSIBLE, chunks impares e cada erro
+bool testeCorpusWav() {
+    for (const CasoWav &caso : CORPUS_WAV) {
+        // Com avanco os chunks ignorados sao pulados pela fonte; sem ele o leitor descarta lendo
+        for (bool com_avanco : {true, false}) {
+            if (!conferirCasoWav(caso, com_avanco)) {
+                printf("caso %s (%s avanco)\n", caso.nome, com_avanco ? "com" : "sem");
+                return false;
+            }
+        }
+
+        // Estereo 16 bits vai do arquivo direto para o anel; blocos de 64 bytes cruzam varias fronteiras
+        if (caso.esperado == cartao_sd::ResultadoWav::OK && caso.canais == 2u && caso.bits_por_amostra == 16u) {
+            for (size_t tamanho_bloco : {static_cast<size_t>(64u), static_cast<size_t>(512u)}) {
+                if (!conferirAnelWav(caso, tamanho_bloco)) {
+                    printf("caso %s (anel de %lu bytes)\n", caso.nome, static_cast<unsigned long>(tamanho_bloco));
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool lerArquivoMapeado(CartaoSD &cartao, const char *caminho, uint32_t tamanho, size_t bloco, uint32_t semente) {
+    static uint8_t buffer[16384];
+    ArquivoSd arquivo = cartao.abrir(caminho, MODO_LEITURA | MODO_MAPA_CLUSTERS);
+    VERIFICAR(arquivo.estaAberto());
+    VERIFICAR(arquivo.temMapaClusters());
+
+    uint32_t lidos = 0u;
+    while (lidos < tamanho) {
+        size_t parte = (bloco > sizeof(buffer)) ? sizeof(buffer) : bloco;
+        size_t recebidos = arquivo.lerBytes(buffer, parte);
+        VERIFICAR(recebidos > 0u);
+        VERIFICAR(conferirPadrao(buffer, recebidos, lidos, semente));
+        lidos += static_cast<uint32_t>(recebidos);
+    }
+    VERIFICAR(arquivo.lerBytes(buffer, 1u) == 0u);
+    VERIFICAR(arquivo.fechar());
+    return true;
+}
+
+// Tabela de clusters: caminho contiguo direto ao cartao, busca, copia do handle e arquivo fragmentado
+bool testeMapaClusters() {
+    CartaoEmulado emulado("mapa_clusters.img", cartao_sd::configuracaoPadraoEmuladorSd());
+    CartaoSD cartao(SPI_CARTAO, PINO_SPI_MISO_CARTAO, PINO_SPI_MOSI_CARTAO, PINO_SPI_SCK_CARTAO, PINO_SPI_CS_CARTAO);
+    static uint8_t area_formatacao[4096];
+    ParametrosFormatacaoFat parametros = {FM_ANY, 0u, 0u, 0u, 2048u};
+    VERIFICAR(cartao.formatar("0:", parametros, area_formatacao, sizeof(area_formatacao)));
+    VERIFICAR(cartao.montarSistemaArquivos());
+
+    // Volume vazio: o primeiro arquivo sai contiguo. O segundo cresce intercalado com um terceiro.
+    constexpr uint32_t TAMANHO = 100003u;
+    VERIFICAR(gravarArquivoPadrao(cartao, "/contiguo.bin", TAMANHO, 4096u, 11u));
+    static uint8_t bloco_cluster[2048];
+    for (uint32_t gravados = 0u; gravados < TAMANHO; gravados += sizeof(bloco_cluster)) {
+        uint32_t parte = (TAMANHO - gravados < sizeof(bloco_cluster)) ? TAMANHO - gravados : sizeof(bloco_cluster);
+        preencherPadrao(bloco_cluster, parte, gravados, 12u);
+        for (const char *caminho : {"/fragmentado.bin", "/vizinho.bin"}) {
+            ArquivoSd arquivo = cartao.abrir(caminho, MODO_ACRESCENTAR);
+            VERIFICAR(arquivo.estaAberto());
+            VERIFICAR(arquivo.escreverBytes(bloco_cluster, parte) == parte);
+            VERIFICAR(arquivo.fechar());
+        }
+    }
+
+    ArquivoSd contiguo = cartao.abrir("/contiguo.bin", MODO_LEITURA | MODO_MAPA_CLUSTERS);
+    VERIFICAR(contiguo.temMapaClusters());
+    VERIFICAR(contiguo.eContiguo());
+    contiguo.fechar();
+
+    // 49 fragmentos nao cabem na tabela: abre sem ela e le pela FAT
+    ArquivoSd fragmentado = cartao.abrir("/fragmentado.bin", MODO_LEITURA | MODO_MAPA_CLUSTERS);
+    VERIFICAR(fragmentado.estaAberto());
+    VERIFICAR(!fragmentado.temMapaClusters());
+    VERIFICAR(!fragmentado.eContiguo());
+    fragmentado.fechar();
+
+    // A tabela so existe para leitura
+    ArquivoSd escrita = cartao.abrir("/contiguo.bin", MODO_LEITURA | MODO_ESCRITA | MODO_MAPA_CLUSTERS);
+    VERIFICAR(escrita.estaAberto());
+    VERIFICAR(!escrita.temMapaClusters());
+    escrita.fechar();
+
+    VERIFICAR(lerArquivoMapeado(cartao, "/contiguo.bin", TAMANHO, 16384u, 11u));
+    VERIFICAR(lerArquivoMapeado(cartao, "/contiguo.bin", TAMANHO, 1000u, 11u));
+    VERIFICAR(lerArquivoMapeado(cartao, "/contiguo.bin", TAMANHO, 512u, 11u));
+    VERIFICAR(lerArquivoPadrao(cartao, "/fragmentado.bin", TAMANHO, 4096u, 12u));
+
+    // Blocos de 16 KB atravessam 8 clusters: sem a tabela o FatFs faz um CMD18 por cluster
+    EstatisticasEmuladorSd sem_mapa;
+    EstatisticasEmuladorSd com_mapa;
+    emulado.emulador.zerarEstatisticas();
+    VERIFICAR(lerArquivoPadrao(cartao, "/contiguo.bin", TAMANHO, 16384u, 11u));
+    emulado.emulador.obterEstatisticas(sem_mapa);
+    emulado.emulador.zerarEstatisticas();
+    VERIFICAR(lerArquivoMapeado(cartao, "/contiguo.bin", TAMANHO, 16384u, 11u));
+    emulado.emulador.obterEstatisticas(com_mapa);
+    VERIFICAR(com_mapa.leituras_multiplas * 4u <= sem_mapa.leituras_multiplas);
+
+    // Buscas e leituras fora do alinhamento, e a copia continua valida depois que o original e reaberto
+    ArquivoSd original = cartao.abrir("/contiguo.bin", MODO_LEITURA | MODO_MAPA_CLUSTERS);
+    ArquivoSd copia = original;
+    original = cartao.abrir("/vizinho.bin", MODO_LEITURA | MODO_MAPA_CLUSTERS);
+    VERIFICAR(copia.eContiguo());
+    uint8_t trecho[3000];
+    const uint32_t posicoes[] = {77777u, 512u, 0u, 4095u, TAMANHO - 1500u, 51200u};
+    for (uint32_t posicao : posicoes) {
+        VERIFICAR(copia.buscar(static_cast<long>(posicao)));
+        size_t esperado = (TAMANHO - posicao < sizeof(trecho)) ? TAMANHO - posicao : sizeof(trecho);
+        VERIFICAR(copia.lerBytes(trecho, sizeof(trecho)) == esperado);
+        VERIFICAR(conferirPadrao(trecho, esperado, posicao, 11u));
+        VERIFICAR(copia.posicao() == static_cast<long>(posicao + esperado));
+    }
+    VERIFICAR(copia.buscar(10u));
+    VERIFICAR(copia.lerCaractere() == padraoByte(10u, 11u));
+    VERIFICAR(copia.lerBytes(trecho, 600u) == 600u);
+    VERIFICAR(conferirPadrao(trecho, 600u, 11u, 11u));
+    copia.fechar();
+    original.fechar();
+    return true;
+}
+
+// Fluxo de leitura: blocos do pool terminam em fronteira de cluster e os setores vao direto ao bloco
+bool testeFluxo() {
+    CartaoEmulado emulado("fluxo.img", cartao_sd::configuracaoPadraoEmuladorSd());
+    CartaoSD cartao(SPI_CARTAO, PINO_SPI_MISO_CARTAO, PINO_SPI_MOSI_CARTAO, PINO_SPI_SCK_CARTAO, PINO_SPI_CS_CARTAO);
+    static uint8_t area_formatacao[4096];
+    ParametrosFormatacaoFat parametros = {FM_ANY, 0u, 0u, 0u, 2048u};
+    VERIFICAR(cartao.formatar("0:", parametros, area_formatacao, sizeof(area_formatacao)));
+    VERIFICAR(cartao.montarSistemaArquivos());
+
+    constexpr uint32_t TAMANHO = 100003u;
+    constexpr uint32_t CLUSTER = 2048u;
+    VERIFICAR(gravarArquivoPadrao(cartao, "/fluxo.bin", TAMANHO, 4096u, 21u));
+
+    // Leitura antecipada ligada: o fluxo a ignora, nenhum setor passa pelo anel dela
+    VERIFICAR(cartao.configurarLeituraAntecipada(1u));
+
+    static cartao_sd::PoolBlocosFluxo pool;
+    for (int modo : {static_cast<int>(MODO_LEITURA), MODO_LEITURA | MODO_MAPA_CLUSTERS}) {
+        ArquivoSd arquivo = cartao.abrir("/fluxo.bin", modo);
+        VERIFICAR(arquivo.estaAberto());
+
+        // Cabecalho fora do alinhamento, como o de um WAV
+        VERIFICAR(arquivo.buscar(44));
+        uint32_t esperado = 44u;
+        cartao_sd::BlocoFluxoSd anterior = {nullptr, 0u, 0u, 0u};
+        cartao_sd::BlocoFluxoSd bloco;
+        emulado.emulador.zerarEstatisticas();
+        while (arquivo.obterBlocoFluxo(pool, bloco)) {
+            VERIFICAR(bloco.posicao == esperado);
+            VERIFICAR(bloco.bytes <= cartao_sd::PoolBlocosFluxo::BYTES_BLOCO);
+            VERIFICAR((reinterpret_cast<uintptr_t>(bloco.dados) % TAMANHO_SETOR) == (bloco.posicao % TAMANHO_SETOR));
+            VERIFICAR(conferirPadrao(bloco.dados, bloco.bytes, bloco.posicao, 21u));
+            esperado += static_cast<uint32_t>(bloco.bytes);
+            VERIFICAR(esperado == TAMANHO || (esperado % CLUSTER) == 0u);
+
+            // Dois blocos em uso ao mesmo tempo, como um produtor um bloco a frente do consumidor
+            pool.liberar(anterior);
+            anterior = bloco;
+        }
+        pool.liberar(anterior);
+        VERIFICAR(esperado == TAMANHO);
+        VERIFICAR(arquivo.resultadoOperacao() == FR_OK);
+        VERIFICAR(pool.blocosLivres() == cartao_sd::PoolBlocosFluxo::QUANTIDADE_BLOCOS);
+
+        // So o setor do cabecalho e o ultimo setor parcial passam pelo buffer do FIL, e nenhum setor
+        // e lido duas vezes (trechos curtos vao ao bloco por CMD17, abaixo do limiar do CMD18)
+        EstatisticasEmuladorSd estatisticas;
+        emulado.emulador.obterEstatisticas(estatisticas);
+        VERIFICAR(estatisticas.setores_lidos <= (TAMANHO + TAMANHO_SETOR - 1u) / TAMANHO_SETOR);
+        arquivo.fechar();
+    }
+
+    cartao_sd::EstatisticasLeituraAntecipada antecipacao{};
+    cartao.obterEstatisticasLeituraAntecipada(antecipacao);
+    VERIFICAR(antecipacao.acertos_setores == 0u && antecipacao.setores_antecipados == 0u);
+
+    // Pool esgotado: nenhum bloco e o cursor nao anda
+    ArquivoSd arquivo = cartao.abrir("/fluxo.bin", MODO_LEITURA);
+    cartao_sd::BlocoFluxoSd blocos[cartao_sd::PoolBlocosFluxo::QUANTIDADE_BLOCOS];
+    for (cartao_sd::BlocoFluxoSd &reservado : blocos) {
+        VERIFICAR(arquivo.obterBlocoFluxo(pool, reservado));
+    }
+    long posicao = arquivo.posicao();
+    cartao_sd::BlocoFluxoSd extra;
+    VERIFICAR(!arquivo.obterBlocoFluxo(pool, extra));
+    VERIFICAR(arquivo.resultadoOperacao() == FR_NOT_ENOUGH_CORE);
+    VERIFICAR(arquivo.posicao() == posicao);
+    pool.liberar(blocos[1]);
+    VERIFICAR(arquivo.obterBlocoFluxo(pool, extra));
+    VERIFICAR(extra.posicao == static_cast<uint32_t>(posicao));
+    VERIFICAR(conferirPadrao(extra.dados, extra.bytes, extra.posicao, 21u));
+    pool.liberar(extra);
+    for (cartao_sd::BlocoFluxoSd &reservado : blocos) {
+        pool.liberar(reservado);
+    }
+    VERIFICAR(pool.blocosLivres() == cartao_sd::PoolBlocosFluxo::QUANTIDADE_BLOCOS);
+    arquivo.fechar();
+    return true;
+}
+
+// Anel de rastreamento: ordem, aninhamento das camadas, sobrescrita, pausa e exportacao para o Chrome
+bool testeRastreamento() {
+#ifndef CARTAO_SD_RASTREAMENTO
+    printf("sem CARTAO_SD_RASTREAMENTO, nada a conferir\n");
+    return true;
+#else
+    using cartao_sd::CamadaSd;
+    using cartao_sd::EventoRastreamento;
+
+    CartaoEmulado emulado("rastreamento.img", cartao_sd::configuracaoPadraoEmuladorSd());
+    CartaoSD cartao(SPI_CARTAO, PINO_SPI_MISO_CARTAO, PINO_SPI_MOSI_CARTAO, PINO_SPI_SCK_CARTAO, PINO_SPI_CS_CARTAO);
+    VERIFICAR(formatarEMontar(cartao));
+
+    // Maior que o cache de setores: a leitura depois da remontagem precisa ir ao cartao
+    constexpr uint32_t TAMANHO = 64u * 1024u;
+    VERIFICAR(gravarArquivoPadrao(cartao, "/rastro.bin", TAMANHO, 4096u, 3u));
+    VERIFICAR(cartao.desmontarSistemaArquivos());
+    VERIFICAR(cartao.montarSistemaArquivos());
+
+    cartao_sd::zerarRastreamento();
+    ArquivoSd arquivo = cartao.abrir("/rastro.bin", MODO_LEITURA);
+    VERIFICAR(arquivo.estaAberto());
+    uint8_t bloco[4096];
+    VERIFICAR(arquivo.lerBytes(bloco, sizeof(bloco)) == sizeof(bloco));
+    VERIFICAR(arquivo.fechar());
+
+    static EventoRastreamento eventos[CARTAO_SD_RASTREAMENTO_EVENTOS];
+    size_t quantidade = cartao_sd::copiarRastreamento(eventos, CARTAO_SD_RASTREAMENTO_EVENTOS);
+    VERIFICAR(quantidade > 0u);
+    VERIFICAR(quantidade == cartao_sd::totalEventosRastreamento());
+
+    const EventoRastreamento *leitura = nullptr;
+    bool viu_abertura = false;
+    bool viu_comando_leitura = false;
+    bool viu_token = false;
+    for (size_t indice = 0; indice < quantidade; ++indice) {
+        const EventoRastreamento &evento = eventos[indice];
+        VERIFICAR(evento.sequencia == indice);
+        VERIFICAR(evento.camada != CamadaSd::TRANSFERIR_BUFFER);
+        if (evento.camada == CamadaSd::F_OPEN) {
+            viu_abertura = true;
+        } else if (evento.camada == CamadaSd::F_READ) {
+            VERIFICAR(evento.bytes == sizeof(bloco));
+            leitura = &evento;
+        } else if (evento.camada == CamadaSd::COMANDO && (evento.argumento == 17u || evento.argumento == 18u)) {
+            viu_comando_leitura = true;
+        } else if (evento.camada == CamadaSd::AGUARDAR_TOKEN && evento.argumento == 0xFEu) {
+            viu_token = true;
+        }
+    }
+    VERIFICAR(viu_abertura);
+    VERIFICAR(viu_comando_leitura);
+    VERIFICAR(viu_token);
+    VERIFICAR(leitura != nullptr);
+
+    // O evento de fora termina depois dos de dentro, entao os disk_read do f_read vem antes dele
+    uint32_t setores_lidos = 0u;
+    for (const EventoRastreamento *evento = eventos; evento != leitura; ++evento) {
+        if (evento->camada == CamadaSd::DISK_READ && evento->inicio_us >= leitura->inicio_us) {
+            VERIFICAR(evento->inicio_us + evento->duracao_us <= leitura->inicio_us + leitura->duracao_us);
+            setores_lidos += evento->bytes / TAMANHO_SETOR;
+        }
+    }
+    VERIFICAR(setores_lidos >= sizeof(bloco) / TAMANHO_SETOR);
+
+    // Pausado, o anel nao muda
+    cartao_sd::pausarRastreamento(true);
+    uint32_t total_pausado = cartao_sd::totalEventosRastreamento();
+    VERIFICAR(lerArquivoPadrao(cartao, "/rastro.bin", TAMANHO, 4096u, 3u));
+    VERIFICAR(cartao_sd::totalEventosRastreamento() == total_pausado);
+    cartao_sd::pausarRastreamento(false);
+
+    // Mais eventos que posicoes: ficam os ultimos, em sequencia
+    VERIFICAR(cartao.desmontarSistemaArquivos());
+    VERIFICAR(cartao.montarSistemaArquivos());
+    cartao_sd::zerarRastreamento();
+    VERIFICAR(lerArquivoPadrao(cartao, "/rastro.bin", TAMANHO, 512u, 3u));
+    uint32_t total = cartao_sd::totalEventosRastreamento();
+    VERIFICAR(total > CARTAO_SD_RASTREAMENTO_EVENTOS);
+    quantidade = cartao_sd::copiarRastreamento(eventos, CARTAO_SD_RASTREAMENTO_EVENTOS);
+    VERIFICAR(quantidade == CARTAO_SD_RASTREAMENTO_EVENTOS);
+    VERIFICAR(eventos[0].sequencia == total - CARTAO_SD_RASTREAMENTO_EVENTOS);
+    VERIFICAR(eventos[quantidade - 1u].sequencia == total - 1u);
+    VERIFICAR(cartao_sd::copiarRastreamento(eventos, 4u) == 4u);
+    VERIFICAR(eventos[3].sequencia == total - 1u);
+
+    VERIFICAR(cartao_sd::exportarRastreamentoChrome("rastreamento.json"));
+    FILE *json = fopen("rastreamento.json", "r");
+    VERIFICAR(json != nullptr);
+    static char conteudo[64u * 1024u];
+    size_t lidos = fread(conteudo, 1u, sizeof(conteudo) - 1u, json);
+    fclose(json);
+    conteudo[lidos] = 0;
+    VERIFICAR(strncmp(conteudo, "{\"displayTimeUnit\"", 18u) == 0);
+    VERIFICAR(strstr(conteudo, "\"name\":\"disk_read\",\"cat\":\"disk_read\",\"ph\":\"X\"") != nullptr);
+    VERIFICAR(strstr(conteudo, "\"name\":\"aguardarToken\"") != nullptr);
+    VERIFICAR(strstr(conteudo, "\"name\":\"CMD17\"") != nullptr || strstr(conteudo, "\"name\":\"CMD18\"") != nullptr);
+    VERIFICAR(strcmp(conteudo + lidos - 3u, "]}\n") == 0);
+    return true;
+#endif
+}
+
+struct CasoTeste {
+    const char *nome;
+    bool (*executar)();
+};
+
+const CasoTeste CASOS[] = {
+    {"setores_crus", testeSetoresCrus},
+    {"fora_da_faixa", testeForaDaFaixa},
+    {"tempos", testeTempos},
+    {"transferencias_setor", testeTransferenciasSetor},
+    {"arquivos", testeArquivos},
+    {"diretorios", testeDiretorios},
+    {"cache_setores", testeCacheSetores},
+    {"leitura_antecipada", testeLeituraAntecipada},
+    {"wav", testeWav},
+    {"corpus_wav", testeCorpusWav},
+    {"rastreamento", testeRastreamento},
+    {"mapa_clusters", testeMapaClusters},
+    {"fluxo", testeFluxo},
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *filtro = (argc > 1) ? argv[1] : nullptr;
+    uint32_t executados = 0u;
+    uint32_t falhas = 0u;
+
+    for (const CasoTeste &caso : CASOS) {
+        if (filtro != nullptr && strcmp(filtro, caso.nome) != 0) {
+            continue;
+        }
+        executados++;
+        bool passou = caso.executar();
+        printf("%s: %s\n", caso.nome, passou ? "ok" : "FALHOU");
+        if (!passou) {
+            falhas++;
+        }
+    }
+
+    if (executados == 0u) {
+        printf("caso desconhecido: %s\n", filtro);
+        return 1;
+    }
+    return (falhas == 0u) ? 0 : 1;
+}
@@ -1,8 +1,15 @@
 #include <stdio.h>           // Inclui as funções padrão de entrada/saída
 #include "pico/stdlib.h"     // Inclui as funções padrão da Pico SDK
 #include "CartaoSD.h"        // Inclui a classe CartaoSD e ArquivoSd
-#include "pico/util/queue.h" // Inclui a fila para comunicação 
+#include "LeitorWav.h"       // Inclui o analisador RIFF/WAVE
+#include "Instrumentacao.h"  // Inclui o anel de rastreamento da pilha do cartao (CARTAO_SD_RASTREAMENTO)
+#include "pico/multicore.h"  // Inclui o lancamento do leitor SD no core1
 #include "hardware/spi.h"    // Inclui a biblioteca SPI
+#include "hardware/timer.h"  // Inclui o alarme de hardware que marca o relogio de amostras
+#include "hardware/sync.h"   // Inclui __dmb, usado para publicar os indices do anel entre os nucleos
+#include "hardware/dma.h"    // Inclui o DMA que envia as rajadas de amostras ao FPGA
+#include "hardware/irq.h"    // Inclui a interrupcao de fim de rajada DMA
+#include "hardware/clocks.h" // Inclui clk_sys, base do temporizador DMA
 
 // Definicoes SPI cartao SD e FPGA
 // Configuração SPI do Cartão SD (SPI0)
@@ -18,12 +25,55 @@
 #define PINO_SPI_MOSI_FPGA 3u   // GP3 - SDA para I2C, configurado como MOSI
 #define PINO_SPI_SCK_FPGA 2u    // GP2 - SCK para I2C, configurado como SCK
 #define PINO_SPI_CS_FPGA 1u     // GP1 - SDA para I2C, configurado como CS
+#define PINO_PEDIDO_FPGA 28u    // GP28 - linha de pedido do FPGA (com_request_out): 1 = cabem mais duas rajadas
+#define FPGA_SPI_BAUD 6250000   // O receptor do FPGA amostra o SCLK a 25 MHz: maximo de clk/4
+#define FPGA_SPI_BAUD_LEITURA 1000000 // Leituras de registrador: o MISO do FPGA muda ate 120 ns depois da descida
 
-// Definicoes de audio e fila
-#define SD_READ_BLOCK_SIZE 1024                 // Tamanho do buffer de leitura do SD
-#define SAMPLE_QUEUE_CAPACITY 512               // Tamanho da Fila
-#define SAMPLE_RATE 44100                       // Taxa de amostragem do arquivo WAV
-#define SAMPLE_TIME_US (1000000 / SAMPLE_RATE)  // 1.000.000 us / 44100 Hz ≈ 22.67 µs
+// Palavra de comando no inicio de cada janela de CS: [15:8] comando, [7:0] endereco
+#define FPGA_CMD_AUDIO 0x00     // Seguem quadros de audio (L, R)
+#define FPGA_CMD_ESCRITA 0x80   // Seguem palavras gravadas a partir do endereco, com autoincremento
+#define FPGA_CMD_LEITURA 0x40   // O FPGA devolve uma palavra por palavra enviada, com autoincremento
+
+// Banco de registradores do FPGA (control_regs.sv)
+#define FPGA_REG_ID 0x00
+#define FPGA_REG_STATUS 0x01        // [0] overflow, [1] underflow, [2] FIFO cheia, [3] FIFO vazia
+#define FPGA_REG_FIFO_NIVEL 0x02
+#define FPGA_REG_QUADROS_LO 0x03    // Ler LO e HI na mesma rajada
+#define FPGA_REG_QUADROS_HI 0x04
+#define FPGA_REG_UNDERFLOWS 0x05
+#define FPGA_REG_OVERFLOWS 0x06
+#define FPGA_REG_CONTROLE 0x08      // [0] limpa as flags da FIFO, [1] zera os contadores
+#define FPGA_REG_BYPASS 0x09        // Um bit por estagio, 1 = bypass
+#define FPGA_REG_ORDEM_HI 0x0A      // Posicoes 4..7 da ordem dos estagios (4 bits cada)
+#define FPGA_REG_ORDEM 0x0B         // Posicoes 0..3; a escrita aplica a ordem inteira
+#define FPGA_REG_TAXA_HI 0x0C       // Taxa do relogio de amostras do FPGA em Hz, bits 31:16
+#define FPGA_REG_TAXA 0x0D          // Bits 15:0; a escrita aplica a taxa inteira
+#define FPGA_REG_PARAMETRO 0x10     // + estagio
+#define FPGA_REG_COEF_ENDERECO 0x20 // {estagio[3:0], indice[7:0]} do coeficiente de biquad
+#define FPGA_REG_COEF_HI 0x21       // Bits 17:16; a escrita de COEF_LO grava e avanca o endereco
+#define FPGA_ID_ESPERADO 0xEF01
+
+// Definicoes de audio e do anel de blocos
+#define RING_BLOCK_BYTES 512                    // Um setor do SD por bloco do anel
+#define RING_BLOCK_COUNT 32                     // Potencia de 2: 32 blocos = 4096 amostras (~93 ms a 44,1 kHz)
+#define RING_PRIME_BLOCKS (RING_BLOCK_COUNT / 2) // Blocos no anel antes de ligar o relogio
+#define SAMPLE_RATE 44100                       // Taxa inicial do relogio, trocada pela do cabecalho WAV
+#define WAV_CONVERSION_BUFFER_BYTES 1024        // Dados crus de formatos que precisam de conversao para 16 bits estereo
+
+// Modos de saida para o FPGA
+#define SAIDA_FPGA_POR_AMOSTRA 0  // Alarme a cada amostra: CS + spi_write_blocking de 4 bytes
+#define SAIDA_FPGA_DMA_BLOCOS 1   // Um bloco do anel por rajada DMA, no ritmo do temporizador DMA
+#define SAIDA_FPGA_SOB_PEDIDO 2   // Um bloco por rajada DMA na velocidade do SPI, enquanto o FPGA pedir
+#ifndef SAIDA_FPGA_MODO
+#define SAIDA_FPGA_MODO SAIDA_FPGA_SOB_PEDIDO
+#endif
+#define SAIDA_FPGA_USA_DMA (SAIDA_FPGA_MODO != SAIDA_FPGA_POR_AMOSTRA)
+
+#define SILENCIO_SAMPLES 32                     // Rajada de silencio enviada quando o anel esvazia no modo DMA
+#define CS_FPGA_MIN_ALTO_CICLOS 32              // CS alto entre rajadas (~256 ns a 125 MHz, > 3 clocks do FPGA)
+#define OCUPACAO_JANELA_US 10000                // Janela do laco ocioso usado para medir a ocupacao do core0
+#define OCUPACAO_CALIBRACAO_US 100000           // Duracao da calibracao do laco ocioso sem saida de audio
+#define FPGA_TRANSACAO_TIMEOUT_US 50000         // Espera maxima pela interrupcao da saida (rajada de 128 amostras a 8 kHz = 16 ms)
 
 // Definição da Amostra: 16-bit estéreo (dois canais)
 typedef struct {
@@ -31,23 +81,154 @@ typedef struct {
     int16_t right;
 } Sample16BitStereo;
 
-queue_t sample_queue;               // Fila global
+#define RING_SAMPLES_PER_BLOCK (RING_BLOCK_BYTES / sizeof(Sample16BitStereo))
+
+// Anel de blocos com um produtor (leitor SD no core1) e um consumidor (alarme no core0), sem trava.
+// cabeca e cauda so crescem; o slot de um indice e indice & (RING_BLOCK_COUNT - 1).
+// Cada indice e escrito por um unico lado e publicado depois de um __dmb.
+typedef struct {
+    uint8_t dados[RING_BLOCK_COUNT][RING_BLOCK_BYTES] __attribute__((aligned(RING_BLOCK_BYTES))); // Slot = setor alinhado, destino do SPI
+    uint16_t bytes_validos[RING_BLOCK_COUNT]; // Bytes de amostras em cada bloco (o ultimo pode vir incompleto)
+    volatile uint32_t cabeca;                 // Blocos publicados pelo produtor
+    volatile uint32_t cauda;                  // Blocos devolvidos pelo consumidor
+    uint32_t posicao_leitura;                 // Proxima amostra do bloco da cauda (so o consumidor usa)
+} AnelBlocos;
+
+AnelBlocos anel_amostras;           // Anel global
 volatile bool end_of_file = false;  // Variável para indicar se a leitura do arquivo terminou
+volatile bool leitor_concluido = false; // Core1 terminou de usar o arquivo e o cartao
+
+// Contexto entregue ao leitor que roda no core1
+typedef struct {
+    cartao_sd::LeitorWav *leitor;
+} ContextoLeitor;
+
+ContextoLeitor contexto_leitor = { NULL };
+
+// Relogio de amostras: cada tick n acontece em inicio + n * 1.000.000 / taxa (us), sem acumular erro
+typedef struct {
+    int alarme;                      // Alarme de hardware reservado
+    uint32_t taxa_amostragem;        // Taxa lida do cabecalho WAV
+    uint64_t inicio_us;              // Instante do tick 0
+    volatile uint32_t proximo_tick;  // Indice do proximo tick a ser atendido
+    volatile bool ativo;
+} RelogioAmostras;
+
+// Medicoes feitas dentro da interrupcao e lidas pelo laco principal
+typedef struct {
+    volatile uint32_t amostras_enviadas;
+    volatile uint32_t underruns;
+    volatile uint32_t nivel_minimo_anel; // Menor numero de blocos no anel visto pela interrupcao
+    volatile uint32_t ticks_atrasados;   // Alvos que ja tinham passado ao reagendar
+    volatile uint32_t atraso_max_us;     // Maior atraso entre o alvo ideal e a entrada na interrupcao
+    volatile uint64_t soma_atraso_us;
+    volatile uint64_t ultimo_tick_us;    // Instante real do ultimo tick atendido
+} MedicaoRelogio;
+
+// Saida em rajadas: cada rajada e um bloco do anel em palavras de 16 bits (L, R, L, R...) com o CS baixo.
+// O temporizador DMA libera uma palavra a cada 1 / (2 * taxa) s; o CS sobe entre rajadas para o FPGA realinhar.
+// No modo sob pedido o DREQ do SPI libera as palavras e quem marca o ritmo e o relogio de amostras do FPGA:
+// a proxima rajada so sai com a linha de pedido alta, no fim da rajada anterior ou na borda de subida.
+typedef struct {
+    int canal;                      // Canal DMA que alimenta o SPI1
+    int temporizador;               // Temporizador DMA que marca o ritmo das palavras
+    uint16_t fracao_x;              // Taxa de palavras = clk_sys * X / Y
+    uint16_t fracao_y;
+    bool bloco_do_anel;             // A rajada atual e um bloco do anel (devolver ao terminar) ou silencio
+    uint32_t amostras_rajada;
+    volatile uint32_t rajadas;
+    volatile bool em_rajada;        // DMA ativo com o CS baixo
+    volatile uint32_t esperas;      // Fins de rajada com o pedido baixo (a saida esperou o FPGA)
+    volatile uint64_t tempo_rajadas_us; // Soma da duracao das rajadas, para a vazao do link
+    uint64_t inicio_rajada_us;
+    // Ritmo das rajadas: cada inicio contra o ideal dado pelas amostras enviadas desde a referencia
+    volatile bool ritmo_estavel;    // Os inicios ja seguem o relogio (sob pedido: FIFO do FPGA cheia)
+    volatile uint32_t amostras_rajadas; // Amostras de todas as rajadas iniciadas, silencio incluido
+    volatile uint32_t rajadas_ritmadas; // Inicios medidos desde a referencia
+    uint64_t referencia_us;         // Primeiro inicio com ritmo estavel
+    uint32_t referencia_amostras;
+    volatile uint64_t ultimo_inicio_us;
+    volatile uint32_t ultimo_inicio_amostras;
+    volatile uint32_t desvio_max_us;    // Maior |intervalo real - ideal| entre dois inicios
+    volatile uint64_t soma_desvio_us;
+} SaidaDmaFpga;
+
+// Ocupacao do core0: iteracoes do laco ocioso durante a reproducao contra a taxa calibrada sem audio
+typedef struct {
+    uint64_t iteracoes_livres;      // Iteracoes na calibracao
+    uint64_t iteracoes_reproducao;  // Iteracoes durante a reproducao
+    uint64_t tempo_reproducao_us;
+} MedicaoOcupacao;
+
+RelogioAmostras relogio = { -1, SAMPLE_RATE, 0, 0, false };
+MedicaoRelogio medicao = { 0, 0, RING_BLOCK_COUNT, 0, 0, 0, 0 };
+SaidaDmaFpga saida_dma = { -1, -1, 0, 0, false, 0, 0, false, 0, 0, 0, false, 0, 0, 0, 0, 0, 0, 0, 0 };
+MedicaoOcupacao ocupacao = { 0, 0, 0 };
+
+// Acesso a registrador do FPGA pedido pelo laco principal e feito pela interrupcao da saida,
+// com o CS alto entre dois envios de audio, para nao abrir uma janela no meio de uma rajada
+typedef struct {
+    volatile bool pendente;
+    uint8_t comando;                // FPGA_CMD_ESCRITA ou FPGA_CMD_LEITURA
+    uint8_t endereco;
+    uint16_t *dados;
+    uint8_t palavras;
+} TransacaoRegistrador;
+
+TransacaoRegistrador transacao_fpga = { false, 0, 0, NULL, 0 };
+
+static const uint16_t silencio_fpga[SILENCIO_SAMPLES * 2] = { 0 };
 
 // Protótipos das funções
 bool listarDiretorio(CartaoSD &cartao);
-void setup_sample_queue();
-void ler_e_encher_fila(ArquivoSd *wav_file);
+void setup_anel_amostras();
+uint8_t *anel_bloco_escrita();
+void anel_publicar_bloco(uint16_t bytes);
+const uint8_t *anel_bloco_leitura(uint16_t *bytes);
+void anel_liberar_bloco();
+bool anel_retirar_amostra(Sample16BitStereo *sample);
+uint32_t anel_nivel_blocos();
+size_t ler_arquivo_wav(void *contexto, uint8_t *destino, size_t tamanho);
+bool avancar_arquivo_wav(void *contexto, uint32_t bytes);
+void ler_e_encher_anel(cartao_sd::LeitorWav *leitor);
+void nucleo1_leitor_sd();
+void acompanhar_reproducao();
 void processar_amostra(Sample16BitStereo sample);
 void setup_spi_fpga();
+void servico_registradores_fpga();
+bool fpga_escrever_registradores(uint8_t endereco, const uint16_t *valores, uint8_t palavras);
+bool fpga_ler_registradores(uint8_t endereco, uint16_t *valores, uint8_t palavras);
+bool fpga_definir_bypass(uint16_t mascara);
+bool fpga_definir_parametro(uint8_t estagio, uint16_t valor);
+bool fpga_definir_ordem(const uint8_t *estagios, uint8_t quantidade);
+bool fpga_definir_taxa(uint32_t taxa_amostragem);
+void relatar_fpga();
+void iniciar_relogio_amostras(uint32_t taxa_amostragem);
+void parar_relogio_amostras();
+void relatar_relogio_amostras();
+void calcular_fracao_temporizador(uint32_t taxa_palavras, uint16_t *x, uint16_t *y);
+void iniciar_saida_dma(uint32_t taxa_amostragem);
+void parar_saida_dma();
+void relatar_saida_dma();
+void iniciar_saida_audio(uint32_t taxa_amostragem);
+void parar_saida_audio();
+void relatar_saida_audio();
+uint32_t laco_ocioso(uint64_t ate_us);
+void calibrar_ocupacao();
+void relatar_ocupacao();
 
 int main(){
     stdio_init_all();
     while (!stdio_usb_connected()) sleep_ms(100);
     printf("\r\nIniciando SD_CARD_LEITURA...\r\n");
     
-    setup_sample_queue();   // Inicia a fila antes de abrir o arquivo
+    setup_anel_amostras();  // Inicia o anel antes de abrir o arquivo
     setup_spi_fpga();       // Configura o SPI para o FPGA
+
+    uint16_t id_fpga = 0;
+    fpga_ler_registradores(FPGA_REG_ID, &id_fpga, 1);
+    if (id_fpga == FPGA_ID_ESPERADO) printf("FPGA respondeu (ID %04x).\r\n", id_fpga);
+    else printf("FPGA nao respondeu ao registrador de ID (%04x, esperado %04x).\r\n", id_fpga, FPGA_ID_ESPERADO);
     
     // Configuracao e montagem do cartao SD
     CartaoSD cartao(SPI_CARTAO,
@@ -61,62 +242,66 @@ int main(){
 
     if (!cartao.montarSistemaArquivos()) printf("Falha ao montar FAT. Cartão formatado?\r\n");
     else printf("Sistema de arquivos montado com sucesso.\r\n");
+
+    // Sem leitura antecipada: o proprio anel de blocos ja e o buffer a frente da reproducao, e cada
+    // setor vai do SPI direto ao slot. Com o anel da LeituraAntecipada no meio, o setor seria copiado
+    // duas vezes (SPI -> anel de setores -> slot).
+    cartao.configurarLeituraAntecipada(0u);
     
     // ------------------------------ Leitura WAV ---------------------------------------
     const char* nome_arquivo = "meu_audio.wav";  // <------------
     printf("\nTentando abrir arquivo: %s\r\n", nome_arquivo);
 
-    ArquivoSd wav_file = cartao.abrir(nome_arquivo, MODO_LEITURA);  // Abre arquivo no modo leitura definido no CartaoSD.h
+    ArquivoSd wav_file = cartao.abrir(nome_arquivo, MODO_LEITURA | MODO_MAPA_CLUSTERS);  // Leitura com tabela de clusters: sem caminhar pela FAT e direto do cartao se o arquivo for contiguo
     if (wav_file.estaAberto()) {
-        printf("Arquivo WAV aberto com sucesso.\n");
+        printf("Arquivo WAV aberto com sucesso%s.\n", wav_file.eContiguo() ? " (contiguo: leitura direta do cartao)" : "");
         
-        // Buffer para ler o cabeçalho (44 bytes para um header WAV padrão)
-        const int WAV_HEADER_SIZE = 44;
-        uint8_t header_buffer[WAV_HEADER_SIZE];
+        // Percorre os chunks RIFF ate o inicio dos dados; LIST, fact etc. sao pulados com buscar()
+        cartao_sd::LeitorWav leitor_wav(ler_arquivo_wav, avancar_arquivo_wav, &wav_file);
+        cartao_sd::ResultadoWav resultado_wav = leitor_wav.analisarCabecalho();
+
+        if (resultado_wav == cartao_sd::ResultadoWav::OK) {
+            const cartao_sd::FormatoWav &formato = leitor_wav.formato();
+            printf("WAV: %u canal(is), %lu Hz, %u bits, %lu bytes de audio a partir do byte %lu%s.\n",
+                   formato.canais, (unsigned long)formato.taxa_amostragem, formato.bits_por_amostra,
+                   (unsigned long)formato.tamanho_dados, (unsigned long)formato.inicio_dados,
+                   leitor_wav.estereo16Bits() ? "" : " (convertido para 16 bits estereo)");
 
-        if (wav_file.lerBytes(header_buffer, WAV_HEADER_SIZE)) {
-            printf("Cabecalho WAV lido (%d bytes).\n", WAV_HEADER_SIZE);
-            ler_e_encher_fila(&wav_file); // Inicio leitura continua e enchimento da fila
+            // Core1 le o cartao e enche o anel; core0 fica com o relogio de amostras e a saida SPI
+            contexto_leitor.leitor = &leitor_wav;
+            multicore_launch_core1(nucleo1_leitor_sd);
 
-        } else printf("Erro ao ler o cabecalho WAV.\n");
+            // Espera o anel ter folga antes de ligar o relogio para nao comecar em underrun
+            while (anel_nivel_blocos() < RING_PRIME_BLOCKS && !end_of_file) tight_loop_contents();
+
+            calibrar_ocupacao();
+            iniciar_saida_audio(formato.taxa_amostragem);
+            acompanhar_reproducao();
+            parar_saida_audio();
+
+            // O arquivo so pode ser fechado depois que o core1 parar de le-lo
+            while (!leitor_concluido) tight_loop_contents();
+
+            printf("Transmissão SPI concluída. Total de amostras enviadas: %lu\r\n", (unsigned long)medicao.amostras_enviadas);
+            relatar_saida_audio();
+            relatar_ocupacao();
+            relatar_fpga();
+
+#ifdef CARTAO_SD_RASTREAMENTO
+            if (medicao.underruns > 0) {
+                printf("Rastreamento do cartao ate o primeiro underrun:\r\n");
+                cartao_sd::imprimirRastreamento();
+            }
+            cartao_sd::pausarRastreamento(false);
+#endif
+
+        } else printf("Erro ao ler o cabecalho WAV: %s.\n", cartao_sd::LeitorWav::descreverResultado(resultado_wav));
 
         wav_file.fechar();
         printf("Arquivo WAV fechado.\n");
 
     } else printf("Falha ao abrir o arquivo WAV: %s\n", nome_arquivo);
 
-    // ------------------------ Consumo e transmissao do audio -------------------------------
-    printf("\n--- Loop de Consumo (Transmissão SPI ao FPGA) ---\r\n");
-    Sample16BitStereo current_sample;
-    uint32_t samples_consumed = 0; // Mudado para uint32_t para evitar overflow
-    
-    // Loop de reprodução: termina quando o arquivo terminar E a fila esvaziar
-    while (!end_of_file || !queue_is_empty(&sample_queue)) {
-        // Tenta remover (não-bloqueante) uma amostra da fila
-        if (queue_try_remove(&sample_queue, &current_sample)) {
-            // Envia a amostra para o FPGA via SPI
-            processar_amostra(current_sample);
-            samples_consumed++;
-
-            // Sincronização de Tempo (CRÍTICO: Impreciso!)  <---------------------
-            // Tenta forçar a taxa de amostragem de 44.1 kHz
-            sleep_us(SAMPLE_TIME_US);
-            
-            // Exemplo de status
-            if (samples_consumed % 44100 == 0) { // A cada 1 segundo
-                printf("Tempo: %lu s | Amostras: %lu | Fila atual: %d\r\n", samples_consumed / SAMPLE_RATE, samples_consumed, queue_get_level(&sample_queue));
-            }
-
-        } else {
-            // A fila está vazia (underrun).
-            if (!end_of_file) {
-                printf("AVISO: Fila vazia (Underrun)! A leitura do SD precisa ser mais rápida.\r\n");
-            }
-            tight_loop_contents(); 
-        }
-    }
-    printf("Transmissão SPI concluída. Total de amostras enviadas: %lu\r\n", samples_consumed);
-    
     // ----------------------- Listagem diretorio e Desmontagem ------------------------------
     listarDiretorio(cartao);
     cartao.desmontarSistemaArquivos(); printf("Sistema de arquivos desmontado.\r\n");
@@ -162,78 +347,572 @@ bool listarDiretorio(CartaoSD &cartao){
     return true;
 }
 
-// Funcao para iniciar a fila
-void setup_sample_queue() {
-    // Inicializa a fila: tamanho do item (Sample16BitStereo) e capacidade (SAMPLE_QUEUE_CAPACITY)
-    queue_init(&sample_queue, sizeof(Sample16BitStereo), SAMPLE_QUEUE_CAPACITY);
-    printf("Fila de amostras inicializada (capacidade: %d samples).\r\n", SAMPLE_QUEUE_CAPACITY);
+// Funcao para iniciar o anel
+void setup_anel_amostras() {
+    anel_amostras.cabeca = 0;
+    anel_amostras.cauda = 0;
+    anel_amostras.posicao_leitura = 0;
+    printf("Anel de amostras inicializado (%d blocos de %d bytes, %u samples).\r\n",
+           RING_BLOCK_COUNT, RING_BLOCK_BYTES, (unsigned)(RING_BLOCK_COUNT * RING_SAMPLES_PER_BLOCK));
+}
+
+// Produtor: devolve o slot livre da cabeca para o leitor escrever direto nele, ou NULL se o anel estiver cheio
+uint8_t *anel_bloco_escrita() {
+    uint32_t cabeca = anel_amostras.cabeca;
+    if (cabeca - anel_amostras.cauda >= RING_BLOCK_COUNT) return NULL;
+    __dmb(); // O consumidor terminou de ler o slot antes de ele ser reescrito
+    return anel_amostras.dados[cabeca & (RING_BLOCK_COUNT - 1)];
 }
 
-// Funcao para ler dados do arquivo WAV e encher a fila
-void ler_e_encher_fila(ArquivoSd *wav_file) {
-    uint8_t read_buffer[SD_READ_BLOCK_SIZE];
-    size_t bytes_read = 0;
+// Produtor: entrega o slot preenchido ao consumidor
+void anel_publicar_bloco(uint16_t bytes) {
+    uint32_t cabeca = anel_amostras.cabeca;
+    anel_amostras.bytes_validos[cabeca & (RING_BLOCK_COUNT - 1)] = bytes;
+    __dmb(); // Dados e tamanho do bloco ficam visiveis antes da nova cabeca
+    anel_amostras.cabeca = cabeca + 1;
+}
+
+// Consumidor: devolve o bloco da cauda para leitura direta, ou NULL se o anel estiver vazio
+const uint8_t *anel_bloco_leitura(uint16_t *bytes) {
+    uint32_t cauda = anel_amostras.cauda;
+    if (cauda == anel_amostras.cabeca) return NULL;
+    __dmb(); // So le o bloco depois de ver a cabeca que o publicou
+
+    uint32_t slot = cauda & (RING_BLOCK_COUNT - 1);
+    *bytes = anel_amostras.bytes_validos[slot];
+    return anel_amostras.dados[slot];
+}
+
+// Consumidor: devolve o bloco da cauda ao produtor
+void anel_liberar_bloco() {
+    anel_amostras.posicao_leitura = 0;
+    __dmb(); // Termina a leitura do slot antes de devolve-lo ao produtor
+    anel_amostras.cauda = anel_amostras.cauda + 1;
+}
+
+// Consumidor: le a proxima amostra direto do slot e devolve o bloco quando ele acaba
+bool anel_retirar_amostra(Sample16BitStereo *sample) {
+    uint16_t bytes;
+    const uint8_t *bloco = anel_bloco_leitura(&bytes);
+    if (bloco == NULL) return false;
+
+    *sample = ((const Sample16BitStereo *)bloco)[anel_amostras.posicao_leitura++];
+    if (anel_amostras.posicao_leitura * sizeof(Sample16BitStereo) >= bytes) anel_liberar_bloco();
+    return true;
+}
+
+uint32_t anel_nivel_blocos() {
+    return anel_amostras.cabeca - anel_amostras.cauda;
+}
+
+// Ponto de entrada do core1: le o WAV inteiro para o anel e avisa o core0 ao terminar
+void nucleo1_leitor_sd() {
+    ler_e_encher_anel(contexto_leitor.leitor);
+    leitor_concluido = true;
+}
+
+// Acompanha a reproducao no core0 enquanto a interrupcao do alarme envia as amostras
+void acompanhar_reproducao() {
+    printf("\n--- Reproducao (core1: SD -> anel | core0: alarme -> SPI FPGA) ---\r\n");
+    uint32_t proximo_status = relogio.taxa_amostragem;
+
+    while (relogio.ativo && (!end_of_file || anel_nivel_blocos() > 0)) {
+        // So as janelas do laco ocioso entram na medicao; o printf de status fica de fora
+        uint64_t inicio_janela_us = time_us_64();
+        ocupacao.iteracoes_reproducao += laco_ocioso(inicio_janela_us + OCUPACAO_JANELA_US);
+        ocupacao.tempo_reproducao_us += time_us_64() - inicio_janela_us;
+
+        uint32_t enviadas = medicao.amostras_enviadas;
+        if (enviadas >= proximo_status) { // A cada 1 segundo de audio
+            printf("Tempo: %lu s | Amostras: %lu | Anel: %lu blocos (min %lu) | Underruns: %lu\r\n",
+                   (unsigned long)(enviadas / relogio.taxa_amostragem), (unsigned long)enviadas,
+                   (unsigned long)anel_nivel_blocos(), (unsigned long)medicao.nivel_minimo_anel,
+                   (unsigned long)medicao.underruns);
+            proximo_status += relogio.taxa_amostragem;
+        }
+    }
+}
+
+// Fonte de bytes do LeitorWav sobre o ArquivoSd
+size_t ler_arquivo_wav(void *contexto, uint8_t *destino, size_t tamanho) {
+    return ((ArquivoSd *)contexto)->lerBytes(destino, tamanho);
+}
+
+bool avancar_arquivo_wav(void *contexto, uint32_t bytes) {
+    ArquivoSd *arquivo = (ArquivoSd *)contexto;
+    return arquivo->buscar(arquivo->posicao() + (long)bytes);
+}
+
+// Funcao para ler dados do arquivo WAV direto nos blocos do anel (roda no core1)
+void ler_e_encher_anel(cartao_sd::LeitorWav *leitor) {
+    static uint8_t area_conversao[WAV_CONVERSION_BUFFER_BYTES]; // Fora da pilha de 2 KB do core1
+    const cartao_sd::FormatoWav &formato = leitor->formato();
+    bool leitura_direta = leitor->estereo16Bits();
     size_t total_bytes_read = 0;
 
-    printf("Iniciando leitura dos dados e preenchimento da fila...\r\n");
+    // 16 bits estereo ja e o formato do anel: o primeiro bloco vai ate a fronteira do setor e depois
+    // cada leitura cobre um setor inteiro, que o FatFs le do SPI direto para o slot (leitura antecipada
+    // desligada: uma copia so).
+    // A primeira leitura para em quadro inteiro: com o data em offset 2 mod 4 (fmt de 18 bytes,
+    // LIST impar) os 2 bytes que sobrassem seriam descartados e L/R trocariam ate o fim.
+    size_t tamanho_leitura = leitor->tamanhoPrimeiraLeitura(RING_BLOCK_BYTES);
 
-    do {
-        // Lê um bloco de bytes do arquivo SD
-        bytes_read = wav_file->lerBytes(read_buffer, SD_READ_BLOCK_SIZE);
-        total_bytes_read += bytes_read;
-
-        if (bytes_read > 0) {
-            // Converte os bytes lidos em amostras estéreo de 16 bits
-            // O número de amostras estéreo é bytes_read / (2 canais * 2 bytes/amostra)
-            size_t num_samples = bytes_read / sizeof(Sample16BitStereo);
-            
-            // Cast do buffer de bytes para o array de amostras estéreo
-            Sample16BitStereo *samples = (Sample16BitStereo *)read_buffer;
-
-            // Coloca cada amostra na fila. Tenta colocar na fila (bloqueia se a fila estiver cheia)
-            for (size_t i = 0; i < num_samples; ++i) {
-                queue_add_blocking(&sample_queue, &samples[i]);
-            }
+    printf("Iniciando leitura dos dados e preenchimento do anel...\r\n");
+
+    while (!end_of_file) {
+        uint8_t *bloco = anel_bloco_escrita();
+        if (bloco == NULL) {
+            // Anel cheio: o consumidor no core0 libera um bloco a cada RING_SAMPLES_PER_BLOCK amostras
+            tight_loop_contents();
+            continue;
         }
-        
-        if (bytes_read < SD_READ_BLOCK_SIZE) {
+
+        size_t bytes_amostras;
+        bool fim;
+        if (leitura_direta) {
+            size_t bytes_read = leitor->lerDados(bloco, tamanho_leitura);
+            total_bytes_read += bytes_read;
+
+            // Publica apenas amostras estereo completas (4 bytes cada)
+            bytes_amostras = bytes_read - (bytes_read % sizeof(Sample16BitStereo));
+            fim = bytes_read < tamanho_leitura;
+            tamanho_leitura = RING_BLOCK_BYTES;
+        } else {
+            // Mono, 8/24/32 bits ou mais canais: le quadros crus e converte para o slot
+            size_t quadros = leitor->lerQuadrosEstereo16((int16_t *)bloco, RING_SAMPLES_PER_BLOCK,
+                                                         area_conversao, sizeof(area_conversao));
+            total_bytes_read += quadros * formato.alinhamento_bloco;
+            bytes_amostras = quadros * sizeof(Sample16BitStereo);
+            fim = quadros < RING_SAMPLES_PER_BLOCK;
+        }
+
+        if (bytes_amostras > 0) anel_publicar_bloco((uint16_t)bytes_amostras);
+
+        if (fim) {
             end_of_file = true;
             printf("Fim do arquivo alcançado. Total de dados lidos: %zu bytes.\r\n", total_bytes_read);
         }
-
-    } while (bytes_read > 0);
+    }
 }
 
 // Funcao para processar/enviar a amostra lida
-// O FPGA espera 32 bits por amostra (16 bits L + 16 bits R), e o Raspberry Pi Pico é Little Endian.
+// O FPGA espera a palavra de comando de audio e 32 bits por quadro (16 bits L + 16 bits R),
+// cada canal MSB primeiro, igual ao modo DMA.
 void processar_amostra(Sample16BitStereo sample) {
-    uint8_t spi_tx_buffer[4]; 
+    uint8_t spi_tx_buffer[6]; 
+
+    // Palavra de comando: audio, endereco ignorado
+    spi_tx_buffer[0] = FPGA_CMD_AUDIO;
+    spi_tx_buffer[1] = 0x00;
 
     // Canal Esquerdo (Left) (16 bits)
-    // Little Endian: Byte menos significativo primeiro (LSB)
-    spi_tx_buffer[0] = (uint8_t)(sample.left & 0xFF);
-    spi_tx_buffer[1] = (uint8_t)((sample.left >> 8) & 0xFF);
+    // Byte mais significativo primeiro (MSB)
+    spi_tx_buffer[2] = (uint8_t)((sample.left >> 8) & 0xFF);
+    spi_tx_buffer[3] = (uint8_t)(sample.left & 0xFF);
 
     // Canal Direito (Right) (16 bits)
-    spi_tx_buffer[2] = (uint8_t)(sample.right & 0xFF);
-    spi_tx_buffer[3] = (uint8_t)((sample.right >> 8) & 0xFF);
+    spi_tx_buffer[4] = (uint8_t)((sample.right >> 8) & 0xFF);
+    spi_tx_buffer[5] = (uint8_t)(sample.right & 0xFF);
     
     // Ativa o Chip Select (CS) - Nível baixo (0)
     gpio_put(PINO_SPI_CS_FPGA, 0); 
     
-    // Envia 4 bytes (32 bits) via SPI
-    spi_write_blocking(SPI_FPGA, spi_tx_buffer, 4);
+    // Envia 6 bytes (comando + 32 bits) via SPI
+    spi_write_blocking(SPI_FPGA, spi_tx_buffer, 6);
 
     // Desativa o Chip Select (CS) - Nível alto (1)
     gpio_put(PINO_SPI_CS_FPGA, 1);
 }
 
+// Instante ideal do tick n, calculado a partir do inicio para nao acumular o truncamento
+static inline uint64_t alvo_tick_us(uint32_t tick) {
+    return relogio.inicio_us + ((uint64_t)tick * 1000000u) / relogio.taxa_amostragem;
+}
+
+// Anel vazio antes do fim do arquivo. O rastreamento congela na propria interrupcao: o que o core1
+// fazia no cartao ate ali fica no anel, sem eventos posteriores ao underrun por cima.
+static inline void registrar_underrun() {
+    medicao.underruns++;
+#ifdef CARTAO_SD_RASTREAMENTO
+    cartao_sd::pausarRastreamento(true);
+#endif
+}
+
+// Interrupcao do alarme: envia uma amostra por tick e agenda o proximo tick
+void tratar_alarme_amostra(uint alarm_num) {
+    bool atrasado = false;
+
+    do {
+        uint32_t tick = relogio.proximo_tick;
+        uint64_t agora = time_us_64();
+        uint64_t alvo = alvo_tick_us(tick);
+        uint32_t atraso = (agora > alvo) ? (uint32_t)(agora - alvo) : 0u;
+
+        if (atraso > medicao.atraso_max_us) medicao.atraso_max_us = atraso;
+        medicao.soma_atraso_us += atraso;
+        medicao.ultimo_tick_us = agora;
+        if (atrasado) medicao.ticks_atrasados++;
+
+        Sample16BitStereo sample;
+        if (anel_retirar_amostra(&sample)) {
+            processar_amostra(sample);
+            medicao.amostras_enviadas++;
+
+            uint32_t nivel = anel_nivel_blocos();
+            if (nivel < medicao.nivel_minimo_anel) medicao.nivel_minimo_anel = nivel;
+        } else if (!end_of_file) {
+            registrar_underrun();
+        }
+
+        relogio.proximo_tick = tick + 1;
+        servico_registradores_fpga();
+        if (!relogio.ativo) return;
+
+        // hardware_alarm_set_target devolve true se o alvo ja passou: atende o tick imediatamente
+        atrasado = hardware_alarm_set_target(alarm_num, from_us_since_boot(alvo_tick_us(relogio.proximo_tick)));
+    } while (atrasado);
+}
+
+void iniciar_relogio_amostras(uint32_t taxa_amostragem) {
+    relogio.taxa_amostragem = taxa_amostragem;
+    relogio.proximo_tick = 0;
+    relogio.alarme = hardware_alarm_claim_unused(true);
+    hardware_alarm_set_callback(relogio.alarme, tratar_alarme_amostra);
+
+    // Pequena folga antes do primeiro tick
+    relogio.inicio_us = time_us_64() + 1000u;
+    relogio.ativo = true;
+    hardware_alarm_set_target(relogio.alarme, from_us_since_boot(relogio.inicio_us));
+    printf("Relogio de amostras iniciado a %lu Hz (alarme %d).\r\n", (unsigned long)taxa_amostragem, relogio.alarme);
+}
+
+void parar_relogio_amostras() {
+    if (relogio.alarme < 0) return;
+    relogio.ativo = false;
+    hardware_alarm_cancel(relogio.alarme);
+    hardware_alarm_set_callback(relogio.alarme, NULL);
+    hardware_alarm_unclaim(relogio.alarme);
+    relogio.alarme = -1;
+}
+
+// Jitter: atraso de cada tick em relacao ao alvo ideal. Deriva: tempo real do ultimo tick contra o ideal.
+// So no modo SAIDA_FPGA_POR_AMOSTRA; nos modos DMA o jitter e a deriva saem em relatar_saida_dma.
+void relatar_relogio_amostras() {
+    uint32_t ticks = relogio.proximo_tick;
+    if (ticks == 0) return;
+
+    uint64_t duracao_ideal_us = alvo_tick_us(ticks - 1) - relogio.inicio_us;
+    uint64_t duracao_real_us = medicao.ultimo_tick_us - relogio.inicio_us;
+    int64_t deriva_us = (int64_t)duracao_real_us - (int64_t)duracao_ideal_us;
+
+    printf("Relogio de amostras: %lu ticks a %lu Hz\r\n", (unsigned long)ticks, (unsigned long)relogio.taxa_amostragem);
+    printf("  jitter: medio %lu us | maximo %lu us | ticks atrasados %lu\r\n",
+           (unsigned long)(medicao.soma_atraso_us / ticks), (unsigned long)medicao.atraso_max_us,
+           (unsigned long)medicao.ticks_atrasados);
+    printf("  deriva: %lld us em %llu us de audio | underruns: %lu\r\n",
+           (long long)deriva_us, (unsigned long long)duracao_ideal_us, (unsigned long)medicao.underruns);
+}
+
+// Melhor fracao X/Y (16 bits cada) para o temporizador DMA gerar taxa_palavras a partir de clk_sys
+void calcular_fracao_temporizador(uint32_t taxa_palavras, uint16_t *x, uint16_t *y) {
+    uint64_t clk = clock_get_hz(clk_sys);
+    uint64_t melhor_erro = UINT64_MAX;
+    uint32_t melhor_y = 1;
+    *x = 1;
+    *y = 0xFFFF;
+
+    for (uint32_t candidato_y = 1; candidato_y <= 0xFFFF; candidato_y++) {
+        uint64_t candidato_x = ((uint64_t)taxa_palavras * candidato_y + clk / 2) / clk;
+        if (candidato_x == 0 || candidato_x > 0xFFFF) continue;
+
+        // Erro da taxa = |X * clk - taxa * Y| / Y; compara em produto cruzado para ficar em inteiros
+        uint64_t gerado = candidato_x * clk;
+        uint64_t desejado = (uint64_t)taxa_palavras * candidato_y;
+        uint64_t erro = (gerado > desejado) ? gerado - desejado : desejado - gerado;
+        if (erro * melhor_y < melhor_erro * candidato_y) {
+            melhor_erro = erro;
+            melhor_y = candidato_y;
+            *x = (uint16_t)candidato_x;
+            *y = (uint16_t)candidato_y;
+            if (erro == 0) break;
+        }
+    }
+}
+
+// Mede o inicio de uma rajada. amostras_rajada ainda e a da rajada anterior: o FPGA gasta
+// amostras_rajada / taxa para consumi-la, e esse e o intervalo ideal ate este inicio.
+static void registrar_inicio_rajada(uint64_t agora) {
+    if (!saida_dma.ritmo_estavel) return;
+
+    if (saida_dma.rajadas_ritmadas == 0) {
+        saida_dma.referencia_us = agora;
+        saida_dma.referencia_amostras = saida_dma.amostras_rajadas;
+    } else {
+        uint64_t ideal = (uint64_t)saida_dma.amostras_rajada * 1000000u / relogio.taxa_amostragem;
+        uint64_t real = agora - saida_dma.ultimo_inicio_us;
+        uint32_t desvio = (uint32_t)((real > ideal) ? real - ideal : ideal - real);
+        if (desvio > saida_dma.desvio_max_us) saida_dma.desvio_max_us = desvio;
+        saida_dma.soma_desvio_us += desvio;
+    }
+    saida_dma.rajadas_ritmadas++;
+    saida_dma.ultimo_inicio_us = agora;
+    saida_dma.ultimo_inicio_amostras = saida_dma.amostras_rajadas;
+}
+
+// Comeca a proxima rajada: um bloco do anel ou, se ele estiver vazio, um trecho curto de silencio
+static void iniciar_rajada_dma() {
+    uint64_t agora = time_us_64();
+    registrar_inicio_rajada(agora);
+
+    uint16_t bytes = 0;
+    const uint8_t *bloco = anel_bloco_leitura(&bytes);
+    const void *origem;
+
+    if (bloco != NULL) {
+        origem = bloco;
+        saida_dma.bloco_do_anel = true;
+        saida_dma.amostras_rajada = bytes / sizeof(Sample16BitStereo);
+    } else {
+        if (!end_of_file) registrar_underrun();
+        origem = silencio_fpga;
+        saida_dma.bloco_do_anel = false;
+        saida_dma.amostras_rajada = SILENCIO_SAMPLES;
+    }
+
+    // A palavra de comando vai direto para a FIFO do SPI; o DMA entra atras dela no ritmo do temporizador
+    saida_dma.amostras_rajadas += saida_dma.amostras_rajada;
+    saida_dma.em_rajada = true;
+    saida_dma.inicio_rajada_us = agora;
+    gpio_put(PINO_SPI_CS_FPGA, 0);
+    spi_get_hw(SPI_FPGA)->dr = (uint32_t)FPGA_CMD_AUDIO << 8;
+    dma_channel_set_read_addr(saida_dma.canal, origem, false);
+    dma_channel_set_trans_count(saida_dma.canal, saida_dma.amostras_rajada * 2, true); // 2 palavras por amostra
+}
+
+// Interrupcao de fim de rajada: fecha o quadro com o CS, devolve o bloco e encadeia a proxima rajada
+void tratar_fim_rajada_dma() {
+    dma_channel_acknowledge_irq1(saida_dma.canal);
+
+    // O DMA termina ao escrever a ultima palavra na FIFO; espera o SPI desloca-la antes de subir o CS
+    while (spi_is_busy(SPI_FPGA)) tight_loop_contents();
+    gpio_put(PINO_SPI_CS_FPGA, 1);
+    saida_dma.rajadas++;
+    saida_dma.tempo_rajadas_us += time_us_64() - saida_dma.inicio_rajada_us;
+
+    if (saida_dma.bloco_do_anel) {
+        medicao.amostras_enviadas += saida_dma.amostras_rajada;
+        anel_liberar_bloco();
+
+        uint32_t nivel = anel_nivel_blocos();
+        if (nivel < medicao.nivel_minimo_anel) medicao.nivel_minimo_anel = nivel;
+    }
+
+    busy_wait_at_least_cycles(CS_FPGA_MIN_ALTO_CICLOS);
+    servico_registradores_fpga();
+
+    saida_dma.em_rajada = false;
+    if (!relogio.ativo) return;
+    if (end_of_file && anel_nivel_blocos() == 0) {
+        relogio.ativo = false; // Ultimo bloco enviado
+        return;
+    }
+
+#if SAIDA_FPGA_MODO == SAIDA_FPGA_SOB_PEDIDO
+    // FIFO do FPGA sem espaco: a borda de subida do pedido retoma a saida em tratar_pedido_fpga
+    if (!gpio_get(PINO_PEDIDO_FPGA)) {
+        saida_dma.esperas++;
+        return;
+    }
+#endif
+    iniciar_rajada_dma();
+}
+
+// Borda de subida do pedido do FPGA. Tem a mesma prioridade da interrupcao do DMA, entao nao a
+// interrompe: ou a rajada anterior ja viu o pedido baixo e parou, ou ainda vai ver o pedido alto.
+void tratar_pedido_fpga(uint gpio, uint32_t eventos) {
+    if (gpio != PINO_PEDIDO_FPGA || !(eventos & GPIO_IRQ_EDGE_RISE)) return;
+    if (!relogio.ativo || saida_dma.em_rajada) return;
+    if (end_of_file && anel_nivel_blocos() == 0) return;
+    servico_registradores_fpga(); // Transacao que chegou enquanto a saida esperava o FPGA
+    // A FIFO do FPGA encheu e pediu mais: daqui em diante os inicios seguem o relogio de amostras dele
+    saida_dma.ritmo_estavel = true;
+    iniciar_rajada_dma();
+}
+
+void iniciar_saida_dma(uint32_t taxa_amostragem) {
+    relogio.taxa_amostragem = taxa_amostragem;
+
+    // Memoria (16 bits, incrementa) -> SPI1 DR (fixo), uma palavra por pulso do temporizador
+    // ou, sob pedido, sempre que a FIFO de transmissao do SPI tiver lugar
+    saida_dma.canal = dma_claim_unused_channel(true);
+    dma_channel_config config = dma_channel_get_default_config(saida_dma.canal);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_16);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, false);
+#if SAIDA_FPGA_MODO == SAIDA_FPGA_SOB_PEDIDO
+    channel_config_set_dreq(&config, spi_get_dreq(SPI_FPGA, true));
+#else
+    calcular_fracao_temporizador(taxa_amostragem * 2, &saida_dma.fracao_x, &saida_dma.fracao_y);
+    saida_dma.temporizador = dma_claim_unused_timer(true);
+    dma_timer_set_fraction(saida_dma.temporizador, saida_dma.fracao_x, saida_dma.fracao_y);
+    channel_config_set_dreq(&config, dma_get_timer_dreq(saida_dma.temporizador));
+#endif
+    dma_channel_configure(saida_dma.canal, &config, &spi_get_hw(SPI_FPGA)->dr, NULL, 0, false);
+
+    // DMA_IRQ_1 fica so para a saida; o driver do cartao usa o DMA sem interrupcao
+    dma_channel_set_irq1_enabled(saida_dma.canal, true);
+    irq_set_exclusive_handler(DMA_IRQ_1, tratar_fim_rajada_dma);
+    irq_set_enabled(DMA_IRQ_1, true);
+
+    saida_dma.rajadas = 0;
+    saida_dma.esperas = 0;
+    saida_dma.tempo_rajadas_us = 0;
+    saida_dma.amostras_rajadas = 0;
+    saida_dma.rajadas_ritmadas = 0;
+    saida_dma.desvio_max_us = 0;
+    saida_dma.soma_desvio_us = 0;
+    // Com o temporizador DMA o ritmo vale desde a primeira rajada; sob pedido, so depois de encher o FPGA
+    saida_dma.ritmo_estavel = (SAIDA_FPGA_MODO != SAIDA_FPGA_SOB_PEDIDO);
+    relogio.inicio_us = time_us_64();
+    relogio.ativo = true;
+
+#if SAIDA_FPGA_MODO == SAIDA_FPGA_SOB_PEDIDO
+    gpio_set_irq_enabled_with_callback(PINO_PEDIDO_FPGA, GPIO_IRQ_EDGE_RISE, true, tratar_pedido_fpga);
+
+    // Com a FIFO do FPGA vazia o pedido ja esta alto e nao havera borda: comeca aqui
+    uint32_t estado_irq = save_and_disable_interrupts();
+    if (gpio_get(PINO_PEDIDO_FPGA) && !saida_dma.em_rajada) iniciar_rajada_dma();
+    restore_interrupts(estado_irq);
+
+    printf("Saida DMA sob pedido iniciada: rajadas de %u amostras a %lu Hz de SCLK (canal %d, pedido em GP%u).\r\n",
+           (unsigned)RING_SAMPLES_PER_BLOCK, (unsigned long)spi_get_baudrate(SPI_FPGA), saida_dma.canal, PINO_PEDIDO_FPGA);
+#else
+    iniciar_rajada_dma();
+
+    uint64_t taxa_mhz = (uint64_t)clock_get_hz(clk_sys) * saida_dma.fracao_x * 1000u / saida_dma.fracao_y / 2u;
+    printf("Saida DMA iniciada: %lu Hz pedidos, %llu.%03llu Hz gerados (X/Y = %u/%u, canal %d, temporizador %d).\r\n",
+           (unsigned long)taxa_amostragem, (unsigned long long)(taxa_mhz / 1000u), (unsigned long long)(taxa_mhz % 1000u),
+           saida_dma.fracao_x, saida_dma.fracao_y, saida_dma.canal, saida_dma.temporizador);
+#endif
+}
+
+void parar_saida_dma() {
+    if (saida_dma.canal < 0) return;
+    relogio.ativo = false;
+#if SAIDA_FPGA_MODO == SAIDA_FPGA_SOB_PEDIDO
+    gpio_set_irq_enabled(PINO_PEDIDO_FPGA, GPIO_IRQ_EDGE_RISE, false);
+#endif
+    while (dma_channel_is_busy(saida_dma.canal)) tight_loop_contents(); // Deixa a rajada atual terminar
+
+    irq_set_enabled(DMA_IRQ_1, false);
+    dma_channel_set_irq1_enabled(saida_dma.canal, false);
+    dma_channel_acknowledge_irq1(saida_dma.canal);
+    dma_channel_unclaim(saida_dma.canal);
+    if (saida_dma.temporizador >= 0) dma_timer_unclaim(saida_dma.temporizador);
+    gpio_put(PINO_SPI_CS_FPGA, 1);
+    saida_dma.canal = -1;
+    saida_dma.temporizador = -1;
+}
+
+void relatar_saida_dma() {
+    uint64_t duracao_us = time_us_64() - relogio.inicio_us;
+    printf("Saida DMA: %lu rajadas, %lu amostras | anel min %lu blocos | underruns: %lu | %llu us\r\n",
+           (unsigned long)saida_dma.rajadas, (unsigned long)medicao.amostras_enviadas,
+           (unsigned long)medicao.nivel_minimo_anel, (unsigned long)medicao.underruns,
+           (unsigned long long)duracao_us);
+
+    // Vazao dentro das rajadas: limitada so pelo SCLK (32 bits por amostra + 16 de comando por rajada)
+    if (saida_dma.tempo_rajadas_us > 0) {
+        uint64_t amostras_por_s = (uint64_t)medicao.amostras_enviadas * 1000000u / saida_dma.tempo_rajadas_us;
+        printf("  link: %llu amostras/s dentro das rajadas | %llu us com o CS baixo | esperas pelo pedido: %lu\r\n",
+               (unsigned long long)amostras_por_s, (unsigned long long)saida_dma.tempo_rajadas_us,
+               (unsigned long)saida_dma.esperas);
+    }
+
+    // Jitter: desvio de cada intervalo entre inicios de rajada. Deriva: ultimo inicio contra o ideal
+    // das amostras enviadas desde a referencia (sob pedido, o relogio do FPGA contra o do Pico).
+    if (saida_dma.rajadas_ritmadas > 1) {
+        uint32_t intervalos = saida_dma.rajadas_ritmadas - 1;
+        uint32_t amostras = saida_dma.ultimo_inicio_amostras - saida_dma.referencia_amostras;
+        uint64_t duracao_ideal_us = (uint64_t)amostras * 1000000u / relogio.taxa_amostragem;
+        uint64_t duracao_real_us = saida_dma.ultimo_inicio_us - saida_dma.referencia_us;
+        int64_t deriva_us = (int64_t)duracao_real_us - (int64_t)duracao_ideal_us;
+
+        printf("  jitter das rajadas: medio %lu us | maximo %lu us em %lu intervalos\r\n",
+               (unsigned long)(saida_dma.soma_desvio_us / intervalos), (unsigned long)saida_dma.desvio_max_us,
+               (unsigned long)intervalos);
+        printf("  deriva: %lld us em %llu us de audio\r\n",
+               (long long)deriva_us, (unsigned long long)duracao_ideal_us);
+    }
+}
+
+void iniciar_saida_audio(uint32_t taxa_amostragem) {
+    // O FPGA tira as amostras da FIFO no proprio relogio: ele precisa rodar na taxa do WAV
+    fpga_definir_taxa(taxa_amostragem);
+
+#if SAIDA_FPGA_USA_DMA
+    iniciar_saida_dma(taxa_amostragem);
+#else
+    iniciar_relogio_amostras(taxa_amostragem);
+#endif
+}
+
+void parar_saida_audio() {
+#if SAIDA_FPGA_USA_DMA
+    parar_saida_dma();
+#else
+    parar_relogio_amostras();
+#endif
+}
+
+void relatar_saida_audio() {
+#if SAIDA_FPGA_USA_DMA
+    relatar_saida_dma();
+#else
+    relatar_relogio_amostras();
+#endif
+}
+
+// Laco ocioso do core0: conta iteracoes ate o instante dado. Interrupcoes de audio roubam iteracoes.
+uint32_t __no_inline_not_in_flash_func(laco_ocioso)(uint64_t ate_us) {
+    uint32_t iteracoes = 0;
+    while (time_us_64() < ate_us) iteracoes++;
+    return iteracoes;
+}
+
+void calibrar_ocupacao() {
+    ocupacao.iteracoes_livres = laco_ocioso(time_us_64() + OCUPACAO_CALIBRACAO_US);
+    ocupacao.iteracoes_reproducao = 0;
+    ocupacao.tempo_reproducao_us = 0;
+}
+
+// Ocupacao = 1 - iteracoes na reproducao / iteracoes esperadas sem audio no mesmo tempo
+void relatar_ocupacao() {
+    if (ocupacao.iteracoes_livres == 0 || ocupacao.tempo_reproducao_us == 0) return;
+
+    uint64_t esperadas = ocupacao.iteracoes_livres * ocupacao.tempo_reproducao_us / OCUPACAO_CALIBRACAO_US;
+    uint64_t livres_milesimos = (esperadas == 0) ? 0 : ocupacao.iteracoes_reproducao * 1000u / esperadas;
+    if (livres_milesimos > 1000u) livres_milesimos = 1000u;
+    uint32_t ocupado = (uint32_t)(1000u - livres_milesimos);
+
+    printf("Ocupacao do core0 com a saida %s: %lu.%lu %% (%llu de %llu iteracoes ociosas)\r\n",
+           (SAIDA_FPGA_MODO == SAIDA_FPGA_SOB_PEDIDO) ? "DMA sob pedido" :
+           (SAIDA_FPGA_MODO == SAIDA_FPGA_DMA_BLOCOS) ? "DMA em blocos" : "por amostra",
+           (unsigned long)(ocupado / 10u), (unsigned long)(ocupado % 10u),
+           (unsigned long long)ocupacao.iteracoes_reproducao, (unsigned long long)esperadas);
+}
+
 void setup_spi_fpga() {
     // Configura o SPI1 para comunicação com o FPGA
     printf("Configurando SPI para o FPGA (Pinos: MOSI=GP3, SCK=GP2, CS=GP1).\r\n");
 
-    // Inicializa o periférico SPI1. Taxa de clock: 10MHz <----------pode ser ajustada
-    spi_init(SPI_FPGA, 1000 * 1000 * 10); 
+    // Inicializa o periférico SPI1. Taxa de clock: 6,25MHz (125 MHz / 20), o maximo do receptor do FPGA
+    spi_init(SPI_FPGA, FPGA_SPI_BAUD); 
+
+#if SAIDA_FPGA_USA_DMA
+    // Quadros de 16 bits saem MSB primeiro: cada palavra do DMA e um canal inteiro, L e R alternados
+    spi_set_format(SPI_FPGA, 16, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+#endif
 
     // Configura os GPIOs para a função SPI.
     gpio_set_function(PINO_SPI_MISO_FPGA, GPIO_FUNC_SPI);
@@ -245,6 +924,125 @@ void setup_spi_fpga() {
     gpio_init(PINO_SPI_CS_FPGA);
     gpio_set_dir(PINO_SPI_CS_FPGA, GPIO_OUT);
     gpio_put(PINO_SPI_CS_FPGA, 1); // CS inativo (nível alto)
+
+    // Linha de pedido do FPGA: com o FPGA desligado ou sem o fio fica em 0 e a saida sob pedido espera
+    gpio_init(PINO_PEDIDO_FPGA);
+    gpio_set_dir(PINO_PEDIDO_FPGA, GPIO_IN);
+    gpio_pull_down(PINO_PEDIDO_FPGA);
     
     printf("SPI FPGA configurado.\r\n");
-}
\ No newline at end of file
+}
+// Executa a transacao pendente com o CS alto; chamada pelas interrupcoes da saida entre dois envios
+// de audio ou direto pelo laco principal quando a saida esta parada. Leituras baixam o SCLK para
+// FPGA_SPI_BAUD_LEITURA: uma leitura de N palavras ocupa (N + 1) * 16 us e atrasa o proximo envio.
+void servico_registradores_fpga() {
+    if (!transacao_fpga.pendente) return;
+
+    uint16_t cabecalho = (uint16_t)((transacao_fpga.comando << 8) | transacao_fpga.endereco);
+    bool leitura = (transacao_fpga.comando == FPGA_CMD_LEITURA);
+
+#if !SAIDA_FPGA_USA_DMA
+    spi_set_format(SPI_FPGA, 16, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+#endif
+    if (leitura) spi_set_baudrate(SPI_FPGA, FPGA_SPI_BAUD_LEITURA);
+
+    gpio_put(PINO_SPI_CS_FPGA, 0);
+    spi_write16_blocking(SPI_FPGA, &cabecalho, 1); // Tambem descarta o que o MISO trouxe durante o audio
+    if (leitura) spi_read16_blocking(SPI_FPGA, 0x0000, transacao_fpga.dados, transacao_fpga.palavras);
+    else spi_write16_blocking(SPI_FPGA, transacao_fpga.dados, transacao_fpga.palavras);
+    gpio_put(PINO_SPI_CS_FPGA, 1);
+
+    if (leitura) spi_set_baudrate(SPI_FPGA, FPGA_SPI_BAUD);
+#if !SAIDA_FPGA_USA_DMA
+    spi_set_format(SPI_FPGA, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+#endif
+
+    busy_wait_at_least_cycles(CS_FPGA_MIN_ALTO_CICLOS);
+    __dmb(); // Dados lidos visiveis antes de liberar o laco principal
+    transacao_fpga.pendente = false;
+}
+
+// Entrega a transacao a interrupcao da saida e espera ela terminar. Com a saida parada nao ha
+// rajada em andamento e a transacao roda aqui mesmo. No modo sob pedido a saida pode ficar parada
+// esperando um pedido que nao vem (FPGA em reset ou reconfigurado, DAC travado): depois de
+// FPGA_TRANSACAO_TIMEOUT_US a transacao roda aqui com as interrupcoes mascaradas, se nao houver
+// rajada em andamento, ou e abandonada e a funcao devolve false.
+static bool transacao_registradores_fpga(uint8_t comando, uint8_t endereco, uint16_t *dados, uint8_t palavras) {
+    if (palavras == 0 || transacao_fpga.pendente) return false;
+
+    transacao_fpga.comando = comando;
+    transacao_fpga.endereco = endereco;
+    transacao_fpga.dados = dados;
+    transacao_fpga.palavras = palavras;
+    __dmb(); // Campos prontos antes da interrupcao ver o pedido
+    transacao_fpga.pendente = true;
+
+    // pendente e marcado antes de olhar o relogio: a ultima interrupcao da saida ainda atende o pedido
+    if (!relogio.ativo) servico_registradores_fpga();
+
+    uint64_t limite_us = time_us_64() + FPGA_TRANSACAO_TIMEOUT_US;
+    while (transacao_fpga.pendente && time_us_64() < limite_us) tight_loop_contents();
+    if (!transacao_fpga.pendente) return true;
+
+    // Com as interrupcoes mascaradas nenhuma rajada comeca nem termina enquanto a decisao e tomada
+    bool atendida = true;
+    uint32_t estado_irq = save_and_disable_interrupts();
+    if (transacao_fpga.pendente) {
+        if (!saida_dma.em_rajada) {
+            servico_registradores_fpga();
+        } else {
+            transacao_fpga.pendente = false; // Rajada que nao termina: o DMA nao vai atender o pedido
+            atendida = false;
+        }
+    }
+    restore_interrupts(estado_irq);
+    return atendida;
+}
+
+bool fpga_escrever_registradores(uint8_t endereco, const uint16_t *valores, uint8_t palavras) {
+    return transacao_registradores_fpga(FPGA_CMD_ESCRITA, endereco, (uint16_t *)valores, palavras);
+}
+
+bool fpga_ler_registradores(uint8_t endereco, uint16_t *valores, uint8_t palavras) {
+    return transacao_registradores_fpga(FPGA_CMD_LEITURA, endereco, valores, palavras);
+}
+
+bool fpga_definir_bypass(uint16_t mascara) {
+    return fpga_escrever_registradores(FPGA_REG_BYPASS, &mascara, 1);
+}
+
+bool fpga_definir_parametro(uint8_t estagio, uint16_t valor) {
+    return fpga_escrever_registradores((uint8_t)(FPGA_REG_PARAMETRO + estagio), &valor, 1);
+}
+
+// estagios[p] = estagio que roda na posicao p; ORDEM_HI e ORDEM vao na mesma rajada e a ordem
+// inteira e aplicada de uma vez, com a cadeia vazia entre dois quadros
+bool fpga_definir_ordem(const uint8_t *estagios, uint8_t quantidade) {
+    if (quantidade > 8) return false;
+
+    uint32_t ordem = 0x76543210u; // Posicoes nao informadas ficam na ordem fixa
+    for (uint8_t p = 0; p < quantidade; p++) {
+        ordem &= ~(0xFu << (4u * p));
+        ordem |= (uint32_t)(estagios[p] & 0xFu) << (4u * p);
+    }
+
+    uint16_t palavras[2] = { (uint16_t)(ordem >> 16), (uint16_t)ordem };
+    return fpga_escrever_registradores(FPGA_REG_ORDEM_HI, palavras, 2);
+}
+
+bool fpga_definir_taxa(uint32_t taxa_amostragem) {
+    uint16_t palavras[2] = { (uint16_t)(taxa_amostragem >> 16), (uint16_t)taxa_amostragem };
+    return fpga_escrever_registradores(FPGA_REG_TAXA_HI, palavras, 2);
+}
+
+// Diagnostico do lado do FPGA, lido de uma vez do STATUS ao OVERFLOWS
+void relatar_fpga() {
+    uint16_t regs[6] = { 0 };
+    if (!fpga_ler_registradores(FPGA_REG_STATUS, regs, 6)) return;
+
+    uint32_t quadros = ((uint32_t)regs[FPGA_REG_QUADROS_HI - FPGA_REG_STATUS] << 16) | regs[FPGA_REG_QUADROS_LO - FPGA_REG_STATUS];
+    printf("FPGA: %lu quadros recebidos | FIFO %u quadros | underflows %u | overflows %u | flags %s%s\r\n",
+           (unsigned long)quadros, regs[FPGA_REG_FIFO_NIVEL - FPGA_REG_STATUS],
+           regs[FPGA_REG_UNDERFLOWS - FPGA_REG_STATUS], regs[FPGA_REG_OVERFLOWS - FPGA_REG_STATUS],
+           (regs[0] & 0x1) ? "overflow " : "", (regs[0] & 0x2) ? "underflow" : "");
+}